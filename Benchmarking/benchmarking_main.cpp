@@ -1,5 +1,22 @@
+#include "backprop.hpp"
+#include "cached_neural_net.hpp"
+#include "dynamic_neural_net.hpp"
+#include "neat_neural_net.hpp"
+#include "net_arena.hpp"
+#include "net_image.hpp"
+#include "population_neural_net.hpp"
+#include "static_neural_net.hpp"
+#include <algorithm>
+#include <array>
 #include <benchmark/benchmark.h>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
 
 static void BM_StringCreation(benchmark::State& state)
 {
@@ -49,5 +66,702 @@ static void hand_mul(benchmark::State& state)
 BENCHMARK(std_Pow);
 BENCHMARK(hand_mul);
 
+//-----------------------------------------------------------------------------
+//------------ Tiny dense layers  ---------------------------------------------
+//-----------------------------------------------------------------------------
 
-BENCHMARK_MAIN();
\ No newline at end of file
+// Layer shapes of the proof of concept net [1, 16, 16, 32, 64, 1] and of the
+// Connect Four nets [42, 9, 1], one input row: the generic fused dense kernel
+// against the unrolled one ga_sm::multiply_add_activate picks for them.
+
+template <std::size_t K, std::size_t N>
+struct dense_operands
+{
+    alignas(64) float a[K]{};
+    alignas(64) float w[K * N]{};
+    alignas(64) float bias[N]{};
+    alignas(64) float c[N]{};
+
+    dense_operands()
+    {
+        std::ranges::generate(a, [] { return random::randnormal(0.f, 1.f); });
+        std::ranges::generate(w, [] { return random::randnormal(0.f, 1.f); });
+        std::ranges::generate(bias, [] {
+            return random::randnormal(0.f, 1.f);
+        });
+    }
+};
+
+inline constexpr auto relu = [](float x) { return std::max(0.f, x); };
+
+template <std::size_t K, std::size_t N>
+static void dense_generic(benchmark::State& state)
+{
+    auto op = std::make_unique<dense_operands<K, N>>();
+    for (auto _ : state)
+    {
+        ga_sm::simd::dense<float, 1, K, N>(
+            op->a, K, op->w, N, op->bias, op->c, N, relu
+        );
+        benchmark::DoNotOptimize(op->c);
+        benchmark::ClobberMemory();
+    }
+}
+
+template <std::size_t K, std::size_t N>
+static void dense_unrolled(benchmark::State& state)
+{
+    auto op = std::make_unique<dense_operands<K, N>>();
+    for (auto _ : state)
+    {
+        ga_sm::simd::dense_unrolled<float, 1, K, N, K, N, N>(
+            op->a, op->w, op->bias, op->c, relu
+        );
+        benchmark::DoNotOptimize(op->c);
+        benchmark::ClobberMemory();
+    }
+}
+
+// The same layers on output-major weights, see ga_snn::weight_layout
+template <std::size_t K, std::size_t N>
+static void dense_transposed(benchmark::State& state)
+{
+    auto op = std::make_unique<dense_operands<K, N>>();
+    for (auto _ : state)
+    {
+        ga_sm::simd::dense_transposed<float, 1, K, N, K, K, N>(
+            op->a, op->w, op->bias, op->c, relu
+        );
+        benchmark::DoNotOptimize(op->c);
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK(dense_generic<1, 16>);
+BENCHMARK(dense_unrolled<1, 16>);
+BENCHMARK(dense_generic<16, 16>);
+BENCHMARK(dense_unrolled<16, 16>);
+BENCHMARK(dense_generic<16, 32>);
+BENCHMARK(dense_unrolled<16, 32>);
+BENCHMARK(dense_generic<64, 1>);
+BENCHMARK(dense_unrolled<64, 1>);
+BENCHMARK(dense_generic<42, 9>);
+BENCHMARK(dense_unrolled<42, 9>);
+BENCHMARK(dense_generic<9, 9>);
+BENCHMARK(dense_unrolled<9, 9>);
+BENCHMARK(dense_generic<9, 4>);
+BENCHMARK(dense_unrolled<9, 4>);
+BENCHMARK(dense_transposed<16, 16>);
+BENCHMARK(dense_transposed<16, 32>);
+BENCHMARK(dense_transposed<64, 1>);
+BENCHMARK(dense_transposed<42, 42>);
+BENCHMARK(dense_transposed<42, 9>);
+BENCHMARK(dense_transposed<9, 9>);
+BENCHMARK(dense_transposed<9, 4>);
+
+template <typename NNet>
+static void net_forward_pass(benchmark::State& state)
+{
+    const auto net =
+        ga_snn::static_neural_net_factory<NNet>(random::randnormal, 0.f, 1.f);
+    typename NNet::input_type input{};
+    input.fill(random::randfloat);
+    for (auto _ : state)
+    {
+        auto out = net->forward_pass(input);
+        benchmark::DoNotOptimize(out);
+        benchmark::DoNotOptimize(input);
+    }
+}
+
+namespace tiny_nets
+{
+namespace af = matrix_activation_functions;
+
+inline constexpr ga_snn::Layer_Signature a1{ 1, af::Identifiers::ReLU };
+inline constexpr ga_snn::Layer_Signature a9{ 9, af::Identifiers::ReLU };
+inline constexpr ga_snn::Layer_Signature a16{ 16, af::Identifiers::ReLU };
+inline constexpr ga_snn::Layer_Signature a32{ 32, af::Identifiers::ReLU };
+inline constexpr ga_snn::Layer_Signature a42{ 42, af::Identifiers::ReLU };
+inline constexpr ga_snn::Layer_Signature a64{ 64, af::Identifiers::ReLU };
+inline constexpr ga_snn::Layer_Signature a1_tanh{ 1, af::Identifiers::Tanh };
+
+using proof_of_concept =
+    ga_snn::static_neural_net<float, 1, a1, a16, a16, a32, a64, a1>;
+using connect_four = ga_snn::static_neural_net<float, 1, a42, a9, a1_tanh>;
+
+using proof_of_concept_output_major =
+    proof_of_concept::with_layout<ga_snn::weight_layout::output_major>;
+using connect_four_output_major =
+    connect_four::with_layout<ga_snn::weight_layout::output_major>;
+
+// A net of the smooth activation functions, whose kernels spend as much time
+// in the activations as in the products
+inline constexpr ga_snn::Layer_Signature a8_identity{
+    8, af::Identifiers::Identity
+};
+inline constexpr ga_snn::Layer_Signature a32_gelu{ 32, af::Identifiers::GELU };
+inline constexpr ga_snn::Layer_Signature a32_silu{ 32, af::Identifiers::SiLU };
+inline constexpr ga_snn::Layer_Signature a32_tanh{ 32, af::Identifiers::Tanh };
+inline constexpr ga_snn::Layer_Signature a8_sigmoid{
+    8, af::Identifiers::Sigmoid
+};
+
+using smooth = ga_snn::static_neural_net<
+    float,
+    1,
+    a8_identity,
+    a32_gelu,
+    a32_silu,
+    a32_tanh,
+    a8_sigmoid>;
+using smooth_fast =
+    smooth::with_activation_precision<af::activation_precision::fast>;
+} // namespace tiny_nets
+
+BENCHMARK(net_forward_pass<tiny_nets::proof_of_concept>);
+BENCHMARK(net_forward_pass<tiny_nets::proof_of_concept_output_major>);
+BENCHMARK(net_forward_pass<tiny_nets::connect_four>);
+BENCHMARK(net_forward_pass<tiny_nets::connect_four_output_major>);
+
+// A connect four shaped NEAT net grown by Nodes node and 4 * Nodes
+// connection mutations, run through its compiled plan
+template <std::size_t Nodes>
+static void neat_forward_pass(benchmark::State& state)
+{
+    using neat_net = ga_snn::neat_neural_net<
+        float,
+        42,
+        1,
+        matrix_activation_functions::Identifiers::ReLU,
+        matrix_activation_functions::Identifiers::Tanh>;
+
+    neat_net net;
+    net.init(random::randnormal, 0.f, 1.f);
+    for (std::size_t n = 0; n != Nodes; ++n)
+    {
+        net.mutate_add_node();
+        for (std::size_t c = 0; c != 4; ++c)
+        {
+            net.mutate_add_connection(random::randnormal());
+        }
+    }
+    typename neat_net::input_type input{};
+    input.fill(random::randfloat);
+    for (auto _ : state)
+    {
+        auto out = net.forward_pass(input);
+        benchmark::DoNotOptimize(out);
+        benchmark::DoNotOptimize(input);
+    }
+    state.counters["edges"] = static_cast<double>(net.plan_edge_count());
+}
+
+BENCHMARK(neat_forward_pass<0>);
+BENCHMARK(neat_forward_pass<9>);
+BENCHMARK(neat_forward_pass<64>);
+
+// A generation of 21 nets on Rows inputs: one net at a time and stacked
+// into a population_neural_net
+inline constexpr std::size_t generation_size = 21;
+
+template <typename NNet>
+static auto make_generation() -> std::vector<std::unique_ptr<NNet>>
+{
+    std::vector<std::unique_ptr<NNet>> ret;
+    for (std::size_t p = 0; p != generation_size; ++p)
+    {
+        ret.push_back(ga_snn::static_neural_net_factory<NNet>(
+            random::randnormal, 0.f, 1.f
+        ));
+    }
+    return ret;
+}
+
+template <typename NNet, std::size_t Rows>
+static void generation_forward_pass(benchmark::State& state)
+{
+    const auto nets = make_generation<NNet>();
+    std::array<typename NNet::input_type, Rows> inputs;
+    for (auto& input : inputs)
+    {
+        input.fill(random::randfloat);
+    }
+    for (auto _ : state)
+    {
+        for (auto const& input : inputs)
+        {
+            for (auto const& net : nets)
+            {
+                auto out = net->forward_pass(input);
+                benchmark::DoNotOptimize(out);
+            }
+        }
+        benchmark::DoNotOptimize(inputs);
+    }
+}
+
+template <typename NNet, std::size_t Rows>
+static void population_forward_pass(benchmark::State& state)
+{
+    const auto nets = make_generation<NNet>();
+    std::array<NNet const*, generation_size> ptrs;
+    std::ranges::transform(nets, ptrs.begin(), [](auto const& net) {
+        return net.get();
+    });
+    const auto population = ga_snn::stack_nets<Rows>(ptrs);
+
+    typename std::remove_cvref_t<decltype(*population)>::input_type inputs;
+    inputs.fill(random::randfloat);
+    for (auto _ : state)
+    {
+        auto outs = population->forward_pass(inputs);
+        benchmark::DoNotOptimize(outs);
+        benchmark::DoNotOptimize(inputs);
+    }
+}
+
+BENCHMARK(generation_forward_pass<tiny_nets::proof_of_concept, 1>);
+BENCHMARK(population_forward_pass<tiny_nets::proof_of_concept, 1>);
+BENCHMARK(generation_forward_pass<tiny_nets::proof_of_concept, 8>);
+BENCHMARK(population_forward_pass<tiny_nets::proof_of_concept, 8>);
+BENCHMARK(generation_forward_pass<tiny_nets::connect_four, 1>);
+BENCHMARK(population_forward_pass<tiny_nets::connect_four, 1>);
+BENCHMARK(generation_forward_pass<tiny_nets::connect_four, 8>);
+BENCHMARK(population_forward_pass<tiny_nets::connect_four, 8>);
+
+// Generation turnovers: every net of the next generation made anew as a copy
+// of a parent, one heap allocation each or a slot of a net_arena, then the
+// generation evaluated on one input
+template <typename NNet, bool Arena>
+static void generation_turnover(benchmark::State& state)
+{
+    using pointer_type = std::conditional_t<
+        Arena,
+        ga_snn::arena_ptr<NNet>,
+        std::unique_ptr<NNet>>;
+
+    ga_snn::net_arena<NNet> arena(2 * generation_size);
+    auto make = [&arena](NNet const& parent) -> pointer_type {
+        if constexpr (Arena)
+        {
+            return arena.make(parent);
+        }
+        else
+        {
+            return std::make_unique<NNet>(parent);
+        }
+    };
+
+    std::vector<pointer_type> current;
+    std::vector<pointer_type> next(generation_size);
+    for (auto const& net : make_generation<NNet>())
+    {
+        current.push_back(make(*net));
+    }
+    typename NNet::input_type input;
+    input.fill(random::randfloat);
+
+    for (auto _ : state)
+    {
+        for (std::size_t p = 0; p != generation_size; ++p)
+        {
+            next[p].reset();
+            next[p] = make(*current[p * 5 % generation_size]);
+        }
+        std::swap(current, next);
+        for (auto const& net : current)
+        {
+            auto out = net->forward_pass(input);
+            benchmark::DoNotOptimize(out);
+        }
+    }
+}
+
+BENCHMARK(generation_turnover<tiny_nets::proof_of_concept, false>);
+BENCHMARK(generation_turnover<tiny_nets::proof_of_concept, true>);
+
+// Startup of a run resuming from 1000 checkpointed nets: one
+// serialize_store file per net read back by deserialize_load, or a single
+// image mapped in place (checksum verified). The nets are then summed over.
+inline constexpr std::size_t checkpoint_size = 1000;
+
+template <typename NNet, bool Image>
+static void checkpoint_load(benchmark::State& state)
+{
+    const auto directory =
+        std::filesystem::temp_directory_path() / "ga_checkpoint_benchmark";
+    std::filesystem::create_directories(directory);
+    const auto file = [&directory](std::size_t i) {
+        return directory / ("net" + std::to_string(i) + ".bin");
+    };
+
+    std::vector<std::unique_ptr<NNet>> population;
+    for (std::size_t i = 0; i != checkpoint_size; ++i)
+    {
+        population.push_back(ga_snn::static_neural_net_factory<NNet>(
+            random::randnormal, 0.f, 1.f
+        ));
+        if constexpr (!Image)
+        {
+            population.back()->serialize_store(file(i));
+        }
+    }
+    if constexpr (Image)
+    {
+        ga_snn::store_net_image(directory / "population.img", population);
+    }
+
+    for (auto _ : state)
+    {
+        float sum = 0;
+        if constexpr (Image)
+        {
+            const ga_snn::mapped_net_image<NNet> image(
+                directory / "population.img"
+            );
+            for (const auto& net : image)
+            {
+                sum += net.template layer<1>().get_bias_vector()[0, 0];
+            }
+        }
+        else
+        {
+            for (std::size_t i = 0; i != checkpoint_size; ++i)
+            {
+                auto& net = *population[i];
+                net.deserialize_load(file(i));
+                sum += net.template layer<1>().get_bias_vector()[0, 0];
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    std::filesystem::remove_all(directory);
+}
+
+BENCHMARK(checkpoint_load<tiny_nets::connect_four, false>);
+BENCHMARK(checkpoint_load<tiny_nets::connect_four, true>);
+
+//--------------------------------------------------------------------------------------//
+// Activation functions
+//--------------------------------------------------------------------------------------//
+
+// Activation Id in double, without the cancellations of its float formula
+// (1 + erf(x) for GELU)
+template <matrix_activation_functions::Identifiers::Identifiers_ Id>
+static auto activation_reference(double x, double beta) -> double
+{
+    using matrix_activation_functions::Identifiers;
+    if constexpr (Id == Identifiers::Sigmoid)
+    {
+        return 1 / (1 + std::exp(-x));
+    }
+    else if constexpr (Id == Identifiers::Tanh)
+    {
+        return std::tanh(x);
+    }
+    else if constexpr (Id == Identifiers::GELU)
+    {
+        return x / 2 * std::erfc(-x / std::sqrt(2.));
+    }
+    else if constexpr (Id == Identifiers::SiLU)
+    {
+        return x / (1 + std::exp(-x));
+    }
+    else
+    {
+        return x / (1 + std::exp(-beta * x));
+    }
+}
+
+// Throughput of the element function of activation Id at Precision, one
+// float at a time, with counters["max_ulp"] its largest error against the
+// function in double (libm) over every 251st float whose result is a normal
+// float. Swish runs with beta = 0.5, whose products are exact. The kernels
+// apply the fast functions a vector at a time, see
+// dataset_micro_batches<tiny_nets::smooth_fast> for that speed.
+template <
+    matrix_activation_functions::Identifiers::Identifiers_ Id,
+    matrix_activation_functions::activation_precision      Precision>
+static void activation_accuracy(benchmark::State& state)
+{
+    using namespace matrix_activation_functions;
+    constexpr float beta = 0.5f;
+
+    activation_function<ga_sm::static_matrix<float, 1, 1>, Id, Precision>
+        activation{};
+    if constexpr (Id == Identifiers::Swish)
+    {
+        activation.params.beta = beta;
+    }
+    const auto fn = activation.element_function();
+
+    double max_ulp = 0;
+    for (std::uint32_t bits = 0; bits < 0x7f800000u; bits += 251)
+    {
+        for (const std::uint32_t sign : { 0u, 0x80000000u })
+        {
+            float x;
+            const std::uint32_t x_bits = bits | sign;
+            std::memcpy(&x, &x_bits, sizeof(x));
+            const double ref =
+                activation_reference<Id>(static_cast<double>(x), beta);
+            if (!(std::abs(ref) >= std::numeric_limits<float>::min()) ||
+                std::abs(ref) > std::numeric_limits<float>::max())
+            {
+                continue;
+            }
+            int exponent;
+            std::frexp(static_cast<float>(ref), &exponent);
+            max_ulp = std::max(
+                max_ulp,
+                std::abs(static_cast<double>(fn(x)) - ref) /
+                    std::ldexp(1.0, exponent - 24)
+            );
+        }
+    }
+    state.counters["max_ulp"] = max_ulp;
+
+    std::vector<float> inputs(4096);
+    std::vector<float> outputs(inputs.size());
+    std::ranges::generate(inputs, [] { return random::randnormal(0.f, 4.f); });
+    for (auto _ : state)
+    {
+        std::ranges::transform(inputs, outputs.begin(), fn);
+        benchmark::DoNotOptimize(outputs.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(
+        static_cast<std::int64_t>(state.iterations() * inputs.size())
+    );
+}
+
+using af_id        = matrix_activation_functions::Identifiers;
+using af_precision = matrix_activation_functions::activation_precision;
+
+BENCHMARK(activation_accuracy<af_id::Sigmoid, af_precision::exact>);
+BENCHMARK(activation_accuracy<af_id::Sigmoid, af_precision::fast>);
+BENCHMARK(activation_accuracy<af_id::Tanh, af_precision::exact>);
+BENCHMARK(activation_accuracy<af_id::Tanh, af_precision::fast>);
+BENCHMARK(activation_accuracy<af_id::GELU, af_precision::exact>);
+BENCHMARK(activation_accuracy<af_id::GELU, af_precision::fast>);
+BENCHMARK(activation_accuracy<af_id::SiLU, af_precision::exact>);
+BENCHMARK(activation_accuracy<af_id::SiLU, af_precision::fast>);
+BENCHMARK(activation_accuracy<af_id::Swish, af_precision::exact>);
+BENCHMARK(activation_accuracy<af_id::Swish, af_precision::fast>);
+
+// Softmax of a M x N matrix of logits, row by row: 7 wide rows are the policy
+// head of a Connect Four agent, the others wider heads
+template <std::size_t M, std::size_t N>
+static void softmax_rows(benchmark::State& state)
+{
+    using matrix = ga_sm::static_matrix<float, M, N>;
+
+    matrix logits;
+    logits.fill([] { return random::randnormal(0.f, 4.f); });
+    const matrix_activation_functions::Softmax<matrix> softmax{};
+
+    matrix mat;
+    for (auto _ : state)
+    {
+        mat = logits;
+        softmax(mat, {});
+        benchmark::DoNotOptimize(mat);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * M));
+}
+
+BENCHMARK(softmax_rows<1, 7>);
+BENCHMARK(softmax_rows<64, 7>);
+BENCHMARK(softmax_rows<64, 64>);
+BENCHMARK(softmax_rows<8, 1000>);
+
+// The 1000 samples of the evolution environment dataset through the proof
+// of concept net, Rows per forward pass by an executor of the net with that
+// batch size, as ga_neural_model::brain::evaluate_batch streams them
+inline constexpr std::size_t dataset_size = 1000;
+
+template <typename NNet, std::size_t Rows>
+static void dataset_forward_pass(benchmark::State& state)
+{
+    using batch_net_type = typename NNet::template executor_type<Rows>;
+
+    const auto net =
+        ga_snn::static_neural_net_factory<NNet>(random::randnormal, 0.f, 1.f);
+    const auto batch_net = net->template executor<Rows>();
+
+    std::vector<float> inputs(dataset_size);
+    std::vector<float> outputs(dataset_size);
+    std::ranges::generate(inputs, random::randfloat);
+
+    typename batch_net_type::input_type batch{};
+    for (auto _ : state)
+    {
+        for (std::size_t first = 0; first < dataset_size; first += Rows)
+        {
+            const auto rows = std::min(Rows, dataset_size - first);
+            for (std::size_t r = 0; r != rows; ++r)
+            {
+                batch[r, 0] = inputs[first + r];
+            }
+            const auto out = batch_net.batch_forward_pass(batch);
+            for (std::size_t r = 0; r != rows; ++r)
+            {
+                outputs[first + r] = out[r, 0];
+            }
+        }
+        benchmark::DoNotOptimize(outputs.data());
+        benchmark::ClobberMemory();
+    }
+}
+
+// The same samples through the forward_pass over a run time number of rows,
+// Micro_Batch at a time
+template <typename NNet, std::size_t Micro_Batch = NNet::s_Micro_Batch>
+static void dataset_micro_batches(benchmark::State& state)
+{
+    const auto net =
+        ga_snn::static_neural_net_factory<NNet>(random::randnormal, 0.f, 1.f);
+
+    std::vector<float> inputs(dataset_size * NNet::s_Input_Size);
+    std::vector<float> outputs(dataset_size * NNet::s_Output_Size);
+    std::ranges::generate(inputs, random::randfloat);
+
+    for (auto _ : state)
+    {
+        net->template forward_pass<Micro_Batch>(
+            std::span<const float>(inputs), std::span<float>(outputs)
+        );
+        benchmark::DoNotOptimize(outputs.data());
+        benchmark::ClobberMemory();
+    }
+}
+
+// The same samples through a dynamic_neural_net copy of the net, whose
+// kernels are picked at run time
+template <typename NNet>
+static void dataset_dynamic(benchmark::State& state)
+{
+    const auto net =
+        ga_snn::static_neural_net_factory<NNet>(random::randnormal, 0.f, 1.f);
+    const ga_snn::dynamic_neural_net<float> dynamic_net(*net);
+
+    std::vector<float> inputs(dataset_size * NNet::s_Input_Size);
+    std::vector<float> outputs(dataset_size * NNet::s_Output_Size);
+    std::ranges::generate(inputs, random::randfloat);
+
+    for (auto _ : state)
+    {
+        dynamic_net.forward_pass(
+            std::span<const float>(inputs), std::span<float>(outputs)
+        );
+        benchmark::DoNotOptimize(outputs.data());
+        benchmark::ClobberMemory();
+    }
+}
+
+// The same samples through a cached_neural_net whose layer Layer is mutated
+// before every pass: the layers before it are cache hits
+template <typename NNet, std::size_t Layer>
+static void dataset_cached(benchmark::State& state)
+{
+    const auto net =
+        ga_snn::static_neural_net_factory<NNet>(random::randnormal, 0.f, 1.f);
+    const auto cached_net =
+        std::make_unique<ga_snn::cached_neural_net<NNet>>(*net);
+
+    std::vector<float> inputs(dataset_size * NNet::s_Input_Size);
+    std::vector<float> outputs(dataset_size * NNet::s_Output_Size);
+    std::ranges::generate(inputs, random::randfloat);
+
+    for (auto _ : state)
+    {
+        cached_net->mutate_layer(Layer, [](float w) { return w; });
+        cached_net->dataset_forward_pass(inputs, outputs);
+        benchmark::DoNotOptimize(outputs.data());
+        benchmark::ClobberMemory();
+    }
+}
+
+// Rows samples at once, with the hidden activations on the stack or, with
+// Workspace, in a reused forward_workspace
+template <typename NNet, std::size_t Rows, bool Workspace>
+static void batch_activations(benchmark::State& state)
+{
+    using executor_type = typename NNet::template executor_type<Rows>;
+
+    const auto net =
+        ga_snn::static_neural_net_factory<NNet>(random::randnormal, 0.f, 1.f);
+    const auto executor = net->template executor<Rows>();
+
+    const auto inputs  = std::make_unique<typename executor_type::input_type>();
+    const auto outputs = std::make_unique<typename executor_type::output_type>();
+    const auto workspace =
+        std::make_unique<typename executor_type::workspace_type>();
+    inputs->fill(random::randfloat);
+
+    for (auto _ : state)
+    {
+        if constexpr (Workspace)
+        {
+            executor.forward_pass(*inputs, *outputs, *workspace);
+        }
+        else
+        {
+            net->get_genome().forward_pass(
+                ga_sm::make_view(std::as_const(*inputs)),
+                ga_sm::make_view(*outputs)
+            );
+        }
+        benchmark::DoNotOptimize(outputs->begin());
+        benchmark::ClobberMemory();
+    }
+}
+
+// One step of Lamarckian refinement on the same samples: the gradient of the
+// loss by backpropagation, then an Adam step
+template <typename NNet>
+static void gradient_step(benchmark::State& state)
+{
+    const auto net =
+        ga_snn::static_neural_net_factory<NNet>(random::randnormal, 0.f, 1.f);
+    ga_snn::gradient_trainer<NNet> trainer;
+
+    std::vector<float> inputs(dataset_size * NNet::s_Input_Size);
+    std::vector<float> targets(dataset_size * NNet::s_Output_Size);
+    std::ranges::generate(inputs, random::randfloat);
+    std::ranges::generate(targets, random::randfloat);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(trainer.step(*net, inputs, targets));
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK(batch_activations<tiny_nets::connect_four, 256, false>);
+BENCHMARK(batch_activations<tiny_nets::connect_four, 256, true>);
+BENCHMARK(batch_activations<tiny_nets::connect_four, 4096, false>);
+BENCHMARK(batch_activations<tiny_nets::connect_four, 4096, true>);
+
+BENCHMARK(dataset_forward_pass<tiny_nets::proof_of_concept, 1>);
+BENCHMARK(dataset_forward_pass<tiny_nets::proof_of_concept, 8>);
+BENCHMARK(dataset_forward_pass<tiny_nets::proof_of_concept, 32>);
+BENCHMARK(dataset_micro_batches<tiny_nets::proof_of_concept, 8>);
+BENCHMARK(dataset_micro_batches<tiny_nets::proof_of_concept>);
+BENCHMARK(dataset_micro_batches<tiny_nets::connect_four, 1>);
+BENCHMARK(dataset_micro_batches<tiny_nets::connect_four>);
+BENCHMARK(dataset_micro_batches<tiny_nets::smooth>);
+BENCHMARK(dataset_micro_batches<tiny_nets::smooth_fast>);
+BENCHMARK(dataset_dynamic<tiny_nets::smooth>);
+BENCHMARK(dataset_dynamic<tiny_nets::smooth_fast>);
+BENCHMARK(dataset_dynamic<tiny_nets::proof_of_concept>);
+BENCHMARK(dataset_dynamic<tiny_nets::connect_four>);
+BENCHMARK(dataset_cached<tiny_nets::proof_of_concept, 0>);
+BENCHMARK(dataset_cached<tiny_nets::proof_of_concept, 4>);
+BENCHMARK(dataset_cached<tiny_nets::proof_of_concept, 5>);
+BENCHMARK(gradient_step<tiny_nets::proof_of_concept>);
+BENCHMARK(gradient_step<tiny_nets::connect_four>);
+
+BENCHMARK_MAIN();
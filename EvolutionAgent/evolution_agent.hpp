@@ -91,6 +91,25 @@ public:
         return m_Brain(input);
     }
 
+    /**
+     * \brief Responses to a whole dataset at once, see the brain's
+     *        evaluate_batch. Rows, if given, is the number of samples per
+     *        forward pass.
+     */
+    template <std::size_t... Rows, typename Input_Range, typename Output_Range>
+        requires requires(Input_Range const& inputs, Output_Range&& outputs) {
+            m_Brain.template evaluate_batch<Rows...>(
+                inputs, std::forward<Output_Range>(outputs)
+            );
+        }
+    auto evaluate_batch(Input_Range const& inputs, Output_Range&& outputs) const
+        -> void
+    {
+        m_Brain.template evaluate_batch<Rows...>(
+            inputs, std::forward<Output_Range>(outputs)
+        );
+    }
+
     //--------------------------------------------------------------------------------------//
     // Utility
     //--------------------------------------------------------------------------------------//
@@ -153,6 +172,29 @@ auto to_target_crossover(
     );
 }
 
+//--------------------------------------------------------------------------------------//
+// Population inference
+//--------------------------------------------------------------------------------------//
+
+/**
+ * \brief A generation as one callable: invoked with a stimulus, it returns
+ *        the response of every agent, in order. Built from the brains of the
+ *        agents (see stack_brains), it is a snapshot of them.
+ */
+template <agent_type Agent, std::size_t N>
+    requires requires(std::array<typename Agent::brain_type const*, N> brains
+    ) { stack_brains(brains); }
+[[nodiscard]]
+auto stack_population(std::array<Agent, N> const& agents)
+{
+    std::array<typename Agent::brain_type const*, N> brains;
+    for (std::size_t i = 0; i != N; ++i)
+    {
+        brains[i] = &agents[i].get_brain();
+    }
+    return stack_brains(brains);
+}
+
 template <std::floating_point R, agent_type Agent, typename Distance>
     requires requires(Agent agent) {
         {
@@ -1,12 +1,15 @@
 #include "Random.hpp"
 #include "TApplication.h"
 #include "activation_functions.hpp"
+#include "backprop.hpp"
 #include "data_processor.hpp"
 #include "evolution_agent.hpp"
 #include "evolution_environment.hpp"
 #include "mutation_policy.hpp"
 #include "neural_model.hpp"
 #include "population.hpp"
+#include "population_neural_net.hpp"
+#include "refinement_policy.hpp"
 #include "reproduction_manager.hpp"
 #include "root_plotting_utility.hpp"
 #include "static_neural_net.hpp"
@@ -22,6 +25,8 @@ struct activity
     using agent_response_type = float;
 
     inline static constexpr std::size_t N = 1000;
+    // Samples per forward pass when scoring responses to the whole dataset
+    inline static constexpr std::size_t s_Batch_Size = 32;
 
     using input_data_container  = std::array<stimulus_type, N>;
     using output_data_container = std::array<agent_response_type, N>;
@@ -100,6 +105,55 @@ public:
         return static_cast<fitness_score_type>(1 / fitness_score);
     }
 
+    // Responses to the whole dataset, see evaluation_system::system
+    [[nodiscard]]
+    auto operator()(output_data_container const& responses) const
+        -> fitness_score_type
+    {
+        const auto fitness_score = ga_sm::span_distance<fitness_score_type>(
+            std::span{ output_data },
+            std::span{ responses },
+            ga_sm::distance::L2{}
+        );
+        if (s_iter % 2100 == 0)
+        {
+            s_best_error = fitness_score;
+        }
+        ++s_iter;
+        return static_cast<fitness_score_type>(1 / fitness_score);
+    }
+
+    // Whole generation at once, see evolution_agent::stack_population. Only
+    // used when the dataset overload is not, see evaluation_system::system.
+    template <typename Population_Type>
+        requires std::is_invocable_r_v<
+            std::array<agent_response_type, Population_Type::s_Population>,
+            Population_Type,
+            stimulus_type>
+    [[nodiscard]]
+    auto operator()(Population_Type const& population) const
+        -> std::array<fitness_score_type, Population_Type::s_Population>
+    {
+        std::array<fitness_score_type, Population_Type::s_Population>
+            fitness_scores{};
+        for (auto i = 0uz; i != N; ++i)
+        {
+            const auto responses = population(input_data[i]);
+            for (auto p = 0uz; p != Population_Type::s_Population; ++p)
+            {
+                fitness_scores[p] += static_cast<fitness_score_type>(
+                    generics::algorithms::L2_norm(output_data[i], responses[p])
+                );
+            }
+        }
+        s_iter += Population_Type::s_Population;
+        for (auto& fitness_score : fitness_scores)
+        {
+            fitness_score = static_cast<fitness_score_type>(1 / fitness_score);
+        }
+        return fitness_scores;
+    }
+
     template <typename Agent_Type>
         requires std::
             is_invocable_r_v<agent_response_type, Agent_Type, stimulus_type>
@@ -150,14 +204,21 @@ int main()
     using postprocessor = data_processor::scalar_converter;
     using return_type   = typename NET::value_type;
 
-    using brain_t =
-        ga_neural_model::brain<NET, preprocessor, postprocessor, return_type>;
+    // The nets of both generations live side by side in NET's arena
+    using brain_t = ga_neural_model::brain<
+        NET,
+        preprocessor,
+        postprocessor,
+        return_type,
+        ga_neural_model::arena_net_storage>;
 
     using agent_t = evolution_agent::agent<brain_t>;
 
     constexpr int GEN_SIZE = 21;
     activity      a;
 
+    ga_snn::net_arena<NET>::global().reserve(2 * GEN_SIZE);
+
     [[maybe_unused]] evaluation_system::system<activity> system(a);
     using system_t = decltype(system);
 
@@ -165,8 +226,17 @@ int main()
         mutation_policy_::mutation_policy<typename NET::value_type, 6>;
 
 
-    using reproduction_manager_t = reproduction_mngr::
-        reproduction_manager<GEN_SIZE, agent_t, float, mutation_policy_t>;
+    // The elites take a few steps of gradient descent on the dataset before
+    // every generation is evaluated
+    using refinement_policy_t = refinement_policy_::gradient_refinement<
+        ga_snn::gradient_trainer<NET>>;
+
+    using reproduction_manager_t = reproduction_mngr::reproduction_manager<
+        GEN_SIZE,
+        agent_t,
+        float,
+        mutation_policy_t,
+        refinement_policy_t>;
 
     using evolution_environment_t = evolution_env::evolution_environment<
         GEN_SIZE,
@@ -179,7 +249,8 @@ int main()
     };
 
     reproduction_manager_t reproduction_manager(
-        reproduction_mngr::parent_categories(GEN_SIZE, 3, 4)
+        reproduction_mngr::parent_categories(GEN_SIZE, 3, 4),
+        refinement_policy_t(activity::input_data, activity::output_data, 5)
     );
 
     [[maybe_unused]] evolution_environment_t eenv(
@@ -0,0 +1,91 @@
+#ifndef REFINEMENT_POLICY
+#define REFINEMENT_POLICY
+
+#include "backprop.hpp"
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Stage of reproduction_mngr::reproduction_manager run on the next generation
+// once it is bred: refinement_policy(next_generation, elites_count), the
+// elites being the first elites_count agents, carried over unmutated
+namespace refinement_policy_
+{
+
+/**
+ * \brief Plain evolution, the elites are left as they are
+ */
+struct no_refinement
+{
+    template <typename Generation>
+    auto operator()(Generation&, int) const noexcept -> void
+    {
+    }
+};
+
+/**
+ * \brief Lamarckian refinement: every elite takes Steps steps of gradient
+ *        descent (see ga_snn::gradient_trainer) on a dataset before the
+ *        generation is evaluated, and breeds with the weights it learnt.
+ *        The dataset, in the inputs and targets of the agents' nets (not
+ *        preprocessed), is copied into the policy.
+ */
+template <typename Trainer>
+class gradient_refinement
+{
+public:
+    using trainer_type = Trainer;
+    using net_type     = typename Trainer::net_type;
+    using value_type   = typename Trainer::value_type;
+
+private:
+    Trainer                 m_Trainer;
+    std::vector<value_type> m_Inputs;
+    std::vector<value_type> m_Targets;
+    std::size_t             m_Steps;
+
+public:
+    gradient_refinement(
+        std::span<const value_type> inputs,
+        std::span<const value_type> targets,
+        std::size_t                 steps,
+        Trainer                     trainer = Trainer{}
+    ) :
+        m_Trainer{ std::move(trainer) },
+        m_Inputs(inputs.begin(), inputs.end()),
+        m_Targets(targets.begin(), targets.end()),
+        m_Steps{ steps }
+    {
+    }
+
+    template <typename Generation>
+        requires requires(Generation& generation) {
+            {
+                generation[0].get_brain().get_net()
+            } -> std::same_as<net_type&>;
+        }
+    auto operator()(Generation& generation, int elites_count) -> void
+    {
+        for (int i = 0; i != elites_count; ++i)
+        {
+            m_Trainer.refine(
+                generation[i].get_brain().get_net(),
+                m_Inputs,
+                m_Targets,
+                m_Steps
+            );
+        }
+    }
+
+    [[nodiscard]]
+    auto get_trainer() noexcept -> Trainer&
+    {
+        return m_Trainer;
+    }
+};
+
+} // namespace refinement_policy_
+
+#endif // REFINEMENT_POLICY
@@ -3,6 +3,7 @@
 
 #include "evolution_environment_traits.hpp"
 #include "generics.hpp"
+#include "refinement_policy.hpp"
 #include "static_matrix.hpp"
 #include <array>
 #include <concepts>
@@ -10,6 +11,7 @@
 #include <limits>
 #include <ranges>
 #include <type_traits>
+#include <utility>
 #include <variant>
 
 namespace reproduction_mngr
@@ -92,7 +94,12 @@ template <
     int                                         Generation_Size,
     evolution_environment_traits::agent_concept Agent_Type,
     std::floating_point                         Fitness_Score_Type,
-    mutation_policy_concept                     Mutation_Policy>
+    mutation_policy_concept                     Mutation_Policy,
+    typename Refinement_Policy = refinement_policy_::no_refinement>
+    requires std::is_invocable_v<
+        Refinement_Policy&,
+        std::array<Agent_Type, Generation_Size>&,
+        int>
 class reproduction_manager
 
 {
@@ -107,6 +114,7 @@ public:
     using fitness_score_type        = Fitness_Score_Type;
     using agent_type                = Agent_Type;
     using mutation_policy_type      = Mutation_Policy;
+    using refinement_policy_type    = Refinement_Policy;
     using generation_container_type = std::array<agent_type, s_Generation_size>;
     template <typename T>
     using container_type = std::array<T, s_Generation_size>;
@@ -118,18 +126,23 @@ public:
 
 public:
     reproduction_manager() noexcept :
-        m_Parent_categories(s_Generation_size),
-        m_Asexual_reproduction_parents(
-            m_Parent_categories.elites_count() +
-            m_Parent_categories.survivors_count()
-        ),
-        m_Sexual_reproduction_parents(m_Parent_categories.progenitors_count()),
-        m_Base_probability(0.01f),
-        m_Mutation_policy(m_Base_probability)
+        reproduction_manager(parent_categories(s_Generation_size))
     {
     }
 
     reproduction_manager(parent_categories parent_categories) noexcept :
+        reproduction_manager(parent_categories, Refinement_Policy{})
+    {
+    }
+
+    /**
+     * \brief Manager whose elites go through refinement_policy once the
+     *        next generation is bred, see refinement_policy.hpp
+     */
+    reproduction_manager(
+        parent_categories parent_categories,
+        Refinement_Policy refinement_policy
+    ) :
         m_Parent_categories(parent_categories),
         m_Asexual_reproduction_parents(
             m_Parent_categories.elites_count() +
@@ -137,7 +150,8 @@ public:
         ),
         m_Sexual_reproduction_parents(m_Parent_categories.progenitors_count()),
         m_Base_probability(0.01f),
-        m_Mutation_policy(m_Base_probability)
+        m_Mutation_policy(m_Base_probability),
+        m_Refinement_policy(std::move(refinement_policy))
     {
     }
 
@@ -157,13 +171,13 @@ public:
             {
                 population_variability<diversity_score_type>(
                     std::declval<generation_container_type&>(),
-                    generics::algorithms::L2_norm
+                    ga_sm::distance::L2{}
                 )
             } -> std::same_as<diversity_scores_container_type>;
         }
     {
         const auto& diversity = population_variability<float>(
-            current_generation, generics::algorithms::L2_norm
+            current_generation, ga_sm::distance::L2{}
         );
         update_current_parents(fitness_scores, diversity);
         reproduce_generation(current_generation, next_generation_nest);
@@ -340,6 +354,9 @@ private:
         {
             next_generation_nest[i].mutate(m_Mutation_policy);
         }
+        m_Refinement_policy(
+            next_generation_nest, m_Parent_categories.elites_count()
+        );
     }
 
     auto update_best_fitness_score(fitness_score_type top_score) noexcept
@@ -427,6 +444,7 @@ private:
     int                                       m_Sexual_parents_idx  = 0;
     typename mutation_policy_type::value_type m_Base_probability;
     mutation_policy_type                      m_Mutation_policy;
+    refinement_policy_type                    m_Refinement_policy{};
 };
 
 } // namespace reproduction_mngr
@@ -3,14 +3,67 @@
 
 #include "error_handling.hpp"
 #include "generics.hpp"
+#include <array>
 #include <concepts>
+#include <functional>
 #include <ranges>
 #include <span>
 #include <type_traits>
+#include <utility>
 
 namespace evaluation_system
 {
 
+/**
+ * \brief Evaluation functions that score a whole generation at once from
+ *        its stacked form (see evolution_agent::stack_population), which
+ *        evaluates every agent on a stimulus in one pass
+ */
+template <typename Fn, typename Agent_Type, std::size_t N>
+concept population_evaluation_function =
+    requires(std::array<Agent_Type, N> const& population) {
+        stack_population(population);
+    } &&
+    std::is_invocable_r_v<
+        std::array<typename Fn::fitness_score_type, N>,
+        Fn,
+        decltype(stack_population(
+            std::declval<std::array<Agent_Type, N> const&>()
+        )) const&>;
+
+/**
+ * \brief Evaluation functions that score an agent from its responses to a
+ *        whole dataset, Fn::input_data. The responses are computed with the
+ *        agent's evaluate_batch, Fn::s_Batch_Size samples per forward pass,
+ *        into an Fn::output_data_container.
+ */
+template <typename Fn, typename Agent_Type>
+concept dataset_evaluation_function =
+    requires(
+        Fn const&                             fn,
+        Agent_Type const&                     agent,
+        typename Fn::output_data_container&   responses
+    ) {
+        {
+            Fn::s_Batch_Size
+        } -> std::convertible_to<std::size_t>;
+        agent.template evaluate_batch<Fn::s_Batch_Size>(
+            fn.input_data, responses
+        );
+    } &&
+    std::is_invocable_r_v<
+        typename Fn::fitness_score_type,
+        Fn,
+        typename Fn::output_data_container const&>;
+
+/**
+ * \brief Evaluation functions that set s_Evaluate_Population are handed the
+ *        stacked generation even when they can score dataset responses
+ */
+template <typename Fn>
+concept population_evaluation_preferred =
+    requires { requires static_cast<bool>(Fn::s_Evaluate_Population); };
+
 template <typename Fn>
 class system
 {
@@ -24,17 +77,46 @@ public:
     {
     }
 
+    // Evaluation functions scoring a whole dataset are preferred, as it is
+    // streamed through the nets several samples per forward pass, then the
+    // ones that take the stacked generation. Those that opt in with
+    // s_Evaluate_Population take the stacked generation first.
     template <typename Agent_Type, std::size_t N>
         requires std::is_invocable_r_v<fitness_score_type, Fn, Agent_Type> ||
         std::is_invocable_r_v<
                      std::array<Agent_Type, N>,
                      Fn,
-                     std::array<Agent_Type, N>>
+                     std::array<Agent_Type, N>> ||
+        population_evaluation_function<Fn, Agent_Type, N> ||
+        dataset_evaluation_function<Fn, Agent_Type>
     [[nodiscard]]
     auto evaluate(std::array<Agent_Type, N> const& population) const
         -> std::array<fitness_score_type, N>
     {
-        if constexpr (std::is_invocable_r_v<fitness_score_type, Fn, Agent_Type>)
+        constexpr bool stacked =
+            population_evaluation_function<Fn, Agent_Type, N> &&
+            (population_evaluation_preferred<Fn> ||
+             !dataset_evaluation_function<Fn, Agent_Type>);
+
+        if constexpr (stacked)
+        {
+            return std::invoke(
+                m_Evaluation_function, stack_population(population)
+            );
+        }
+        else if constexpr (dataset_evaluation_function<Fn, Agent_Type>)
+        {
+            std::array<fitness_score_type, N> ret;
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                ret[i] = evaluate_dataset(population[i]);
+            }
+            return ret;
+        }
+        else if constexpr (std::is_invocable_r_v<
+                               fitness_score_type,
+                               Fn,
+                               Agent_Type>)
         {
             std::array<fitness_score_type, N> ret;
             for (std::size_t i = 0; i != N; ++i)
@@ -61,12 +143,26 @@ public:
         std::is_invocable_r_v<
                      std::vector<fitness_score_type>,
                      Fn,
-                     std::vector<Agent_Type>>
+                     std::vector<Agent_Type>> ||
+        dataset_evaluation_function<Fn, Agent_Type>
     [[nodiscard]]
     auto evaluate(std::span<Agent_Type> population) const
         -> std::vector<fitness_score_type>
     {
-        if constexpr (std::is_invocable_r_v<fitness_score_type, Fn, Agent_Type>)
+        if constexpr (dataset_evaluation_function<Fn, Agent_Type>)
+        {
+            const auto                      n = population.size();
+            std::vector<fitness_score_type> ret(n);
+            for (std::size_t i = 0; i != n; ++i)
+            {
+                ret[i] = evaluate_dataset(population[i]);
+            }
+            return ret;
+        }
+        else if constexpr (std::is_invocable_r_v<
+                               fitness_score_type,
+                               Fn,
+                               Agent_Type>)
         {
             const auto                      n = population.size();
             std::vector<fitness_score_type> ret(n);
@@ -90,6 +186,18 @@ public:
     }
 
 private:
+    template <typename Agent_Type>
+        requires dataset_evaluation_function<Fn, Agent_Type>
+    [[nodiscard]]
+    auto evaluate_dataset(Agent_Type const& agent) const -> fitness_score_type
+    {
+        typename Fn::output_data_container responses{};
+        agent.template evaluate_batch<Fn::s_Batch_Size>(
+            m_Evaluation_function.input_data, responses
+        );
+        return std::invoke(m_Evaluation_function, std::as_const(responses));
+    }
+
     Fn m_Evaluation_function;
 };
 } // namespace evaluation_system
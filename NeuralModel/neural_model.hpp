@@ -3,21 +3,37 @@
 #ifndef NEURAL_MODEL
 #define NEURAL_MODEL
 
+#include "cached_neural_net.hpp"
 #include "data_processor.hpp"
+#include "net_arena.hpp"
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <cassert>
 #include <concepts>
 #include <iostream>
 #include <memory>
+#include <ranges>
+#include <span>
 #include <type_traits>
+#include <vector>
 
 namespace ga_neural_model
 {
 
+/**
+ * \brief Nets a brain can evaluate. Inference only nets (e.g.
+ *        ga_snn::quantized_neural_net) make brains that cannot be mutated.
+ */
 template <typename NNet>
-concept neural_net_concept = requires(NNet net) {
+concept inference_net_concept = requires(NNet net) {
     net.print_net();
     net.print_address();
     net.forward_pass(std::declval<typename NNet::input_type&>());
+};
+
+template <typename NNet>
+concept neural_net_concept = inference_net_concept<NNet> && requires(NNet net) {
     net.mutate(
         std::declval<typename NNet::value_type (*)(typename NNet::value_type)>()
     );
@@ -27,11 +43,88 @@ concept neural_net_concept = requires(NNet net) {
     );
 };
 
+/**
+ * \brief Nets that can be evaluated Rows samples per forward pass, by an
+ *        executor referencing their parameters (e.g.
+ *        ga_snn::static_neural_net::executor)
+ */
+template <typename NNet, std::size_t Rows>
+concept batch_net_concept =
+    inference_net_concept<NNet> &&
+    requires { typename NNet::template executor_type<Rows>; } &&
+    requires(
+        NNet const& net,
+        typename NNet::template executor_type<Rows>::input_type const& in
+    ) { net.template executor<Rows>().batch_forward_pass(in); };
+
+/**
+ * \brief Nets that evaluate a whole dataset at once, rows of samples back to
+ *        back, e.g. ga_snn::cached_neural_net, which keeps the outputs of its
+ *        layers between evaluations on the same dataset, told apart by its
+ *        contents.
+ */
+template <typename NNet>
+concept dataset_net_concept =
+    inference_net_concept<NNet> &&
+    requires(
+        NNet&                                      net,
+        std::span<const typename NNet::value_type> inputs,
+        std::span<typename NNet::value_type>       outputs
+    ) { net.dataset_forward_pass(inputs, outputs); };
+
+// An executor evaluating one sample, whose input and output a single
+// stimulus and response are processed into and from
+template <typename NNet>
+using sample_net_type = typename NNet::template executor_type<1>;
+
+/**
+ * \brief Where brains keep their nets: one heap allocation per net
+ */
+struct heap_net_storage
+{
+    template <typename NNet>
+    using pointer = std::unique_ptr<NNet>;
+
+    template <typename NNet, typename... Args>
+    [[nodiscard]]
+    static auto make(Args&&... args) -> pointer<NNet>
+    {
+        return std::make_unique<NNet>(std::forward<Args>(args)...);
+    }
+};
+
+/**
+ * \brief Where brains keep their nets: slots of the global
+ *        ga_snn::net_arena of their type, so that a population's nets share
+ *        one block and generation turnovers recycle slots. Reserve the
+ *        population in the arena before making its brains.
+ */
+struct arena_net_storage
+{
+    template <typename NNet>
+    using pointer = ga_snn::arena_ptr<NNet>;
+
+    template <typename NNet, typename... Args>
+    [[nodiscard]]
+    static auto make(Args&&... args) -> pointer<NNet>
+    {
+        return ga_snn::net_arena<NNet>::global().make(
+            std::forward<Args>(args)...
+        );
+    }
+};
+
+template <typename Storage, typename NNet>
+concept net_storage_concept =
+    requires { Storage::template make<NNet>(); } &&
+    std::movable<typename Storage::template pointer<NNet>>;
+
 template <
-    neural_net_concept                  NNet,
+    inference_net_concept               NNet,
     data_processor::data_processor_type Data_Preprocessor,
     data_processor::data_processor_type Data_Postprocessor,
-    typename Brain_Output_Type>
+    typename Brain_Output_Type,
+    net_storage_concept<NNet> Net_Storage = heap_net_storage>
     requires requires {
         Data_Postprocessor::template process<
             typename NNet::output_type,
@@ -48,12 +141,11 @@ public:
     using postprocessor     = Data_Postprocessor;
     using brain_output_type = Brain_Output_Type;
     using value_type        = nn_value_type;
-
-    inline static constexpr std::size_t s_Brain_layers = NNet::s_Layers;
-
+    using net_storage_type  = Net_Storage;
+    using net_pointer_type  = typename Net_Storage::template pointer<NNet>;
 
 private:
-    std::unique_ptr<NNet> m_Ptr_net;
+    net_pointer_type m_Ptr_net;
 
 public:
     brain() noexcept = default;
@@ -61,32 +153,38 @@ public:
     template <typename Fn, typename... Args>
         requires std::is_invocable_r_v<nn_value_type, Fn, Args...>
     explicit brain(Fn&& fn, Args&&... args) noexcept :
-        m_Ptr_net{ std::make_unique<NNet>() }
+        m_Ptr_net{ Net_Storage::template make<NNet>() }
     {
         m_Ptr_net->init(std::forward<Fn>(fn), std::forward<Args>(args)...);
     }
 
     explicit brain(const NNet& net) noexcept :
-        m_Ptr_net{ std::make_unique<NNet>(net) }
+        m_Ptr_net{ Net_Storage::template make<NNet>(net) }
     {
     }
 
     brain(const brain& other) noexcept :
-        m_Ptr_net{ std::make_unique<NNet>(*other.get()) }
+        m_Ptr_net{ Net_Storage::template make<NNet>(*other.get()) }
     {
     }
 
-    explicit brain(std::unique_ptr<NNet>&& other_ptr_net) noexcept :
+    explicit brain(net_pointer_type&& other_ptr_net) noexcept :
         m_Ptr_net(std::move(other_ptr_net))
     {
     }
 
     brain(brain&& other) noexcept = default;
 
+    // Copies into the net this brain already has, if any, so generation
+    // turnovers do not allocate
     brain& operator=(const brain& other) noexcept
     {
-        if (other.m_Ptr_net)
-            m_Ptr_net = std::make_unique<NNet>(*other.m_Ptr_net);
+        if (this == &other)
+            return *this;
+        if (other.m_Ptr_net && m_Ptr_net)
+            *m_Ptr_net = *other.m_Ptr_net;
+        else if (other.m_Ptr_net)
+            m_Ptr_net = Net_Storage::template make<NNet>(*other.m_Ptr_net);
         else
             m_Ptr_net.reset();
         return *this;
@@ -161,6 +259,111 @@ public:
         return m_Ptr_net->forward_pass(in);
     }
 
+    /**
+     * \brief operator() over a whole dataset, outputs[i] being the response
+     *        to inputs[i]. The samples are streamed through batch_forward_pass
+     *        Rows at a time, by an executor of the net with that batch size,
+     *        which does not copy the net. Rows past the end of the last chunk
+     *        hold stale samples, their outputs are dropped.
+     */
+    template <
+        std::size_t Rows = nn_input_type::Size_y,
+        std::ranges::random_access_range Input_Range,
+        std::ranges::random_access_range Output_Range>
+        requires batch_net_concept<NNet, Rows> && requires {
+            typename sample_net_type<NNet>;
+            {
+                preprocessor::template process<
+                    std::ranges::range_value_t<Input_Range>,
+                    typename sample_net_type<NNet>::input_type>(
+                    std::declval<std::ranges::range_value_t<Input_Range>&>()
+                )
+            } -> std::same_as<typename sample_net_type<NNet>::input_type>;
+            postprocessor::template process<
+                typename sample_net_type<NNet>::output_type,
+                brain_output_type>(
+                std::declval<typename sample_net_type<NNet>::output_type&>()
+            );
+        }
+    auto evaluate_batch(Input_Range const& inputs, Output_Range&& outputs)
+        const -> void
+    {
+        using batch_net_type = typename NNet::template executor_type<Rows>;
+        using sample_input_type  = typename sample_net_type<NNet>::input_type;
+        using sample_output_type = typename sample_net_type<NNet>::output_type;
+        using input_value_type   = std::ranges::range_value_t<Input_Range>;
+
+        const auto n = static_cast<std::size_t>(std::ranges::size(inputs));
+        assert(static_cast<std::size_t>(std::ranges::size(outputs)) >= n);
+
+        if constexpr (dataset_net_concept<NNet>)
+        {
+            // The whole dataset in one call, which the net tells apart from
+            // the one it cached by the preprocessed samples
+            constexpr auto in_size  = sample_input_type::Size_x;
+            constexpr auto out_size = sample_output_type::Size_x;
+            std::vector<nn_value_type> samples(n * in_size);
+            std::vector<nn_value_type> responses(n * out_size);
+            for (std::size_t i = 0; i != n; ++i)
+            {
+                const auto sample = preprocessor::
+                    template process<input_value_type, sample_input_type>(
+                        inputs[i]
+                    );
+                for (std::size_t k = 0; k != in_size; ++k)
+                {
+                    samples[i * in_size + k] = sample[0, k];
+                }
+            }
+            m_Ptr_net->dataset_forward_pass(
+                std::span<const nn_value_type>(samples), responses
+            );
+            for (std::size_t i = 0; i != n; ++i)
+            {
+                sample_output_type response;
+                for (std::size_t k = 0; k != out_size; ++k)
+                {
+                    response[0, k] = responses[i * out_size + k];
+                }
+                outputs[i] = postprocessor::template process<
+                    sample_output_type,
+                    brain_output_type>(response);
+            }
+            return;
+        }
+
+        const auto net = m_Ptr_net->template executor<Rows>();
+
+        typename batch_net_type::input_type batch{};
+        for (std::size_t first = 0; first < n; first += Rows)
+        {
+            const auto rows = std::min(Rows, n - first);
+            for (std::size_t r = 0; r != rows; ++r)
+            {
+                const auto sample = preprocessor::template process<
+                    input_value_type,
+                    sample_input_type>(inputs[first + r]);
+                for (std::size_t k = 0; k != sample_input_type::Size_x; ++k)
+                {
+                    batch[r, k] = sample[0, k];
+                }
+            }
+
+            const auto responses = net.batch_forward_pass(batch);
+            for (std::size_t r = 0; r != rows; ++r)
+            {
+                sample_output_type response;
+                for (std::size_t k = 0; k != sample_output_type::Size_x; ++k)
+                {
+                    response[0, k] = responses[r, k];
+                }
+                outputs[first + r] = postprocessor::template process<
+                    sample_output_type,
+                    brain_output_type>(response);
+            }
+        }
+    }
+
     /* Utility */
 
     void print_net() const
@@ -175,6 +378,9 @@ public:
 
     /* GA Utility */
 
+    // Changes every layer: a net with an activation cache (e.g.
+    // ga_snn::cached_neural_net) evaluates all of them again, where
+    // mutate_set_layers keeps the outputs of the layers before its first one
     template <typename Fn>
         requires std::is_invocable_r_v<nn_value_type, Fn, nn_value_type>
     void mutate(Fn&& fn)
@@ -195,15 +401,17 @@ public:
 //--------------------------------------------------------------------------------------//
 
 template <
-    neural_net_concept                  NNet,
+    inference_net_concept               NNet,
     data_processor::data_processor_type Data_Preprocessor,
     data_processor::data_processor_type Data_Postprocessor,
-    typename Brain_Output_Type>
+    typename Brain_Output_Type,
+    typename Net_Storage>
 void brain_dummy(brain<
                  NNet,
                  Data_Preprocessor,
                  Data_Postprocessor,
-                 Brain_Output_Type>)
+                 Brain_Output_Type,
+                 Net_Storage>)
 {
 }
 
@@ -236,6 +444,103 @@ auto brain_distance(
     );
 }
 
+//--------------------------------------------------------------------------------------//
+//  Population inference
+//--------------------------------------------------------------------------------------//
+
+/**
+ * \brief The brains of a whole generation, evaluated together on the same
+ *        stimulus by the population net their nets stack into (e.g.
+ *        ga_snn::population_neural_net, see stack_nets). operator() returns
+ *        what each brain would, in the order they were stacked.
+ */
+template <brain_type Brain, std::size_t Population>
+    requires requires(
+        std::array<typename Brain::neural_net_type const*, Population> nets
+    ) { stack_nets(nets); }
+class population_brain
+{
+public:
+    using brain_type        = Brain;
+    using nn_input_type     = typename Brain::nn_input_type;
+    using nn_output_type    = typename Brain::nn_output_type;
+    using preprocessor      = typename Brain::preprocessor;
+    using postprocessor     = typename Brain::postprocessor;
+    using brain_output_type = typename Brain::brain_output_type;
+    using nets_type =
+        std::array<typename Brain::neural_net_type const*, Population>;
+    using population_net_type =
+        typename decltype(stack_nets(std::declval<nets_type&>()))::element_type;
+
+    inline static constexpr std::size_t s_Population = Population;
+
+private:
+    std::unique_ptr<population_net_type> m_Ptr_net;
+
+public:
+    explicit population_brain(std::array<Brain const*, Population> const& brains
+    ) :
+        m_Ptr_net{ stack_nets(nets_of(brains)) }
+    {
+    }
+
+    template <typename Brain_Input_Type>
+        requires requires {
+            {
+                preprocessor::template process<Brain_Input_Type, nn_input_type>(
+                    std::declval<Brain_Input_Type&>()
+                )
+            } -> std::same_as<nn_input_type>;
+        }
+    [[nodiscard]]
+    auto operator()(const Brain_Input_Type& in) const
+        -> std::array<brain_output_type, Population>
+    {
+        const auto outputs = m_Ptr_net->forward_pass(
+            preprocessor::template process<Brain_Input_Type, nn_input_type>(in)
+        );
+
+        std::array<brain_output_type, Population> ret;
+        for (std::size_t i = 0; i != Population; ++i)
+        {
+            ret[i] = postprocessor::template process<
+                nn_output_type,
+                brain_output_type>(outputs[i]);
+        }
+        return ret;
+    }
+
+    [[nodiscard]]
+    auto get_net() const -> const population_net_type&
+    {
+        return *m_Ptr_net;
+    }
+
+private:
+    [[nodiscard]]
+    static auto nets_of(std::array<Brain const*, Population> const& brains)
+        -> nets_type
+    {
+        nets_type ret;
+        for (std::size_t i = 0; i != Population; ++i)
+        {
+            ret[i] = brains[i]->get();
+        }
+        return ret;
+    }
+};
+
+template <brain_type Brain, std::size_t Population>
+    requires requires(
+        std::array<typename Brain::neural_net_type const*, Population> nets
+    ) { stack_nets(nets); }
+[[nodiscard]]
+auto stack_brains(std::array<Brain const*, Population> const& brains)
+    -> population_brain<Brain, Population>
+{
+    return population_brain<Brain, Population>(brains);
+}
+
 template <brain_type Brain>
 auto to_target_brain_crossover(
     const Brain& parent_a,
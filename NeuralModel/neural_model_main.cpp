@@ -9,6 +9,7 @@
 #include "Stopwatch.hpp"
 #include "activation_functions.hpp"
 #include "data_processor.hpp"
+#include "neat_neural_net.hpp"
 #include "neural_model.hpp"
 #include "static_matrix.hpp"
 #include "static_neural_net.hpp"
@@ -253,9 +254,45 @@ void new_brain_test()
         << std::endl;
 }
 
+void neat_brain_test()
+{
+    using NET = ga_snn::neat_neural_net<
+        float,
+        9,
+        1,
+        matrix_activation_functions::Identifiers::ReLU,
+        matrix_activation_functions::Identifiers::Tanh>;
+
+    using preprocessor  = data_processor::iterable_converter;
+    using postprocessor = data_processor::scalar_converter;
+    using return_type   = NET::value_type;
+
+    using brain_t =
+        ga_neural_model::brain<NET, preprocessor, postprocessor, return_type>;
+
+    brain_t a(random::randnormal, 0, 1);
+    brain_t b(random::randnormal, 0, 1);
+    brain_t c = a;
+    brain_t d = b;
+
+    // Grows a hidden node or two on the way
+    for (std::size_t gen = 0; gen != 50; ++gen)
+    {
+        a.mutate([](float x) { return x + random::randnormal(0, 0.1f); });
+        b.mutate([](float x) { return x + random::randnormal(0, 0.1f); });
+    }
+    ga_neural_model::to_target_brain_crossover(a, b, c, d);
+
+    const std::array<float, 9> board{};
+    std::cout << c(board) << ' ' << d(board) << std::endl;
+    std::cout << c.get_net().hidden_count() << " hidden nodes, "
+              << c.get_net().plan_edge_count() << " connections run\n";
+}
+
 int main()
 {
     new_brain_test();
+    neat_brain_test();
 
     return EXIT_SUCCESS;
 }
@@ -5,8 +5,10 @@
 #endif
 
 #include "error_handling.hpp"
+#include "kernels.hpp"
 #include <algorithm>
 #include <cmath>
+#include <concepts>
 #include <functional>
 #include <iostream>
 #include <sstream>
@@ -281,9 +283,22 @@ struct ReLU
         ReLU_impl(mat);
     }
 
+    [[nodiscard]]
+    inline static auto element_function(const parameters_type&)
+    {
+        return [](T x) { return std::max(T(), x); };
+    }
+
+    // Derivative at x, for backpropagation (see ga_snn::backprop)
+    [[nodiscard]]
+    inline static auto derivative_function(const parameters_type&)
+    {
+        return [](T x) { return x > T() ? T(1) : T(); };
+    }
+
     inline static void ReLU_impl(Mat& mat)
     {
-        mat.transform([](T x) { return std::max(T(), x); }
+        mat.transform(element_function({})
         ); //  { return x > T{} ? x : T{}; });
     }
 
@@ -302,11 +317,34 @@ struct Sigmoid
         Sigmoid_impl(mat);
     }
 
-    inline static void Sigmoid_impl(Mat& mat)
+    [[nodiscard]]
+    inline static auto element_function(const parameters_type&)
     {
-        mat.transform([](T x) {
+        return [](T x) {
             return static_cast<T>(T(1) / (T(1) + std::exp(-x)));
-        });
+        };
+    }
+
+    // See activation_precision
+    [[nodiscard]]
+    inline static auto fast_element_function(const parameters_type&)
+        requires std::same_as<T, float>
+    {
+        return ga_sm::simd::sigmoid_function{};
+    }
+
+    [[nodiscard]]
+    inline static auto derivative_function(const parameters_type&)
+    {
+        return [](T x) {
+            const auto s = static_cast<T>(T(1) / (T(1) + std::exp(-x)));
+            return s * (T(1) - s);
+        };
+    }
+
+    inline static void Sigmoid_impl(Mat& mat)
+    {
+        mat.transform(element_function({}));
     }
 
     static constexpr auto name = "Sigmoid";
@@ -323,6 +361,18 @@ struct Identity
         Identity_impl(mat);
     }
 
+    [[nodiscard]]
+    inline static auto element_function(const parameters_type&)
+    {
+        return [](T x) { return x; };
+    }
+
+    [[nodiscard]]
+    inline static auto derivative_function(const parameters_type&)
+    {
+        return [](T) { return T(1); };
+    }
+
     inline static void Identity_impl(Mat&)
     {
     }
@@ -341,9 +391,31 @@ struct Tanh
         Tanh_impl(mat);
     }
 
+    [[nodiscard]]
+    inline static auto element_function(const parameters_type&)
+    {
+        return [](T x) { return static_cast<T>(std::tanh(x)); };
+    }
+
+    [[nodiscard]]
+    inline static auto fast_element_function(const parameters_type&)
+        requires std::same_as<T, float>
+    {
+        return ga_sm::simd::tanh_function{};
+    }
+
+    [[nodiscard]]
+    inline static auto derivative_function(const parameters_type&)
+    {
+        return [](T x) {
+            const auto t = static_cast<T>(std::tanh(x));
+            return T(1) - t * t;
+        };
+    }
+
     inline static void Tanh_impl(Mat& mat)
     {
-        mat.transform([](T x) { return static_cast<T>(std::tanh(x)); });
+        mat.transform(element_function({}));
     }
 
     static constexpr auto name = "Tanh";
@@ -363,13 +435,39 @@ struct GELU
         GELU_impl(mat);
     }
 
-    inline static void GELU_impl(Mat& mat)
+    [[nodiscard]]
+    inline static auto element_function(const parameters_type&)
     {
-        mat.transform([](T x) {
+        return [](T x) {
             return static_cast<T>(
                 x / 2 * (T(1) + std::erf(x / std::sqrt(T(2))))
             );
-        });
+        };
+    }
+
+    [[nodiscard]]
+    inline static auto fast_element_function(const parameters_type&)
+        requires std::same_as<T, float>
+    {
+        return ga_sm::simd::gelu_function{};
+    }
+
+    // Phi(x) + x * phi(x), Phi and phi being the standard normal cdf and pdf
+    [[nodiscard]]
+    inline static auto derivative_function(const parameters_type&)
+    {
+        return [](T x) {
+            constexpr auto inv_sqrt_2pi = T(0.398942280401432677939946);
+            return static_cast<T>(
+                (T(1) + std::erf(x / std::sqrt(T(2)))) / 2 +
+                x * inv_sqrt_2pi * std::exp(-x * x / 2)
+            );
+        };
+    }
+
+    inline static void GELU_impl(Mat& mat)
+    {
+        mat.transform(element_function({}));
     }
 
     static constexpr auto name = "GELU";
@@ -389,11 +487,33 @@ struct SiLU
         SiLU_impl(mat);
     }
 
-    inline static void SiLU_impl(Mat& mat)
+    [[nodiscard]]
+    inline static auto element_function(const parameters_type&)
     {
-        mat.transform([](T x) {
+        return [](T x) {
             return static_cast<T>(x / (T(1) + std::exp(-x)));
-        });
+        };
+    }
+
+    [[nodiscard]]
+    inline static auto fast_element_function(const parameters_type&)
+        requires std::same_as<T, float>
+    {
+        return ga_sm::simd::silu_function{};
+    }
+
+    [[nodiscard]]
+    inline static auto derivative_function(const parameters_type&)
+    {
+        return [](T x) {
+            const auto s = static_cast<T>(T(1) / (T(1) + std::exp(-x)));
+            return s * (T(1) + x * (T(1) - s));
+        };
+    }
+
+    inline static void SiLU_impl(Mat& mat)
+    {
+        mat.transform(element_function({}));
     }
 
     static constexpr auto name = "SiLU";
@@ -414,8 +534,22 @@ struct Softmax
         Softmax_impl(mat);
     }
 
+    /**
+     * \brief Row by row. Float rows go through ga_sm::simd::softmax, any
+     *        other type through the max, the exps and their sum, then the
+     *        quotients.
+     */
     inline static void Softmax_impl(Mat& mat)
     {
+        if constexpr (std::same_as<T, float> && requires {
+                          mat.m_Elems;
+                          Mat::Row_Stride;
+                      })
+        {
+            ga_sm::simd::softmax(M, N, mat.m_Elems, Mat::Row_Stride);
+            return;
+        }
+
         for (size_t j = 0; j != M; ++j)
         {
             matrix_iterator start   = mat.begin() + j * N;
@@ -436,6 +570,27 @@ struct Softmax
         }
     }
 
+    /**
+     * \brief Turns gradient, of a loss with respect to the outputs out of
+     *        Softmax, into the one with respect to its inputs:
+     *        g_i = out_i * (g_i - sum_k g_k * out_k), row by row
+     */
+    inline static void backward(Mat const& out, Mat& gradient)
+    {
+        for (size_t j = 0; j != M; ++j)
+        {
+            auto dot = T();
+            for (size_t i = 0; i != N; ++i)
+            {
+                dot += gradient[j, i] * out[j, i];
+            }
+            for (size_t i = 0; i != N; ++i)
+            {
+                gradient[j, i] = out[j, i] * (gradient[j, i] - dot);
+            }
+        }
+    }
+
     static constexpr auto name = "Softmax";
 };
 
@@ -453,11 +608,35 @@ struct Swish
         Swish_impl(mat, params.beta);
     }
 
-    inline static void Swish_impl(Mat& mat, T beta)
+    [[nodiscard]]
+    inline static auto element_function(const parameters_type& params)
     {
-        mat.transform([_beta = beta](T x) {
+        return [_beta = params.beta](T x) {
             return static_cast<T>(x / (T(1) + std::exp(-_beta * x)));
-        });
+        };
+    }
+
+    [[nodiscard]]
+    inline static auto fast_element_function(const parameters_type& params)
+        requires std::same_as<T, float>
+    {
+        return ga_sm::simd::swish_function{ params.beta };
+    }
+
+    // The derivative with respect to x only, beta is left to mutation
+    [[nodiscard]]
+    inline static auto derivative_function(const parameters_type& params)
+    {
+        return [_beta = params.beta](T x) {
+            const auto s =
+                static_cast<T>(T(1) / (T(1) + std::exp(-_beta * x)));
+            return s * (T(1) + _beta * x * (T(1) - s));
+        };
+    }
+
+    inline static void Swish_impl(Mat& mat, T beta)
+    {
+        mat.transform(element_function({ beta }));
     }
 
     static constexpr auto name = "Swish";
@@ -474,13 +653,28 @@ struct PReLU
         PReLU_impl(mat, params.alpha);
     }
 
-    inline static void PReLU_impl(Mat& mat, T alpha)
+    [[nodiscard]]
+    inline static auto element_function(const parameters_type& params)
     {
-        mat.transform([_alpha = alpha](T x) {
+        return [_alpha = params.alpha](T x) {
             return static_cast<T>(
                 std::max<T>(T(), x) + _alpha * std::min<T>(T{}, x)
             );
-        });
+        };
+    }
+
+    // The derivative with respect to x only, alpha is left to mutation
+    [[nodiscard]]
+    inline static auto derivative_function(const parameters_type& params)
+    {
+        return [_alpha = params.alpha](T x) {
+            return x > T() ? T(1) : _alpha;
+        };
+    }
+
+    inline static void PReLU_impl(Mat& mat, T alpha)
+    {
+        mat.transform(element_function({ alpha }));
     }
 
     static constexpr auto name = "PReLU";
@@ -492,18 +686,29 @@ struct Threshold
     using T               = typename Mat::value_type;
     using parameters_type = threshold_parameters_type<T>;
 
-    inline void operator()(Mat& mat, const parameters_type& params) const
+    inline void operator()(Mat& mat, const parameters_type&) const
     {
-        Threshold_impl(mat, params.threshold);
+        Threshold_impl(mat);
     }
 
-    inline static void Threshold_impl(Mat& mat, T threshold)
+    // A step at 0, the threshold parameter is carried but not applied
+    [[nodiscard]]
+    inline static auto element_function(const parameters_type&)
     {
-        // mat.transform([_threshold = threshold](T x) { return x > _threshold ?
-        // T(1) : T(); });
-        mat.transform([_threshold = threshold](T x) {
-            return x > T() ? T(1) : T();
-        });
+        return [](T x) { return x > T() ? T(1) : T(); };
+    }
+
+    // A step: its derivative is 0 wherever it exists, no gradient flows
+    // through it
+    [[nodiscard]]
+    inline static auto derivative_function(const parameters_type&)
+    {
+        return [](T) { return T(); };
+    }
+
+    inline static void Threshold_impl(Mat& mat)
+    {
+        mat.transform(element_function({}));
     }
 
     static constexpr auto name = "Threshold";
@@ -526,6 +731,20 @@ struct Identifiers
     };
 };
 
+/**
+ * \brief How element_function computes Sigmoid, Tanh, GELU, SiLU and Swish.
+ *        exact calls libm (std::exp, std::tanh, std::erf). fast, for float
+ *        only, uses the polynomial approximations of vector_math.hpp, within
+ *        a few ulps of it, which the kernels inline and evaluate a vector
+ *        register at a time. Other functions and types, and derivatives, are
+ *        computed the same in both.
+ */
+enum class activation_precision
+{
+    exact,
+    fast
+};
+
 template <
     typename Mat,
     matrix_activation_functions::Identifiers::Identifiers_ Function_Identifier>
@@ -555,23 +774,126 @@ constexpr auto choose_func() noexcept -> decltype(auto)
     assert_unreachable();
 }
 
+/**
+ * \brief Calls fn with id as a std::integral_constant, so activation
+ *        functions picked at run time reach their compile time
+ *        implementation (e.g. activation_function<Mat, decltype(id)::value>)
+ */
+template <typename Fn>
+constexpr auto visit_identifier(Identifiers::Identifiers_ id, Fn&& fn)
+    -> decltype(auto)
+{
+    const auto call = [&]<Identifiers::Identifiers_ Id>() -> decltype(auto) {
+        return std::invoke(
+            std::forward<Fn>(fn),
+            std::integral_constant<Identifiers::Identifiers_, Id>{}
+        );
+    };
+    switch (id)
+    {
+    case Identifiers::ReLU:
+        return call.template operator()<Identifiers::ReLU>();
+    case Identifiers::Sigmoid:
+        return call.template operator()<Identifiers::Sigmoid>();
+    case Identifiers::Tanh:
+        return call.template operator()<Identifiers::Tanh>();
+    case Identifiers::Identity:
+        return call.template operator()<Identifiers::Identity>();
+    case Identifiers::GELU:
+        return call.template operator()<Identifiers::GELU>();
+    case Identifiers::SiLU:
+        return call.template operator()<Identifiers::SiLU>();
+    case Identifiers::Softmax:
+        return call.template operator()<Identifiers::Softmax>();
+    case Identifiers::Swish:
+        return call.template operator()<Identifiers::Swish>();
+    case Identifiers::PReLU:
+        return call.template operator()<Identifiers::PReLU>();
+    case Identifiers::Threshold:
+        break;
+    }
+    return call.template operator()<Identifiers::Threshold>();
+}
+
 template <
     typename Mat,
-    matrix_activation_functions::Identifiers::Identifiers_ Function_Identifier>
+    matrix_activation_functions::Identifiers::Identifiers_ Function_Identifier,
+    activation_precision Precision = activation_precision::exact>
 struct activation_function
 {
     inline static constexpr auto Identifier = Function_Identifier;
+    inline static constexpr auto s_Precision = Precision;
     inline static constexpr auto activation_function_impl =
         choose_func<Mat, Function_Identifier>();
 
     using activation_function_type = decltype(activation_function_impl);
     using parameters_type = typename activation_function_type::parameters_type;
 
+    // Whether the function maps every element on its own (everything but
+    // Softmax), so it can be applied as part of another kernel
+    inline static constexpr bool is_element_wise = requires(parameters_type p) {
+        activation_function_type::element_function(p);
+    };
+
+    // Whether element_function is the fast one, see activation_precision
+    inline static constexpr bool is_fast =
+        Precision == activation_precision::fast &&
+        requires(parameters_type p) {
+            activation_function_type::fast_element_function(p);
+        };
+
     parameters_type params;
 
     void operator()(Mat& mat) const
     {
-        std::invoke(activation_function_impl, mat, params);
+        if constexpr (is_fast)
+        {
+            mat.transform(element_function());
+        }
+        else
+        {
+            std::invoke(activation_function_impl, mat, params);
+        }
+    }
+
+    /**
+     * \brief Scalar T -> T version of the function, with the current
+     *        parameters bound. The fast one also maps float vectors (see
+     *        ga_sm::simd::apply_lanes).
+     */
+    [[nodiscard]]
+    auto element_function() const
+        requires is_element_wise
+    {
+        if constexpr (is_fast)
+        {
+            return activation_function_type::fast_element_function(params);
+        }
+        else
+        {
+            return activation_function_type::element_function(params);
+        }
+    }
+
+    /**
+     * \brief Scalar derivative of element_function, with the current
+     *        parameters bound
+     */
+    [[nodiscard]]
+    auto derivative_function() const
+        requires is_element_wise
+    {
+        return activation_function_type::derivative_function(params);
+    }
+
+    /**
+     * \brief Backpropagates gradient through a function that is not
+     *        element-wise (Softmax), see its backward
+     */
+    void backward(Mat const& out, Mat& gradient) const
+        requires(!is_element_wise)
+    {
+        activation_function_type::backward(out, gradient);
     }
 
     template <typename Fn>
@@ -618,8 +940,11 @@ struct activation_function
 
 template <
     typename Mat,
-    matrix_activation_functions::Identifiers::Identifiers_ Function_Identifier>
-void activation_function_dummy(activation_function<Mat, Function_Identifier>)
+    matrix_activation_functions::Identifiers::Identifiers_ Function_Identifier,
+    activation_precision Precision>
+void activation_function_dummy(
+    activation_function<Mat, Function_Identifier, Precision>
+)
 {
 }
 
@@ -0,0 +1,394 @@
+#pragma once
+
+#ifndef BACKPROP
+#define BACKPROP
+
+#include "static_matrix.hpp"
+#include "static_neural_net.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+/*
+Gradient descent for static_neural_nets, to refine nets evolution found
+(Lamarckian refinement, see EvolutionEnvironment/refinement_policy.hpp).
+
+A gradient_trainer evaluates the mean loss of a net over a dataset together
+with its gradient, by reverse-mode differentiation through the layers
+(basic_static_neural_net::backward_pass): the samples go through the net
+Rows at a time, every layer keeping its pre-activations and outputs, then
+the gradient of the loss is backpropagated from the outputs to the first
+layer. Its Optimizer turns the gradient into the steps the weights and
+biases take. Activation parameters (Swish's beta, PReLU's alpha) are left to
+mutation.
+*/
+
+namespace ga_snn
+{
+
+//--------------------------------------------------------------------------------------//
+//  Losses
+//--------------------------------------------------------------------------------------//
+
+/**
+ * \brief Loss of an output y against its target t, and its derivative with
+ *        respect to y. A net's loss on a sample is the sum over its outputs.
+ */
+template <typename Loss, typename T>
+concept loss_function_type = requires(T y, T t) {
+    {
+        Loss::value(y, t)
+    } -> std::convertible_to<T>;
+    {
+        Loss::gradient(y, t)
+    } -> std::convertible_to<T>;
+};
+
+struct squared_error
+{
+    template <std::floating_point T>
+    [[nodiscard]]
+    static constexpr auto value(T y, T t) noexcept -> T
+    {
+        return (y - t) * (y - t);
+    }
+
+    template <std::floating_point T>
+    [[nodiscard]]
+    static constexpr auto gradient(T y, T t) noexcept -> T
+    {
+        return 2 * (y - t);
+    }
+};
+
+/**
+ * \brief Categorical cross entropy, for nets whose outputs are a
+ *        distribution (Softmax) and targets that sum to 1. s_Epsilon is
+ *        added to the outputs so that one that underflows to 0 has a finite
+ *        loss, and the gradient is the derivative of that same value.
+ */
+struct cross_entropy
+{
+    template <std::floating_point T>
+    [[nodiscard]]
+    static auto value(T y, T t) noexcept -> T
+    {
+        return -t * std::log(std::max(y, T(0)) + s_Epsilon<T>);
+    }
+
+    template <std::floating_point T>
+    [[nodiscard]]
+    static constexpr auto gradient(T y, T t) noexcept -> T
+    {
+        return y > 0 ? -t / (y + s_Epsilon<T>) : T(0);
+    }
+
+private:
+    template <std::floating_point T>
+    static constexpr T s_Epsilon = T(1e-12);
+};
+
+//--------------------------------------------------------------------------------------//
+//  Optimizers
+//--------------------------------------------------------------------------------------//
+
+/**
+ * \brief Turns gradients into the steps the parameters take, in place. reset
+ *        forgets the state of the previous steps, sized for a number of
+ *        parameters.
+ */
+template <typename O>
+concept optimizer_type =
+    requires(O o, std::span<typename O::value_type> gradients) {
+        o.reset(std::size_t{});
+        o.step(gradients);
+    };
+
+/**
+ * \brief Stochastic gradient descent, with momentum if it is not 0
+ */
+template <std::floating_point T>
+class sgd
+{
+public:
+    using value_type = T;
+
+private:
+    value_type              m_Learning_Rate;
+    value_type              m_Momentum;
+    std::vector<value_type> m_Velocity;
+
+public:
+    explicit sgd(
+        value_type learning_rate = value_type(0.01),
+        value_type momentum      = 0
+    ) :
+        m_Learning_Rate{ learning_rate },
+        m_Momentum{ momentum }
+    {
+    }
+
+    auto reset(std::size_t parameters) -> void
+    {
+        m_Velocity.assign(m_Momentum != 0 ? parameters : 0, value_type());
+    }
+
+    auto step(std::span<value_type> gradients) -> void
+    {
+        if (m_Momentum == 0)
+        {
+            for (auto& g : gradients)
+            {
+                g *= m_Learning_Rate;
+            }
+            return;
+        }
+        assert(m_Velocity.size() == gradients.size());
+        for (std::size_t i = 0; i != gradients.size(); ++i)
+        {
+            m_Velocity[i] = m_Momentum * m_Velocity[i] + gradients[i];
+            gradients[i]  = m_Learning_Rate * m_Velocity[i];
+        }
+    }
+};
+
+/**
+ * \brief Adam: steps of learning_rate scaled by running, bias corrected
+ *        estimates of the mean and variance of every gradient
+ */
+template <std::floating_point T>
+class adam
+{
+public:
+    using value_type = T;
+
+private:
+    value_type              m_Learning_Rate;
+    value_type              m_Beta1;
+    value_type              m_Beta2;
+    value_type              m_Epsilon;
+    std::vector<value_type> m_Mean;
+    std::vector<value_type> m_Variance;
+    // beta1 and beta2 to the number of steps taken
+    value_type m_Beta1_Power = 1;
+    value_type m_Beta2_Power = 1;
+
+public:
+    explicit adam(
+        value_type learning_rate = value_type(0.001),
+        value_type beta1         = value_type(0.9),
+        value_type beta2         = value_type(0.999),
+        value_type epsilon       = value_type(1e-8)
+    ) :
+        m_Learning_Rate{ learning_rate },
+        m_Beta1{ beta1 },
+        m_Beta2{ beta2 },
+        m_Epsilon{ epsilon }
+    {
+    }
+
+    auto reset(std::size_t parameters) -> void
+    {
+        m_Mean.assign(parameters, value_type());
+        m_Variance.assign(parameters, value_type());
+        m_Beta1_Power = 1;
+        m_Beta2_Power = 1;
+    }
+
+    auto step(std::span<value_type> gradients) -> void
+    {
+        assert(m_Mean.size() == gradients.size());
+        m_Beta1_Power *= m_Beta1;
+        m_Beta2_Power *= m_Beta2;
+        const auto mean_correction     = 1 / (1 - m_Beta1_Power);
+        const auto variance_correction = 1 / (1 - m_Beta2_Power);
+        for (std::size_t i = 0; i != gradients.size(); ++i)
+        {
+            const auto g  = gradients[i];
+            m_Mean[i]     = m_Beta1 * m_Mean[i] + (1 - m_Beta1) * g;
+            m_Variance[i] = m_Beta2 * m_Variance[i] + (1 - m_Beta2) * g * g;
+            gradients[i]  = m_Learning_Rate * m_Mean[i] * mean_correction /
+                           (std::sqrt(m_Variance[i] * variance_correction) +
+                            m_Epsilon);
+        }
+    }
+};
+
+//--------------------------------------------------------------------------------------//
+//  Trainer
+//--------------------------------------------------------------------------------------//
+
+/**
+ * \brief Gradient descent on nets of type NNet, see the top of this file.
+ *        Datasets are given as inputs, rows of s_Inputs values back to
+ *        back, and targets, as many rows of s_Outputs values. The buffers
+ *        of the passes are allocated once, so a trainer refines any number
+ *        of nets without allocating.
+ * \tparam Rows Samples per backward pass. A last, partial chunk is padded
+ *         with samples that do not count.
+ */
+template <
+    static_neural_net_type NNet,
+    optimizer_type         Optimizer = adam<typename NNet::value_type>,
+    typename Loss                    = squared_error,
+    std::size_t Rows                 = NNet::s_Micro_Batch>
+    requires(
+        loss_function_type<Loss, typename NNet::value_type> &&
+        std::same_as<typename Optimizer::value_type, typename NNet::value_type> &&
+        Rows > 0
+    )
+class gradient_trainer
+{
+public:
+    using net_type       = NNet;
+    using value_type     = typename NNet::value_type;
+    using optimizer_type = Optimizer;
+    using loss_type      = Loss;
+
+    static constexpr std::size_t s_Inputs  = NNet::s_Input_Size;
+    static constexpr std::size_t s_Outputs = NNet::s_Output_Size;
+    static constexpr std::size_t s_Rows    = Rows;
+
+private:
+    Optimizer               m_Optimizer;
+    std::vector<value_type> m_Gradients;
+    std::vector<value_type> m_Values;
+    std::vector<value_type> m_Tail;
+
+public:
+    explicit gradient_trainer(Optimizer optimizer = Optimizer{}) :
+        m_Optimizer{ std::move(optimizer) },
+        m_Gradients(NNet::s_Gradient_Size),
+        m_Values(Rows * NNet::s_Backward_Values),
+        m_Tail(Rows * s_Inputs)
+    {
+        m_Optimizer.reset(NNet::s_Gradient_Size);
+    }
+
+    /**
+     * \brief Mean loss of net over the dataset. Its gradient with respect to
+     *        the weights and biases of the net is left in gradients().
+     */
+    auto gradient(
+        NNet const&                 net,
+        std::span<const value_type> inputs,
+        std::span<const value_type> targets
+    ) -> value_type
+    {
+        assert(inputs.size() % s_Inputs == 0);
+        const auto rows = inputs.size() / s_Inputs;
+        assert(targets.size() == rows * s_Outputs);
+
+        std::ranges::fill(m_Gradients, value_type());
+        if (rows == 0)
+        {
+            return value_type();
+        }
+
+        const auto scale = 1 / static_cast<value_type>(rows);
+        value_type loss{};
+        for (std::size_t first = 0; first < rows; first += Rows)
+        {
+            const auto        count  = std::min(Rows, rows - first);
+            const value_type* in     = inputs.data() + first * s_Inputs;
+            const value_type* target = targets.data() + first * s_Outputs;
+            if (count != Rows)
+            {
+                const auto tail =
+                    std::copy_n(in, count * s_Inputs, m_Tail.begin());
+                std::fill(tail, m_Tail.end(), value_type());
+                in = m_Tail.data();
+            }
+
+            net.backward_pass(
+                ga_sm::static_matrix_view<const value_type, Rows, s_Inputs>{
+                    in },
+                [&](auto outputs, auto output_gradient) {
+                    for (std::size_t j = 0; j != Rows; ++j)
+                    {
+                        for (std::size_t i = 0; i != s_Outputs; ++i)
+                        {
+                            if (j >= count)
+                            {
+                                output_gradient[j, i] = value_type();
+                                continue;
+                            }
+                            const auto y = outputs[j, i];
+                            const auto t = target[j * s_Outputs + i];
+                            loss += Loss::value(y, t);
+                            output_gradient[j, i] =
+                                scale * Loss::gradient(y, t);
+                        }
+                    }
+                },
+                m_Values.data(),
+                m_Gradients.data()
+            );
+        }
+        return loss * scale;
+    }
+
+    /**
+     * \brief One step of the optimizer down the gradient of the loss of net
+     *        over the dataset. Returns the loss before the step.
+     */
+    auto step(
+        NNet&                       net,
+        std::span<const value_type> inputs,
+        std::span<const value_type> targets
+    ) -> value_type
+    {
+        const auto loss = gradient(net, inputs, targets);
+        m_Optimizer.step(std::span{ m_Gradients });
+        net.descend(m_Gradients);
+        return loss;
+    }
+
+    /**
+     * \brief steps steps of a fresh optimizer (its state is reset, nets
+     *        refined in turn do not share it). Returns the loss before the
+     *        last step.
+     */
+    auto refine(
+        NNet&                       net,
+        std::span<const value_type> inputs,
+        std::span<const value_type> targets,
+        std::size_t                 steps
+    ) -> value_type
+    {
+        m_Optimizer.reset(NNet::s_Gradient_Size);
+        value_type loss{};
+        for (std::size_t i = 0; i != steps; ++i)
+        {
+            loss = step(net, inputs, targets);
+        }
+        return loss;
+    }
+
+    /**
+     * \brief Gradient of the last call to gradient, laid out as
+     *        basic_static_neural_net::backward_pass's: the weights of every
+     *        layer in their layout, then its bias. After a step, the steps
+     *        the optimizer took instead.
+     */
+    [[nodiscard]]
+    auto gradients() const noexcept -> std::span<const value_type>
+    {
+        return m_Gradients;
+    }
+
+    [[nodiscard]]
+    auto optimizer() noexcept -> Optimizer&
+    {
+        return m_Optimizer;
+    }
+};
+
+} // namespace ga_snn
+
+#endif // !BACKPROP
@@ -0,0 +1,420 @@
+#pragma once
+
+#ifndef CACHED_NEURAL_NET
+#define CACHED_NEURAL_NET
+
+#include "static_neural_net.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cassert>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+A static_neural_net that remembers the outputs of its layers over the dataset
+it was last evaluated on, for evolution on a fixed evaluation dataset.
+
+dataset_forward_pass evaluates the net on a whole dataset, Rows samples per
+forward pass, keeping the outputs of every layer for every sample. Mutations
+go through the cached net, which flags the layers they change as dirty. The
+next dataset_forward_pass on the same dataset reuses the cached outputs of
+the layers before the first dirty one and only evaluates the layers from
+there on: after mutate_layer or mutate_set_layers of the last layers of a
+deep net, most of the evaluation is a cache hit. An agent carried over to the
+next generation unmutated (an elite) is not evaluated at all.
+
+Only those two save work on a mutated net. mutate, init, load and descend
+change every layer, so the next evaluation runs the whole net just like an
+uncached one: an evolution loop whose mutation policy goes through mutate
+(ga_neural_model::brain::mutate, as reproduction_manager does) only gains
+the skipped evaluation of its elites.
+
+The cache is keyed on a dataset_key, a fingerprint of the dataset's contents
+and its number of samples: evaluating the net on another key evaluates every
+layer again. dataset_forward_pass over a span hashes the samples on every
+call, a single pass over them. A caller that wants a cache hit to read
+nothing of the dataset keys it itself, e.g. hashing it once with
+dataset_key::of, or numbering its versions. The inputs are kept with the
+cache, for the layers evaluated again after a mutation. It holds
+s_Cached_Values values per sample of the dataset, the outputs of every layer,
+so it is meant for datasets of a few thousand samples. Copies of a net (e.g.
+the offspring of a ga_neural_model::brain) share the cache of the net they
+copy until one of them evaluates a mutation: it is copied then, if the
+mutation kept some layers clean, and dropped otherwise. Copying a net never
+copies its cache.
+
+The weights are only reachable as const (get_net): every change to them goes
+through a member function of cached_neural_net that flags its layers.
+
+dataset_forward_pass writes the cache, so it is not const: like any other
+non-const member function, it must not run on one net from two threads at
+once. Copies sharing a cache may be evaluated on different threads (as
+minimax evaluates brains): a net writes a cache in place only when no other
+net holds it, and copies it otherwise.
+*/
+
+namespace ga_snn
+{
+
+/**
+ * \brief Tells evaluation datasets apart: an id and the number of samples.
+ *        The id must change whenever the samples do, as the hash of of
+ *        does. A caller may instead give each version of its datasets its
+ *        own number, as long as no two of them share one.
+ */
+struct dataset_key
+{
+    std::size_t id      = 0;
+    std::size_t samples = 0;
+
+    /**
+     * \brief The key of samples samples whose values, back to back, are
+     *        values, with their hash as id
+     */
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    [[nodiscard]]
+    static auto of(std::span<const T> values, std::size_t samples) noexcept
+        -> dataset_key
+    {
+        const std::string_view bytes(
+            reinterpret_cast<const char*>(values.data()), values.size_bytes()
+        );
+        return { std::hash<std::string_view>{}(bytes), samples };
+    }
+
+    friend auto operator==(dataset_key, dataset_key) noexcept -> bool = default;
+};
+
+/**
+ * \brief NNet with an activation cache over its evaluation dataset, see the
+ *        top of this file
+ * \tparam Rows Samples per forward pass of dataset_forward_pass. A last,
+ *         partial chunk of the dataset is padded with zeros.
+ */
+template <static_neural_net_type NNet, std::size_t Rows = NNet::s_Micro_Batch>
+    requires(Rows > 0)
+class cached_neural_net
+{
+public:
+    using net_type         = NNet;
+    using value_type       = typename NNet::value_type;
+    using input_type       = typename NNet::input_type;
+    using output_type      = typename NNet::output_type;
+    using input_view_type  = typename NNet::input_view_type;
+    using output_view_type = typename NNet::output_view_type;
+    using dirty_flags_type = std::bitset<NNet::s_Layers>;
+
+    // Samples per forward pass of the net itself
+    static constexpr std::size_t s_Batch_Size =
+        NNet::template executor_type<>::s_Batch_Size;
+    static constexpr std::size_t s_Layers      = NNet::s_Layers;
+    static constexpr std::size_t s_Input_Size  = NNet::s_Input_Size;
+    static constexpr std::size_t s_Output_Size = NNet::s_Output_Size;
+    static constexpr std::size_t s_Rows        = Rows;
+
+    template <std::size_t Other_Batch_Size = s_Batch_Size>
+    using executor_type =
+        typename NNet::template executor_type<Other_Batch_Size>;
+
+private:
+    // Values of a chunk of Rows samples in the cache, the outputs of the net
+    // being the last Rows * s_Output_Size
+    static constexpr std::size_t s_Chunk_Values = Rows * NNet::s_Cached_Values;
+    static constexpr std::size_t s_Chunk_Outputs =
+        s_Chunk_Values - Rows * s_Output_Size;
+
+    struct activation_cache
+    {
+        // Inputs of the cached dataset, padded to whole chunks, and the
+        // outputs of every layer for them, chunk after chunk
+        std::vector<value_type>    inputs;
+        std::vector<value_type>    activations;
+        std::optional<dataset_key> key;
+    };
+
+    NNet m_Net;
+    // Shared by the copies of a net until one of them writes to it
+    std::shared_ptr<activation_cache> m_Cache;
+    // Layers whose cached outputs are stale, along with every later one
+    dirty_flags_type m_Dirty = dirty_flags_type{}.set();
+
+public:
+    cached_neural_net() = default;
+
+    explicit cached_neural_net(NNet const& net) :
+        m_Net{ net }
+    {
+    }
+
+    [[nodiscard]]
+    auto get_net() const noexcept -> NNet const&
+    {
+        return m_Net;
+    }
+
+    /**
+     * \brief Layers that dataset_forward_pass will evaluate again, from the
+     *        first set one on
+     */
+    [[nodiscard]]
+    auto dirty_layers() const noexcept -> dirty_flags_type
+    {
+        return m_Dirty;
+    }
+
+    // Drops the cached dataset along with the outputs of every layer
+    auto invalidate() noexcept -> void
+    {
+        invalidate_layers();
+        if (m_Cache)
+        {
+            m_Cache->key.reset();
+        }
+    }
+
+    template <std::size_t Other_Batch_Size = s_Batch_Size>
+    [[nodiscard]]
+    auto executor() const noexcept -> executor_type<Other_Batch_Size>
+    {
+        return m_Net.template executor<Other_Batch_Size>();
+    }
+
+    //--------------------------------------------------------------------------------------//
+    // Changes to the weights, which flag the layers they change
+    //--------------------------------------------------------------------------------------//
+
+    template <typename Fn, typename... Args>
+    auto init(Fn&& fn, Args&&... args) -> void
+    {
+        m_Net.init(std::forward<Fn>(fn), std::forward<Args>(args)...);
+        invalidate_layers();
+    }
+
+    template <typename Fn>
+    auto mutate(Fn&& fn) -> void
+    {
+        m_Net.mutate(std::forward<Fn>(fn));
+        invalidate_layers();
+    }
+
+    template <typename Fn>
+    auto mutate_layer(std::size_t layer_idx, Fn&& fn) -> void
+    {
+        assert(layer_idx < s_Layers);
+        m_Net.mutate_layer(layer_idx, std::forward<Fn>(fn));
+        m_Dirty.set(layer_idx);
+    }
+
+    template <typename Fn>
+    auto mutate_set_layers(const std::vector<size_t>& layers_idx, Fn&& fn)
+        -> void
+    {
+        m_Net.mutate_set_layers(layers_idx, std::forward<Fn>(fn));
+        for (const auto layer_idx : layers_idx)
+        {
+            if (layer_idx < s_Layers)
+            {
+                m_Dirty.set(layer_idx);
+            }
+        }
+    }
+
+    // See basic_static_neural_net::descend
+    auto descend(std::span<const value_type> steps) -> void
+    {
+        m_Net.descend(steps);
+        invalidate_layers();
+    }
+
+    auto load(const std::filesystem::path& filename) -> void
+    {
+        m_Net.load(filename);
+        invalidate_layers();
+    }
+
+    auto store(const std::filesystem::path& filename) const -> void
+    {
+        m_Net.store(filename);
+    }
+
+    //--------------------------------------------------------------------------------------//
+    // Evaluation
+    //--------------------------------------------------------------------------------------//
+
+    [[nodiscard]]
+    auto forward_pass(input_type const& input_data) const -> output_type
+    {
+        return m_Net.forward_pass(input_data);
+    }
+
+    auto forward_pass(input_view_type input_data, output_view_type output_data)
+        const -> void
+    {
+        m_Net.forward_pass(input_data, output_data);
+    }
+
+    /**
+     * \brief The net's outputs for a whole dataset, key: fill_inputs writes
+     *        its key.samples rows of s_Input_Size values back to back into
+     *        the span it is given, and outputs receives as many rows of
+     *        s_Output_Size. fill_inputs is only called when key is not the
+     *        dataset of the cache, and then every layer is evaluated; only
+     *        the layers from the first dirty one on are otherwise. A key
+     *        that outlives a change to its dataset returns stale outputs.
+     */
+    template <typename Fill_Inputs>
+        requires std::is_invocable_v<Fill_Inputs&, std::span<value_type>>
+    auto dataset_forward_pass(
+        dataset_key           key,
+        Fill_Inputs&&         fill_inputs,
+        std::span<value_type> outputs
+    ) -> void
+    {
+        const auto samples = key.samples;
+        assert(outputs.size() >= samples * s_Output_Size);
+
+        if (!m_Cache || key != m_Cache->key)
+        {
+            cache_dataset(key, fill_inputs);
+        }
+
+        if (m_Dirty.any())
+        {
+            // Copy on write, the other nets sharing the cache keep theirs
+            if (!owns_cache())
+            {
+                m_Cache = std::make_shared<activation_cache>(*m_Cache);
+            }
+            std::size_t first_layer = 0;
+            while (!m_Dirty.test(first_layer))
+            {
+                ++first_layer;
+            }
+            const auto chunks = m_Cache->inputs.size() / (Rows * s_Input_Size);
+            for (std::size_t c = 0; c != chunks; ++c)
+            {
+                m_Net.forward_pass_from(
+                    first_layer,
+                    ga_sm::static_matrix_view<
+                        const value_type,
+                        Rows,
+                        s_Input_Size>{ m_Cache->inputs.data() +
+                                       c * Rows * s_Input_Size },
+                    m_Cache->activations.data() + c * s_Chunk_Values
+                );
+            }
+            m_Dirty.reset();
+        }
+
+        for (std::size_t first = 0; first < samples; first += Rows)
+        {
+            const auto count = std::min(Rows, samples - first);
+            std::copy_n(
+                m_Cache->activations.data() + first / Rows * s_Chunk_Values +
+                    s_Chunk_Outputs,
+                count * s_Output_Size,
+                outputs.data() + first * s_Output_Size
+            );
+        }
+    }
+
+    /**
+     * \brief The net's outputs for the dataset inputs, rows of s_Input_Size
+     *        values back to back, keyed on their contents (dataset_key::of)
+     */
+    auto dataset_forward_pass(
+        std::span<const value_type> inputs,
+        std::span<value_type>       outputs
+    ) -> void
+    {
+        assert(inputs.size() % s_Input_Size == 0);
+        dataset_forward_pass(
+            dataset_key::of(inputs, inputs.size() / s_Input_Size),
+            [inputs](std::span<value_type> dst) {
+                std::ranges::copy(inputs, dst.begin());
+            },
+            outputs
+        );
+    }
+
+    //--------------------------------------------------------------------------------------//
+    // Utility
+    //--------------------------------------------------------------------------------------//
+
+    auto print_net() const -> void
+    {
+        m_Net.print_net();
+    }
+
+    auto print_address() const -> void
+    {
+        std::cout << "Net address: " << this << '\n';
+    }
+
+private:
+    // Drops the cached outputs of every layer
+    auto invalidate_layers() noexcept -> void
+    {
+        m_Dirty.set();
+        // Nothing in a shared cache is of use any more, let the other nets
+        // keep it rather than copy it on the next evaluation
+        if (m_Cache && !owns_cache())
+        {
+            m_Cache.reset();
+        }
+    }
+
+    // Whether no other net holds the cache, which may then be written in
+    // place. The acquire fence orders those writes after the reads of the
+    // nets that let go of it, on whichever thread they ran.
+    [[nodiscard]]
+    auto owns_cache() const noexcept -> bool
+    {
+        if (m_Cache.use_count() != 1)
+        {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    // Makes the dataset key, written by fill_inputs, the dataset of the
+    // cache, with every layer dirty. A cache shared with other nets is left
+    // to them.
+    template <typename Fill_Inputs>
+    auto cache_dataset(dataset_key key, Fill_Inputs& fill_inputs) -> void
+    {
+        if (!m_Cache || !owns_cache())
+        {
+            m_Cache = std::make_shared<activation_cache>();
+        }
+        auto& cache       = *m_Cache;
+        cache.key         = key;
+        const auto chunks = (key.samples + Rows - 1) / Rows;
+        const auto values = key.samples * s_Input_Size;
+        cache.inputs.resize(chunks * Rows * s_Input_Size);
+        fill_inputs(std::span<value_type>(cache.inputs.data(), values));
+        std::fill(
+            cache.inputs.begin() + static_cast<std::ptrdiff_t>(values),
+            cache.inputs.end(),
+            value_type()
+        );
+        cache.activations.resize(chunks * s_Chunk_Values);
+        m_Dirty.set();
+    }
+};
+
+} // namespace ga_snn
+
+#endif // !CACHED_NEURAL_NET
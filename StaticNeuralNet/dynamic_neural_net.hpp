@@ -0,0 +1,835 @@
+#pragma once
+
+#ifndef DYNAMIC_NEURAL_NET
+#define DYNAMIC_NEURAL_NET
+
+#include "Log.hpp"
+#include "activation_functions.hpp"
+#include "kernels.hpp"
+#include "static_neural_net.hpp"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+A fully connected net whose shape is only known at run time: the sibling of
+basic_static_neural_net for architecture sweeps, where every topology would
+otherwise be a new instantiation of the whole template stack.
+
+dynamic_neural_net takes its Layer_Signatures as a std::vector and lays out
+the layers as a static net of the same signatures does (the first layer maps
+the input onto itself), so the nets store and load the same files and a
+static net converts into a dynamic one.
+
+The layers run on the run time shape kernels of ga_sm::simd
+(dense_dynamic_candidates), which differ by their column tile width, plus
+kernels fully unrolled, as the static nets' layers are, for the few tiny
+shapes of dense_dynamic_unrolled_shapes (1 x N, 16 x 16).
+Which one is the fastest depends on the shape of the layer and on the CPU,
+so the first net with a layer of a given shape times them and the choice is
+kept in a dense_kernel_cache, shared by every net of the process. ReLU,
+identity and the fast activation functions without parameters (see
+activation_precision) are applied by the kernel itself, the other activation
+functions right after it, while the outputs are still in L1.
+*/
+
+namespace ga_snn
+{
+
+/**
+ * \brief The fastest ga_sm::simd::dense_dynamic kernel for each layer shape
+ *        (Inputs x Outputs) met so far, for the stateless epilogue Epilogue.
+ *        A shape is tuned once per process, the first time it is asked for,
+ *        by timing every candidate on s_Tuning_Rows rows (best of
+ *        s_Tuning_Runs runs). The candidates only differ by rounding,
+ *        in the order they sum the products.
+ */
+template <ga_sm::gemm::gemm_value_type T, typename Epilogue>
+class dense_kernel_cache
+{
+public:
+    using kernel_type = ga_sm::simd::dense_dynamic_kernel<T>;
+
+    static constexpr std::size_t s_Tuning_Rows = 32;
+    static constexpr std::size_t s_Tuning_Runs = 8;
+    // Multiply-adds timed per run
+    static constexpr std::size_t s_Tuning_Macs = std::size_t{ 1 } << 16;
+
+private:
+    std::map<std::pair<std::size_t, std::size_t>, kernel_type> m_Kernels;
+    mutable std::mutex                                         m_Mutex;
+
+public:
+    [[nodiscard]]
+    static auto global() -> dense_kernel_cache&
+    {
+        static dense_kernel_cache cache;
+        return cache;
+    }
+
+    // The kernel of Inputs x Outputs layers, tuned now if it is a new shape
+    [[nodiscard]]
+    auto get(std::size_t inputs, std::size_t outputs) -> kernel_type
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        const auto [it, inserted] =
+            m_Kernels.try_emplace({ inputs, outputs }, nullptr);
+        if (inserted)
+        {
+            it->second = tune(inputs, outputs);
+        }
+        return it->second;
+    }
+
+    // Shapes tuned so far
+    [[nodiscard]]
+    auto size() const -> std::size_t
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        return m_Kernels.size();
+    }
+
+private:
+    [[nodiscard]]
+    static auto tune(std::size_t K, std::size_t N) -> kernel_type
+    {
+        const auto candidates =
+            ga_sm::simd::dense_dynamic_candidates<T, Epilogue>(K, N);
+        if (!candidates[1])
+        {
+            return candidates[0];
+        }
+
+        // Small values, so that no candidate runs into denormals
+        std::vector<T> a(s_Tuning_Rows * K, T(0.5));
+        std::vector<T> w(K * N, T(0.01));
+        std::vector<T> bias(N, T(0.1));
+        std::vector<T> c(s_Tuning_Rows * N);
+        // Enough calls per run for small shapes to outweigh the clock
+        const auto calls = std::max<std::size_t>(
+            s_Tuning_Macs / (s_Tuning_Rows * K * N), 1
+        );
+
+        auto best      = candidates[0];
+        auto best_time = std::chrono::steady_clock::duration::max();
+        for (const auto kernel : candidates)
+        {
+            if (!kernel)
+            {
+                break;
+            }
+            auto time = std::chrono::steady_clock::duration::max();
+            for (std::size_t run = 0; run != s_Tuning_Runs; ++run)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                for (std::size_t call = 0; call != calls; ++call)
+                {
+                    kernel(
+                        s_Tuning_Rows,
+                        K,
+                        N,
+                        a.data(),
+                        K,
+                        w.data(),
+                        N,
+                        bias.data(),
+                        c.data(),
+                        N
+                    );
+                }
+                time = std::min(time, std::chrono::steady_clock::now() - start);
+            }
+            if (time < best_time)
+            {
+                best      = kernel;
+                best_time = time;
+            }
+        }
+        return best;
+    }
+};
+
+/**
+ * \brief Fully connected net of run time shape, see the top of this file.
+ *        Its layers are those of a basic_static_neural_net<T, 1,
+ *        weight_layout::input_major, Signatures...>, with all their
+ *        parameters in one contiguous buffer.
+ */
+template <ga_sm::gemm::gemm_value_type T>
+class dynamic_neural_net
+{
+public:
+    using value_type  = T;
+    using weight_type = T;
+    // One sample
+    using input_type  = std::vector<T>;
+    using output_type = std::vector<T>;
+    using kernel_type = ga_sm::simd::dense_dynamic_kernel<T>;
+
+private:
+    template <
+        matrix_activation_functions::Identifiers::Identifiers_ Id,
+        matrix_activation_functions::activation_precision      Precision =
+            matrix_activation_functions::activation_precision::exact>
+    using activation_of = matrix_activation_functions::
+        activation_function<ga_sm::static_matrix<T, 1, 1>, Id, Precision>;
+
+    using identity_epilogue = decltype(matrix_activation_functions::Identity<
+                                       ga_sm::static_matrix<T, 1, 1>>::
+                                           element_function({}));
+    using relu_epilogue     = decltype(matrix_activation_functions::ReLU<
+                                       ga_sm::static_matrix<T, 1, 1>>::
+                                           element_function({}));
+
+    struct layer_type
+    {
+        Layer_Structure Structure;
+        // Offset of the Inputs x Outputs weights in m_Parameters, followed by
+        // the bias and the parameters of the activation function
+        std::size_t Offset;
+        kernel_type Kernel;
+        // Whether Kernel applies the activation function itself
+        bool Fused_Activation;
+    };
+
+    std::vector<Layer_Signature> m_Signatures;
+    std::vector<layer_type>      m_Layers;
+    std::vector<T>               m_Parameters;
+    std::size_t                  m_Max_Size    = 0;
+    std::size_t                  m_Micro_Batch = 1;
+
+public:
+    /**
+     * \brief Net of the given signatures, at least 3 of them, with all its
+     *        parameters 0. Kernels are tuned for the shapes not seen yet.
+     */
+    explicit dynamic_neural_net(std::vector<Layer_Signature> signatures) :
+        m_Signatures{ std::move(signatures) }
+    {
+        if (m_Signatures.size() < 3)
+        {
+            throw std::invalid_argument(
+                "A dynamic_neural_net needs at least 3 layers"
+            );
+        }
+
+        std::size_t offset = 0;
+        std::size_t inputs = m_Signatures[0].Size;
+        for (const auto& signature : m_Signatures)
+        {
+            const Layer_Structure structure{ inputs,
+                                             signature.Size,
+                                             signature.Activation,
+                                             signature.Precision };
+            const auto [kernel, fused] = tuned_kernel(structure);
+            m_Layers.push_back({ structure, offset, kernel, fused });
+            offset += layer_parameter_count(m_Layers.size() - 1);
+            inputs = signature.Size;
+        }
+        m_Parameters.resize(offset);
+
+        m_Max_Size = std::ranges::max(m_Signatures, {}, &Layer_Signature::Size)
+                         .Size;
+        // As basic_static_neural_net::s_Micro_Batch
+        m_Micro_Batch = std::clamp<std::size_t>(
+            std::bit_floor(
+                ga_sm::gemm::cache_sizes::L1 / 4 / (m_Max_Size * sizeof(T))
+            ),
+            1,
+            32
+        );
+    }
+
+    /**
+     * \brief Copy of a static net, e.g. to sweep architectures around it
+     */
+    template <static_neural_net_type NNet>
+        requires std::same_as<typename NNet::weight_type, T>
+    explicit dynamic_neural_net(NNet const& net) :
+        dynamic_neural_net{ std::vector<Layer_Signature>(
+            NNet::s_Signatures.begin(), NNet::s_Signatures.end()
+        ) }
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (copy_layer(I, net.template layer<I>()), ...);
+        }(std::make_index_sequence<NNet::s_Layers>{});
+    }
+
+    [[nodiscard]]
+    auto signatures() const noexcept -> std::span<const Layer_Signature>
+    {
+        return m_Signatures;
+    }
+
+    [[nodiscard]]
+    auto layer_count() const noexcept -> std::size_t
+    {
+        return m_Layers.size();
+    }
+
+    [[nodiscard]]
+    auto layer_structure(std::size_t layer_idx) const noexcept
+        -> Layer_Structure const&
+    {
+        assert(layer_idx < m_Layers.size());
+        return m_Layers[layer_idx].Structure;
+    }
+
+    [[nodiscard]]
+    auto input_size() const noexcept -> std::size_t
+    {
+        return m_Signatures.front().Size;
+    }
+
+    [[nodiscard]]
+    auto output_size() const noexcept -> std::size_t
+    {
+        return m_Signatures.back().Size;
+    }
+
+    [[nodiscard]]
+    auto parameter_count() const noexcept -> std::size_t
+    {
+        return m_Parameters.size();
+    }
+
+    [[nodiscard]]
+    auto layer_parameter_count(std::size_t layer_idx) const noexcept
+        -> std::size_t
+    {
+        const auto& [inputs, outputs, activation, precision] =
+            layer_structure(layer_idx);
+        return outputs * (inputs + 1) + activation_parameter_count(activation);
+    }
+
+    // Weight from input to output of layer layer_idx
+    [[nodiscard]]
+    auto weight(std::size_t layer_idx, std::size_t input, std::size_t output)
+        const noexcept -> T const&
+    {
+        return weights(layer_idx)[input * layer_structure(layer_idx).Outputs +
+                                  output];
+    }
+
+    [[nodiscard]]
+    auto weight(std::size_t layer_idx, std::size_t input, std::size_t output)
+        noexcept -> T&
+    {
+        return weights(layer_idx)[input * layer_structure(layer_idx).Outputs +
+                                  output];
+    }
+
+    // Parameters of the layer, in the order they are stored
+    [[nodiscard]]
+    auto layer_parameters(std::size_t layer_idx) noexcept -> std::span<T>
+    {
+        return { weights(layer_idx), layer_parameter_count(layer_idx) };
+    }
+
+    [[nodiscard]]
+    auto layer_parameters(std::size_t layer_idx) const noexcept
+        -> std::span<const T>
+    {
+        return { weights(layer_idx), layer_parameter_count(layer_idx) };
+    }
+
+    template <typename Fn, typename... Args>
+        requires std::is_invocable_r_v<T, Fn, Args...>
+    auto init(Fn&& fn, Args&&... args) -> void
+    {
+        for (std::size_t l = 0; l != m_Layers.size(); ++l)
+        {
+            const auto& [inputs, outputs, activation, precision] =
+                layer_structure(l);
+            auto params = layer_parameters(l);
+            for (auto& p : params.first(outputs * (inputs + 1)))
+            {
+                p = static_cast<T>(std::invoke(fn, args...));
+            }
+            update_activation_parameters(
+                activation,
+                params.subspan(outputs * (inputs + 1)),
+                [&](auto& activation_params) {
+                    activation_params.fill(fn, args...);
+                }
+            );
+        }
+    }
+
+    template <typename Fn>
+    auto mutate(Fn&& fn) -> void
+    {
+        for (std::size_t l = 0; l != m_Layers.size(); ++l)
+        {
+            mutate_layer(l, fn);
+        }
+    }
+
+    template <typename Fn>
+    auto mutate_layer(std::size_t layer_idx, Fn&& fn) -> void
+    {
+        const auto& [inputs, outputs, activation, precision] =
+            layer_structure(layer_idx);
+        auto params = layer_parameters(layer_idx);
+        for (auto& p : params.first(outputs * (inputs + 1)))
+        {
+            p = fn(p);
+        }
+        update_activation_parameters(
+            activation,
+            params.subspan(outputs * (inputs + 1)),
+            [&](auto& activation_params) { activation_params.mutate(fn); }
+        );
+    }
+
+    template <typename Fn>
+    auto mutate_set_layers(const std::vector<size_t>& layers_idx, Fn&& fn)
+        -> void
+    {
+        for (std::size_t l = 0; l != m_Layers.size(); ++l)
+        {
+            if (std::ranges::find(layers_idx, l) != layers_idx.end())
+            {
+                mutate_layer(l, fn);
+            }
+        }
+    }
+
+    auto print_layers() const -> void
+    {
+        for (std::size_t l = 0; l != m_Layers.size(); ++l)
+        {
+            const auto& [inputs, outputs, activation, precision] =
+                layer_structure(l);
+            const auto params = layer_parameters(l);
+            for (std::size_t j = 0; j != inputs + 1; ++j)
+            {
+                for (std::size_t i = 0; i != outputs; ++i)
+                {
+                    std::cout << params[j * outputs + i] << ' ';
+                }
+                std::cout << '\n';
+            }
+            std::cout << '\n';
+            matrix_activation_functions::visit_identifier(
+                activation,
+                [&](auto id) {
+                    activation_of<id.value> activation_function{};
+                    load_activation_parameters(
+                        activation_function.params,
+                        params.subspan(outputs * (inputs + 1))
+                    );
+                    std::cout << activation_function << "\n\n";
+                }
+            );
+        }
+    }
+
+    auto print_net() const -> void
+    {
+        std::cout
+            << "##########################################################"
+               "################\n";
+        print_layers();
+        std::cout << "Net has " << parameter_count() << " parameters\n";
+        std::cout << "Net size: " << m_Parameters.size() * sizeof(T)
+                  << " bytes\n";
+        print_address();
+        std::cout
+            << "----------------------------------------------------------"
+               "----------------\n";
+    }
+
+    auto print_address() const -> void
+    {
+        std::cout << "Net address: " << this << '\n';
+    }
+
+    // Same format as basic_static_neural_net::store
+    auto store(const std::filesystem::path& filename) const -> void
+    {
+        std::ofstream out(filename);
+        if (!out.is_open())
+        {
+            const auto message =
+                "Could not open file: " + filename.string() + '\n';
+            std::cout << message;
+            log::add(message);
+            std::exit(EXIT_FAILURE);
+        }
+        // The precision too, so both nets load what the other stored
+        out << std::setprecision(std::numeric_limits<value_type>::max_digits10);
+        for (const auto& layer_signature : m_Signatures)
+        {
+            out << layer_signature.Size << ' ';
+        }
+        out << "\n\n";
+        for (std::size_t l = 0; l != m_Layers.size(); ++l)
+        {
+            const auto& [inputs, outputs, activation, precision] =
+                layer_structure(l);
+            const auto params = layer_parameters(l);
+            // The weights, then the bias, as static_matrix::store writes them
+            for (std::size_t j = 0; j != inputs + 1; ++j)
+            {
+                for (std::size_t i = 0; i != outputs; ++i)
+                {
+                    out << params[j * outputs + i] << ' ';
+                }
+                out << (j + 1 < inputs ? "\n" : "\n\n");
+            }
+            for (const auto p : params.subspan(outputs * (inputs + 1)))
+            {
+                out << p << "\n\n";
+            }
+        }
+    }
+
+    // Overrides current net with one read from "filename", stored by this
+    // net or by a static one. Shapes of both nets must be the same
+    auto load(const std::filesystem::path& filename) -> void
+    {
+        std::ifstream in(filename);
+        if (!in.is_open())
+        {
+            const std::string message =
+                "Could not open file: " + filename.string() + '\n';
+            std::cout << message;
+            log::add(message);
+            std::exit(EXIT_FAILURE);
+        }
+        typename Layer_Signature::size_type layer_size{};
+        for (const auto& layer_signature : m_Signatures)
+        {
+            in >> layer_size;
+            if (layer_size != layer_signature.Size)
+            {
+                const auto message =
+                    "Cannot load this net here. Shapes must match.\n";
+                std::cout << message;
+                log::add(message);
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        for (auto& p : m_Parameters)
+        {
+            in >> p;
+        }
+    }
+
+    [[nodiscard]]
+    auto forward_pass(input_type const& input_data) const -> output_type
+    {
+        output_type output(output_size());
+        forward_pass(std::span{ input_data }, std::span{ output });
+        return output;
+    }
+
+    /**
+     * \brief forward_pass over any number of rows: inputs holds rows of
+     *        input_size() values back to back and outputs receives as many
+     *        rows of output_size(). The rows go through the layers
+     *        micro-batch at a time (as basic_static_neural_net::forward_pass
+     *        over spans), with the hidden activations in a buffer of the
+     *        thread.
+     */
+    auto forward_pass(std::span<const T> inputs, std::span<T> outputs) const
+        -> void
+    {
+        assert(inputs.size() % input_size() == 0);
+        const auto rows = inputs.size() / input_size();
+        assert(outputs.size() >= rows * output_size());
+
+        auto& workspace = thread_workspace();
+        if (workspace.size() < 2 * m_Micro_Batch * m_Max_Size)
+        {
+            workspace.resize(2 * m_Micro_Batch * m_Max_Size);
+        }
+        T* const ping = workspace.data();
+        T* const pong = ping + m_Micro_Batch * m_Max_Size;
+
+        const T* in  = inputs.data();
+        T*       out = outputs.data();
+        for (std::size_t row = 0; row < rows; row += m_Micro_Batch)
+        {
+            const auto chunk = std::min(m_Micro_Batch, rows - row);
+            forward_pass_rows(chunk, in, out, ping, pong);
+            in += chunk * input_size();
+            out += chunk * output_size();
+        }
+    }
+
+private:
+    auto forward_pass_rows(
+        std::size_t rows,
+        const T*    in,
+        T*          out,
+        T*          ping,
+        T*          pong
+    ) const -> void
+    {
+        for (std::size_t l = 0; l != m_Layers.size(); ++l)
+        {
+            T* const layer_out = l + 1 == m_Layers.size() ? out : ping;
+            layer_forward_pass(m_Layers[l], rows, in, layer_out);
+            in = layer_out;
+            std::swap(ping, pong);
+        }
+    }
+
+    auto layer_forward_pass(
+        layer_type const& layer,
+        std::size_t       rows,
+        const T*          in,
+        T*                out
+    ) const -> void
+    {
+        const auto& [inputs, outputs, activation, precision] = layer.Structure;
+        const T* const w      = m_Parameters.data() + layer.Offset;
+        const T* const bias   = w + inputs * outputs;
+        const T* const params = bias + outputs;
+
+        layer.Kernel(
+            rows, inputs, outputs, in, inputs, w, outputs, bias, out, outputs
+        );
+
+        if (layer.Fused_Activation)
+        {
+            return;
+        }
+        const auto apply = [&](auto activation_function) {
+            if constexpr (decltype(activation_function)::is_element_wise)
+            {
+                load_activation_parameters(
+                    activation_function.params,
+                    std::span{ params, activation_function.parameter_count() }
+                );
+                std::ranges::transform(
+                    out,
+                    out + rows * outputs,
+                    out,
+                    activation_function.element_function()
+                );
+            }
+            else
+            {
+                // Softmax, row by row as matrix_activation_functions::Softmax
+                if constexpr (std::same_as<T, float>)
+                {
+                    ga_sm::simd::softmax(rows, outputs, out, outputs);
+                    return;
+                }
+                for (std::size_t j = 0; j != rows; ++j)
+                {
+                    T* const   start   = out + j * outputs;
+                    T* const   end     = start + outputs;
+                    const auto row_max = *std::max_element(start, end);
+                    auto       row_sum = T();
+                    for (auto p = start; p != end; ++p)
+                    {
+                        *p = std::exp(*p - row_max);
+                        row_sum += *p;
+                    }
+                    for (auto p = start; p != end; ++p)
+                    {
+                        *p /= row_sum;
+                    }
+                }
+            }
+        };
+        matrix_activation_functions::visit_identifier(activation, [&](auto id) {
+            if (precision == matrix_activation_functions::activation_precision::
+                                 fast)
+            {
+                apply(activation_of<
+                      id.value,
+                      matrix_activation_functions::activation_precision::fast>{
+                });
+            }
+            else
+            {
+                apply(activation_of<id.value>{});
+            }
+        });
+    }
+
+    /**
+     * \brief The kernel of a layer of that structure and whether it applies
+     *        the activation function itself: ReLU, identity and, for floats,
+     *        the fast activation functions without parameters (see
+     *        ga_sm::simd::sigmoid_function) are stateless epilogues of the
+     *        kernel, the others are applied after it.
+     */
+    [[nodiscard]]
+    static auto tuned_kernel(Layer_Structure const& structure)
+        -> std::pair<kernel_type, bool>
+    {
+        using matrix_activation_functions::Identifiers;
+        const auto [inputs, outputs, activation, precision] = structure;
+        if (activation == Identifiers::ReLU)
+        {
+            return {
+                dense_kernel_cache<T, relu_epilogue>::global().get(
+                    inputs, outputs
+                ),
+                true
+            };
+        }
+        if constexpr (std::same_as<T, float>)
+        {
+            if (precision == matrix_activation_functions::activation_precision::
+                                 fast)
+            {
+                kernel_type fused = nullptr;
+                matrix_activation_functions::visit_identifier(
+                    activation,
+                    [&](auto id) {
+                        using fast_activation = activation_of<
+                            id.value,
+                            matrix_activation_functions::activation_precision::
+                                fast>;
+                        if constexpr (fast_activation::is_fast)
+                        {
+                            using epilogue = decltype(fast_activation{}
+                                                          .element_function());
+                            if constexpr (std::is_empty_v<epilogue>)
+                            {
+                                fused = dense_kernel_cache<T, epilogue>::
+                                            global()
+                                                .get(inputs, outputs);
+                            }
+                        }
+                    }
+                );
+                if (fused != nullptr)
+                {
+                    return { fused, true };
+                }
+            }
+        }
+        return {
+            dense_kernel_cache<T, identity_epilogue>::global().get(
+                inputs, outputs
+            ),
+            activation == Identifiers::Identity
+        };
+    }
+
+    [[nodiscard]]
+    static auto activation_parameter_count(
+        matrix_activation_functions::Identifiers::Identifiers_ activation
+    ) noexcept -> std::size_t
+    {
+        return matrix_activation_functions::visit_identifier(
+            activation,
+            [](auto id) { return activation_of<id.value>::parameter_count(); }
+        );
+    }
+
+    // The parameters of the activation function params, a one member
+    // aggregate when it has any, from and to the values they are stored as
+    template <typename Params>
+    static auto load_activation_parameters(
+        Params&            params,
+        std::span<const T> values
+    ) noexcept -> void
+    {
+        if constexpr (Params::parameter_count() == 1)
+        {
+            auto& [value] = params;
+            value         = values[0];
+        }
+    }
+
+    template <typename Params>
+    static auto store_activation_parameters(
+        Params const& params,
+        std::span<T>  values
+    ) noexcept -> void
+    {
+        if constexpr (Params::parameter_count() == 1)
+        {
+            const auto& [value] = params;
+            values[0]           = value;
+        }
+    }
+
+    // Applies fn to the parameters of activation stored in values, e.g. to
+    // mutate them within the bounds of the function
+    template <typename Fn>
+    static auto update_activation_parameters(
+        matrix_activation_functions::Identifiers::Identifiers_ activation,
+        std::span<T>                                           values,
+        Fn&&                                                   fn
+    ) -> void
+    {
+        matrix_activation_functions::visit_identifier(activation, [&](auto id) {
+            activation_of<id.value> activation_function{};
+            load_activation_parameters(activation_function.params, values);
+            fn(activation_function.params);
+            store_activation_parameters(activation_function.params, values);
+        });
+    }
+
+    template <static_layer_type Layer>
+    auto copy_layer(std::size_t layer_idx, Layer const& layer) -> void
+    {
+        for (std::size_t j = 0; j != Layer::s_Inputs; ++j)
+        {
+            for (std::size_t i = 0; i != Layer::s_Outputs; ++i)
+            {
+                weight(layer_idx, j, i) = layer.weight(j, i);
+            }
+        }
+        const auto params = layer_parameters(layer_idx);
+        auto       bias   = params.subspan(Layer::s_Inputs * Layer::s_Outputs);
+        for (std::size_t i = 0; i != Layer::s_Outputs; ++i)
+        {
+            bias[i] = layer.get_bias_vector()[0, i];
+        }
+        store_activation_parameters(
+            layer.get_activation_function().params,
+            bias.subspan(Layer::s_Outputs)
+        );
+    }
+
+    [[nodiscard]]
+    auto weights(std::size_t layer_idx) const noexcept -> const T*
+    {
+        return m_Parameters.data() + m_Layers[layer_idx].Offset;
+    }
+
+    [[nodiscard]]
+    auto weights(std::size_t layer_idx) noexcept -> T*
+    {
+        return m_Parameters.data() + m_Layers[layer_idx].Offset;
+    }
+
+    [[nodiscard]]
+    static auto thread_workspace() -> std::vector<T>&
+    {
+        thread_local std::vector<T> workspace;
+        return workspace;
+    }
+};
+
+} // namespace ga_snn
+
+#endif // !DYNAMIC_NEURAL_NET
@@ -0,0 +1,178 @@
+#pragma once
+
+#ifndef STATIC_MATRIX_GEMM_KERNELS
+#define STATIC_MATRIX_GEMM_KERNELS
+
+#include "simd.hpp"
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+
+/*
+Packed, register blocked GEMM engine used by ga_sm::matrix_mul.
+
+C[M x N] = A[M x K] * B[K x N], all row major with leading dimensions
+lda, ldb and ldc (elements between consecutive rows).
+
+Structure (Goto / BLIS style):
+  - B is split in KC x NC panels, packed in NR wide column slivers.
+  - A is split in MC x KC panels, packed in MR tall row slivers.
+  - A MR x NR tile of C is kept in registers by the microkernel during the
+    whole KC loop, so every loaded element of A and B feeds MR or NR FMAs.
+Panels are zero padded to whole slivers, so the microkernel never has to deal
+with edges. Partial tiles of C are written through a small buffer.
+
+All blocking factors are compile time constants derived from M, K, N, the
+vector width of the tier and the cache sizes below, so every instantiation
+only reserves the packing buffers its own shape needs.
+
+This header only holds the shape dependent parameters. The packing routines
+and the microkernel are compiled per instruction set tier in
+tier_kernels.hpp.
+*/
+
+namespace ga_sm::gemm
+{
+
+struct cache_sizes
+{
+    // Per-core figures (i7-9750h: 32K L1d, 256K L2). L3 is shared, so NC is
+    // sized from one core's share of it: 12M over 6 cores.
+    inline static constexpr std::size_t L1 = 32 * 1024;
+    inline static constexpr std::size_t L2 = 256 * 1024;
+    inline static constexpr std::size_t L3 = 12 * 1024 * 1024 / 6;
+};
+
+[[nodiscard]]
+constexpr auto round_up(std::size_t value, std::size_t multiple) noexcept
+    -> std::size_t
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+[[nodiscard]]
+constexpr auto round_down(std::size_t value, std::size_t multiple) noexcept
+    -> std::size_t
+{
+    return std::max(value / multiple * multiple, multiple);
+}
+
+template <typename T>
+concept gemm_value_type = std::same_as<T, float> || std::same_as<T, double>;
+
+/**
+ * \brief Epilogue of a plain product: no bias, no activation
+ */
+struct no_epilogue
+{
+};
+
+template <
+    gemm_value_type T,
+    std::size_t     M,
+    std::size_t     K,
+    std::size_t     N,
+    std::size_t     Register_Bytes = simd::register_bytes>
+struct blocking
+{
+    static constexpr std::size_t s_Lanes = simd::lanes<T, Register_Bytes>;
+    // 6 x 2 registers of accumulators leave room for the B sliver and the
+    // broadcast A element within the 16 architectural vector registers.
+    // AVX-512 has 32 of them, so the tile grows to 12 x 2.
+    static constexpr std::size_t MR = Register_Bytes == 64 ? 12 : 6;
+    static constexpr std::size_t NR = 2 * s_Lanes;
+
+    // One A sliver and one B sliver share half of L1
+    static constexpr std::size_t KC = std::min(
+        K,
+        round_down(cache_sizes::L1 / 2 / ((MR + NR) * sizeof(T)), 8)
+    );
+    // The packed A panel lives in half of L2
+    static constexpr std::size_t MC = std::min(
+        round_up(M, MR),
+        round_down(cache_sizes::L2 / 2 / (KC * sizeof(T)), MR)
+    );
+    // The packed B panel lives in L3
+    static constexpr std::size_t NC = std::min(
+        round_up(N, NR),
+        round_down(cache_sizes::L3 / 2 / (KC * sizeof(T)), NR)
+    );
+};
+
+/**
+ * \brief Whether matrix_mul should route a shape through the blocked engine.
+ *        Packing only pays off once there are enough rows to fill most of a
+ *        register tile and enough work to amortise it. Smaller products stay
+ *        on the reference loop.
+ */
+template <typename T, std::size_t M, std::size_t K, std::size_t N>
+inline constexpr bool use_blocked_gemm = [] {
+    if constexpr (gemm_value_type<T>)
+    {
+        using block = blocking<T, M, K, N>;
+        return M >= block::MR && N >= block::s_Lanes && M * K * N >= 32768;
+    }
+    else
+    {
+        return false;
+    }
+}();
+
+/**
+ * \brief Whether multiply_add_activate should route a layer through the
+ *        blocked engine rather than the fused dense kernel. The dense kernel
+ *        streams W from where it is once per 4 rows of A, which beats packing
+ *        it as long as W stays in L2, e.g. the stacked layers of a
+ *        population_neural_net evaluated a batch of inputs at a time.
+ */
+template <typename T, std::size_t M, std::size_t K, std::size_t N>
+inline constexpr bool use_blocked_dense =
+    use_blocked_gemm<T, M, K, N> && K * N * sizeof(T) > cache_sizes::L2;
+
+/**
+ * \brief Whether matrix_mul should treat the right hand side as a small batch
+ *        of column vectors (see matvec_batch in tier_kernels.hpp). Up to 8
+ *        columns, a product is bound by streaming the left hand side once,
+ *        which the batched matrix vector kernel does without packing. Takes
+ *        precedence over the blocked engine.
+ */
+template <typename T, std::size_t M, std::size_t K, std::size_t N>
+inline constexpr bool use_batched_matvec = [] {
+    if constexpr (gemm_value_type<T>)
+    {
+        return N <= 8 && M >= 8 && K >= simd::lanes<T> && M * K * N >= 2048;
+    }
+    else
+    {
+        return false;
+    }
+}();
+
+/**
+ * \brief Whether multiply_add_activate should use the fully unrolled dense
+ *        kernel (see dense_unrolled in tier_kernels.hpp). In the tiny layers
+ *        of the evolved nets, loop overhead and the latency of one FMA chain
+ *        along K outweigh the few FMAs of the product. Rows of more than 4
+ *        vectors do not pay off: once unrolled, the broadcasts of A are
+ *        shared by all the columns and spill. The number of vector FMAs,
+ *        i.e. the code size of the kernel, is bounded too. Products of a
+ *        handful of scalars are left to the inlined reference loops. Takes
+ *        precedence over the other kernels.
+ */
+template <typename T, std::size_t M, std::size_t K, std::size_t N>
+inline constexpr bool use_unrolled_dense = [] {
+    if constexpr (gemm_value_type<T>)
+    {
+        constexpr std::size_t N_Vec =
+            (N + simd::lanes<T> - 1) / simd::lanes<T>;
+        return M * K * N >= 16 && N_Vec <= 4 && M * K * N_Vec <= 256;
+    }
+    else
+    {
+        return false;
+    }
+}();
+
+} // namespace ga_sm::gemm
+
+#endif // !STATIC_MATRIX_GEMM_KERNELS
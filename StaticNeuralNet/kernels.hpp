@@ -0,0 +1,570 @@
+#pragma once
+
+#ifndef STATIC_MATRIX_KERNELS
+#define STATIC_MATRIX_KERNELS
+
+#include "gemm_kernels.hpp"
+#include "reduced_precision.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring> //memcpy
+#include <immintrin.h>
+#include <limits>
+#include <utility>
+
+/*
+Multi-versioned static_matrix kernels.
+
+tier_kernels.hpp is compiled once per instruction set tier below. Each copy
+lives in its own namespace (simd::sse2, simd::sse4_2, simd::avx2,
+simd::avx512) and is compiled under the matching #pragma GCC target, so the
+binary itself only requires the x86-64 baseline. The entry points at the end
+of this file select the copy to run the first time they are called.
+
+The int8 kernels have one more copy, simd::avx512_vnni, picked over the
+avx512 one when the CPU also has AVX512-VNNI.
+*/
+
+namespace ga_sm::simd
+{
+
+/**
+ * \brief Instructions the int8 dot products of a tier are built on
+ */
+enum class int8_dot_kind : std::uint8_t
+{
+    madd16,  // sign extension to int16 and pmaddwd
+    maddubs, // pmaddubsw + pmaddwd
+    vnni,    // vpdpbusd
+};
+
+/**
+ * \brief Fused dense layer C = epilogue(A * W + bias) of run time shape
+ *        M x K x N, see dense_dynamic in tier_kernels.hpp. The epilogue is
+ *        compiled into the kernel.
+ */
+template <typename T>
+using dense_dynamic_kernel = void (*)(
+    std::size_t M,
+    std::size_t K,
+    std::size_t N,
+    const T*    a,
+    std::size_t lda,
+    const T*    w,
+    std::size_t ldw,
+    const T*    bias,
+    T*          c,
+    std::size_t ldc
+) noexcept;
+
+// Widest column tile, in vectors, of the dense_dynamic kernels
+inline constexpr std::size_t dense_dynamic_max_tile = 6;
+
+// Layer shapes, Inputs x Outputs, with a fully unrolled dense_dynamic
+// candidate: the single input layers and the 16 x 16 hidden layers of the
+// tiny evolved nets (those of the benchmarks), where loop overhead
+// outweighs the product. A hand picked list, not every shape
+// gemm::use_unrolled_dense takes: each entry costs an unrolled kernel per
+// tier, value type and epilogue at compile time. Other shapes only get the
+// tiled kernels.
+inline constexpr std::array<std::pair<std::size_t, std::size_t>, 6>
+    dense_dynamic_unrolled_shapes{
+        { { 1, 1 }, { 1, 4 }, { 1, 8 }, { 1, 16 }, { 1, 32 }, { 16, 16 } }
+    };
+
+/**
+ * \brief The fast activation functions of floats, polynomial approximations
+ *        within a few ulps of libm (see vector_math.hpp). Kernels apply them
+ *        a whole vector at a time (see apply_lanes), the float overloads run
+ *        the same code on one lane.
+ */
+struct sigmoid_function
+{
+    [[nodiscard]]
+    auto operator()(float x) const noexcept -> float;
+};
+
+struct silu_function
+{
+    [[nodiscard]]
+    auto operator()(float x) const noexcept -> float;
+};
+
+struct swish_function
+{
+    float beta = 1.f;
+
+    [[nodiscard]]
+    auto operator()(float x) const noexcept -> float;
+};
+
+struct tanh_function
+{
+    [[nodiscard]]
+    auto operator()(float x) const noexcept -> float;
+};
+
+struct gelu_function
+{
+    [[nodiscard]]
+    auto operator()(float x) const noexcept -> float;
+};
+
+namespace sse2
+{
+inline constexpr std::size_t   register_bytes = 16;
+inline constexpr int8_dot_kind int8_dot       = int8_dot_kind::madd16;
+#include "tier_kernels.hpp"
+} // namespace sse2
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+namespace sse4_2
+{
+inline constexpr std::size_t   register_bytes = 16;
+inline constexpr int8_dot_kind int8_dot       = int8_dot_kind::maddubs;
+#include "tier_kernels.hpp"
+} // namespace sse4_2
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma,f16c")
+namespace avx2
+{
+inline constexpr std::size_t   register_bytes = 32;
+inline constexpr int8_dot_kind int8_dot       = int8_dot_kind::maddubs;
+#include "tier_kernels.hpp"
+} // namespace avx2
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512vl,avx512bw,avx512dq,avx2,fma,f16c")
+namespace avx512
+{
+inline constexpr std::size_t   register_bytes = 64;
+inline constexpr int8_dot_kind int8_dot       = int8_dot_kind::maddubs;
+#include "tier_kernels.hpp"
+} // namespace avx512
+#pragma GCC pop_options
+
+// Only the int8 kernels are instantiated from this copy
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512vl,avx512bw,avx512vnni,avx2,fma,f16c")
+namespace avx512_vnni
+{
+inline constexpr std::size_t   register_bytes = 64;
+inline constexpr int8_dot_kind int8_dot       = int8_dot_kind::vnni;
+#include "tier_kernels.hpp"
+} // namespace avx512_vnni
+#pragma GCC pop_options
+
+// The float overloads of the fast activation functions, on the baseline
+// copy of vector_math.hpp: one float goes through a 4 lane vector
+inline auto sigmoid_function::operator()(float x) const noexcept -> float
+{
+    return sse2::vectorized(*this, vec<float, 16>{} + x)[0];
+}
+
+inline auto silu_function::operator()(float x) const noexcept -> float
+{
+    return sse2::vectorized(*this, vec<float, 16>{} + x)[0];
+}
+
+inline auto swish_function::operator()(float x) const noexcept -> float
+{
+    return sse2::vectorized(*this, vec<float, 16>{} + x)[0];
+}
+
+inline auto tanh_function::operator()(float x) const noexcept -> float
+{
+    return sse2::vectorized(*this, vec<float, 16>{} + x)[0];
+}
+
+inline auto gelu_function::operator()(float x) const noexcept -> float
+{
+    return sse2::vectorized(*this, vec<float, 16>{} + x)[0];
+}
+
+//-----------------------------------------------------------------------------
+//------------ Entry points  --------------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Blocked C = A * B for compile time shapes (see gemm_kernels.hpp).
+ *        C is overwritten. With an epilogue, C = epilogue(A * B + bias),
+ *        with epilogue applied element-wise. B and the bias are either T or
+ *        bf16 / fp16 (W) widened to T.
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           K,
+    std::size_t           N,
+    typename Epilogue = gemm::no_epilogue,
+    typename W        = T>
+auto gemm(
+    const T*        a,
+    std::size_t     lda,
+    const W*        b,
+    std::size_t     ldb,
+    T*              c,
+    std::size_t     ldc,
+    const W*        bias     = nullptr,
+    Epilogue const& epilogue = {}
+) noexcept -> void
+{
+    static const auto s_Kernel = select(
+        &sse2::gemm<T, M, K, N, Epilogue, W>,
+        &sse4_2::gemm<T, M, K, N, Epilogue, W>,
+        &avx2::gemm<T, M, K, N, Epilogue, W>,
+        &avx512::gemm<T, M, K, N, Epilogue, W>
+    );
+    s_Kernel(a, lda, b, ldb, c, ldc, bias, epilogue);
+}
+
+/**
+ * \brief Fused dense layer C = epilogue(A * W + bias) for the small shapes of
+ *        layer::forward_pass (see tier_kernels.hpp). epilogue is applied
+ *        element-wise. W and the bias are either T or bf16 / fp16 widened to
+ *        T.
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           K,
+    std::size_t           N,
+    typename Epilogue,
+    typename Weight_Type>
+auto dense(
+    const T*           a,
+    std::size_t        lda,
+    const Weight_Type* w,
+    std::size_t        ldw,
+    const Weight_Type* bias,
+    T*                 c,
+    std::size_t        ldc,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    static const auto s_Kernel = select(
+        &sse2::dense<T, M, K, N, Epilogue, Weight_Type>,
+        &sse4_2::dense<T, M, K, N, Epilogue, Weight_Type>,
+        &avx2::dense<T, M, K, N, Epilogue, Weight_Type>,
+        &avx512::dense<T, M, K, N, Epilogue, Weight_Type>
+    );
+    s_Kernel(a, lda, w, ldw, bias, c, ldc, epilogue);
+}
+
+/**
+ * \brief Fused dense layers C = epilogue(A * W + bias) of run time shape, for
+ *        K x N layers, of the widest tier the CPU supports: one per column
+ *        tile width, null past the widest that fits N, then one unrolled for
+ *        the shape if it is one of dense_dynamic_unrolled_shapes. The tiled
+ *        ones compute the same bits, the unrolled one sums K in another
+ *        order. The one to run is picked per shape by timing them (see
+ *        ga_snn::dense_kernel_cache). Epilogue must be stateless, e.g. a
+ *        lambda without captures.
+ */
+template <gemm::gemm_value_type T, typename Epilogue>
+[[nodiscard]]
+auto dense_dynamic_candidates(std::size_t K, std::size_t N) noexcept
+    -> std::array<dense_dynamic_kernel<T>, dense_dynamic_max_tile>
+{
+    static const auto s_Kernel = select(
+        &sse2::dense_dynamic_candidates<T, Epilogue>,
+        &sse4_2::dense_dynamic_candidates<T, Epilogue>,
+        &avx2::dense_dynamic_candidates<T, Epilogue>,
+        &avx512::dense_dynamic_candidates<T, Epilogue>
+    );
+    return s_Kernel(K, N);
+}
+
+/**
+ * \brief Runs nodes nodes of the flat plan of a sparse net, see gather_plan
+ *        in tier_kernels.hpp. Epilogue must be stateless.
+ */
+template <gemm::gemm_value_type T, typename Epilogue>
+auto gather_plan(
+    std::size_t          nodes,
+    const std::uint32_t* offsets,
+    const std::uint32_t* sources,
+    const T*             weights,
+    const T*             bias,
+    const T*             values,
+    T*                   out
+) noexcept -> void
+{
+    static const auto s_Kernel = select(
+        &sse2::gather_plan<T, Epilogue>,
+        &sse4_2::gather_plan<T, Epilogue>,
+        &avx2::gather_plan<T, Epilogue>,
+        &avx512::gather_plan<T, Epilogue>
+    );
+    s_Kernel(nodes, offsets, sources, weights, bias, values, out);
+}
+
+/**
+ * \brief Softmax of each of the M rows of N floats of c, rows being ldc
+ *        elements apart, in place: one pass over a row for its max and sum,
+ *        one to normalise it, a row of up to two vectors in registers (see
+ *        softmax in tier_kernels.hpp)
+ */
+inline auto softmax(std::size_t M, std::size_t N, float* c, std::size_t ldc)
+    noexcept -> void
+{
+    static const auto s_Kernel = select(
+        &sse2::softmax, &sse4_2::softmax, &avx2::softmax, &avx512::softmax
+    );
+    s_Kernel(M, N, c, ldc);
+}
+
+/**
+ * \brief c += transpose(a) * b of compile time shape, see
+ *        transposed_multiply_add in tier_kernels.hpp
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           K,
+    std::size_t           N,
+    std::size_t           Lda,
+    std::size_t           Ldb,
+    std::size_t           Ldc>
+auto transposed_multiply_add(const T* a, const T* b, T* c) noexcept -> void
+{
+    static const auto s_Kernel = select(
+        &sse2::transposed_multiply_add<T, M, K, N, Lda, Ldb, Ldc>,
+        &sse4_2::transposed_multiply_add<T, M, K, N, Lda, Ldb, Ldc>,
+        &avx2::transposed_multiply_add<T, M, K, N, Lda, Ldb, Ldc>,
+        &avx512::transposed_multiply_add<T, M, K, N, Lda, Ldb, Ldc>
+    );
+    s_Kernel(a, b, c);
+}
+
+/**
+ * \brief Fully unrolled fused dense layer C = epilogue(A * W + bias) for the
+ *        tiny shapes of gemm::use_unrolled_dense, with the leading dimensions
+ *        of A, W and C known at compile time (see tier_kernels.hpp).
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           K,
+    std::size_t           N,
+    std::size_t           Lda,
+    std::size_t           Ldw,
+    std::size_t           Ldc,
+    typename Epilogue,
+    typename Weight_Type>
+auto dense_unrolled(
+    const T*           a,
+    const Weight_Type* w,
+    const Weight_Type* bias,
+    T*                 c,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    static const auto s_Kernel = select(
+        &sse2::dense_unrolled<T, M, K, N, Lda, Ldw, Ldc, Epilogue, Weight_Type>,
+        &sse4_2::
+            dense_unrolled<T, M, K, N, Lda, Ldw, Ldc, Epilogue, Weight_Type>,
+        &avx2::dense_unrolled<T, M, K, N, Lda, Ldw, Ldc, Epilogue, Weight_Type>,
+        &avx512::
+            dense_unrolled<T, M, K, N, Lda, Ldw, Ldc, Epilogue, Weight_Type>
+    );
+    s_Kernel(a, w, bias, c, epilogue);
+}
+
+/**
+ * \brief Fused dense layer C = epilogue(A * transpose(W) + bias) on
+ *        output-major weights W[N x K], one dot product per output (see
+ *        tier_kernels.hpp).
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           K,
+    std::size_t           N,
+    std::size_t           Lda,
+    std::size_t           Ldw,
+    std::size_t           Ldc,
+    typename Epilogue,
+    typename Weight_Type>
+auto dense_transposed(
+    const T*           a,
+    const Weight_Type* w,
+    const Weight_Type* bias,
+    T*                 c,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    static const auto s_Kernel = select(
+        &sse2::
+            dense_transposed<T, M, K, N, Lda, Ldw, Ldc, Epilogue, Weight_Type>,
+        &sse4_2::
+            dense_transposed<T, M, K, N, Lda, Ldw, Ldc, Epilogue, Weight_Type>,
+        &avx2::
+            dense_transposed<T, M, K, N, Lda, Ldw, Ldc, Epilogue, Weight_Type>,
+        &avx512::
+            dense_transposed<T, M, K, N, Lda, Ldw, Ldc, Epilogue, Weight_Type>
+    );
+    s_Kernel(a, w, bias, c, epilogue);
+}
+
+/**
+ * \brief out[j * ldo_row + b * ldo_batch] = mat row j . vector b, for
+ *        B <= 8 vectors. mat rows and the vectors are Row_Stride elements
+ *        apart and aligned to Alignment bytes (see tier_kernels.hpp).
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           N,
+    std::size_t           B,
+    std::size_t           Row_Stride = N,
+    std::size_t           Alignment  = alignof(T)>
+auto matvec_batch(
+    const T*    mat,
+    const T*    v,
+    T*          out,
+    std::size_t ldo_row,
+    std::size_t ldo_batch
+) noexcept -> void
+{
+    static const auto s_Kernel = select(
+        &sse2::matvec_batch<T, M, N, B, Row_Stride, Alignment>,
+        &sse4_2::matvec_batch<T, M, N, B, Row_Stride, Alignment>,
+        &avx2::matvec_batch<T, M, N, B, Row_Stride, Alignment>,
+        &avx512::matvec_batch<T, M, N, B, Row_Stride, Alignment>
+    );
+    s_Kernel(mat, v, out, ldo_row, ldo_batch);
+}
+
+/**
+ * \brief out[M] = mat[M x N] * v[N]
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           N,
+    std::size_t           Row_Stride = N,
+    std::size_t           Alignment  = alignof(T)>
+auto matvec(const T* mat, const T* v, T* out) noexcept -> void
+{
+    matvec_batch<T, M, N, 1, Row_Stride, Alignment>(mat, v, out, 1, 0);
+}
+
+/**
+ * \brief Sum of |a[i] - b[i]| over Size elements. The distance kernels take
+ *        elements of type T or bf16 / fp16 (W) widened to T.
+ */
+template <gemm::gemm_value_type T, std::size_t Size, typename W = T>
+[[nodiscard]]
+auto reduce_abs_diff(const W* a, const W* b) noexcept -> T
+{
+    static const auto s_Kernel = select(
+        &sse2::reduce<T, Size, sse2::abs_diff, W>,
+        &sse4_2::reduce<T, Size, sse4_2::abs_diff, W>,
+        &avx2::reduce<T, Size, avx2::abs_diff, W>,
+        &avx512::reduce<T, Size, avx512::abs_diff, W>
+    );
+    T sum;
+    s_Kernel(a, b, &sum);
+    return sum;
+}
+
+/**
+ * \brief Sum of (a[i] - b[i])^2 over Size elements
+ */
+template <gemm::gemm_value_type T, std::size_t Size, typename W = T>
+[[nodiscard]]
+auto reduce_squared_diff(const W* a, const W* b) noexcept -> T
+{
+    static const auto s_Kernel = select(
+        &sse2::reduce<T, Size, sse2::squared_diff, W>,
+        &sse4_2::reduce<T, Size, sse4_2::squared_diff, W>,
+        &avx2::reduce<T, Size, avx2::squared_diff, W>,
+        &avx512::reduce<T, Size, avx512::squared_diff, W>
+    );
+    T sum;
+    s_Kernel(a, b, &sum);
+    return sum;
+}
+
+/**
+ * \brief sums = { a . b, a . a, b . b } over Size elements
+ */
+template <gemm::gemm_value_type T, std::size_t Size, typename W = T>
+auto reduce_dot_norms(const W* a, const W* b, T (&sums)[3]) noexcept -> void
+{
+    static const auto s_Kernel = select(
+        &sse2::reduce<T, Size, sse2::dot_norms, W>,
+        &sse4_2::reduce<T, Size, sse4_2::dot_norms, W>,
+        &avx2::reduce<T, Size, avx2::dot_norms, W>,
+        &avx512::reduce<T, Size, avx512::dot_norms, W>
+    );
+    s_Kernel(a, b, sums);
+}
+
+/**
+ * \brief out[M x N] = x[M x K] * w[K x N] in int32 for int8 x and w in
+ *        [-127, 127]. K is a multiple of 4 and N of 16, zero padded, and w
+ *        is packed in groups of 4 inputs (see tier_kernels.hpp). Exact, so
+ *        every tier gives the same result.
+ */
+template <std::size_t M, std::size_t K, std::size_t N>
+    requires(K % 4 == 0 && N % 16 == 0)
+auto dense_i8(
+    const std::int8_t* x,
+    const std::int8_t* w,
+    std::int32_t*      out
+) noexcept -> void
+{
+    static const auto s_Kernel = cpu_features::has_avx512_vnni()
+        ? &avx512_vnni::dense_i8<M, K, N>
+        : select(
+              &sse2::dense_i8<M, K, N>,
+              &sse4_2::dense_i8<M, K, N>,
+              &avx2::dense_i8<M, K, N>,
+              &avx512::dense_i8<M, K, N>
+          );
+    s_Kernel(x, w, out);
+}
+
+/**
+ * \brief int8 dense layer C = epilogue(A * W + bias) for float A and C. The
+ *        rows of A are quantized on the fly, W is int8 (times w_scale) and
+ *        packed as dense_i8 expects, the bias is zero padded to a multiple
+ *        of 16 (see tier_kernels.hpp).
+ */
+template <std::size_t M, std::size_t K, std::size_t N, typename Epilogue>
+auto quantized_dense(
+    const float*       a,
+    std::size_t        lda,
+    const std::int8_t* w,
+    float              w_scale,
+    const float*       bias,
+    float*             c,
+    std::size_t        ldc,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    static const auto s_Kernel = cpu_features::has_avx512_vnni()
+        ? &avx512_vnni::quantized_dense<M, K, N, Epilogue>
+        : select(
+              &sse2::quantized_dense<M, K, N, Epilogue>,
+              &sse4_2::quantized_dense<M, K, N, Epilogue>,
+              &avx2::quantized_dense<M, K, N, Epilogue>,
+              &avx512::quantized_dense<M, K, N, Epilogue>
+          );
+    s_Kernel(a, lda, w, w_scale, bias, c, ldc, epilogue);
+}
+
+} // namespace ga_sm::simd
+
+#endif // !STATIC_MATRIX_KERNELS
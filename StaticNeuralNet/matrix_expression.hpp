@@ -0,0 +1,281 @@
+#pragma once
+
+#ifndef STATIC_MATRIX_EXPRESSION
+#define STATIC_MATRIX_EXPRESSION
+
+#include "static_matrix.hpp"
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+/*
+Lazy element-wise static_matrix arithmetic (expression templates).
+
+The functions and operators in ga_sm::expr do not compute anything, they
+return small expression nodes that describe the operation. A chain of them
+is evaluated in a single loop, with no intermediate matrices, when it is
+assigned to a static_matrix (static_matrix::operator=) or passed to
+evaluate():
+
+    out = expr::matrix_vec_add(out, bias) * scale;
+
+The eager operations of static_matrix.hpp are left unchanged. The lazy ones
+are picked either by qualifying the call (expr::matrix_vec_add(a, b)) or, for
+the operators, as soon as one operand is already an expression.
+
+Nodes hold matrices by reference and other nodes by value, so an expression
+must not outlive the matrices it refers to: evaluate it in the full
+expression that builds it, do not store it in an auto variable past that.
+
+Every node only reads element [j, i] of its operands (row vectors are
+broadcast from [0, i]), so a matrix can be assigned an expression that reads
+itself.
+*/
+
+namespace ga_sm::expr
+{
+
+template <typename X>
+concept expression = requires { X::s_Is_Expression; };
+
+template <typename X>
+concept operand = expression<X> || static_matrix_type<X>;
+
+template <operand X>
+using stored_t = std::conditional_t<expression<X>, X, X const&>;
+
+template <typename L, typename R>
+concept same_shape = L::Size_y == R::Size_y && L::Size_x == R::Size_x &&
+    std::same_as<typename L::value_type, typename R::value_type>;
+
+//-----------------------------------------------------------------------------
+//------------ Nodes ----------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Element-wise op(lhs[j, i], rhs[j, i])
+ */
+template <typename Op, operand L, operand R>
+    requires same_shape<L, R>
+struct binary
+{
+    static constexpr bool s_Is_Expression = true;
+    static constexpr auto Size_y          = L::Size_y;
+    static constexpr auto Size_x          = L::Size_x;
+
+    using value_type   = typename L::value_type;
+    using storage_type = typename L::storage_type;
+
+    stored_t<L>               m_Lhs;
+    stored_t<R>               m_Rhs;
+    [[no_unique_address]] Op m_Op;
+
+    [[nodiscard]]
+    constexpr value_type
+    operator[](const std::size_t j, const std::size_t i) const noexcept
+    {
+        return static_cast<value_type>(m_Op(m_Lhs[j, i], m_Rhs[j, i]));
+    }
+};
+
+/**
+ * \brief Element-wise fn(e[j, i]). Also used for the scalar operations, with
+ *        the scalar captured in fn.
+ */
+template <typename Fn, operand E>
+struct unary
+{
+    static constexpr bool s_Is_Expression = true;
+    static constexpr auto Size_y          = E::Size_y;
+    static constexpr auto Size_x          = E::Size_x;
+
+    using value_type   = typename E::value_type;
+    using storage_type = typename E::storage_type;
+
+    stored_t<E> m_Expr;
+    Fn          m_Fn;
+
+    [[nodiscard]]
+    constexpr value_type
+    operator[](const std::size_t j, const std::size_t i) const noexcept
+    {
+        return static_cast<value_type>(m_Fn(m_Expr[j, i]));
+    }
+};
+
+/**
+ * \brief Repeats the row vector e on M rows
+ */
+template <std::size_t M, operand E>
+    requires(E::Size_y == 1)
+struct broadcast_rows
+{
+    static constexpr bool s_Is_Expression = true;
+    static constexpr auto Size_y          = M;
+    static constexpr auto Size_x          = E::Size_x;
+
+    using value_type   = typename E::value_type;
+    using storage_type = typename E::storage_type;
+
+    stored_t<E> m_Expr;
+
+    [[nodiscard]]
+    constexpr value_type
+    operator[](const std::size_t, const std::size_t i) const noexcept
+    {
+        return m_Expr[0, i];
+    }
+};
+
+//-----------------------------------------------------------------------------
+//------------ Evaluation -----------------------------------------------------
+//-----------------------------------------------------------------------------
+
+template <expression E>
+using result_t = static_matrix<
+    typename E::value_type,
+    E::Size_y,
+    E::Size_x,
+    typename E::storage_type>;
+
+/**
+ * \brief Evaluates e into a new matrix, in a single pass.
+ */
+template <expression E>
+[[nodiscard]]
+constexpr auto evaluate(E const& e) noexcept -> result_t<E>
+{
+    result_t<E> ret{};
+    ret = e;
+    return ret;
+}
+
+//-----------------------------------------------------------------------------
+//------------ Element-wise operations ----------------------------------------
+//-----------------------------------------------------------------------------
+
+template <operand L, operand R>
+    requires(same_shape<L, R> && (expression<L> || expression<R>))
+[[nodiscard]]
+constexpr auto operator+(L const& lhs, R const& rhs) noexcept
+{
+    return binary<std::plus<>, L, R>{ lhs, rhs, {} };
+}
+
+template <operand L, operand R>
+    requires(same_shape<L, R> && (expression<L> || expression<R>))
+[[nodiscard]]
+constexpr auto operator-(L const& lhs, R const& rhs) noexcept
+{
+    return binary<std::minus<>, L, R>{ lhs, rhs, {} };
+}
+
+template <operand L, operand R>
+    requires same_shape<L, R>
+[[nodiscard]]
+constexpr auto element_wise_mul(L const& lhs, R const& rhs) noexcept
+{
+    return binary<std::multiplies<>, L, R>{ lhs, rhs, {} };
+}
+
+/**
+ * \brief fn applied to every element of e
+ */
+template <operand E, typename Fn>
+    requires std::is_invocable_r_v<
+        typename E::value_type,
+        Fn,
+        typename E::value_type>
+[[nodiscard]]
+constexpr auto map(E const& e, Fn fn) noexcept
+{
+    return unary<Fn, E>{ e, std::move(fn) };
+}
+
+template <expression E>
+[[nodiscard]]
+constexpr auto operator-(E const& e) noexcept
+{
+    return map(e, std::negate<>{});
+}
+
+//-----------------------------------------------------------------------------
+//------------ Scalar operations ----------------------------------------------
+//-----------------------------------------------------------------------------
+
+template <expression E>
+[[nodiscard]]
+constexpr auto operator+(E const& e, typename E::value_type s) noexcept
+{
+    return map(e, [s](typename E::value_type x) { return x + s; });
+}
+
+template <expression E>
+[[nodiscard]]
+constexpr auto operator-(E const& e, typename E::value_type s) noexcept
+{
+    return map(e, [s](typename E::value_type x) { return x - s; });
+}
+
+template <expression E>
+[[nodiscard]]
+constexpr auto operator*(E const& e, typename E::value_type s) noexcept
+{
+    return map(e, [s](typename E::value_type x) { return x * s; });
+}
+
+template <expression E>
+[[nodiscard]]
+constexpr auto operator*(typename E::value_type s, E const& e) noexcept
+{
+    return e * s;
+}
+
+template <expression E>
+[[nodiscard]]
+constexpr auto operator/(E const& e, typename E::value_type s) noexcept
+{
+    return map(e, [s](typename E::value_type x) { return x / s; });
+}
+
+//-----------------------------------------------------------------------------
+//------------ Row vector operations ------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Lazy ga_sm::matrix_vec_add: adds the row vector vec to every row of
+ *        mat.
+ */
+template <operand Mat, operand Vec>
+    requires(
+        Vec::Size_y == 1 && Vec::Size_x == Mat::Size_x &&
+        std::same_as<typename Mat::value_type, typename Vec::value_type>
+    )
+[[nodiscard]]
+constexpr auto matrix_vec_add(Mat const& mat, Vec const& vec) noexcept
+{
+    return mat + broadcast_rows<Mat::Size_y, Vec>{ vec };
+}
+
+/**
+ * \brief Lazy ga_sm::vector_expand: multiplies every column of col_vectors by
+ *        the element of row_vector of the same index.
+ */
+template <operand Vec, operand Mat>
+    requires(
+        Vec::Size_y == 1 && Vec::Size_x == Mat::Size_x &&
+        std::same_as<typename Mat::value_type, typename Vec::value_type>
+    )
+[[nodiscard]]
+constexpr auto vector_expand(Vec const& row_vector, Mat const& col_vectors)
+    noexcept
+{
+    return element_wise_mul(
+        broadcast_rows<Mat::Size_y, Vec>{ row_vector }, col_vectors
+    );
+}
+
+} // namespace ga_sm::expr
+
+#endif // !STATIC_MATRIX_EXPRESSION
@@ -0,0 +1,930 @@
+#pragma once
+
+#ifndef NEAT_NEURAL_NET
+#define NEAT_NEURAL_NET
+
+#include "Log.hpp"
+#include "Random.hpp"
+#include "activation_functions.hpp"
+#include "kernels.hpp"
+#include "static_matrix.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+Nets of variable topology, as evolved by NEAT (NeuroEvolution of Augmenting
+Topologies). The genome of a neat_neural_net is a graph: node genes (the
+hidden and output neurons, with their bias) and connection genes (weighted
+edges, which can be disabled). It starts as the inputs fully connected to the
+outputs and grows by mutation, one connection or one node at a time.
+
+The genome is not run as a graph. Whenever its structure changes, it is
+compiled into a flat plan: the nodes an output depends on in topological
+order, the enabled connections into each node next to each other, sorted by
+source, and every node at a fixed slot of one value buffer (the inputs, the
+hidden nodes in plan order, then the outputs). A forward pass is a sweep of
+ga_sm::simd::gather_plan over the plan, which gathers the inputs of a node a
+vector at a time. Mutations of the weights and biases only copy the new
+values into the plan.
+
+Connections are identified by their innovation number, shared by every
+genome of the process through neat_innovations: the same connection, or the
+same split of a connection into a node, gets the same number in every genome
+it appears in, so crossover aligns the genes of two parents by number.
+*/
+
+namespace ga_snn
+{
+
+/**
+ * \brief Innovation numbers of the connections, and ids of the nodes, of the
+ *        neat_neural_nets with Inputs inputs and Outputs outputs. Nodes
+ *        [0, Inputs) are the inputs and [Inputs, Inputs + Outputs) the
+ *        outputs. The connection from input i to output o is innovation
+ *        i * Outputs + o, the others are numbered as they first appear.
+ */
+template <std::size_t Inputs, std::size_t Outputs>
+class neat_innovations
+{
+public:
+    using id_type = std::uint32_t;
+
+    static constexpr id_type s_First_Hidden = Inputs + Outputs;
+
+private:
+    std::map<std::pair<id_type, id_type>, id_type> m_Connections;
+    std::map<id_type, id_type>                     m_Splits;
+    id_type            m_Next_Innovation = Inputs * Outputs;
+    id_type            m_Next_Node       = s_First_Hidden;
+    mutable std::mutex m_Mutex;
+
+public:
+    [[nodiscard]]
+    static auto global() -> neat_innovations&
+    {
+        static neat_innovations innovations;
+        return innovations;
+    }
+
+    // Innovation number of the connection from node in to node out
+    [[nodiscard]]
+    auto connection(id_type in, id_type out) -> id_type
+    {
+        if (in < Inputs && out >= Inputs && out < s_First_Hidden)
+        {
+            return static_cast<id_type>(in * Outputs + out - Inputs);
+        }
+        const std::scoped_lock lock{ m_Mutex };
+        const auto [it, added] =
+            m_Connections.try_emplace({ in, out }, m_Next_Innovation);
+        m_Next_Innovation += added;
+        return it->second;
+    }
+
+    // Id of the node splitting the connection innovation
+    [[nodiscard]]
+    auto split(id_type innovation) -> id_type
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        const auto [it, added] = m_Splits.try_emplace(innovation, m_Next_Node);
+        m_Next_Node += added;
+        return it->second;
+    }
+
+    /**
+     * \brief Records the genes of a genome numbered elsewhere (e.g. loaded
+     *        from a file), so that new genes are not given their numbers
+     */
+    auto adopt_connection(id_type innovation, id_type in, id_type out) -> void
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        m_Connections.try_emplace({ in, out }, innovation);
+        m_Next_Innovation = std::max(m_Next_Innovation, innovation + 1);
+    }
+
+    auto adopt_node(id_type id) -> void
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        m_Next_Node = std::max(m_Next_Node, id + 1);
+    }
+};
+
+/**
+ * \brief Net of the NEAT genome it holds, see the top of this file. The
+ *        hidden and output nodes apply Hidden_Activation and
+ *        Output_Activation, which must be element-wise functions without
+ *        parameters. Input and output types are row vectors, as those of
+ *        static_neural_net with a batch size of 1.
+ */
+template <
+    ga_sm::gemm::gemm_value_type T,
+    std::size_t                  Inputs,
+    std::size_t                  Outputs,
+    matrix_activation_functions::Identifiers::Identifiers_ Hidden_Activation =
+        matrix_activation_functions::Identifiers::Sigmoid,
+    matrix_activation_functions::Identifiers::Identifiers_ Output_Activation =
+        matrix_activation_functions::Identifiers::Sigmoid>
+    requires(Inputs > 0 && Outputs > 0)
+class neat_neural_net
+{
+public:
+    using value_type       = T;
+    using input_type       = ga_sm::static_matrix<T, 1, Inputs>;
+    using output_type      = ga_sm::static_matrix<T, 1, Outputs>;
+    using innovations_type = neat_innovations<Inputs, Outputs>;
+    using id_type          = typename innovations_type::id_type;
+
+    struct node_gene
+    {
+        id_type Id;
+        T       Bias;
+    };
+
+    struct connection_gene
+    {
+        id_type Innovation;
+        id_type In;
+        id_type Out;
+        T       Weight;
+        bool    Enabled;
+    };
+
+    /**
+     * \brief Probabilities of the structural mutations of mutate
+     */
+    struct structural_mutation_rates
+    {
+        double Add_Connection    = 0.05;
+        double Add_Node          = 0.03;
+        double Toggle_Connection = 0.01;
+    };
+
+    static constexpr std::size_t s_Inputs  = Inputs;
+    static constexpr std::size_t s_Outputs = Outputs;
+
+private:
+    template <matrix_activation_functions::Identifiers::Identifiers_ Id>
+    using activation_of = matrix_activation_functions::
+        activation_function<ga_sm::static_matrix<T, 1, 1>, Id>;
+
+    static_assert(
+        activation_of<Hidden_Activation>::is_element_wise &&
+            activation_of<Hidden_Activation>::parameter_count() == 0 &&
+            activation_of<Output_Activation>::is_element_wise &&
+            activation_of<Output_Activation>::parameter_count() == 0,
+        "NEAT nodes apply element-wise activations without parameters"
+    );
+
+    using hidden_epilogue = decltype(activation_of<Hidden_Activation>::
+                                         activation_function_type::
+                                             element_function({}));
+    using output_epilogue = decltype(activation_of<Output_Activation>::
+                                         activation_function_type::
+                                             element_function({}));
+
+    static constexpr std::uint32_t s_None =
+        std::numeric_limits<std::uint32_t>::max();
+    // Tries of mutate_add_connection at finding two nodes to connect
+    static constexpr std::size_t s_Connection_Tries = 20;
+
+    // Genome: the output and hidden nodes sorted by id, the outputs first,
+    // and the connections sorted by innovation number
+    std::vector<node_gene>       m_Nodes;
+    std::vector<connection_gene> m_Connections;
+    structural_mutation_rates    m_Rates{};
+
+    // Plan: node n runs over the edges [m_Offsets[n], m_Offsets[n + 1]).
+    // The first m_Hidden nodes are hidden ones, the last Outputs the outputs.
+    std::vector<std::uint32_t> m_Offsets;
+    std::vector<std::uint32_t> m_Sources; // value slot of the edge source
+    std::vector<T>             m_Weights;
+    std::vector<T>             m_Bias;
+    std::vector<std::uint32_t> m_Edge_Genes; // connection gene of each edge
+    std::vector<std::uint32_t> m_Node_Genes; // node gene of each plan node
+    std::size_t                m_Hidden       = 0;
+    std::size_t                m_Compilations = 0;
+
+public:
+    // The inputs fully connected to the outputs, every weight and bias 0
+    neat_neural_net()
+    {
+        m_Nodes.reserve(Outputs);
+        for (std::size_t o = 0; o != Outputs; ++o)
+        {
+            m_Nodes.push_back({ static_cast<id_type>(Inputs + o), T{} });
+        }
+        m_Connections.reserve(Inputs * Outputs);
+        for (std::size_t i = 0; i != Inputs; ++i)
+        {
+            for (std::size_t o = 0; o != Outputs; ++o)
+            {
+                m_Connections.push_back(
+                    { static_cast<id_type>(i * Outputs + o),
+                      static_cast<id_type>(i),
+                      static_cast<id_type>(Inputs + o),
+                      T{},
+                      true }
+                );
+            }
+        }
+        compile();
+    }
+
+    /* Getters and setters */
+
+    [[nodiscard]]
+    auto nodes() const noexcept -> std::span<const node_gene>
+    {
+        return m_Nodes;
+    }
+
+    [[nodiscard]]
+    auto connections() const noexcept -> std::span<const connection_gene>
+    {
+        return m_Connections;
+    }
+
+    [[nodiscard]]
+    auto hidden_count() const noexcept -> std::size_t
+    {
+        return m_Nodes.size() - Outputs;
+    }
+
+    // Hidden nodes an output depends on, which the plan runs
+    [[nodiscard]]
+    auto plan_hidden_count() const noexcept -> std::size_t
+    {
+        return m_Hidden;
+    }
+
+    // Connections the plan runs
+    [[nodiscard]]
+    auto plan_edge_count() const noexcept -> std::size_t
+    {
+        return m_Sources.size();
+    }
+
+    // Times the genome was compiled into a plan, i.e. changed structure
+    [[nodiscard]]
+    auto compilations() const noexcept -> std::size_t
+    {
+        return m_Compilations;
+    }
+
+    [[nodiscard]]
+    auto parameter_count() const noexcept -> std::size_t
+    {
+        return m_Connections.size() + m_Nodes.size();
+    }
+
+    [[nodiscard]]
+    auto mutation_rates() const noexcept -> const structural_mutation_rates&
+    {
+        return m_Rates;
+    }
+
+    auto set_mutation_rates(const structural_mutation_rates& rates) noexcept
+        -> void
+    {
+        m_Rates = rates;
+    }
+
+    /* Member functions */
+
+    [[nodiscard]]
+    auto forward_pass(const input_type& input) const -> output_type
+    {
+        // [inputs, hidden nodes in plan order, outputs]
+        thread_local std::vector<T> values;
+        values.resize(Inputs + m_Hidden + Outputs);
+        std::copy(input.begin(), input.end(), values.begin());
+
+        ga_sm::simd::gather_plan<T, hidden_epilogue>(
+            m_Hidden,
+            m_Offsets.data(),
+            m_Sources.data(),
+            m_Weights.data(),
+            m_Bias.data(),
+            values.data(),
+            values.data() + Inputs
+        );
+        ga_sm::simd::gather_plan<T, output_epilogue>(
+            Outputs,
+            m_Offsets.data() + m_Hidden,
+            m_Sources.data(),
+            m_Weights.data(),
+            m_Bias.data() + m_Hidden,
+            values.data(),
+            values.data() + Inputs + m_Hidden
+        );
+
+        output_type ret;
+        std::copy(values.end() - Outputs, values.end(), ret.begin());
+        return ret;
+    }
+
+    /* Utility */
+
+    auto print_net() const -> void
+    {
+        std::cout
+            << "##########################################################"
+               "################\n";
+        for (const auto& [id, bias] : m_Nodes)
+        {
+            std::cout << "node " << id << "\tbias " << bias << '\n';
+        }
+        for (const auto& [innovation, in, out, weight, enabled] :
+             m_Connections)
+        {
+            std::cout << '#' << innovation << '\t' << in << " -> " << out
+                      << '\t' << weight << (enabled ? "\n" : "\tdisabled\n");
+        }
+        std::cout << "Net has " << hidden_count() << " hidden nodes and "
+                  << m_Connections.size() << " connections, " << m_Hidden
+                  << " and " << plan_edge_count() << " of them in its plan\n";
+        print_address();
+        std::cout
+            << "----------------------------------------------------------"
+               "----------------\n";
+    }
+
+    auto print_address() const -> void
+    {
+        std::cout << "Net address: " << this << '\n';
+    }
+
+    /**
+     * \brief Stores the genome: inputs and outputs, the node genes
+     *        (id bias), then the connection genes
+     *        (innovation in out weight enabled)
+     */
+    auto store(const std::filesystem::path& filename) const -> void
+    {
+        std::ofstream out(filename);
+        if (!out.is_open())
+        {
+            const auto message =
+                "Could not open file: " + filename.string() + '\n';
+            std::cout << message;
+            log::add(message);
+            std::exit(EXIT_FAILURE);
+        }
+        out << Inputs << ' ' << Outputs << "\n\n" << m_Nodes.size() << '\n';
+        for (const auto& [id, bias] : m_Nodes)
+        {
+            out << id << ' ' << bias << '\n';
+        }
+        out << '\n' << m_Connections.size() << '\n';
+        for (const auto& [innovation, in, out_id, weight, enabled] :
+             m_Connections)
+        {
+            out << innovation << ' ' << in << ' ' << out_id << ' ' << weight
+                << ' ' << enabled << '\n';
+        }
+    }
+
+    auto load(const std::filesystem::path& filename) -> void
+    {
+        std::ifstream in(filename);
+        if (!in.is_open())
+        {
+            const std::string message =
+                "Could not open file: " + filename.string() + '\n';
+            std::cout << message;
+            log::add(message);
+            std::exit(EXIT_FAILURE);
+        }
+        std::size_t inputs{}, outputs{}, size{};
+        in >> inputs >> outputs;
+        if (inputs != Inputs || outputs != Outputs)
+        {
+            const auto message =
+                "Cannot load this net here. Shapes must match.\n";
+            std::cout << message;
+            log::add(message);
+            std::exit(EXIT_FAILURE);
+        }
+
+        auto& innovations = innovations_type::global();
+        in >> size;
+        m_Nodes.resize(size);
+        for (auto& [id, bias] : m_Nodes)
+        {
+            in >> id >> bias;
+            innovations.adopt_node(id);
+        }
+        in >> size;
+        m_Connections.resize(size);
+        for (auto& [innovation, in_id, out_id, weight, enabled] :
+             m_Connections)
+        {
+            in >> innovation >> in_id >> out_id >> weight >> enabled;
+            innovations.adopt_connection(innovation, in_id, out_id);
+        }
+        compile();
+    }
+
+    /* GA Utility */
+
+    /**
+     * \brief Every weight and bias = fn(args...), the structure is kept
+     */
+    template <typename Fn, typename... Args>
+        requires std::is_invocable_r_v<T, Fn, Args...>
+    auto init(Fn&& fn, Args&&... args) -> void
+    {
+        for (auto& connection : m_Connections)
+        {
+            connection.Weight = static_cast<T>(std::invoke(fn, args...));
+        }
+        for (auto& node : m_Nodes)
+        {
+            node.Bias = static_cast<T>(std::invoke(fn, args...));
+        }
+        refresh_plan();
+    }
+
+    /**
+     * \brief Every weight and bias = fn(itself), then each structural
+     *        mutation with its probability (see set_mutation_rates). Only
+     *        the latter compile the genome again.
+     */
+    template <typename Fn>
+    auto mutate(Fn&& fn) -> void
+    {
+        for (auto& connection : m_Connections)
+        {
+            connection.Weight = fn(connection.Weight);
+        }
+        for (auto& node : m_Nodes)
+        {
+            node.Bias = fn(node.Bias);
+        }
+        refresh_plan();
+
+        if (random::randfloat() < m_Rates.Add_Connection)
+        {
+            mutate_add_connection(fn(T{}));
+        }
+        if (random::randfloat() < m_Rates.Add_Node)
+        {
+            mutate_add_node();
+        }
+        if (random::randfloat() < m_Rates.Toggle_Connection)
+        {
+            mutate_toggle_connection();
+        }
+    }
+
+    /**
+     * \brief Connects two nodes not connected yet, picked at random, with
+     *        weight. Returns whether such nodes were found.
+     */
+    auto mutate_add_connection(T weight) -> bool
+    {
+        const auto sources = Inputs + hidden_count();
+        for (std::size_t t = 0; t != s_Connection_Tries; ++t)
+        {
+            const auto from = random::randsize_t(0, sources - 1);
+            const auto to   = random::randsize_t(0, m_Nodes.size() - 1);
+            const auto in   = from < Inputs
+                                ? static_cast<id_type>(from)
+                                : m_Nodes[Outputs + from - Inputs].Id;
+            if (mutate_add_connection(in, m_Nodes[to].Id, weight))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * \brief Connects node in to node out with weight, unless they already
+     *        are or the connection would close a cycle (disabled
+     *        connections included, as they may be enabled again). Returns
+     *        whether the connection was added.
+     */
+    auto mutate_add_connection(id_type in, id_type out, T weight) -> bool
+    {
+        if (is_output(in) || out < Inputs || in == out || !has_node(in) ||
+            !has_node(out) || connected(out, in) ||
+            std::ranges::any_of(m_Connections, [&](const auto& c) {
+                return c.In == in && c.Out == out;
+            }))
+        {
+            return false;
+        }
+        insert_connection(
+            { innovations_type::global().connection(in, out),
+              in,
+              out,
+              weight,
+              true }
+        );
+        compile();
+        return true;
+    }
+
+    /**
+     * \brief Splits an enabled connection, picked at random, by a new node.
+     *        Returns whether one could be split.
+     */
+    auto mutate_add_node() -> bool
+    {
+        const auto enabled =
+            std::ranges::count(m_Connections, true, &connection_gene::Enabled);
+        if (enabled == 0)
+        {
+            return false;
+        }
+        auto pick =
+            random::randsize_t(0, static_cast<std::size_t>(enabled) - 1);
+        for (const auto& connection : m_Connections)
+        {
+            if (connection.Enabled && pick-- == 0)
+            {
+                return mutate_add_node(connection.Innovation);
+            }
+        }
+        return false;
+    }
+
+    /**
+     * \brief Splits the enabled connection innovation in -> out by a new node
+     *        n, as NEAT does: the connection is disabled, in -> n gets weight
+     *        1 and n -> out the weight of the connection, so the net barely
+     *        changes. Returns false if there is no such connection or it was
+     *        split before.
+     */
+    auto mutate_add_node(id_type innovation) -> bool
+    {
+        const auto it = std::ranges::lower_bound(
+            m_Connections, innovation, {}, &connection_gene::Innovation
+        );
+        if (it == m_Connections.end() || it->Innovation != innovation ||
+            !it->Enabled)
+        {
+            return false;
+        }
+        auto&      innovations = innovations_type::global();
+        const auto node        = innovations.split(innovation);
+        if (has_node(node))
+        {
+            return false;
+        }
+        it->Enabled      = false;
+        const auto split = *it;
+
+        m_Nodes.insert(
+            std::ranges::upper_bound(m_Nodes, node, {}, &node_gene::Id),
+            { node, T{} }
+        );
+        insert_connection(
+            { innovations.connection(split.In, node), split.In, node, T{ 1 },
+              true }
+        );
+        insert_connection(
+            { innovations.connection(node, split.Out), node, split.Out,
+              split.Weight, true }
+        );
+        compile();
+        return true;
+    }
+
+    /**
+     * \brief Enables a disabled connection, or disables an enabled one,
+     *        picked at random
+     */
+    auto mutate_toggle_connection() -> void
+    {
+        auto& connection = m_Connections[random::randsize_t(
+            0, m_Connections.size() - 1
+        )];
+        connection.Enabled = !connection.Enabled;
+        compile();
+    }
+
+    /**
+     * \brief Crossover of this genome (the primary parent) with other: the
+     *        structure stays this one, each connection and node gene also in
+     *        other is taken from either parent with equal probability.
+     */
+    auto inherit_matching_genes(const neat_neural_net& other) -> void
+    {
+        auto their = other.m_Connections.begin();
+        for (auto& connection : m_Connections)
+        {
+            their = std::ranges::lower_bound(
+                their, other.m_Connections.end(), connection.Innovation, {},
+                &connection_gene::Innovation
+            );
+            if (their != other.m_Connections.end() &&
+                their->Innovation == connection.Innovation &&
+                random::randfloat() < 0.5f)
+            {
+                connection.Weight  = their->Weight;
+                connection.Enabled = their->Enabled;
+            }
+        }
+        auto their_node = other.m_Nodes.begin();
+        for (auto& node : m_Nodes)
+        {
+            their_node = std::ranges::lower_bound(
+                their_node, other.m_Nodes.end(), node.Id, {}, &node_gene::Id
+            );
+            if (their_node != other.m_Nodes.end() &&
+                their_node->Id == node.Id && random::randfloat() < 0.5f)
+            {
+                node.Bias = their_node->Bias;
+            }
+        }
+        compile();
+    }
+
+private:
+    [[nodiscard]]
+    static constexpr auto is_output(id_type id) noexcept -> bool
+    {
+        return id >= Inputs && id < innovations_type::s_First_Hidden;
+    }
+
+    // Index in m_Nodes of the node gene id, which must exist
+    [[nodiscard]]
+    auto node_index(id_type id) const noexcept -> std::uint32_t
+    {
+        const auto it =
+            std::ranges::lower_bound(m_Nodes, id, {}, &node_gene::Id);
+        assert(it != m_Nodes.end() && it->Id == id);
+        return static_cast<std::uint32_t>(it - m_Nodes.begin());
+    }
+
+    [[nodiscard]]
+    auto has_node(id_type id) const noexcept -> bool
+    {
+        return id < Inputs ||
+               std::ranges::binary_search(m_Nodes, id, {}, &node_gene::Id);
+    }
+
+    // Whether a path of connections, enabled or not, leads from node from
+    // to node to
+    [[nodiscard]]
+    auto connected(id_type from, id_type to) const -> bool
+    {
+        std::vector<id_type> stack{ from };
+        std::vector<id_type> seen{ from };
+        while (!stack.empty())
+        {
+            const auto node = stack.back();
+            stack.pop_back();
+            if (node == to)
+            {
+                return true;
+            }
+            for (const auto& connection : m_Connections)
+            {
+                if (connection.In == node &&
+                    std::ranges::find(seen, connection.Out) == seen.end())
+                {
+                    seen.push_back(connection.Out);
+                    stack.push_back(connection.Out);
+                }
+            }
+        }
+        return false;
+    }
+
+    auto insert_connection(const connection_gene& connection) -> void
+    {
+        m_Connections.insert(
+            std::ranges::upper_bound(
+                m_Connections, connection.Innovation, {},
+                &connection_gene::Innovation
+            ),
+            connection
+        );
+    }
+
+    // Weights and biases of the genome into the plan, whose structure holds
+    auto refresh_plan() noexcept -> void
+    {
+        for (std::size_t e = 0; e != m_Weights.size(); ++e)
+        {
+            m_Weights[e] = m_Connections[m_Edge_Genes[e]].Weight;
+        }
+        for (std::size_t n = 0; n != m_Bias.size(); ++n)
+        {
+            m_Bias[n] = m_Nodes[m_Node_Genes[n]].Bias;
+        }
+    }
+
+    // Compiles the genome into the plan, see the top of this file
+    auto compile() -> void
+    {
+        const auto nodes = m_Nodes.size();
+
+        // Node genes at both ends of the enabled connections (s_None for
+        // inputs), and the connections into each node: those of node gene t
+        // are incoming[first_in[t], first_in[t + 1])
+        std::vector<std::uint32_t> source(m_Connections.size(), s_None);
+        std::vector<std::uint32_t> target(m_Connections.size(), s_None);
+        std::vector<std::uint32_t> first_in(nodes + 1, 0);
+        std::vector<std::uint32_t> first_out(nodes + 1, 0);
+        for (std::size_t g = 0; g != m_Connections.size(); ++g)
+        {
+            const auto& connection = m_Connections[g];
+            if (connection.Enabled)
+            {
+                target[g] = node_index(connection.Out);
+                ++first_in[target[g] + 1];
+                if (connection.In >= Inputs)
+                {
+                    source[g] = node_index(connection.In);
+                    ++first_out[source[g] + 1];
+                }
+            }
+        }
+        std::partial_sum(first_in.begin(), first_in.end(), first_in.begin());
+        std::partial_sum(first_out.begin(), first_out.end(), first_out.begin());
+        std::vector<std::uint32_t> incoming(first_in.back());
+        std::vector<std::uint32_t> outgoing(first_out.back());
+        {
+            auto in_end  = first_in;
+            auto out_end = first_out;
+            for (std::uint32_t g = 0; g != m_Connections.size(); ++g)
+            {
+                if (target[g] != s_None)
+                {
+                    incoming[in_end[target[g]]++] = g;
+                }
+                if (source[g] != s_None)
+                {
+                    outgoing[out_end[source[g]]++] = g;
+                }
+            }
+        }
+
+        // Hidden nodes an output depends on
+        std::vector<bool>          live(nodes, false);
+        std::vector<std::uint32_t> stack(Outputs);
+        std::iota(stack.begin(), stack.end(), std::uint32_t{ 0 });
+        std::fill_n(live.begin(), Outputs, true);
+        while (!stack.empty())
+        {
+            const auto t = stack.back();
+            stack.pop_back();
+            for (auto e = first_in[t]; e != first_in[t + 1]; ++e)
+            {
+                const auto s = source[incoming[e]];
+                if (s != s_None && !live[s])
+                {
+                    live[s] = true;
+                    stack.push_back(s);
+                }
+            }
+        }
+
+        // Topological order of the live hidden nodes (Kahn), each node
+        // waiting for the hidden nodes it reads
+        std::vector<std::uint32_t> waiting(nodes, 0);
+        std::vector<std::uint32_t> order;
+        for (auto t = static_cast<std::uint32_t>(Outputs); t != nodes; ++t)
+        {
+            if (!live[t])
+            {
+                continue;
+            }
+            for (auto e = first_in[t]; e != first_in[t + 1]; ++e)
+            {
+                waiting[t] += source[incoming[e]] != s_None;
+            }
+            if (waiting[t] == 0)
+            {
+                order.push_back(t);
+            }
+        }
+        for (std::size_t k = 0; k != order.size(); ++k)
+        {
+            const auto s = order[k];
+            for (auto e = first_out[s]; e != first_out[s + 1]; ++e)
+            {
+                const auto t = target[outgoing[e]];
+                if (t >= Outputs && live[t] && --waiting[t] == 0)
+                {
+                    order.push_back(t);
+                }
+            }
+        }
+        assert(
+            order.size() + Outputs ==
+            static_cast<std::size_t>(std::ranges::count(live, true))
+        );
+        m_Hidden = order.size();
+        for (std::uint32_t o = 0; o != Outputs; ++o)
+        {
+            order.push_back(o);
+        }
+
+        // Value slot of each node gene
+        std::vector<std::uint32_t> slot(nodes, s_None);
+        for (std::size_t k = 0; k != order.size(); ++k)
+        {
+            slot[order[k]] = static_cast<std::uint32_t>(Inputs + k);
+        }
+        const auto source_slot = [&](std::uint32_t g) {
+            return source[g] == s_None ? m_Connections[g].In : slot[source[g]];
+        };
+
+        m_Offsets.assign(1, 0);
+        m_Sources.clear();
+        m_Edge_Genes.clear();
+        m_Node_Genes = order;
+        for (const auto t : order)
+        {
+            const auto first = m_Edge_Genes.size();
+            m_Edge_Genes.insert(
+                m_Edge_Genes.end(),
+                incoming.begin() + first_in[t],
+                incoming.begin() + first_in[t + 1]
+            );
+            // Sources in slot order, so a node reads its inputs forward
+            std::ranges::sort(
+                m_Edge_Genes.begin() + static_cast<std::ptrdiff_t>(first),
+                m_Edge_Genes.end(),
+                {},
+                source_slot
+            );
+            m_Offsets.push_back(
+                static_cast<std::uint32_t>(m_Edge_Genes.size())
+            );
+        }
+        m_Sources.resize(m_Edge_Genes.size());
+        std::ranges::transform(m_Edge_Genes, m_Sources.begin(), source_slot);
+        m_Weights.resize(m_Edge_Genes.size());
+        m_Bias.resize(m_Node_Genes.size());
+        refresh_plan();
+        ++m_Compilations;
+    }
+};
+
+//--------------------------------------------------------------------------------------//
+// NEAT net concept
+
+template <
+    typename T,
+    std::size_t                                            Inputs,
+    std::size_t                                            Outputs,
+    matrix_activation_functions::Identifiers::Identifiers_ Hidden_Activation,
+    matrix_activation_functions::Identifiers::Identifiers_ Output_Activation>
+void neat_neural_net_dummy(
+    neat_neural_net<T, Inputs, Outputs, Hidden_Activation, Output_Activation>
+)
+{
+}
+
+template <typename T>
+concept neat_neural_net_type =
+    requires { neat_neural_net_dummy(std::declval<T&>()); };
+
+//--------------------------------------------------------------------------------------//
+// GA Utility
+// neat net crossover
+
+/**
+ * \brief NEAT crossover: each child has the structure of its own parent
+ *        (child1 that of net1), the genes both parents share being taken
+ *        from either of them
+ */
+template <neat_neural_net_type NNet>
+auto to_target_net_x_crossover(
+    const NNet& net1,
+    const NNet& net2,
+    NNet&       child1,
+    NNet&       child2
+) -> void
+{
+    NNet crossed1 = net1;
+    NNet crossed2 = net2;
+    crossed1.inherit_matching_genes(net2);
+    crossed2.inherit_matching_genes(net1);
+    child1 = std::move(crossed1);
+    child2 = std::move(crossed2);
+}
+
+} // namespace ga_snn
+
+#endif // !NEAT_NEURAL_NET
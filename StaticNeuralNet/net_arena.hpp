@@ -0,0 +1,352 @@
+#pragma once
+
+#ifndef NET_ARENA
+#define NET_ARENA
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/*
+Arena storage for whole populations of nets, e.g. static_neural_nets, which
+embed every layer by value and are too big to live anywhere but the heap.
+
+Instead of one heap allocation per net, the nets of a net_arena share big
+blocks: reserve the population up front and its nets are slots of a single
+contiguous allocation, aligned to (and on Linux advised to be backed by) 2 MiB
+huge pages. Nets of the population are then neighbours in memory and a whole
+generation is reached through few TLB entries.
+
+A net is taken from the arena with make, which returns an arena_ptr: a
+unique_ptr alike owner of its slot. Freed slots are reused by the next make,
+so a generation turnover recycles the slots of the generation it replaces
+instead of going back to the allocator. Slots never move: a net's address
+and its handle, the slot index, are stable for as long as it lives.
+*/
+
+namespace ga_snn
+{
+
+template <typename NNet>
+class net_arena;
+
+/**
+ * \brief Owner of a net in a net_arena, see net_arena::make. Moves like
+ *        std::unique_ptr and gives the slot back to the arena on destruction.
+ */
+template <typename NNet>
+class arena_ptr
+{
+public:
+    using element_type = NNet;
+    using handle_type  = typename net_arena<NNet>::handle_type;
+
+private:
+    net_arena<NNet>* m_Arena  = nullptr;
+    NNet*            m_Net    = nullptr;
+    handle_type      m_Handle = 0;
+
+    friend class net_arena<NNet>;
+
+    arena_ptr(net_arena<NNet>& arena, NNet* net, handle_type handle) noexcept :
+        m_Arena{ &arena },
+        m_Net{ net },
+        m_Handle{ handle }
+    {
+    }
+
+public:
+    arena_ptr() noexcept = default;
+
+    arena_ptr(arena_ptr&& other) noexcept :
+        m_Arena{ std::exchange(other.m_Arena, nullptr) },
+        m_Net{ std::exchange(other.m_Net, nullptr) },
+        m_Handle{ other.m_Handle }
+    {
+    }
+
+    arena_ptr& operator=(arena_ptr&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            m_Arena  = std::exchange(other.m_Arena, nullptr);
+            m_Net    = std::exchange(other.m_Net, nullptr);
+            m_Handle = other.m_Handle;
+        }
+        return *this;
+    }
+
+    arena_ptr(arena_ptr const&)            = delete;
+    arena_ptr& operator=(arena_ptr const&) = delete;
+
+    ~arena_ptr() noexcept
+    {
+        reset();
+    }
+
+    auto reset() noexcept -> void
+    {
+        if (m_Net)
+        {
+            m_Arena->release(m_Handle, m_Net);
+            m_Arena = nullptr;
+            m_Net   = nullptr;
+        }
+    }
+
+    [[nodiscard]]
+    auto get() const noexcept -> NNet*
+    {
+        return m_Net;
+    }
+
+    [[nodiscard]]
+    auto operator*() const noexcept -> NNet&
+    {
+        assert(m_Net);
+        return *m_Net;
+    }
+
+    [[nodiscard]]
+    auto operator->() const noexcept -> NNet*
+    {
+        assert(m_Net);
+        return m_Net;
+    }
+
+    [[nodiscard]]
+    explicit operator bool() const noexcept
+    {
+        return m_Net != nullptr;
+    }
+
+    // Slot of the net in its arena, see net_arena::operator[]
+    [[nodiscard]]
+    auto handle() const noexcept -> handle_type
+    {
+        assert(m_Net);
+        return m_Handle;
+    }
+};
+
+/**
+ * \brief Slots for nets of type NNet in few big blocks, see the top of this
+ *        file. make and release are thread safe, the nets themselves are
+ *        not guarded.
+ */
+template <typename NNet>
+class net_arena
+{
+public:
+    using handle_type = std::uint32_t;
+
+    static constexpr std::size_t s_Huge_Page_Size = 2 * 1024 * 1024;
+    // Slots are cache line aligned, so no two nets share a line
+    static constexpr std::size_t s_Slot_Alignment =
+        std::max<std::size_t>(alignof(NNet), 64);
+    static constexpr std::size_t s_Slot_Size =
+        (sizeof(NNet) + s_Slot_Alignment - 1) / s_Slot_Alignment *
+        s_Slot_Alignment;
+    // Nets a block holds when not told otherwise: a huge page worth
+    static constexpr std::size_t s_Default_Block_Slots =
+        std::max<std::size_t>(s_Huge_Page_Size / s_Slot_Size, 1);
+
+private:
+    struct block_deleter
+    {
+        auto operator()(std::byte* block) const noexcept -> void
+        {
+            ::operator delete(block, std::align_val_t{ s_Huge_Page_Size });
+        }
+    };
+
+    struct block
+    {
+        std::unique_ptr<std::byte, block_deleter> m_Data;
+        handle_type                               m_First;
+        std::size_t                               m_Slots;
+    };
+
+    std::vector<block>       m_Blocks;
+    std::vector<handle_type> m_Free; // free slots, the next one to use last
+    std::size_t              m_Slots = 0;
+    mutable std::mutex       m_Mutex;
+
+public:
+    net_arena() noexcept = default;
+
+    explicit net_arena(std::size_t capacity)
+    {
+        reserve(capacity);
+    }
+
+    net_arena(net_arena const&)            = delete;
+    net_arena& operator=(net_arena const&) = delete;
+
+    // Every arena_ptr must have given its slot back by now
+    ~net_arena() noexcept = default;
+
+    /**
+     * \brief Arena shared by every user of NNet nets, e.g. the brains of
+     *        ga_neural_model::arena_net_storage
+     */
+    [[nodiscard]]
+    static auto global() -> net_arena&
+    {
+        static net_arena arena;
+        return arena;
+    }
+
+    /**
+     * \brief Makes room for at least nets more nets, in one contiguous block
+     *        if there is not enough free slots yet: reserve the whole
+     *        population before making its nets.
+     */
+    auto reserve(std::size_t nets) -> void
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        if (m_Free.size() < nets)
+        {
+            add_block(nets - m_Free.size());
+        }
+    }
+
+    /**
+     * \brief Constructs a net from args in a free slot, in a new block when
+     *        there is none
+     */
+    template <typename... Args>
+    [[nodiscard]]
+    auto make(Args&&... args) -> arena_ptr<NNet>
+    {
+        const auto [handle, place] = acquire();
+        NNet*      net             = nullptr;
+        try
+        {
+            net = ::new (static_cast<void*>(place))
+                NNet(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            give_back(handle);
+            throw;
+        }
+        return arena_ptr<NNet>{ *this, net, handle };
+    }
+
+    // Net living in slot handle
+    [[nodiscard]]
+    auto operator[](handle_type handle) const noexcept -> NNet&
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        return *std::launder(reinterpret_cast<NNet*>(slot(handle)));
+    }
+
+    // Slots in use
+    [[nodiscard]]
+    auto size() const noexcept -> std::size_t
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        return m_Slots - m_Free.size();
+    }
+
+    [[nodiscard]]
+    auto capacity() const noexcept -> std::size_t
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        return m_Slots;
+    }
+
+    [[nodiscard]]
+    auto block_count() const noexcept -> std::size_t
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        return m_Blocks.size();
+    }
+
+private:
+    friend class arena_ptr<NNet>;
+
+    auto release(handle_type handle, NNet* net) noexcept -> void
+    {
+        net->~NNet();
+        give_back(handle);
+    }
+
+    // A free slot and where it lies, the blocks being looked up under the
+    // lock as another thread may be adding one
+    [[nodiscard]]
+    auto acquire() -> std::pair<handle_type, std::byte*>
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        if (m_Free.empty())
+        {
+            add_block(s_Default_Block_Slots);
+        }
+        const auto handle = m_Free.back();
+        m_Free.pop_back();
+        return { handle, slot(handle) };
+    }
+
+    auto give_back(handle_type handle) noexcept -> void
+    {
+        const std::scoped_lock lock{ m_Mutex };
+        m_Free.push_back(handle);
+    }
+
+    // Adds a block of at least slots slots, rounded up to whole huge pages.
+    // Its handles are taken lowest first, so a population made in one go
+    // lies in order in the block.
+    auto add_block(std::size_t slots) -> void
+    {
+        const auto bytes =
+            (slots * s_Slot_Size + s_Huge_Page_Size - 1) / s_Huge_Page_Size *
+            s_Huge_Page_Size;
+        slots = bytes / s_Slot_Size;
+        assert(m_Slots + slots <= std::size_t{ UINT32_MAX });
+
+        std::unique_ptr<std::byte, block_deleter> data{ static_cast<std::byte*>(
+            ::operator new(bytes, std::align_val_t{ s_Huge_Page_Size })
+        ) };
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        // Only advice, the block works with regular pages too
+        ::madvise(data.get(), bytes, MADV_HUGEPAGE);
+#endif
+        // Room for every slot, so giving one back never allocates
+        m_Free.reserve(m_Slots + slots);
+        const auto first = static_cast<handle_type>(m_Slots);
+        m_Blocks.push_back(block{ std::move(data), first, slots });
+        m_Slots += slots;
+
+        for (auto handle = m_Slots; handle != first; --handle)
+        {
+            m_Free.push_back(static_cast<handle_type>(handle - 1));
+        }
+    }
+
+    [[nodiscard]]
+    auto slot(handle_type handle) const noexcept -> std::byte*
+    {
+        const auto it = std::ranges::upper_bound(
+                            m_Blocks, handle, {}, &block::m_First
+                        ) -
+                        1;
+        assert(handle - it->m_First < it->m_Slots);
+        return it->m_Data.get() + (handle - it->m_First) * s_Slot_Size;
+    }
+};
+
+} // namespace ga_snn
+
+#endif // !NET_ARENA
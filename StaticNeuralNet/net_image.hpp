@@ -0,0 +1,581 @@
+#pragma once
+
+#ifndef NET_IMAGE
+#define NET_IMAGE
+
+#include "Log.hpp"
+#include "reduced_precision.hpp"
+#include "static_neural_net.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+Binary images of static_neural_nets, meant to be used where they lie.
+
+An image holds one net or a whole population of nets of the same type:
+
+    net_image_header        64 bytes, see below
+    net_image_signature     one per layer: size and activation function
+    padding                 up to s_Net_Image_Alignment
+    nets                    the memory image of each net, back to back
+
+The header records what the nets were written as (version, byte order, type
+of the weights, weight layout, size of a net) and a checksum of the
+signatures and the nets, so an image is only ever read back into the very
+same net type.
+
+mapped_net_image maps an image into memory (mmap on Linux, private copy on
+write mapping) and hands out its nets in place: opening a population of
+thousands of nets costs one system call and the pages of the nets actually
+used, instead of one file and one read per net. Nets may be mutated in
+place, which never writes back to the file. Elsewhere the image is read into
+one aligned buffer in a single read.
+*/
+
+namespace ga_snn
+{
+
+inline constexpr std::uint32_t s_Net_Image_Version    = 1;
+inline constexpr std::uint32_t s_Net_Image_Byte_Order = 0x01020304;
+// Of the first net from the start of the file, which is mapped page aligned
+inline constexpr std::size_t s_Net_Image_Alignment = 64;
+inline constexpr std::array<char, 8> s_Net_Image_Magic{ 'G', 'A', 'S', 'N',
+                                                        'N', 'I', 'M', 'G' };
+
+/**
+ * \brief Type of the weights of the nets of an image
+ */
+enum class net_image_dtype : std::uint32_t
+{
+    f32  = 1,
+    f64  = 2,
+    bf16 = 3,
+    fp16 = 4,
+};
+
+template <ga_sm::floating_point_storage T>
+inline constexpr net_image_dtype net_image_dtype_of =
+    std::same_as<T, float>          ? net_image_dtype::f32
+    : std::same_as<T, double>       ? net_image_dtype::f64
+    : std::same_as<T, ga_sm::bf16> ? net_image_dtype::bf16
+                                    : net_image_dtype::fp16;
+
+struct net_image_header
+{
+    std::array<char, 8> Magic;
+    std::uint32_t       Version;
+    std::uint32_t       Byte_Order; // s_Net_Image_Byte_Order as written
+    net_image_dtype     Dtype;
+    std::uint32_t       Layout;    // weight_layout
+    std::uint32_t       Layers;    // signatures following the header
+    std::uint32_t       Alignment; // of the nets, from the start of the file
+    std::uint64_t       Net_Size;
+    std::uint64_t       Count;       // nets
+    std::uint64_t       Nets_Offset; // first net, from the start of the file
+    std::uint64_t       Checksum;    // net_image_checksum of what follows
+};
+
+static_assert(sizeof(net_image_header) == 64);
+static_assert(std::is_trivially_copyable_v<net_image_header>);
+
+struct net_image_signature
+{
+    std::uint32_t Size;
+    std::uint32_t Activation;
+};
+
+/**
+ * \brief 64-bit FNV-1a over 8-byte words (then the bytes of the tail of each
+ *        piece), of the signatures then of each net of an image. Only meant
+ *        to catch truncated or corrupted files.
+ */
+class net_image_checksum
+{
+    std::uint64_t m_Hash = 0xcbf29ce484222325;
+
+    static constexpr std::uint64_t s_Prime = 0x100000001b3;
+
+public:
+    auto add(std::span<const std::byte> bytes) noexcept -> void
+    {
+        std::size_t i = 0;
+        for (; i + 8 <= bytes.size(); i += 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, bytes.data() + i, sizeof(word));
+            m_Hash = (m_Hash ^ word) * s_Prime;
+        }
+        for (; i != bytes.size(); ++i)
+        {
+            m_Hash = (m_Hash ^ static_cast<std::uint64_t>(bytes[i])) * s_Prime;
+        }
+    }
+
+    [[nodiscard]]
+    auto value() const noexcept -> std::uint64_t
+    {
+        return m_Hash;
+    }
+};
+
+/**
+ * \brief Nets an image can hold: their memory image is the net
+ */
+template <typename NNet>
+concept net_image_type =
+    static_neural_net_type<NNet> && std::is_trivially_copyable_v<NNet> &&
+    std::is_standard_layout_v<NNet>;
+
+namespace image_detail
+{
+[[noreturn]]
+inline auto fail(const std::string& message) -> void
+{
+    std::cout << message;
+    log::add(message);
+    std::exit(EXIT_FAILURE);
+}
+
+template <net_image_type NNet>
+[[nodiscard]]
+auto signatures() noexcept
+    -> std::array<net_image_signature, NNet::s_Layers>
+{
+    std::array<net_image_signature, NNet::s_Layers> ret{};
+    for (std::size_t l = 0; l != NNet::s_Layers; ++l)
+    {
+        ret[l] = { NNet::s_Signatures[l].Size,
+                   static_cast<std::uint32_t>(
+                       NNet::s_Signatures[l].Activation
+                   ) };
+    }
+    return ret;
+}
+
+template <net_image_type NNet>
+[[nodiscard]]
+constexpr auto nets_offset() noexcept -> std::size_t
+{
+    constexpr auto alignment =
+        std::max(s_Net_Image_Alignment, alignof(NNet));
+    constexpr auto end = sizeof(net_image_header) +
+                         NNet::s_Layers * sizeof(net_image_signature);
+    return (end + alignment - 1) / alignment * alignment;
+}
+
+template <typename Net_Ref>
+[[nodiscard]]
+auto as_net(const Net_Ref& net) noexcept -> const auto&
+{
+    if constexpr (static_neural_net_type<Net_Ref>)
+    {
+        return net;
+    }
+    else
+    {
+        return *net;
+    }
+}
+
+template <typename Net_Ref>
+auto as_bytes(const Net_Ref& net) noexcept
+{
+    return std::as_bytes(std::span{ &as_net(net), 1 });
+}
+} // namespace image_detail
+
+/**
+ * \brief Writes nets, a range of nets or of pointers to them (e.g. the
+ *        std::unique_ptrs of a population), as one image
+ */
+template <std::ranges::forward_range Nets>
+    requires net_image_type<std::remove_cvref_t<
+        decltype(image_detail::as_net(*std::ranges::begin(std::declval<Nets&>())
+        ))>>
+auto store_net_image(const std::filesystem::path& filename, const Nets& nets)
+    -> void
+{
+    using NNet = std::remove_cvref_t<
+        decltype(image_detail::as_net(*std::ranges::begin(nets)))>;
+
+    const auto signatures = image_detail::signatures<NNet>();
+    net_image_checksum checksum;
+    checksum.add(std::as_bytes(std::span{ signatures }));
+    std::uint64_t count = 0;
+    for (const auto& net : nets)
+    {
+        checksum.add(image_detail::as_bytes(net));
+        ++count;
+    }
+
+    const net_image_header header{
+        .Magic       = s_Net_Image_Magic,
+        .Version     = s_Net_Image_Version,
+        .Byte_Order  = s_Net_Image_Byte_Order,
+        .Dtype       = net_image_dtype_of<typename NNet::weight_type>,
+        .Layout      = static_cast<std::uint32_t>(NNet::s_Layout),
+        .Layers      = static_cast<std::uint32_t>(NNet::s_Layers),
+        .Alignment   = static_cast<std::uint32_t>(
+            std::max(s_Net_Image_Alignment, alignof(NNet))
+        ),
+        .Net_Size    = sizeof(NNet),
+        .Count       = count,
+        .Nets_Offset = image_detail::nets_offset<NNet>(),
+        .Checksum    = checksum.value(),
+    };
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open())
+    {
+        image_detail::fail("Could not open file: " + filename.string() + '\n');
+    }
+    constexpr auto padding = image_detail::nets_offset<NNet>() -
+                             sizeof(header) - sizeof(signatures);
+    constexpr std::array<char, padding + 1> zeros{};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(&signatures), sizeof(signatures));
+    out.write(zeros.data(), padding);
+    for (const auto& net : nets)
+    {
+        out.write(
+            reinterpret_cast<const char*>(&image_detail::as_net(net)),
+            sizeof(NNet)
+        );
+    }
+    if (!out)
+    {
+        image_detail::fail("Could not write file: " + filename.string() + '\n');
+    }
+}
+
+/**
+ * \brief Writes net as an image of one net
+ */
+template <net_image_type NNet>
+auto store_net_image(const std::filesystem::path& filename, const NNet& net)
+    -> void
+{
+    store_net_image(filename, std::span{ &net, 1 });
+}
+
+/**
+ * \brief Why image, the bytes of a net image, cannot be read as nets of type
+ *        NNet, or nullptr if it can. Nothing past the end of image is read,
+ *        whatever the header claims. verify_checksum reads every net.
+ */
+template <net_image_type NNet>
+[[nodiscard]]
+auto net_image_error(
+    std::span<const std::byte> image,
+    bool                       verify_checksum = true
+) noexcept -> const char*
+{
+    net_image_header header;
+    if (image.size() < sizeof(header))
+    {
+        return "not a net image.";
+    }
+    std::memcpy(&header, image.data(), sizeof(header));
+    if (header.Magic != s_Net_Image_Magic)
+    {
+        return "not a net image.";
+    }
+    if (header.Version != s_Net_Image_Version ||
+        header.Byte_Order != s_Net_Image_Byte_Order)
+    {
+        return "unsupported version or byte order.";
+    }
+    constexpr auto nets_offset = image_detail::nets_offset<NNet>();
+    if (header.Dtype != net_image_dtype_of<typename NNet::weight_type> ||
+        header.Layout != static_cast<std::uint32_t>(NNet::s_Layout) ||
+        header.Net_Size != sizeof(NNet) || header.Nets_Offset != nets_offset)
+    {
+        return "types must match.";
+    }
+    // The signatures end before the first net
+    if (image.size() < nets_offset)
+    {
+        return "the file is truncated.";
+    }
+    const auto signatures = image_detail::signatures<NNet>();
+    if (header.Layers != NNet::s_Layers ||
+        std::memcmp(
+            image.data() + sizeof(header), signatures.data(), sizeof(signatures)
+        ) != 0)
+    {
+        return "shapes must match.";
+    }
+    // Bounded before it is multiplied, a corrupt count could overflow
+    const auto room = (image.size() - nets_offset) / sizeof(NNet);
+    if (header.Count > room ||
+        image.size() != nets_offset + header.Count * sizeof(NNet))
+    {
+        return "the file is truncated.";
+    }
+
+    if (verify_checksum)
+    {
+        net_image_checksum checksum;
+        checksum.add(std::as_bytes(std::span{ signatures }));
+        for (std::size_t n = 0; n != header.Count; ++n)
+        {
+            checksum.add(
+                image.subspan(nets_offset + n * sizeof(NNet), sizeof(NNet))
+            );
+        }
+        if (checksum.value() != header.Checksum)
+        {
+            return "checksum mismatch.";
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * \brief The nets of an image, in place in the memory the image is mapped
+ *        to, see the top of this file. The image must have been written
+ *        from nets of type NNet, which is checked against its header; a
+ *        mismatch, like a file that cannot be read, ends the program as
+ *        load does (see net_image_error). The nets live as long as the
+ *        mapped_net_image.
+ */
+template <net_image_type NNet>
+class mapped_net_image
+{
+    std::byte*  m_Data   = nullptr;
+    std::size_t m_Bytes  = 0;
+    bool        m_Mapped = false; // by mmap, or read into an aligned buffer
+    NNet*       m_Nets   = nullptr;
+    std::size_t m_Count  = 0;
+
+public:
+    mapped_net_image() noexcept = default;
+
+    /**
+     * \brief Maps the image in filename. verify_checksum reads every page
+     *        of the image once, skip it for a lazier start.
+     */
+    explicit mapped_net_image(
+        const std::filesystem::path& filename,
+        bool                         verify_checksum = true
+    )
+    {
+        map(filename);
+        check(filename, verify_checksum);
+    }
+
+    mapped_net_image(mapped_net_image&& other) noexcept :
+        m_Data{ std::exchange(other.m_Data, nullptr) },
+        m_Bytes{ std::exchange(other.m_Bytes, 0) },
+        m_Mapped{ other.m_Mapped },
+        m_Nets{ std::exchange(other.m_Nets, nullptr) },
+        m_Count{ std::exchange(other.m_Count, 0) }
+    {
+    }
+
+    mapped_net_image& operator=(mapped_net_image&& other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            m_Data   = std::exchange(other.m_Data, nullptr);
+            m_Bytes  = std::exchange(other.m_Bytes, 0);
+            m_Mapped = other.m_Mapped;
+            m_Nets   = std::exchange(other.m_Nets, nullptr);
+            m_Count  = std::exchange(other.m_Count, 0);
+        }
+        return *this;
+    }
+
+    mapped_net_image(mapped_net_image const&)            = delete;
+    mapped_net_image& operator=(mapped_net_image const&) = delete;
+
+    ~mapped_net_image() noexcept
+    {
+        unmap();
+    }
+
+    [[nodiscard]]
+    auto size() const noexcept -> std::size_t
+    {
+        return m_Count;
+    }
+
+    [[nodiscard]]
+    auto nets() noexcept -> std::span<NNet>
+    {
+        return { m_Nets, m_Count };
+    }
+
+    [[nodiscard]]
+    auto nets() const noexcept -> std::span<const NNet>
+    {
+        return { m_Nets, m_Count };
+    }
+
+    [[nodiscard]]
+    auto operator[](std::size_t idx) noexcept -> NNet&
+    {
+        assert(idx < m_Count);
+        return m_Nets[idx];
+    }
+
+    [[nodiscard]]
+    auto operator[](std::size_t idx) const noexcept -> const NNet&
+    {
+        assert(idx < m_Count);
+        return m_Nets[idx];
+    }
+
+    [[nodiscard]]
+    auto begin() noexcept
+    {
+        return nets().begin();
+    }
+
+    [[nodiscard]]
+    auto end() noexcept
+    {
+        return nets().end();
+    }
+
+    [[nodiscard]]
+    auto begin() const noexcept
+    {
+        return nets().begin();
+    }
+
+    [[nodiscard]]
+    auto end() const noexcept
+    {
+        return nets().end();
+    }
+
+private:
+    auto map(const std::filesystem::path& filename) -> void
+    {
+#if defined(__linux__)
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        struct stat st{};
+        if (fd < 0 || ::fstat(fd, &st) != 0)
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            image_detail::fail(
+                "Could not open file: " + filename.string() + '\n'
+            );
+        }
+        m_Bytes = static_cast<std::size_t>(st.st_size);
+        // Private and writable: nets can be mutated in place, copy on write
+        void* data = m_Bytes == 0 ? MAP_FAILED
+                                  : ::mmap(
+                                        nullptr,
+                                        m_Bytes,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE,
+                                        fd,
+                                        0
+                                    );
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            image_detail::fail(
+                "Could not map file: " + filename.string() + '\n'
+            );
+        }
+        m_Data   = static_cast<std::byte*>(data);
+        m_Mapped = true;
+#else
+        std::ifstream in(filename, std::ios::binary | std::ios::ate);
+        if (!in.is_open())
+        {
+            image_detail::fail(
+                "Could not open file: " + filename.string() + '\n'
+            );
+        }
+        m_Bytes = static_cast<std::size_t>(in.tellg());
+        m_Data  = static_cast<std::byte*>(::operator new(
+            std::max<std::size_t>(m_Bytes, 1),
+            std::align_val_t{ alignment() }
+        ));
+        in.seekg(0);
+        in.read(
+            reinterpret_cast<char*>(m_Data),
+            static_cast<std::streamsize>(m_Bytes)
+        );
+#endif
+    }
+
+    auto unmap() noexcept -> void
+    {
+        if (!m_Data)
+        {
+            return;
+        }
+#if defined(__linux__)
+        if (m_Mapped)
+        {
+            ::munmap(m_Data, m_Bytes);
+        }
+#endif
+        if (!m_Mapped)
+        {
+            ::operator delete(m_Data, std::align_val_t{ alignment() });
+        }
+        m_Data = nullptr;
+        m_Nets = nullptr;
+    }
+
+    [[nodiscard]]
+    static constexpr auto alignment() noexcept -> std::size_t
+    {
+        return std::max(s_Net_Image_Alignment, alignof(NNet));
+    }
+
+    auto check(const std::filesystem::path& filename, bool verify_checksum)
+        -> void
+    {
+        if (const auto error = net_image_error<NNet>(
+                { m_Data, m_Bytes }, verify_checksum
+            ))
+        {
+            unmap();
+            image_detail::fail(
+                "Cannot load " + filename.string() + " here: " + error + '\n'
+            );
+        }
+
+        net_image_header header;
+        std::memcpy(&header, m_Data, sizeof(header));
+        m_Count = static_cast<std::size_t>(header.Count);
+        m_Nets  = std::launder(
+            reinterpret_cast<NNet*>(m_Data + header.Nets_Offset)
+        );
+    }
+};
+
+} // namespace ga_snn
+
+#endif // !NET_IMAGE
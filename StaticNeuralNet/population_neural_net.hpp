@@ -0,0 +1,368 @@
+#pragma once
+
+#ifndef POPULATION_NEURAL_NET
+#define POPULATION_NEURAL_NET
+
+#include "static_neural_net.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+Inference engine evaluating a whole generation of static_neural_nets of the
+same type on the same input, e.g. every agent of a population on a fitness
+function's stimulus.
+
+The nets are gathered into structure of arrays blocks, layer by layer:
+- Every agent sees the same input, so the first layers of all of them form
+  one Inputs x (Outputs * Population) matrix (agent p owns columns
+  [p * Outputs, (p + 1) * Outputs)). The whole generation's first layer is a
+  single matrix product, which loads each input tile once and reuses it for
+  every agent, instead of Population small ones.
+- From then on the agents' activations differ. The hidden activations of all
+  agents are kept side by side in one Rows x (Outputs * Population) matrix
+  and every agent's layer reads and writes its columns through strided views,
+  without copies, from a contiguous block of Population layers. Those
+  matrices live in two ping-pong buffers sized for the widest of them (a
+  forward_workspace, per thread unless one is passed in), not on the stack.
+
+Rows, the number of inputs evaluated per forward_pass, defaults to the batch
+size of the nets. Several stimuli per forward_pass reuse every weight loaded
+from cache Rows times, which is where a generation evaluated one stimulus at
+a time spends its time: a generation's weights do not fit in L1.
+
+The engine is a snapshot: stack the nets again after mutating them.
+*/
+
+namespace ga_snn
+{
+
+/**
+ * \brief First layers of Population nets, fed the same input, stacked side by
+ *        side into one wide layer. See population_neural_net.
+ */
+template <static_layer_type Layer, std::size_t Population, std::size_t Rows>
+    requires(Population > 0 && Rows > 0)
+class stacked_layer
+{
+public:
+    using value_type          = typename Layer::value_type;
+    using weight_type         = typename Layer::weights_shape::value_type;
+    using agent_layer_type    = rebatched_layer<Layer, Rows>;
+    using activation_function = typename agent_layer_type::activation_function;
+
+    static constexpr std::size_t s_Inputs          = Layer::s_Inputs;
+    static constexpr std::size_t s_Outputs         = Layer::s_Outputs;
+    static constexpr std::size_t s_Stacked_outputs = s_Outputs * Population;
+
+    using input_view_type = typename agent_layer_type::input_view_type;
+    using output_view_type =
+        ga_sm::static_matrix_view<value_type, Rows, s_Stacked_outputs>;
+
+private:
+    using weights_shape =
+        ga_sm::static_matrix<weight_type, s_Inputs, s_Stacked_outputs>;
+    using bias_vector_shape =
+        ga_sm::static_matrix<weight_type, 1, s_Stacked_outputs>;
+
+    // Activations without parameters are the same for every agent and run
+    // inside the matrix product, the others on each agent's columns after it
+    static constexpr bool s_Shared_activation =
+        activation_function::is_element_wise &&
+        activation_function::parameter_count() == 0;
+
+    weights_shape                               m_Weights;
+    bias_vector_shape                           m_Bias;
+    std::array<activation_function, Population> m_Activations;
+
+public:
+    /**
+     * \brief Copies layer into the columns of agent idx
+     */
+    constexpr void gather(std::size_t idx, Layer const& layer)
+    {
+        const auto first = idx * s_Outputs;
+        for (std::size_t k = 0; k != s_Inputs; ++k)
+        {
+            for (std::size_t j = 0; j != s_Outputs; ++j)
+            {
+                m_Weights[k, first + j] = layer.weight(k, j);
+            }
+        }
+        for (std::size_t j = 0; j != s_Outputs; ++j)
+        {
+            m_Bias[0, first + j] = layer.get_bias_vector()[0, j];
+        }
+        m_Activations[idx].params = layer.get_activation_function().params;
+    }
+
+    constexpr void
+    forward_pass(input_view_type input, output_view_type output) const
+    {
+        if constexpr (s_Shared_activation)
+        {
+            ga_sm::multiply_add_activate(
+                input,
+                m_Weights,
+                m_Bias,
+                m_Activations[0].element_function(),
+                output
+            );
+        }
+        else
+        {
+            ga_sm::multiply_add_activate(
+                input, m_Weights, m_Bias, [](value_type x) { return x; }, output
+            );
+            for (std::size_t p = 0; p != Population; ++p)
+            {
+                activate(p, output);
+            }
+        }
+    }
+
+private:
+    constexpr void activate(std::size_t idx, output_view_type output) const
+    {
+        const ga_sm::
+            static_matrix_view<value_type, Rows, s_Outputs, s_Stacked_outputs>
+                columns{ output.data() + idx * s_Outputs };
+
+        if constexpr (activation_function::is_element_wise)
+        {
+            const auto fn = m_Activations[idx].element_function();
+            for (std::size_t j = 0; j != Rows; ++j)
+            {
+                for (std::size_t i = 0; i != s_Outputs; ++i)
+                {
+                    columns[j, i] = fn(columns[j, i]);
+                }
+            }
+        }
+        else
+        {
+            // The activation function works on whole matrices
+            typename agent_layer_type::output_vector_shape out{};
+            for (std::size_t j = 0; j != Rows; ++j)
+            {
+                for (std::size_t i = 0; i != s_Outputs; ++i)
+                {
+                    out[j, i] = columns[j, i];
+                }
+            }
+            m_Activations[idx](out);
+            columns.assign(out);
+        }
+    }
+};
+
+/**
+ * \brief Evaluates Population nets of type NNet on the same Rows inputs at
+ *        once, see the top of this file. forward_pass returns, in the order
+ *        the nets were gathered, what each net would for every input row.
+ *        NNet needs a hidden layer for the ping-pong buffers to hold, which
+ *        every basic_static_neural_net has: it takes at least two layers.
+ */
+template <
+    static_neural_net_type NNet,
+    std::size_t            Population,
+    std::size_t            Rows = NNet::input_type::Size_y>
+    requires(NNet::s_Layers > 1 && Population > 0 && Rows > 0)
+class population_neural_net
+{
+public:
+    using neural_net_type = NNet;
+    using value_type      = typename NNet::value_type;
+    using input_type =
+        ga_sm::static_matrix<value_type, Rows, NNet::s_Input_Size>;
+    using output_type =
+        ga_sm::static_matrix<value_type, Rows, NNet::s_Output_Size>;
+    using outputs_type = std::array<output_type, Population>;
+
+    static constexpr std::size_t s_Layers     = NNet::s_Layers;
+    static constexpr std::size_t s_Population = Population;
+    static constexpr std::size_t s_Rows       = Rows;
+
+private:
+    template <std::size_t I>
+    using net_layer_type = std::remove_cvref_t<
+        decltype(std::declval<NNet const&>().template layer<I>())>;
+
+    template <std::size_t I>
+    using layer_type = rebatched_layer<net_layer_type<I>, Rows>;
+
+    template <std::size_t... I>
+    static auto layers_of(std::index_sequence<0, I...>) -> std::tuple<
+        stacked_layer<net_layer_type<0>, Population, Rows>,
+        std::array<layer_type<I>, Population>...>;
+
+    using index_sequence = std::make_index_sequence<s_Layers>;
+    using layers_type    = decltype(layers_of(index_sequence{}));
+
+    template <std::size_t... I>
+    static consteval auto max_stacked_hidden(std::index_sequence<I...>)
+        -> std::size_t
+    {
+        return std::max({ net_layer_type<I>::s_Outputs * Population... });
+    }
+
+public:
+    // Widest hidden layer of the whole generation, side by side
+    static constexpr std::size_t s_Max_Stacked_Hidden =
+        max_stacked_hidden(std::make_index_sequence<s_Layers - 1>{});
+
+    using workspace_type =
+        forward_workspace<value_type, Rows, s_Max_Stacked_Hidden>;
+
+private:
+    layers_type m_Layers;
+
+    template <std::size_t... I>
+    constexpr void gather_layers(
+        std::size_t idx,
+        NNet const& net,
+        std::index_sequence<0, I...>
+    )
+    {
+        std::get<0>(m_Layers).gather(idx, net.template layer<0>());
+        (std::get<I>(m_Layers)[idx].init_from(net.template layer<I>()), ...);
+    }
+
+    // Runs layer I of every agent on the side by side activations of layer
+    // I - 1 in hidden, writing its own into next. Layer I + 1 then reads next
+    // and writes over hidden.
+    template <std::size_t I>
+    constexpr void forward_pass_impl(
+        value_type*   hidden,
+        value_type*   next,
+        outputs_type& outputs
+    ) const
+    {
+        constexpr auto Inputs  = layer_type<I>::s_Inputs;
+        constexpr auto Outputs = layer_type<I>::s_Outputs;
+
+        const auto input_of = [hidden](std::size_t idx) {
+            return ga_sm::static_matrix_view<
+                const value_type,
+                Rows,
+                Inputs,
+                Inputs * Population>{ hidden + idx * Inputs };
+        };
+
+        auto const& layers = std::get<I>(m_Layers);
+        if constexpr (I == s_Layers - 1)
+        {
+            for (std::size_t p = 0; p != Population; ++p)
+            {
+                layers[p].forward_pass(
+                    input_of(p), ga_sm::make_view(outputs[p])
+                );
+            }
+        }
+        else
+        {
+            for (std::size_t p = 0; p != Population; ++p)
+            {
+                layers[p].forward_pass(
+                    input_of(p),
+                    ga_sm::static_matrix_view<
+                        value_type,
+                        Rows,
+                        Outputs,
+                        Outputs * Population>{ next + p * Outputs }
+                );
+            }
+            forward_pass_impl<I + 1>(next, hidden, outputs);
+        }
+    }
+
+public:
+    /**
+     * \brief Copies net in as agent idx
+     */
+    constexpr void gather(std::size_t idx, NNet const& net)
+    {
+        gather_layers(idx, net, index_sequence{});
+    }
+
+    /**
+     * \brief forward_pass with the hidden activations in the calling
+     *        thread's workspace
+     */
+    [[nodiscard]]
+    auto forward_pass(input_type const& input_data) const -> outputs_type
+    {
+        return forward_pass(input_data, thread_workspace());
+    }
+
+    /**
+     * \brief forward_pass with the hidden activations of the generation in
+     *        workspace, which this pass overwrites. Every layer writes into
+     *        the buffer the previous one did not.
+     */
+    [[nodiscard]]
+    auto forward_pass(input_type const& input_data, workspace_type& workspace)
+        const -> outputs_type
+    {
+        using first_output_type =
+            typename std::tuple_element_t<0, layers_type>::output_view_type;
+
+        outputs_type outputs;
+        std::get<0>(m_Layers).forward_pass(
+            ga_sm::make_view(input_data),
+            first_output_type{ workspace.m_Ping.data() }
+        );
+        forward_pass_impl<1>(
+            workspace.m_Ping.data(), workspace.m_Pong.data(), outputs
+        );
+        return outputs;
+    }
+
+    /**
+     * \brief The calling thread's workspace, allocated on its first use and
+     *        reused by every later forward pass of the thread on generations
+     *        of this type
+     */
+    [[nodiscard]]
+    static auto thread_workspace() -> workspace_type&
+    {
+        thread_local const auto workspace = std::make_unique<workspace_type>();
+        return *workspace;
+    }
+};
+
+/**
+ * \brief Stacks the nets of a generation into a population_neural_net
+ *        evaluating Rows inputs per forward_pass
+ */
+template <
+    std::size_t            Rows,
+    static_neural_net_type NNet,
+    std::size_t            Population>
+[[nodiscard]]
+auto stack_nets(std::array<NNet const*, Population> const& nets)
+    -> std::unique_ptr<population_neural_net<NNet, Population, Rows>>
+{
+    auto ret =
+        std::make_unique<population_neural_net<NNet, Population, Rows>>();
+    for (std::size_t p = 0; p != Population; ++p)
+    {
+        ret->gather(p, *nets[p]);
+    }
+    return ret;
+}
+
+template <static_neural_net_type NNet, std::size_t Population>
+[[nodiscard]]
+auto stack_nets(std::array<NNet const*, Population> const& nets)
+{
+    return stack_nets<NNet::input_type::Size_y>(nets);
+}
+
+} // namespace ga_snn
+
+#endif // !POPULATION_NEURAL_NET
@@ -0,0 +1,262 @@
+#pragma once
+
+#ifndef QUANTIZED_NEURAL_NET
+#define QUANTIZED_NEURAL_NET
+
+#include "kernels.hpp"
+#include "static_neural_net.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+Post-training int8 quantization of a static_neural_net, for nets that are
+done evolving and only run inference (e.g. as the leaf evaluator of
+minimax_search_engine).
+
+Weights are quantized once and symmetrically, with one scale per layer:
+w ~ scale * q, q in [-127, 127]. The input of every layer is quantized the
+same way on each forward_pass, with one scale per batch row. The int8
+products are accumulated exactly in int32 (simd::dense_i8: pmaddwd on SSE2,
+pmaddubsw on SSE4.2 / AVX2 / AVX-512, vpdpbusd with AVX512-VNNI), rescaled
+to value_type, biased and passed through the activation function of the
+layer, which keeps its parameters.
+
+quantized_neural_net has the input_type / output_type / forward_pass of the
+net it was built from, so it drops in wherever the net is only evaluated,
+e.g. as the net of a ga_neural_model::brain.
+*/
+
+namespace ga_snn
+{
+
+/**
+ * \brief int8 copy of a trained layer, see quantized_neural_net
+ */
+template <static_layer_type Layer>
+    requires std::same_as<typename Layer::value_type, float>
+class quantized_layer
+{
+public:
+    using value_type          = typename Layer::value_type;
+    using input_vector_shape  = typename Layer::input_vector_shape;
+    using output_vector_shape = typename Layer::output_vector_shape;
+    using activation_function = typename Layer::activation_function;
+
+    static constexpr std::size_t s_Inputs     = Layer::s_Inputs;
+    static constexpr std::size_t s_Outputs    = Layer::s_Outputs;
+    static constexpr std::size_t s_Batch_Size = output_vector_shape::Size_y;
+    // Shapes of the int8 product, zero padded as simd::dense_i8 requires
+    static constexpr std::size_t s_Padded_inputs  = (s_Inputs + 3) / 4 * 4;
+    static constexpr std::size_t s_Padded_outputs = (s_Outputs + 15) / 16 * 16;
+
+private:
+    // Packed in groups of 4 inputs, see simd::dense_i8
+    alignas(64) std::array<
+        std::int8_t,
+        s_Padded_inputs * s_Padded_outputs> m_Weights;
+    alignas(64) std::array<value_type, s_Padded_outputs> m_Bias;
+    value_type          m_Weight_scale;
+    activation_function m_activation_function;
+
+public:
+    // layer may evaluate another batch size than Layer, e.g. be a layer of
+    // a net's genome
+    template <static_layer_type Other_Layer>
+        requires(
+            Other_Layer::s_Inputs == s_Inputs &&
+            Other_Layer::s_Outputs == s_Outputs &&
+            Other_Layer::s_Activation == Layer::s_Activation
+        )
+    explicit quantized_layer(Other_Layer const& layer) noexcept :
+        m_Weights{},
+        m_Bias{},
+        m_Weight_scale{},
+        m_activation_function{ layer.get_activation_function().params }
+    {
+        value_type max_abs{};
+        for (std::size_t k = 0; k != s_Inputs; ++k)
+        {
+            for (std::size_t j = 0; j != s_Outputs; ++j)
+            {
+                const auto w = static_cast<value_type>(layer.weight(k, j));
+                max_abs      = std::max(max_abs, std::abs(w));
+            }
+        }
+        m_Weight_scale = max_abs / 127;
+
+        const value_type inv_scale = max_abs > 0 ? 127 / max_abs : 0;
+        for (std::size_t j = 0; j != s_Outputs; ++j)
+        {
+            for (std::size_t k = 0; k != s_Inputs; ++k)
+            {
+                const auto at = (k / 4 * s_Padded_outputs + j) * 4 + k % 4;
+                m_Weights[at] = static_cast<std::int8_t>(std::lround(
+                    static_cast<value_type>(layer.weight(k, j)) * inv_scale
+                ));
+            }
+            m_Bias[j] = static_cast<value_type>(layer.get_bias_vector()[0, j]);
+        }
+    }
+
+    [[nodiscard]]
+    auto forward_pass(input_vector_shape const& input) const
+        -> output_vector_shape
+    {
+        // Only the logical columns are written, the padding stays 0
+        output_vector_shape out;
+        if constexpr (!output_vector_shape::Is_Packed)
+        {
+            out = output_vector_shape{};
+        }
+
+        // Element-wise activations run on the rescaled accumulators, as in
+        // layer::forward_pass
+        if constexpr (activation_function::is_element_wise)
+        {
+            quantized_dense(
+                input, out, m_activation_function.element_function()
+            );
+        }
+        else
+        {
+            quantized_dense(input, out, [](value_type x) { return x; });
+            m_activation_function(out);
+        }
+        return out;
+    }
+
+    [[nodiscard]]
+    auto get_weight_scale() const noexcept -> value_type
+    {
+        return m_Weight_scale;
+    }
+
+private:
+    template <typename Epilogue>
+    auto quantized_dense(
+        input_vector_shape const& input,
+        output_vector_shape&      out,
+        Epilogue const&           epilogue
+    ) const noexcept -> void
+    {
+        ga_sm::simd::quantized_dense<s_Batch_Size, s_Inputs, s_Outputs>(
+            input.m_Elems,
+            input_vector_shape::Row_Stride,
+            m_Weights.data(),
+            m_Weight_scale,
+            m_Bias.data(),
+            out.m_Elems,
+            output_vector_shape::Row_Stride,
+            epilogue
+        );
+    }
+};
+
+/**
+ * \brief int8 weight / int32 accumulation executor of a trained
+ *        static_neural_net (NNet). Evaluates like NNet, but cannot be
+ *        mutated: quantize the net again after changing it.
+ */
+template <static_neural_net_type NNet>
+class quantized_neural_net
+{
+public:
+    using neural_net_type = NNet;
+    using value_type      = typename NNet::value_type;
+    using input_type      = typename NNet::input_type;
+    using output_type     = typename NNet::output_type;
+
+    static constexpr std::size_t s_Layers     = NNet::s_Layers;
+    static constexpr auto        s_Signatures = NNet::s_Signatures;
+
+private:
+    template <std::size_t... I>
+    static auto layers_of(std::index_sequence<I...>)
+        -> std::tuple<quantized_layer<rebatched_layer<
+            std::remove_cvref_t<
+                decltype(std::declval<NNet const&>().template layer<I>())>,
+            input_type::Size_y>>...>;
+
+    using index_sequence = std::make_index_sequence<s_Layers>;
+    using layers_type    = decltype(layers_of(index_sequence{}));
+
+    layers_type m_Layers;
+
+    template <std::size_t... I>
+    [[nodiscard]]
+    static auto quantize_layers(NNet const& net, std::index_sequence<I...>)
+        -> layers_type
+    {
+        return layers_type{ std::tuple_element_t<I, layers_type>(
+            net.template layer<I>()
+        )... };
+    }
+
+    template <std::size_t I, typename Input>
+    [[nodiscard]]
+    auto forward_pass_impl(Input const& input) const -> output_type
+    {
+        if constexpr (I == s_Layers - 1)
+        {
+            return std::get<I>(m_Layers).forward_pass(input);
+        }
+        else
+        {
+            return forward_pass_impl<I + 1>(
+                std::get<I>(m_Layers).forward_pass(input)
+            );
+        }
+    }
+
+public:
+    explicit quantized_neural_net(NNet const& net) noexcept :
+        m_Layers{ quantize_layers(net, index_sequence{}) }
+    {
+    }
+
+    [[nodiscard]]
+    auto forward_pass(input_type const& input_data) const -> output_type
+    {
+        return forward_pass_impl<0>(input_data);
+    }
+
+    template <std::size_t Idx>
+    [[nodiscard]]
+    auto layer() const -> std::tuple_element_t<Idx, layers_type> const&
+    {
+        return std::get<Idx>(m_Layers);
+    }
+
+    auto print_net() const -> void
+    {
+        std::cout << "int8 quantized net of " << NNet::parameter_count()
+                  << " parameters, size: " << sizeof(*this) << " bytes\n";
+        print_address();
+    }
+
+    auto print_address() const -> void
+    {
+        std::cout << "Net address: " << this << '\n';
+    }
+};
+
+/**
+ * \brief Quantizes a trained net, see quantized_neural_net
+ */
+template <static_neural_net_type NNet>
+[[nodiscard]]
+auto quantize(NNet const& net) -> std::unique_ptr<quantized_neural_net<NNet>>
+{
+    return std::make_unique<quantized_neural_net<NNet>>(net);
+}
+
+} // namespace ga_snn
+
+#endif // !QUANTIZED_NEURAL_NET
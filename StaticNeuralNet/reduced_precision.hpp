@@ -0,0 +1,195 @@
+#pragma once
+
+#ifndef STATIC_MATRIX_REDUCED_PRECISION
+#define STATIC_MATRIX_REDUCED_PRECISION
+
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <istream>
+#include <type_traits>
+
+/*
+16 bit floating point element types for static_matrix: bf16 (8 bit exponent,
+the range of float with 8 bits of precision) and fp16 (IEEE binary16).
+
+They only store values, they do not compute: a bf16 or fp16 converts
+implicitly to float and is constructed (rounding to nearest, ties to even)
+from any arithmetic value, so the generic static_matrix code (fill,
+transform, crossover, text and binary serialization) works on the compact
+form unchanged. The kernels of kernels.hpp widen them to float in registers
+and accumulate in float, see multiply_add_activate and matrix_distance.
+*/
+
+namespace ga_sm
+{
+
+/**
+ * \brief bfloat16: the upper half of a float
+ */
+struct bf16_format
+{
+    [[nodiscard]]
+    static constexpr auto from_float(float value) noexcept -> std::uint16_t
+    {
+        const auto bits = std::bit_cast<std::uint32_t>(value);
+        if ((bits & 0x7fffffffu) > 0x7f800000u)
+        {
+            // NaN, kept quiet
+            return static_cast<std::uint16_t>((bits >> 16) | 0x0040u);
+        }
+        return static_cast<std::uint16_t>(
+            (bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16
+        );
+    }
+
+    [[nodiscard]]
+    static constexpr auto to_float(std::uint16_t bits) noexcept -> float
+    {
+        return std::bit_cast<float>(std::uint32_t{ bits } << 16);
+    }
+};
+
+/**
+ * \brief IEEE 754 binary16
+ */
+struct fp16_format
+{
+    [[nodiscard]]
+    static constexpr auto from_float(float value) noexcept -> std::uint16_t
+    {
+        constexpr std::uint32_t F32_Infinity = 255u << 23;
+        constexpr std::uint32_t F16_Overflow = (127u + 16u) << 23;
+        constexpr std::uint32_t F16_Normal   = 113u << 23;
+        // Adding this float moves a value below F16_Normal to the low bits,
+        // rounded by the FPU
+        constexpr std::uint32_t Denormal_Magic =
+            ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+        auto       bits = std::bit_cast<std::uint32_t>(value);
+        const auto sign = bits & 0x80000000u;
+        bits ^= sign;
+
+        std::uint32_t ret{};
+        if (bits >= F16_Overflow)
+        {
+            ret = bits > F32_Infinity ? 0x7e00u : 0x7c00u;
+        }
+        else if (bits < F16_Normal)
+        {
+            const auto sum = std::bit_cast<float>(bits) +
+                std::bit_cast<float>(Denormal_Magic);
+            ret = std::bit_cast<std::uint32_t>(sum) - Denormal_Magic;
+        }
+        else
+        {
+            const auto mantissa_odd = (bits >> 13) & 1u;
+            bits -= 112u << 23; // rebias the exponent
+            bits += 0xfffu + mantissa_odd;
+            ret = bits >> 13;
+        }
+        return static_cast<std::uint16_t>(ret | (sign >> 16));
+    }
+
+    [[nodiscard]]
+    static constexpr auto to_float(std::uint16_t bits) noexcept -> float
+    {
+        const std::uint32_t sign     = (bits & 0x8000u) << 16;
+        const std::uint32_t exp_mant = (bits & 0x7fffu) << 13;
+
+        // Scaling by 2^(127 - 15) rebiases normal and subnormal values
+        // alike, infinities and NaNs get the float exponent instead
+        auto ret = (bits & 0x7c00u) == 0x7c00u
+            ? std::bit_cast<float>(exp_mant | 0x7f800000u)
+            : std::bit_cast<float>(exp_mant) * 0x1p112f;
+        return std::bit_cast<float>(std::bit_cast<std::uint32_t>(ret) | sign);
+    }
+};
+
+/**
+ * \brief 16 bit storage-only float, in the encoding of Format
+ */
+template <typename Format>
+struct reduced_float
+{
+    using format_type = Format;
+
+    std::uint16_t m_Bits;
+
+    reduced_float() = default;
+
+    template <typename A>
+        requires std::is_arithmetic_v<A>
+    constexpr reduced_float(A value) noexcept :
+        m_Bits(Format::from_float(static_cast<float>(value)))
+    {
+    }
+
+    constexpr operator float() const noexcept
+    {
+        return Format::to_float(m_Bits);
+    }
+
+    template <typename A>
+        requires std::is_arithmetic_v<A>
+    constexpr auto operator+=(A rhs) noexcept -> reduced_float&
+    {
+        return *this = static_cast<float>(*this) + static_cast<float>(rhs);
+    }
+
+    template <typename A>
+        requires std::is_arithmetic_v<A>
+    constexpr auto operator-=(A rhs) noexcept -> reduced_float&
+    {
+        return *this = static_cast<float>(*this) - static_cast<float>(rhs);
+    }
+
+    template <typename A>
+        requires std::is_arithmetic_v<A>
+    constexpr auto operator*=(A rhs) noexcept -> reduced_float&
+    {
+        return *this = static_cast<float>(*this) * static_cast<float>(rhs);
+    }
+
+    template <typename A>
+        requires std::is_arithmetic_v<A>
+    constexpr auto operator/=(A rhs) noexcept -> reduced_float&
+    {
+        return *this = static_cast<float>(*this) / static_cast<float>(rhs);
+    }
+};
+
+using bf16 = reduced_float<bf16_format>;
+using fp16 = reduced_float<fp16_format>;
+
+template <typename T>
+concept reduced_floating_point =
+    std::same_as<T, bf16> || std::same_as<T, fp16>;
+
+/**
+ * \brief Types static_matrix parameters (weights) can be stored in
+ */
+template <typename T>
+concept floating_point_storage =
+    std::floating_point<T> || reduced_floating_point<T>;
+
+/**
+ * \brief Type arithmetic on T is carried out in: float for the reduced
+ *        precision types, T otherwise
+ */
+template <typename T>
+using compute_t = std::conditional_t<reduced_floating_point<T>, float, T>;
+
+template <typename Format>
+auto operator>>(std::istream& in, reduced_float<Format>& value)
+    -> std::istream&
+{
+    float f{};
+    in >> f;
+    value = f;
+    return in;
+}
+
+} // namespace ga_sm
+
+#endif // !STATIC_MATRIX_REDUCED_PRECISION
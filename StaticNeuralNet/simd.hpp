@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef STATIC_MATRIX_SIMD
+#define STATIC_MATRIX_SIMD
+
+#include "cpu_features.hpp"
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+/*
+Thin layer over GCC vector extensions used by the static_matrix kernels.
+
+Kernels are written once against vec<T, register_bytes> and the compiler
+lowers the arithmetic to the instruction set of the tier they are compiled
+for (a * b + c is contracted into an FMA when the tier has one).
+
+The binaries are built for the x86-64 baseline. kernels.hpp compiles the
+kernel bodies (tier_kernels.hpp) once per tier, each in its own namespace
+under a matching #pragma GCC target, and simd::select picks one of them with
+cpuid the first time a kernel is called.
+*/
+
+namespace ga_sm::simd
+{
+
+// Default vector width, used for shape heuristics that do not depend on the
+// tier picked at run time (AVX2)
+inline constexpr std::size_t register_bytes = 32;
+
+template <typename T, std::size_t Bytes>
+struct vector_type
+{
+    using type [[gnu::vector_size(Bytes)]] = T;
+};
+
+template <typename T, std::size_t Bytes = register_bytes>
+using vec = typename vector_type<T, Bytes>::type;
+
+template <typename T, std::size_t Bytes = register_bytes>
+inline constexpr std::size_t lanes = Bytes / sizeof(T);
+
+template <typename V>
+using scalar_type = std::remove_cvref_t<decltype(std::declval<V>()[0])>;
+
+/**
+ * \brief Picks the implementation of a kernel for the widest tier supported
+ *        by the CPU. Meant to initialise a function local static, so
+ *        detection and selection only happen once per kernel.
+ */
+template <typename Fn>
+[[nodiscard]]
+auto select(Fn sse2, Fn sse4_2, Fn avx2, Fn avx512) noexcept -> Fn
+{
+    switch (cpu_features::active_isa())
+    {
+    case cpu_features::isa::avx512:
+        return avx512;
+    case cpu_features::isa::avx2_fma:
+        return avx2;
+    case cpu_features::isa::sse4_2:
+        return sse4_2;
+    case cpu_features::isa::sse2:
+        break;
+    }
+    return sse2;
+}
+
+} // namespace ga_sm::simd
+
+#endif // !STATIC_MATRIX_SIMD
@@ -6,6 +6,8 @@
 #include "Random.hpp"
 #include "Stopwatch.hpp"
 #include "cx_helper_functions.hpp"
+#include "kernels.hpp"
+#include "reduced_precision.hpp"
 #include <array>
 #include <bit>
 #include <cassert>
@@ -13,10 +15,10 @@
 #include <cstring> //memcpy
 #include <fstream>
 #include <functional>
-#include <immintrin.h>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
+#include <span>
 #include <stdexcept>
 #include <type_traits>
 
@@ -75,7 +77,84 @@ due to long names
 namespace ga_sm
 {
 
-template <typename T, std::size_t Size>
+//-----------------------------------------------------------------------------
+//------------ Storage policies -----------------------------------------------
+//-----------------------------------------------------------------------------
+
+/*
+A storage policy decides how the M x N logical elements are laid out in
+m_Elems. Both policies keep static_matrix trivial and standard layout, so
+whole matrices (and nets made of them) can still be memcpy'd, compared with
+memcmp and written as raw bytes.
+
+  - packed_storage (default): M * N contiguous elements, natural alignment.
+  - aligned_storage<Alignment>: m_Elems is aligned to Alignment bytes (32 for
+    AVX2, 64 for AVX-512) and every row is padded to a multiple of the vector
+    width, so each row starts on an aligned address and SIMD kernels can sweep
+    whole rows without tail loops. Column vectors (N == 1) are not padded per
+    row; instead the total storage is rounded up to a whole vector.
+
+Padding elements must stay zero, which holds as long as matrices are value
+initialised ({}), as everywhere in this code base. Element-wise operations
+either skip the padding (iterators) or map 0 to 0 on it (+, -), and kernels
+that write whole padded rows produce zeros there.
+*/
+
+struct packed_storage
+{
+    template <typename T>
+    static constexpr std::size_t s_Alignment = alignof(T);
+
+    template <typename T, std::size_t M, std::size_t N>
+    static constexpr std::size_t s_Row_Stride = N;
+
+    template <typename T, std::size_t M, std::size_t N>
+    static constexpr std::size_t s_Storage_Size = M * N;
+};
+
+template <std::size_t Alignment>
+    requires(Alignment == 32 || Alignment == 64)
+struct aligned_storage
+{
+    template <typename T>
+    static constexpr std::size_t s_Alignment = Alignment;
+
+    template <typename T>
+    static constexpr std::size_t s_Lanes = Alignment / sizeof(T);
+
+    template <typename T, std::size_t M, std::size_t N>
+    static constexpr std::size_t s_Row_Stride =
+        N == 1 ? 1 : (N + s_Lanes<T> - 1) / s_Lanes<T> * s_Lanes<T>;
+
+    template <typename T, std::size_t M, std::size_t N>
+    static constexpr std::size_t s_Storage_Size =
+        (M * s_Row_Stride<T, M, N> + s_Lanes<T> - 1) / s_Lanes<T> *
+        s_Lanes<T>;
+};
+
+template <typename S>
+concept storage_policy = requires {
+    S::template s_Alignment<float>;
+    S::template s_Row_Stride<float, 1, 1>;
+    S::template s_Storage_Size<float, 1, 1>;
+};
+
+//-----------------------------------------------------------------------------
+//------------ Iterators ------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+/*
+Iterators walk the logical elements in row major order. With padded rows
+(Row_Size != Row_Stride) they skip the padding at the end of every row, so
+the standard algorithms never see it. Packed matrices keep plain pointer
+semantics.
+*/
+
+template <
+    typename T,
+    std::size_t Size,
+    std::size_t Row_Size   = Size,
+    std::size_t Row_Stride = Row_Size>
 class matrix_const_iterator
 {
 public:
@@ -83,6 +162,8 @@ public:
     using pointer    = const T*;
     using reference  = const T&;
 
+    static constexpr bool s_Padded = Row_Size != Row_Stride;
+
     constexpr matrix_const_iterator() noexcept :
         m_Ptr(nullptr)
     {
@@ -92,8 +173,12 @@ public:
         pointer     p_arg,
         std::size_t offs = 0
     ) noexcept :
-        m_Ptr(p_arg + offs)
+        m_Ptr(p_arg + physical_offset(offs))
     {
+        if constexpr (s_Padded)
+        {
+            m_Col = offs % Row_Size;
+        }
     }
 
     [[nodiscard]]
@@ -114,6 +199,14 @@ public:
     constexpr matrix_const_iterator& operator++() noexcept
     {
         ++m_Ptr;
+        if constexpr (s_Padded)
+        {
+            if (++m_Col == Row_Size)
+            {
+                m_Ptr += Row_Stride - Row_Size;
+                m_Col = 0;
+            }
+        }
         return *this;
     }
 
@@ -121,13 +214,22 @@ public:
     constexpr matrix_const_iterator operator++(int) noexcept
     {
         matrix_const_iterator Tmp = *this;
-        ++m_Ptr;
+        ++*this;
         return Tmp;
     }
 
     //--iter;
     constexpr matrix_const_iterator& operator--() noexcept
     {
+        if constexpr (s_Padded)
+        {
+            if (m_Col == 0)
+            {
+                m_Ptr -= Row_Stride - Row_Size;
+                m_Col = Row_Size;
+            }
+            --m_Col;
+        }
         --m_Ptr;
         return *this;
     }
@@ -136,13 +238,28 @@ public:
     constexpr matrix_const_iterator operator--(int) noexcept
     {
         matrix_const_iterator Tmp = *this;
-        --m_Ptr;
+        --*this;
         return Tmp;
     }
 
     constexpr matrix_const_iterator& operator+=(const ptrdiff_t offs) noexcept
     {
-        m_Ptr += offs;
+        if constexpr (s_Padded)
+        {
+            // floor division, offs can be negative
+            constexpr auto row_size = static_cast<ptrdiff_t>(Row_Size);
+            const auto     col      = static_cast<ptrdiff_t>(m_Col) + offs;
+            const auto     rows =
+                (col >= 0 ? col : col - row_size + 1) / row_size;
+            const auto new_col = col - rows * row_size;
+            m_Ptr += rows * static_cast<ptrdiff_t>(Row_Stride) + new_col -
+                static_cast<ptrdiff_t>(m_Col);
+            m_Col = static_cast<std::size_t>(new_col);
+        }
+        else
+        {
+            m_Ptr += offs;
+        }
         return *this;
     }
 
@@ -157,8 +274,7 @@ public:
 
     constexpr matrix_const_iterator& operator-=(const ptrdiff_t offs) noexcept
     {
-        m_Ptr -= offs;
-        return *this;
+        return *this += -offs;
     }
 
     [[nodiscard]]
@@ -174,14 +290,27 @@ public:
     constexpr ptrdiff_t
     operator-(const matrix_const_iterator& Rhs) const noexcept
     {
-        return m_Ptr - Rhs.m_Ptr;
+        if constexpr (s_Padded)
+        {
+            const auto rows = ((m_Ptr - static_cast<ptrdiff_t>(m_Col)) -
+                               (Rhs.m_Ptr - static_cast<ptrdiff_t>(Rhs.m_Col))
+                              ) /
+                static_cast<ptrdiff_t>(Row_Stride);
+            return rows * static_cast<ptrdiff_t>(Row_Size) +
+                static_cast<ptrdiff_t>(m_Col) -
+                static_cast<ptrdiff_t>(Rhs.m_Col);
+        }
+        else
+        {
+            return m_Ptr - Rhs.m_Ptr;
+        }
     }
 
     [[nodiscard]]
     constexpr reference
     operator[](const ptrdiff_t offs) const noexcept
     {
-        return m_Ptr[offs];
+        return *(*this + offs);
     }
 
     [[nodiscard]]
@@ -213,6 +342,7 @@ public:
     }
 
     constexpr void seek_to(pointer it) noexcept
+        requires(!s_Padded)
     {
         m_Ptr = it;
     }
@@ -224,16 +354,28 @@ public:
     }
 
 private:
-    pointer m_Ptr;
+    [[nodiscard]]
+    static constexpr std::size_t physical_offset(std::size_t offs) noexcept
+    {
+        return offs / Row_Size * Row_Stride + offs % Row_Size;
+    }
+
+    pointer     m_Ptr;
+    std::size_t m_Col{}; // column within the row, only used with padding
 };
 
 //-------------------------------------------------------------------//
 
-template <typename T, std::size_t Size>
-class matrix_iterator : public matrix_const_iterator<T, Size>
+template <
+    typename T,
+    std::size_t Size,
+    std::size_t Row_Size   = Size,
+    std::size_t Row_Stride = Row_Size>
+class matrix_iterator
+    : public matrix_const_iterator<T, Size, Row_Size, Row_Stride>
 {
 public:
-    using My_Base    = matrix_const_iterator<T, Size>;
+    using My_Base    = matrix_const_iterator<T, Size, Row_Size, Row_Stride>;
     using value_type = T;
     using pointer    = T*;
     using reference  = T&;
@@ -335,32 +477,69 @@ public:
 //-------------------------------------------------------------------//
 
 //-------------------------------------------------------------------//
-template <typename T, std::size_t M, std::size_t N>
-    requires(std::is_arithmetic_v<T> && (N > 0) && (M > 0))
+template <
+    typename T,
+    std::size_t    M,
+    std::size_t    N,
+    storage_policy Storage = packed_storage>
+    requires(
+        (std::is_arithmetic_v<T> || reduced_floating_point<T>) && (N > 0) &&
+        (M > 0)
+    )
 class static_matrix
 {
 public:
+    inline static constexpr auto Size_y = M;
+    inline static constexpr auto Size_x = N;
+    inline static constexpr auto Size   = N * M;
+    // Elements between the starts of consecutive rows
+    inline static constexpr auto Row_Stride =
+        Storage::template s_Row_Stride<T, M, N>;
+    // Elements in m_Elems, padding included
+    inline static constexpr auto Storage_Size =
+        Storage::template s_Storage_Size<T, M, N>;
+    inline static constexpr bool Is_Packed = Storage_Size == Size;
+
     using value_type      = T;
     using size_type       = std::size_t;
+    using storage_type    = Storage;
     using pointer         = T*;
     using const_pointer   = const T*;
     using reference       = T&;
     using const_reference = const T&;
     // using iterator        = pointer;
     // using const_iterator  = const_pointer;
-    using iterator       = matrix_iterator<T, M * N>;
-    using const_iterator = matrix_const_iterator<T, M * N>;
-    using row_matrix     = static_matrix<T, 1, N>;
-    using column_matrix  = static_matrix<T, M, 1>;
+    using iterator       = matrix_iterator<T, M * N, N, Row_Stride>;
+    using const_iterator = matrix_const_iterator<T, M * N, N, Row_Stride>;
+    using row_matrix     = static_matrix<T, 1, N, Storage>;
+    using column_matrix  = static_matrix<T, M, 1, Storage>;
 
-    inline static constexpr auto Size_y = M;
-    inline static constexpr auto Size_x = N;
-    inline static constexpr auto Size   = N * M;
-
-    T m_Elems[M * N];
+    alignas(Storage::template s_Alignment<T>) T m_Elems[Storage_Size];
 
     /*--------------------------------------------*/
 
+    /**
+     * \brief Evaluates a lazy expression (see matrix_expression.hpp) into
+     *        this matrix, in a single pass and without temporaries.
+     *        Expressions are element-wise, so this matrix may appear in e.
+     */
+    template <typename Expression>
+        requires(
+            Expression::s_Is_Expression && Expression::Size_y == M &&
+            Expression::Size_x == N
+        )
+    constexpr static_matrix& operator=(Expression const& e) noexcept
+    {
+        for (size_t j = 0; j != M; ++j)
+        {
+            for (size_t i = 0; i != N; ++i)
+            {
+                (*this)[j, i] = static_cast<T>(e[j, i]);
+            }
+        }
+        return *this;
+    }
+
     [[nodiscard]]
     constexpr size_type size() const noexcept
     {
@@ -369,7 +548,7 @@ public:
 
     constexpr void fill(const T& val)
     {
-        fill_n(iterator(m_Elems), M * N, val);
+        fill_n(begin(), M * N, val);
     }
 
     template <class Fn, class... Args>
@@ -488,7 +667,7 @@ public:
     operator[](const std::size_t j, const std::size_t i) noexcept
     {
         assert(j < M and i < N);
-        return m_Elems[j * N + i];
+        return m_Elems[j * Row_Stride + i];
     }
 
     [[nodiscard]]
@@ -496,7 +675,7 @@ public:
     operator[](const std::size_t j, const std::size_t i) const noexcept
     {
         assert(j < M and i < N);
-        return m_Elems[j * N + i];
+        return m_Elems[j * Row_Stride + i];
     }
 
     [[nodiscard]]
@@ -517,12 +696,13 @@ public:
         return m_Elems[j];
     }
 
+    // Padding is 0 on both sides, so the whole storage can be swept
     [[nodiscard]]
     constexpr static_matrix
     operator+(static_matrix const& other) const
     {
         static_matrix ret(*this);
-        for (size_t i = 0; i != M * N; ++i)
+        for (size_t i = 0; i != Storage_Size; ++i)
         {
             ret.m_Elems[i] += other.m_Elems[i];
         }
@@ -534,7 +714,7 @@ public:
     operator-(static_matrix const& other) const
     {
         static_matrix ret(*this);
-        for (size_t i = 0; i != M * N; ++i)
+        for (size_t i = 0; i != Storage_Size; ++i)
         {
             ret.m_Elems[i] -= other.m_Elems[i];
         }
@@ -659,7 +839,7 @@ public:
     // Ifstream file should be closed outside this function
     void load(std::ifstream& in)
     {
-        for (auto& e : m_Elems)
+        for (auto& e : *this)
             in >> e;
     }
 };
@@ -668,8 +848,8 @@ public:
 // Static matrix concept
 // -----------------------------------------------
 
-template <typename T, std::size_t M, std::size_t N>
-void matrix_dummy(static_matrix<T, M, N>)
+template <typename T, std::size_t M, std::size_t N, typename Storage>
+void matrix_dummy(static_matrix<T, M, N, Storage>)
 {
 }
 
@@ -681,13 +861,16 @@ concept static_matrix_type = requires { matrix_dummy(std::declval<T&>()); };
 
 template <typename R, static_matrix_type Matrix>
 [[nodiscard]]
-constexpr auto cast_to(Matrix const& src) noexcept
-    -> static_matrix<R, Matrix::Size_y, Matrix::Size_x>
+constexpr auto cast_to(Matrix const& src) noexcept -> static_matrix<
+    R,
+    Matrix::Size_y,
+    Matrix::Size_x,
+    typename Matrix::storage_type>
 {
     constexpr auto M = Matrix::Size_y;
     constexpr auto N = Matrix::Size_x;
 
-    static_matrix<R, M, N> ret{};
+    static_matrix<R, M, N, typename Matrix::storage_type> ret{};
     for (size_t j = 0; j != M; ++j)
     {
         for (size_t i = 0; i != N; ++i)
@@ -698,21 +881,288 @@ constexpr auto cast_to(Matrix const& src) noexcept
     return ret;
 }
 
-template <size_t Out_M, std::size_t Out_N, static_matrix_type Matrix>
+template <
+    size_t             Out_M,
+    std::size_t        Out_N,
+    static_matrix_type Matrix,
+    storage_policy     Out_Storage = typename Matrix::storage_type>
     requires((Matrix::Size_y * Matrix::Size_x) == (Out_M * Out_N))
 [[nodiscard]]
 constexpr auto cast_to_shape(Matrix const& src) noexcept
-    -> static_matrix<typename Matrix::value_type, Out_M, Out_N>
+    -> static_matrix<typename Matrix::value_type, Out_M, Out_N, Out_Storage>
 {
     constexpr auto M = Matrix::Size_y;
     constexpr auto N = Matrix::Size_x;
     using T          = typename Matrix::value_type;
+    using Ret        = static_matrix<T, Out_M, Out_N, Out_Storage>;
 
-    static_matrix<T, Out_M, Out_N> ret{};
-    std::memcpy(ret.m_Elems, src.m_Elems, N * M * sizeof(T));
+    Ret ret{};
+    if constexpr (Matrix::Is_Packed && Ret::Is_Packed)
+    {
+        std::memcpy(ret.m_Elems, src.m_Elems, N * M * sizeof(T));
+    }
+    else
+    {
+        std::copy(src.begin(), src.end(), ret.begin());
+    }
     return ret;
 }
 
+//-----------------------------------------------------------------------------
+//------------ Views ----------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Non-owning M x N window over row major elements, with compile time
+ *        extents and row stride (elements between the starts of consecutive
+ *        rows), like a std::mdspan with static extents. T is const for read
+ *        only views. A view is a pointer: reshaping, slicing rows or columns
+ *        and passing a matrix to the kernels through a view copies nothing.
+ *        The viewed matrix must outlive the view.
+ */
+template <
+    typename T,
+    std::size_t M,
+    std::size_t N,
+    std::size_t Stride = N>
+    requires((N > 0) && (M > 0) && (M == 1 || Stride >= N))
+class static_matrix_view
+{
+public:
+    inline static constexpr auto Size_y     = M;
+    inline static constexpr auto Size_x     = N;
+    inline static constexpr auto Size       = N * M;
+    inline static constexpr auto Row_Stride = Stride;
+    // Whether the M * N elements are contiguous
+    inline static constexpr bool Is_Packed = M == 1 || Row_Stride == N;
+
+    using element_type = T;
+    using value_type   = std::remove_const_t<T>;
+    using size_type    = std::size_t;
+    using pointer      = T*;
+    using reference    = T&;
+
+private:
+    // A matrix of this shape can be viewed whole when its rows are Row_Stride
+    // apart, any single row matrix can
+    template <storage_policy S>
+    inline static constexpr bool s_Views =
+        M == 1 || static_matrix<value_type, M, N, S>::Row_Stride == Row_Stride;
+
+    pointer m_Data;
+
+public:
+    constexpr explicit static_matrix_view(pointer data) noexcept :
+        m_Data{ data }
+    {
+    }
+
+    template <storage_policy S>
+        requires s_Views<S>
+    constexpr static_matrix_view(static_matrix<value_type, M, N, S>& mat
+    ) noexcept :
+        m_Data{ mat.m_Elems }
+    {
+    }
+
+    template <storage_policy S>
+        requires(std::is_const_v<T> && s_Views<S>)
+    constexpr static_matrix_view(static_matrix<value_type, M, N, S> const& mat
+    ) noexcept :
+        m_Data{ mat.m_Elems }
+    {
+    }
+
+    // Read only view of a mutable one
+    template <typename U>
+        requires(std::is_const_v<T> && std::same_as<U, value_type>)
+    constexpr static_matrix_view(static_matrix_view<U, M, N, Stride> other
+    ) noexcept :
+        m_Data{ other.data() }
+    {
+    }
+
+    [[nodiscard]]
+    constexpr pointer data() const noexcept
+    {
+        return m_Data;
+    }
+
+    [[nodiscard]]
+    constexpr size_type size() const noexcept
+    {
+        return M * N;
+    }
+
+    [[nodiscard]]
+    inline constexpr reference
+    operator[](const std::size_t j, const std::size_t i) const noexcept
+    {
+        assert(j < M and i < N);
+        return m_Data[j * Row_Stride + i];
+    }
+
+    /**
+     * \brief Row J as a 1 x N view
+     */
+    template <std::size_t J>
+        requires(J < M)
+    [[nodiscard]]
+    constexpr auto row() const noexcept -> static_matrix_view<T, 1, N>
+    {
+        return static_matrix_view<T, 1, N>{ m_Data + J * Row_Stride };
+    }
+
+    /**
+     * \brief Column I as an M x 1 view, whose rows are Row_Stride apart
+     */
+    template <std::size_t I>
+        requires(I < N)
+    [[nodiscard]]
+    constexpr auto column() const noexcept
+        -> static_matrix_view<T, M, 1, M == 1 ? 1 : Row_Stride>
+    {
+        return static_matrix_view<T, M, 1, M == 1 ? 1 : Row_Stride>{ m_Data +
+                                                                     I };
+    }
+
+    /**
+     * \brief Copies the elements of a matrix or view of the same shape into
+     *        the viewed elements
+     */
+    template <typename Matrix>
+        requires(
+            !std::is_const_v<T> && Matrix::Size_y == M && Matrix::Size_x == N
+        )
+    constexpr void assign(Matrix const& src) const noexcept
+    {
+        for (size_t j = 0; j != M; ++j)
+        {
+            for (size_t i = 0; i != N; ++i)
+            {
+                (*this)[j, i] = static_cast<value_type>(src[j, i]);
+            }
+        }
+    }
+};
+
+/**
+ * \brief mat as a whole, with its own row stride
+ */
+template <static_matrix_type Matrix>
+[[nodiscard]]
+constexpr auto make_view(Matrix& mat) noexcept -> static_matrix_view<
+    typename Matrix::value_type,
+    Matrix::Size_y,
+    Matrix::Size_x,
+    Matrix::Row_Stride>
+{
+    return static_matrix_view<
+        typename Matrix::value_type,
+        Matrix::Size_y,
+        Matrix::Size_x,
+        Matrix::Row_Stride>{ mat.m_Elems };
+}
+
+template <static_matrix_type Matrix>
+[[nodiscard]]
+constexpr auto make_view(Matrix const& mat) noexcept -> static_matrix_view<
+    const typename Matrix::value_type,
+    Matrix::Size_y,
+    Matrix::Size_x,
+    Matrix::Row_Stride>
+{
+    return static_matrix_view<
+        const typename Matrix::value_type,
+        Matrix::Size_y,
+        Matrix::Size_x,
+        Matrix::Row_Stride>{ mat.m_Elems };
+}
+
+/**
+ * \brief Zero copy cast_to_shape: the elements of a matrix without padding,
+ *        seen as an Out_M x Out_N matrix
+ */
+template <std::size_t Out_M, std::size_t Out_N, static_matrix_type Matrix>
+    requires(
+        Matrix::Is_Packed &&
+        (Matrix::Size_y * Matrix::Size_x) == (Out_M * Out_N)
+    )
+[[nodiscard]]
+constexpr auto reshape_view(Matrix& mat) noexcept
+    -> static_matrix_view<typename Matrix::value_type, Out_M, Out_N>
+{
+    return static_matrix_view<typename Matrix::value_type, Out_M, Out_N>{
+        mat.m_Elems
+    };
+}
+
+template <std::size_t Out_M, std::size_t Out_N, static_matrix_type Matrix>
+    requires(
+        Matrix::Is_Packed &&
+        (Matrix::Size_y * Matrix::Size_x) == (Out_M * Out_N)
+    )
+[[nodiscard]]
+constexpr auto reshape_view(Matrix const& mat) noexcept
+    -> static_matrix_view<const typename Matrix::value_type, Out_M, Out_N>
+{
+    return static_matrix_view<const typename Matrix::value_type, Out_M, Out_N>{
+        mat.m_Elems
+    };
+}
+
+template <
+    std::size_t Out_M,
+    std::size_t Out_N,
+    typename T,
+    std::size_t M,
+    std::size_t N,
+    std::size_t Stride>
+    requires(
+        static_matrix_view<T, M, N, Stride>::Is_Packed &&
+        (M * N) == (Out_M * Out_N)
+    )
+[[nodiscard]]
+constexpr auto reshape_view(static_matrix_view<T, M, N, Stride> view) noexcept
+    -> static_matrix_view<T, Out_M, Out_N>
+{
+    return static_matrix_view<T, Out_M, Out_N>{ view.data() };
+}
+
+/**
+ * \brief Row J of mat, see static_matrix_view::row
+ */
+template <std::size_t J, static_matrix_type Matrix>
+[[nodiscard]]
+constexpr auto row_view(Matrix& mat) noexcept
+{
+    return make_view(mat).template row<J>();
+}
+
+template <std::size_t J, static_matrix_type Matrix>
+[[nodiscard]]
+constexpr auto row_view(Matrix const& mat) noexcept
+{
+    return make_view(mat).template row<J>();
+}
+
+/**
+ * \brief Column I of mat, see static_matrix_view::column
+ */
+template <std::size_t I, static_matrix_type Matrix>
+[[nodiscard]]
+constexpr auto column_view(Matrix& mat) noexcept
+{
+    return make_view(mat).template column<I>();
+}
+
+template <std::size_t I, static_matrix_type Matrix>
+[[nodiscard]]
+constexpr auto column_view(Matrix const& mat) noexcept
+{
+    return make_view(mat).template column<I>();
+}
+
 template <static_matrix_type Matrix>
 std::ostream& operator<<(std::ostream& os, Matrix const& mat)
 {
@@ -783,9 +1233,9 @@ template <static_matrix_type Matrix>
 [[nodiscard]]
 constexpr bool exactly_equals(Matrix const& mat1, Matrix const& mat2) noexcept
 {
-    for (size_t j = 0; j != Matrix::M; ++j)
+    for (size_t j = 0; j != Matrix::Size_y; ++j)
     {
-        for (size_t i = 0; i != Matrix::N; ++i)
+        for (size_t i = 0; i != Matrix::Size_x; ++i)
         {
             if (mat1[j, i] != mat2[j, i])
                 return false;
@@ -852,28 +1302,129 @@ void to_target_x_crossover(
 //------------ Maths utility --------------------------------------------------
 //-----------------------------------------------------------------------------
 
-template <typename T, std::size_t M, std::size_t K, std::size_t N>
+/**
+ * \brief Reference matrix multiplication. Used in constant evaluation and for
+ * shapes too small for the blocked engine to pay off.
+ * \note The inner loop runs over whole (padded) rows of mat2 and the result:
+ * with aligned_storage it has no remainder and starts on aligned addresses,
+ * and the padding of the result stays 0.
+ */
+template <
+    typename T,
+    std::size_t    M,
+    std::size_t    K,
+    std::size_t    N,
+    storage_policy S>
 [[nodiscard]]
-constexpr static_matrix<T, M, N> matrix_mul(
-    static_matrix<T, M, K> const& mat1,
-    static_matrix<T, K, N> const& mat2
+constexpr static_matrix<T, M, N, S> matrix_mul_reference(
+    static_matrix<T, M, K, S> const& mat1,
+    static_matrix<T, K, N, S> const& mat2
 ) noexcept
 {
-    static_matrix<T, M, N> ret{};
+    // Both are 1 for column vectors, the padded row width otherwise
+    constexpr auto Row_Stride = static_matrix<T, M, N, S>::Row_Stride;
+    static_assert(Row_Stride == static_matrix<T, K, N, S>::Row_Stride);
+
+    static_matrix<T, M, N, S> ret{};
 
     for (size_t j = 0; j != M; ++j)
     {
+        T* const ret_row = ret.m_Elems + j * Row_Stride;
         for (size_t k = 0; k != K; ++k)
         {
-            for (size_t i = 0; i != N; ++i)
+            const T        a       = mat1[j, k];
+            const T* const mat2_row = mat2.m_Elems + k * Row_Stride;
+            for (size_t i = 0; i != Row_Stride; ++i)
             {
-                ret[j, i] += mat1[j, k] * mat2[k, i];
+                ret_row[i] += a * mat2_row[i];
             }
         }
     }
     return ret;
 }
 
+/**
+ * \brief Matrix multiplication. Dispatches at compile time (on the static
+ * shape) to the batched matrix vector kernel when mat2 is a handful of
+ * columns, to the packed, register blocked engine in gemm_kernels.hpp, or to
+ * matrix_mul_reference. The kernels pick their instruction set at run time
+ * (see kernels.hpp).
+ */
+template <
+    typename T,
+    std::size_t    M,
+    std::size_t    K,
+    std::size_t    N,
+    storage_policy S>
+[[nodiscard]]
+constexpr static_matrix<T, M, N, S> matrix_mul(
+    static_matrix<T, M, K, S> const& mat1,
+    static_matrix<T, K, N, S> const& mat2
+) noexcept
+{
+    if constexpr (gemm::use_batched_matvec<T, M, K, N>)
+    {
+        if (!std::is_constant_evaluated())
+        {
+            using Lhs = static_matrix<T, M, K, S>;
+            using Ret = static_matrix<T, M, N, S>;
+
+            // The columns of mat2 as contiguous vectors, laid out like the
+            // rows of mat1. The padding of the buffer is never written.
+            alignas(64) thread_local static T s_Columns[N * Lhs::Row_Stride]{};
+            for (size_t k = 0; k != K; ++k)
+            {
+                for (size_t i = 0; i != N; ++i)
+                {
+                    s_Columns[i * Lhs::Row_Stride + k] = mat2[k, i];
+                }
+            }
+
+            Ret ret;
+            if constexpr (!Ret::Is_Packed)
+            {
+                ret = Ret{};
+            }
+            simd::matvec_batch<
+                T,
+                M,
+                K,
+                N,
+                Lhs::Row_Stride,
+                S::template s_Alignment<T>>(
+                mat1.m_Elems, s_Columns, ret.m_Elems, Ret::Row_Stride, 1
+            );
+            return ret;
+        }
+    }
+    else if constexpr (gemm::use_blocked_gemm<T, M, K, N>)
+    {
+        if (!std::is_constant_evaluated())
+        {
+            using Ret = static_matrix<T, M, N, S>;
+
+            // The engine computes the padding columns too (B is 0 there),
+            // which keeps them 0 in the result
+            constexpr auto N_Padded = Ret::Row_Stride;
+
+            Ret ret;
+            simd::gemm<T, M, K, N_Padded>(
+                mat1.m_Elems,
+                static_matrix<T, M, K, S>::Row_Stride,
+                mat2.m_Elems,
+                N_Padded,
+                ret.m_Elems,
+                N_Padded
+            );
+            std::fill(
+                ret.m_Elems + M * N_Padded, ret.m_Elems + Ret::Storage_Size, T{}
+            );
+            return ret;
+        }
+    }
+    return matrix_mul_reference(mat1, mat2);
+}
+
 // // TODO check impl
 // template <size_t M, std::size_t K, std::size_t N>
 // [[nodiscard]] constexpr static_matrix<float, M, N> matrix_mul_avx(
@@ -925,23 +1476,26 @@ constexpr static_matrix<T, M, N> matrix_mul(
 //     return ret;
 // }
 
-template <typename T, std::size_t M, std::size_t N>
+template <typename T, std::size_t M, std::size_t N, storage_policy S>
 [[nodiscard]]
-constexpr static_matrix<T, M, N> matrix_vec_add(
-    static_matrix<T, M, N> const& mat,
-    static_matrix<T, 1, N> const& vec
+constexpr static_matrix<T, M, N, S> matrix_vec_add(
+    static_matrix<T, M, N, S> const& mat,
+    static_matrix<T, 1, N, S> const& vec
 ) noexcept
 {
     if constexpr (M == 1)
         return mat + vec;
     else
     {
+        // Whole rows, padding included (0 + 0)
+        constexpr auto Row_Stride = static_matrix<T, M, N, S>::Row_Stride;
+
         auto ret{ mat };
-        for (size_t i = 0; i != N; ++i)
+        for (size_t j = 0; j != M; ++j)
         {
-            for (size_t j = 0; j != M; ++j)
+            for (size_t i = 0; i != Row_Stride; ++i)
             {
-                ret[j, i] += vec[0, i];
+                ret.m_Elems[j * Row_Stride + i] += vec.m_Elems[i];
             }
         }
         return ret;
@@ -950,56 +1504,70 @@ constexpr static_matrix<T, M, N> matrix_vec_add(
 
 /**
  * \brief
- *    AVX matrix multiplication
- *    Speed up over regular matrix mul for 40x40 matrices and above
+ *    SIMD matrix vector multiplication, dispatched at run time to the widest
+ *    vector unit of the CPU (SSE2 / SSE4.2 / AVX2 + FMA / AVX-512)
+ *    Eight rows are accumulated at once with FMAs and only reduced
+ *    horizontally at the end, so cache resident matrices run at FMA
+ *    throughput and larger ones at memory bandwidth
  * \tparam M Matrix dimension 1
  * \tparam N Matrix dimension 2
  * \param mat Matrix to multiply
  * \param vec Vector to multiply
  * \return Multiplied matrix
  */
-template <size_t M, std::size_t N>
+template <size_t M, std::size_t N, storage_policy S>
 [[nodiscard]]
-static_matrix<float, M, 1> matrix_vector_mul_float_avx(
-    static_matrix<float, M, N> const& mat,
-    static_matrix<float, N, 1> const& vec
+static_matrix<float, M, 1, S> matrix_vector_mul_float_avx(
+    static_matrix<float, M, N, S> const& mat,
+    static_matrix<float, N, 1, S> const& vec
 )
 {
-    static_matrix<float, M, 1> ret{};
-    if constexpr (N > 7)
+    using Mat = static_matrix<float, M, N, S>;
+    using Ret = static_matrix<float, M, 1, S>;
+
+    // The kernel only writes the M logical elements
+    Ret ret;
+    if constexpr (!Ret::Is_Packed)
     {
-        for (size_t i = 0; i < N - 7; i += 8)
-        {
-            const __m256 v_piece = _mm256_loadu_ps(vec.m_Elems + i);
-            for (size_t j = 0; j != M; ++j)
-            {
-                const __m256 row_piece =
-                    _mm256_loadu_ps(mat.m_Elems + i + j * N);
-                const __m256 m256_dot_piece = _mm256_dp_ps(
-                    v_piece, row_piece, 0xf1
-                ); // compare 0xff with 0xf1
-
-                const auto float8_dot_piece =
-                    std::bit_cast<std::array<float, 8>>(m256_dot_piece);
-                ret[j, 0] += float8_dot_piece[0] +
-                    float8_dot_piece[4]; // Now without UB! std::bit_cast
-                                         // edition
-            }
-        }
+        ret = Ret{};
     }
-    // last iterations (lower 3 bits of N)
-    if constexpr (N % 8 != 0)
+    simd::matvec<float, M, N, Mat::Row_Stride, S::template s_Alignment<float>>(
+        mat.m_Elems, vec.m_Elems, ret.m_Elems
+    );
+    return ret;
+}
+
+/**
+ * \brief Multiplies mat by every row of vecs, a batch of up to 8 vectors
+ *        stored one per row (the layout of batched layer inputs):
+ *        ret[b, j] = mat row j . vecs row b.
+ *        Same kernel as matrix_vector_mul_float_avx, each row of mat is
+ *        loaded once for the whole batch.
+ */
+template <
+    typename T,
+    std::size_t    M,
+    std::size_t    N,
+    std::size_t    B,
+    storage_policy S>
+    requires(gemm::gemm_value_type<T> && B <= 8)
+[[nodiscard]]
+static_matrix<T, B, M, S> matrix_vector_mul_batch(
+    static_matrix<T, M, N, S> const& mat,
+    static_matrix<T, B, N, S> const& vecs
+)
+{
+    using Mat = static_matrix<T, M, N, S>;
+    using Ret = static_matrix<T, B, M, S>;
+
+    Ret ret;
+    if constexpr (!Ret::Is_Packed)
     {
-        constexpr std::size_t iterations_completed =
-            (N & (~static_cast<size_t>(7)));
-        for (size_t ii = iterations_completed; ii != N; ++ii)
-        {
-            for (size_t j = 0; j != M; ++j)
-            {
-                ret[j, 0] += mat[j, ii] * vec[ii, 0];
-            }
-        }
+        ret = Ret{};
     }
+    simd::matvec_batch<T, M, N, B, Mat::Row_Stride, S::template s_Alignment<T>>(
+        mat.m_Elems, vecs.m_Elems, ret.m_Elems, 1, Ret::Row_Stride
+    );
     return ret;
 }
 
@@ -1046,23 +1614,293 @@ constexpr static_matrix<T, 1, M> multiple_dot_product(
     return ret;
 }
 
-template <typename T, std::size_t M, std::size_t N, std::size_t P, typename Fn>
-    requires std::is_invocable_r_v<T, Fn, T>
+/**
+ * \brief Fused dense layer: c = activation_func(a * mat_mul_b + bias), with
+ * the row vector bias added to every row and activation_func applied
+ * element-wise. a and c are views, so rows of bigger matrices and reshaped
+ * matrices go through without copies, and only the M x N elements of c are
+ * written. Dispatches like matrix_mul, to the fully unrolled kernel for tiny
+ * shapes, to the blocked engine or to the fused dense kernel (see
+ * tier_kernels.hpp), which all add the bias and apply activation_func to the
+ * accumulators before storing them, so the product is never written to memory
+ * on its own.
+ * mat_mul_b and bias may be stored in bf16 or fp16 (W) for a float T: the
+ * kernels widen them in registers and accumulate in float.
+ */
+template <
+    typename T,
+    std::size_t    M,
+    std::size_t    K,
+    std::size_t    N,
+    std::size_t    Lda,
+    std::size_t    Ldc,
+    storage_policy S,
+    typename W,
+    typename Fn>
+    requires(
+        std::is_invocable_r_v<T, Fn, T> &&
+        (std::same_as<W, T> ||
+         (reduced_floating_point<W> && std::same_as<T, float>))
+    )
+constexpr void multiply_add_activate(
+    static_matrix_view<const T, M, K, Lda> a,
+    static_matrix<W, K, N, S> const&       mat_mul_b,
+    static_matrix<W, 1, N, S> const&       bias,
+    Fn const&                              activation_func,
+    static_matrix_view<T, M, N, Ldc>       c
+)
+{
+    constexpr auto Ldb = static_matrix<W, K, N, S>::Row_Stride;
+
+    // Rows narrower than an SSE register are left to the reference loops
+    // unless the unrolled kernel takes them, the others would not vectorize
+    // them either. A single packed column of weights is also a single row:
+    // the output-major kernel reads it as is, one dot product per row of a.
+    if constexpr (
+        N == 1 && Ldb == 1 && !gemm::use_unrolled_dense<T, M, K, N> &&
+        gemm::gemm_value_type<T> && K * sizeof(T) >= 16
+    )
+    {
+        if (!std::is_constant_evaluated())
+        {
+            simd::dense_transposed<T, M, K, N, Lda, K, Ldc>(
+                a.data(),
+                mat_mul_b.m_Elems,
+                bias.m_Elems,
+                c.data(),
+                activation_func
+            );
+            return;
+        }
+    }
+    else if constexpr (
+        gemm::use_unrolled_dense<T, M, K, N> ||
+        (gemm::gemm_value_type<T> && N * sizeof(T) >= 16)
+    )
+    {
+        if (!std::is_constant_evaluated())
+        {
+            if constexpr (gemm::use_unrolled_dense<T, M, K, N>)
+            {
+                simd::dense_unrolled<T, M, K, N, Lda, Ldb, Ldc>(
+                    a.data(),
+                    mat_mul_b.m_Elems,
+                    bias.m_Elems,
+                    c.data(),
+                    activation_func
+                );
+            }
+            else if constexpr (gemm::use_blocked_dense<T, M, K, N>)
+            {
+                simd::gemm<T, M, K, N>(
+                    a.data(),
+                    Lda,
+                    mat_mul_b.m_Elems,
+                    Ldb,
+                    c.data(),
+                    Ldc,
+                    bias.m_Elems,
+                    activation_func
+                );
+            }
+            else
+            {
+                simd::dense<T, M, K, N>(
+                    a.data(),
+                    Lda,
+                    mat_mul_b.m_Elems,
+                    Ldb,
+                    bias.m_Elems,
+                    c.data(),
+                    Ldc,
+                    activation_func
+                );
+            }
+            return;
+        }
+    }
+
+    for (size_t j = 0; j != M; ++j)
+    {
+        for (size_t i = 0; i != N; ++i)
+        {
+            T acc{};
+            for (size_t k = 0; k != K; ++k)
+            {
+                acc += a[j, k] * static_cast<T>(mat_mul_b[k, i]);
+            }
+            acc += static_cast<T>(bias[0, i]);
+            c[j, i] = std::invoke(activation_func, acc);
+        }
+    }
+}
+
+/**
+ * \brief activation_func(mat_mul_a * mat_mul_b + bias) as a new matrix, see
+ *        the overload on views
+ */
+template <
+    typename T,
+    std::size_t    M,
+    std::size_t    K,
+    std::size_t    N,
+    storage_policy S,
+    typename W,
+    typename Fn>
+    requires(
+        std::is_invocable_r_v<T, Fn, T> &&
+        (std::same_as<W, T> ||
+         (reduced_floating_point<W> && std::same_as<T, float>))
+    )
 [[nodiscard]]
-constexpr static_matrix<T, M, 1> multiply_add_activate(
-    const static_matrix<T, M, N>& mat_mul_a,
-    const static_matrix<T, N, P>& mat_mul_b,
-    const static_matrix<T, M, P>& mat_add,
-    Fn&&                          activation_func
+constexpr static_matrix<T, M, N, S> multiply_add_activate(
+    static_matrix<T, M, K, S> const& mat_mul_a,
+    static_matrix<W, K, N, S> const& mat_mul_b,
+    static_matrix<W, 1, N, S> const& bias,
+    Fn const&                        activation_func
 )
 {
-    auto mul = matrix_mul(mat_mul_a, mat_mul_b);
-    assert(mul.size() == mat_add.size());
-    for (auto it = mat_add.begin(); auto& e : mul)
+    using Ret = static_matrix<T, M, N, S>;
+
+    // Only the N logical columns are written, the padding stays 0
+    Ret ret;
+    if constexpr (!Ret::Is_Packed)
     {
-        e = std::invoke(activation_func, (e + *(it++)));
+        ret = Ret{};
+    }
+    multiply_add_activate(
+        make_view(mat_mul_a),
+        mat_mul_b,
+        bias,
+        activation_func,
+        make_view(ret)
+    );
+    return ret;
+}
+
+/**
+ * \brief Fused dense layer on weights stored transposed (output-major),
+ * c = activation_func(a * transpose(mat_mul_b_t) + bias). Every output is the
+ * dot product of a row of a with a contiguous row of mat_mul_b_t, which is
+ * the access pattern of batch 1 inference. Otherwise as
+ * multiply_add_activate.
+ */
+template <
+    typename T,
+    std::size_t    M,
+    std::size_t    K,
+    std::size_t    N,
+    std::size_t    Lda,
+    std::size_t    Ldc,
+    storage_policy S,
+    typename W,
+    typename Fn>
+    requires(
+        std::is_invocable_r_v<T, Fn, T> &&
+        (std::same_as<W, T> ||
+         (reduced_floating_point<W> && std::same_as<T, float>))
+    )
+constexpr void multiply_transposed_add_activate(
+    static_matrix_view<const T, M, K, Lda> a,
+    static_matrix<W, N, K, S> const&       mat_mul_b_t,
+    static_matrix<W, 1, N, S> const&       bias,
+    Fn const&                              activation_func,
+    static_matrix_view<T, M, N, Ldc>       c
+)
+{
+    constexpr auto Ldb = static_matrix<W, N, K, S>::Row_Stride;
+
+    // A single packed column of weights is also a single row: the unrolled
+    // input-major kernel reads it as is. Other rows of a narrower than an SSE
+    // register are left to the reference loops.
+    if constexpr (
+        K == 1 && Ldb == 1 && gemm::use_unrolled_dense<T, M, K, N>
+    )
+    {
+        if (!std::is_constant_evaluated())
+        {
+            simd::dense_unrolled<T, M, K, N, Lda, N, Ldc>(
+                a.data(),
+                mat_mul_b_t.m_Elems,
+                bias.m_Elems,
+                c.data(),
+                activation_func
+            );
+            return;
+        }
+    }
+    else if constexpr (gemm::gemm_value_type<T> && K * sizeof(T) >= 16)
+    {
+        if (!std::is_constant_evaluated())
+        {
+            simd::dense_transposed<T, M, K, N, Lda, Ldb, Ldc>(
+                a.data(),
+                mat_mul_b_t.m_Elems,
+                bias.m_Elems,
+                c.data(),
+                activation_func
+            );
+            return;
+        }
+    }
+
+    for (size_t j = 0; j != M; ++j)
+    {
+        for (size_t i = 0; i != N; ++i)
+        {
+            T acc{};
+            for (size_t k = 0; k != K; ++k)
+            {
+                acc += a[j, k] * static_cast<T>(mat_mul_b_t[i, k]);
+            }
+            acc += static_cast<T>(bias[0, i]);
+            c[j, i] = std::invoke(activation_func, acc);
+        }
+    }
+}
+
+/**
+ * \brief c += transpose(a) * b, e.g. the gradient of a dense layer with
+ *        respect to its weights, summed over the samples of a batch: a holds
+ *        the inputs and b the gradients of the outputs of the samples, one
+ *        per row, and c the input-major weights. Vectorized along the rows
+ *        of c (see transposed_multiply_add in tier_kernels.hpp).
+ */
+template <
+    typename T,
+    std::size_t M,
+    std::size_t K,
+    std::size_t N,
+    std::size_t Lda,
+    std::size_t Ldb,
+    std::size_t Ldc>
+constexpr void transposed_multiply_add(
+    static_matrix_view<const T, M, K, Lda> a,
+    static_matrix_view<const T, M, N, Ldb> b,
+    static_matrix_view<T, K, N, Ldc>       c
+)
+{
+    if constexpr (gemm::gemm_value_type<T>)
+    {
+        if (!std::is_constant_evaluated())
+        {
+            simd::transposed_multiply_add<T, M, K, N, Lda, Ldb, Ldc>(
+                a.data(), b.data(), c.data()
+            );
+            return;
+        }
+    }
+
+    for (size_t j = 0; j != M; ++j)
+    {
+        for (size_t k = 0; k != K; ++k)
+        {
+            for (size_t i = 0; i != N; ++i)
+            {
+                c[k, i] += a[j, k] * b[j, i];
+            }
+        }
     }
-    return mul;
 }
 
 //-----------------------------------------------------------------------------
@@ -1106,7 +1944,7 @@ constexpr std::tuple<
 
     // Initialize the pointer vector.
     std::array<size_t, N> r_idx{}; // row index
-    std::iota(r_idx.begin(), r_idx.end());
+    std::iota(r_idx.begin(), r_idx.end(), 0);
 
     // LU factorization.
     for (size_t p = 0; p != N - 1; ++p)
@@ -1123,7 +1961,7 @@ constexpr std::tuple<
             }
         }
 
-        if (out(r_idx[p], p) == 0)
+        if (out[r_idx[p], p] == 0)
         {
             // The matrix is singular. //or not invertible by this method until
             // fixed (no permutations)
@@ -1233,9 +2071,9 @@ constexpr bool RREF(static_matrix<T, M, N>& scr)
             {
                 for (size_t i = p + 1; i < N; ++i)
                 { // p+1 to avoid removing each rows' scale factor
-                    scr(r_idx[j], i) -= scr(r_idx[p], i) * scr(r_idx[j], p);
+                    scr[r_idx[j], i] -= scr[r_idx[p], i] * scr[r_idx[j], p];
                 }
-                scr(r_idx[j], p) = 0;
+                scr[r_idx[j], p] = 0;
             }
         }
     }
@@ -1339,29 +2177,18 @@ constexpr static_matrix<T, N, N> identity_matrix()
 //     return ret;
 // }
 
-template <typename T, std::size_t M, std::size_t N>
+template <typename T, std::size_t M, std::size_t N, storage_policy S>
 [[nodiscard]]
-constexpr static_matrix<T, N, M> transpose(static_matrix<T, M, N> const& scr)
+constexpr static_matrix<T, N, M, S> transpose(
+    static_matrix<T, M, N, S> const& scr
+)
 {
-    static_matrix<T, N, M> ret{};
-    if constexpr (M == N)
-    {
-        for (size_t j = 0; j != N - 1; ++j)
-        {
-            for (size_t i = j + 1; i != N; ++i)
-            {
-                std::swap(ret[j, i], ret[i, j]);
-            }
-        }
-    }
-    else
+    static_matrix<T, N, M, S> ret{};
+    for (size_t j = 0; j != M; ++j)
     {
-        for (size_t j = 0; j != M; ++j)
+        for (size_t i = 0; i != N; ++i)
         {
-            for (size_t i = 0; i != N; ++i)
-            {
-                ret[i, j] = scr[j, i];
-            }
+            ret[i, j] = scr[j, i];
         }
     }
     return ret;
@@ -1400,9 +2227,9 @@ template <static_matrix_type Matrix>
 constexpr Matrix element_wise_mul(Matrix const& mat1, Matrix const& mat2)
 {
     Matrix ret{ mat1 };
-    for (size_t j = 0; j != Matrix::M; ++j)
+    for (size_t j = 0; j != Matrix::Size_y; ++j)
     {
-        for (size_t i = 0; i != Matrix::N; ++i)
+        for (size_t i = 0; i != Matrix::Size_x; ++i)
         {
             ret[j, i] *= mat2[j, i];
         }
@@ -1446,6 +2273,246 @@ constexpr auto matrix_distance(
     return distance;
 }
 
+/*
+Built-in distances, passed by tag instead of a per element Distance callable:
+
+    matrix_distance<float>(mat1, mat2, distance::L2{});
+
+They reduce whole matrices with the vectorised kernels of kernels.hpp
+(accumulating in the matrix value type, over several partial sums). Each tag
+describes its reduction as a few running sums: accumulate adds one pair of
+elements to them and finish turns them into the distance, so the distance of
+several matrices seen as a single vector (e.g. a layer) can be computed by
+adding up their sums before finishing.
+*/
+namespace distance
+{
+
+/**
+ * \brief Sum of |a - b|, as accumulated from generics::algorithms::L1_norm
+ */
+struct L1
+{
+    static constexpr std::size_t s_Sums = 1;
+
+    template <std::floating_point R>
+    static constexpr auto accumulate(std::array<R, s_Sums>& sums, R a, R b)
+        -> void
+    {
+        sums[0] += a < b ? b - a : a - b;
+    }
+
+    template <std::floating_point R>
+    [[nodiscard]]
+    static constexpr auto finish(std::array<R, s_Sums> const& sums) -> R
+    {
+        return sums[0];
+    }
+};
+
+/**
+ * \brief Sum of (a - b)^2, the squared euclidean distance, as accumulated
+ *        from generics::algorithms::L2_norm
+ */
+struct L2
+{
+    static constexpr std::size_t s_Sums = 1;
+
+    template <std::floating_point R>
+    static constexpr auto accumulate(std::array<R, s_Sums>& sums, R a, R b)
+        -> void
+    {
+        sums[0] += (a - b) * (a - b);
+    }
+
+    template <std::floating_point R>
+    [[nodiscard]]
+    static constexpr auto finish(std::array<R, s_Sums> const& sums) -> R
+    {
+        return sums[0];
+    }
+};
+
+/**
+ * \brief 1 - cos(angle between a and b), with a and b seen as vectors. In
+ *        [0, 2]; a 0 vector is at distance 1 from any other one, 0 from
+ *        itself.
+ */
+struct cosine
+{
+    // a . b, a . a, b . b
+    static constexpr std::size_t s_Sums = 3;
+
+    template <std::floating_point R>
+    static constexpr auto accumulate(std::array<R, s_Sums>& sums, R a, R b)
+        -> void
+    {
+        sums[0] += a * b;
+        sums[1] += a * a;
+        sums[2] += b * b;
+    }
+
+    template <std::floating_point R>
+    [[nodiscard]]
+    static constexpr auto finish(std::array<R, s_Sums> const& sums) -> R
+    {
+        if (sums[1] == R{} || sums[2] == R{})
+        {
+            return sums[1] == sums[2] ? R{} : R(1);
+        }
+        return R(1) - sums[0] / std::sqrt(sums[1] * sums[2]);
+    }
+};
+
+} // namespace distance
+
+template <typename D>
+concept distance_tag = std::same_as<D, distance::L1> ||
+    std::same_as<D, distance::L2> || std::same_as<D, distance::cosine>;
+
+/**
+ * \brief Running sums of the built-in distance Distance over Size elements
+ *        of a and b, with the vectorised kernels. bf16 and fp16 elements are
+ *        widened to float by the kernels.
+ */
+template <
+    std::floating_point R,
+    typename T,
+    std::size_t  Size,
+    distance_tag Distance>
+    requires gemm::gemm_value_type<compute_t<T>>
+[[nodiscard]]
+auto kernel_distance_sums(const T* a, const T* b, Distance)
+    -> std::array<R, Distance::s_Sums>
+{
+    using C = compute_t<T>;
+
+    std::array<R, Distance::s_Sums> sums{};
+    if constexpr (std::same_as<Distance, distance::L1>)
+    {
+        sums[0] = static_cast<R>(simd::reduce_abs_diff<C, Size>(a, b));
+    }
+    else if constexpr (std::same_as<Distance, distance::L2>)
+    {
+        sums[0] = static_cast<R>(simd::reduce_squared_diff<C, Size>(a, b));
+    }
+    else
+    {
+        C partial[3];
+        simd::reduce_dot_norms<C, Size>(a, b, partial);
+        for (std::size_t s = 0; s != 3; ++s)
+        {
+            sums[s] = static_cast<R>(partial[s]);
+        }
+    }
+    return sums;
+}
+
+/**
+ * \brief Running sums of the built-in distance Distance between mat1 and mat2
+ *        (see namespace distance). The padding of aligned storage is 0 in
+ *        both matrices, so it is reduced along with the elements.
+ */
+template <
+    std::floating_point R,
+    static_matrix_type  Matrix,
+    distance_tag        Distance>
+[[nodiscard]]
+constexpr auto matrix_distance_sums(
+    Matrix const& mat1,
+    Matrix const& mat2,
+    Distance      dist_tag
+) -> std::array<R, Distance::s_Sums>
+{
+    using T = typename Matrix::value_type;
+    using C = compute_t<T>;
+
+    // Below a cache line, the dispatch costs more than the scalar loop
+    if constexpr (
+        gemm::gemm_value_type<C> && Matrix::Storage_Size * sizeof(T) >= 64
+    )
+    {
+        if (!std::is_constant_evaluated())
+        {
+            return kernel_distance_sums<R, T, Matrix::Storage_Size>(
+                mat1.m_Elems, mat2.m_Elems, dist_tag
+            );
+        }
+    }
+
+    std::array<R, Distance::s_Sums> sums{};
+    for (size_t j = 0; j != Matrix::Size_y; ++j)
+    {
+        for (size_t i = 0; i != Matrix::Size_x; ++i)
+        {
+            Distance::accumulate(
+                sums, static_cast<R>(mat1[j, i]), static_cast<R>(mat2[j, i])
+            );
+        }
+    }
+    return sums;
+}
+
+/// @brief Built-in distance between mat1 and mat2, reduced over the whole
+/// matrices with the vectorised kernels (see namespace distance). The
+/// callable overload above stays the generic fallback.
+/// @tparam R A floating point type
+/// @tparam Matrix A static matrix type
+/// @tparam Distance distance::L1, distance::L2 or distance::cosine
+template <
+    std::floating_point R,
+    static_matrix_type  Matrix,
+    distance_tag        Distance>
+[[nodiscard]]
+constexpr auto matrix_distance(
+    Matrix const& mat1,
+    Matrix const& mat2,
+    Distance      dist_tag
+) -> R
+{
+    return Distance::finish(matrix_distance_sums<R>(mat1, mat2, dist_tag));
+}
+
+/**
+ * \brief Built-in distance between two arrays of Size elements seen as
+ *        vectors, e.g. the predictions of an agent over a dataset and their
+ *        targets. Same kernels as matrix_distance.
+ */
+template <
+    std::floating_point R,
+    typename T,
+    std::size_t  Size,
+    distance_tag Distance>
+    requires(Size != std::dynamic_extent)
+[[nodiscard]]
+constexpr auto span_distance(
+    std::span<T const, Size> a,
+    std::span<T const, Size> b,
+    Distance                 dist_tag
+) -> R
+{
+    if constexpr (
+        gemm::gemm_value_type<compute_t<T>> && Size * sizeof(T) >= 64
+    )
+    {
+        if (!std::is_constant_evaluated())
+        {
+            return Distance::finish(kernel_distance_sums<R, T, Size>(
+                a.data(), b.data(), dist_tag
+            ));
+        }
+    }
+
+    std::array<R, Distance::s_Sums> sums{};
+    for (std::size_t i = 0; i != Size; ++i)
+    {
+        Distance::accumulate(
+            sums, static_cast<R>(a[i]), static_cast<R>(b[i])
+        );
+    }
+    return Distance::finish(sums);
+}
+
 //-----------------------------------------------------------------------------
 //------------ Miscellany related functionality
 //-------------------------------------
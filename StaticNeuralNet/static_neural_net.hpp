@@ -5,13 +5,19 @@
 #include "activation_functions.hpp"
 #include "error_handling.hpp"
 #include "static_matrix.hpp"
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cassert>
 #include <concepts>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <span>
 #include <stdexcept>
 #include <utility>
 
@@ -23,8 +29,18 @@ struct Layer_Signature
     using size_type = unsigned int;
     size_type                                              Size;
     matrix_activation_functions::Identifiers::Identifiers_ Activation;
+    // See matrix_activation_functions::activation_precision
+    matrix_activation_functions::activation_precision Precision =
+        matrix_activation_functions::activation_precision::exact;
 
     constexpr bool operator==(const Layer_Signature&) const = default;
+
+    // The same layer, activation aside
+    [[nodiscard]]
+    constexpr bool same_weights(const Layer_Signature& other) const
+    {
+        return Size == other.Size && Activation == other.Activation;
+    }
 };
 
 struct Layer_Structure
@@ -32,16 +48,57 @@ struct Layer_Structure
     std::size_t                                            Inputs;
     std::size_t                                            Outputs;
     matrix_activation_functions::Identifiers::Identifiers_ Activation;
+    matrix_activation_functions::activation_precision      Precision =
+        matrix_activation_functions::activation_precision::exact;
 
     constexpr bool operator==(const Layer_Structure&) const = default;
+
+    // The same layer, activation aside
+    [[nodiscard]]
+    constexpr bool same_weights(const Layer_Structure& other) const
+    {
+        return Inputs == other.Inputs && Outputs == other.Outputs &&
+               Activation == other.Activation;
+    }
+};
+
+/**
+ * \brief Order the weights of a layer are stored in. input_major is the
+ *        Inputs x Outputs matrix the inputs are multiplied by, output_major
+ *        its transpose: the weights of each neuron are contiguous and every
+ *        output is one dot product with the input row (see
+ *        ga_sm::multiply_transposed_add_activate), meant for batch 1
+ *        inference such as minimax leaf evaluation. It pays off most for
+ *        layers narrower than a vector register (e.g. 42 x 9 or 64 x 1),
+ *        small wide layers stay faster input_major. The weights mean the same
+ *        in both, layer::weight reads them in either.
+ */
+enum class weight_layout
+{
+    input_major,
+    output_major
 };
 
 //--------------------------------------------------------------------------------------//
 
+/**
+ * \brief Fully connected layer.
+ * \tparam T Type the weights and bias are stored in. With ga_sm::bf16 or
+ *         ga_sm::fp16 they take half the memory, inputs, outputs and
+ *         activation parameters are float (value_type) and forward_pass
+ *         accumulates in float.
+ * \tparam Storage Storage policy of the weights, bias and activations (see
+ *         static_matrix.hpp). ga_sm::aligned_storage pads every row to the
+ *         vector width so forward_pass runs without remainder loops.
+ * \tparam Layout Whether the weights are stored Inputs x Outputs or
+ *         transposed, see weight_layout.
+ */
 template <
-    std::floating_point T,
-    std::size_t         Batch_Size,
-    Layer_Structure     Structure>
+    ga_sm::floating_point_storage T,
+    std::size_t                   Batch_Size,
+    Layer_Structure               Structure,
+    ga_sm::storage_policy         Storage = ga_sm::packed_storage,
+    weight_layout                 Layout  = weight_layout::input_major>
     requires(Batch_Size > 0)
 class layer
 {
@@ -49,13 +106,22 @@ public:
     static constexpr std::size_t s_Inputs     = Structure.Inputs;
     static constexpr std::size_t s_Outputs    = Structure.Outputs;
     static constexpr auto        s_Activation = Structure.Activation;
-
-    using weights_shape       = ga_sm::static_matrix<T, s_Inputs, s_Outputs>;
-    using output_vector_shape = ga_sm::static_matrix<T, Batch_Size, s_Outputs>;
-    using input_vector_shape  = ga_sm::static_matrix<T, Batch_Size, s_Inputs>;
-    using bias_vector_shape   = ga_sm::static_matrix<T, 1, s_Outputs>;
+    static constexpr auto        s_Precision  = Structure.Precision;
+    static constexpr auto        s_Layout     = Layout;
+
+    using value_type = ga_sm::compute_t<T>;
+
+    using weights_shape = std::conditional_t<
+        Layout == weight_layout::input_major,
+        ga_sm::static_matrix<T, s_Inputs, s_Outputs, Storage>,
+        ga_sm::static_matrix<T, s_Outputs, s_Inputs, Storage>>;
+    using output_vector_shape =
+        ga_sm::static_matrix<value_type, Batch_Size, s_Outputs, Storage>;
+    using input_vector_shape =
+        ga_sm::static_matrix<value_type, Batch_Size, s_Inputs, Storage>;
+    using bias_vector_shape = ga_sm::static_matrix<T, 1, s_Outputs, Storage>;
     using activation_function = matrix_activation_functions::
-        activation_function<output_vector_shape, Structure.Activation>;
+        activation_function<output_vector_shape, s_Activation, s_Precision>;
 
 private:
     weights_shape       m_weights_mat;
@@ -63,20 +129,274 @@ private:
     activation_function m_activation_function;
 
 public:
+    using input_view_type = ga_sm::static_matrix_view<
+        const value_type,
+        Batch_Size,
+        s_Inputs,
+        input_vector_shape::Row_Stride>;
+    using output_view_type = ga_sm::static_matrix_view<
+        value_type,
+        Batch_Size,
+        s_Outputs,
+        output_vector_shape::Row_Stride>;
+
     // each neuron produces a column vector that splits into the input of the
     // neurons in the next layer
     [[nodiscard]]
     constexpr output_vector_shape forward_pass(input_vector_shape const& Input
     ) const
     {
-        auto out =
-            matrix_vec_add(matrix_mul(Input, m_weights_mat), m_bias_vector);
-        // std::cout << out << std::endl;
-        m_activation_function(out);
-        // std::cout << out << std::endl;
+        // Only the logical columns are written, the padding stays 0
+        output_vector_shape out;
+        if constexpr (!output_vector_shape::Is_Packed)
+        {
+            out = output_vector_shape{};
+        }
+
+        if constexpr (activation_function::is_element_wise)
+        {
+            forward_pass(ga_sm::make_view(Input), ga_sm::make_view(out));
+        }
+        else
+        {
+            dense(
+                ga_sm::make_view(Input),
+                ga_sm::make_view(out),
+                [](value_type x) { return x; }
+            );
+            m_activation_function(out);
+        }
         return out;
     }
 
+    /**
+     * \brief forward_pass from and into views, e.g. rows of bigger matrices
+     *        or reshaped ones, without copying them. The weights do not depend
+     *        on the batch size, so views of any number of Rows go through.
+     */
+    template <std::size_t Rows, std::size_t In_Stride, std::size_t Out_Stride>
+    constexpr void forward_pass(
+        ga_sm::static_matrix_view<const value_type, Rows, s_Inputs, In_Stride>
+            input,
+        ga_sm::static_matrix_view<value_type, Rows, s_Outputs, Out_Stride>
+            output
+    ) const
+    {
+        // Bias and element-wise activations are applied by the matrix
+        // product kernel itself, while the results are still in registers.
+        // Tiny Structures get a fully unrolled kernel, see
+        // ga_sm::gemm::use_unrolled_dense
+        if constexpr (activation_function::is_element_wise)
+        {
+            dense(input, output, m_activation_function.element_function());
+        }
+        else
+        {
+            // The activation function works on whole matrices
+            using rows_shape =
+                ga_sm::static_matrix<value_type, Rows, s_Outputs, Storage>;
+            const matrix_activation_functions::
+                activation_function<rows_shape, s_Activation, s_Precision>
+                    rows_activation_function{ m_activation_function.params };
+
+            rows_shape out{};
+            dense(input, ga_sm::make_view(out), [](value_type x) { return x; });
+            rows_activation_function(out);
+            output.assign(out);
+        }
+    }
+
+    // Values of the gradient of this layer, see backward_pass
+    static constexpr std::size_t s_Gradient_Size = s_Outputs * (s_Inputs + 1);
+
+    /**
+     * \brief forward_pass that also keeps the pre-activations,
+     *        input * weights + bias, for backward_pass
+     */
+    template <std::size_t Rows, std::size_t In_Stride>
+    constexpr void forward_pass(
+        ga_sm::static_matrix_view<const value_type, Rows, s_Inputs, In_Stride>
+                                                                   input,
+        ga_sm::static_matrix_view<value_type, Rows, s_Outputs> pre_activations,
+        ga_sm::static_matrix_view<value_type, Rows, s_Outputs> output
+    ) const
+    {
+        dense(input, pre_activations, [](value_type x) { return x; });
+        if constexpr (activation_function::is_element_wise)
+        {
+            const auto fn = m_activation_function.element_function();
+            for (std::size_t j = 0; j != Rows; ++j)
+            {
+                for (std::size_t i = 0; i != s_Outputs; ++i)
+                {
+                    output[j, i] = fn(pre_activations[j, i]);
+                }
+            }
+        }
+        else
+        {
+            using rows_shape =
+                ga_sm::static_matrix<value_type, Rows, s_Outputs, Storage>;
+            const matrix_activation_functions::
+                activation_function<rows_shape, s_Activation, s_Precision>
+                    rows_activation_function{ m_activation_function.params };
+
+            rows_shape out;
+            std::copy_n(pre_activations.data(), Rows * s_Outputs, out.begin());
+            rows_activation_function(out);
+            output.assign(out);
+        }
+    }
+
+    /**
+     * \brief Reverse of the forward_pass above, over the same input and
+     *        the pre_activations and output it kept. gradient holds the
+     *        gradient of the loss with respect to output and is left with
+     *        the one with respect to the pre-activations. The gradient with
+     *        respect to the weights (in their layout) and then the bias,
+     *        s_Gradient_Size values, is added to gradients, and the one with
+     *        respect to input written to input_gradient, Rows x s_Inputs
+     *        values, unless it is null. The activation parameters are left
+     *        to mutation.
+     */
+    template <std::size_t Rows, std::size_t In_Stride>
+    void backward_pass(
+        ga_sm::static_matrix_view<const value_type, Rows, s_Inputs, In_Stride>
+            input,
+        ga_sm::static_matrix_view<const value_type, Rows, s_Outputs>
+            pre_activations,
+        ga_sm::static_matrix_view<const value_type, Rows, s_Outputs> output,
+        ga_sm::static_matrix_view<value_type, Rows, s_Outputs>       gradient,
+        value_type*                                                gradients,
+        value_type* input_gradient
+    ) const
+    {
+        if constexpr (activation_function::is_element_wise)
+        {
+            const auto derivative =
+                m_activation_function.derivative_function();
+            for (std::size_t j = 0; j != Rows; ++j)
+            {
+                for (std::size_t i = 0; i != s_Outputs; ++i)
+                {
+                    gradient[j, i] *= derivative(pre_activations[j, i]);
+                }
+            }
+        }
+        else
+        {
+            using rows_shape =
+                ga_sm::static_matrix<value_type, Rows, s_Outputs, Storage>;
+            const matrix_activation_functions::
+                activation_function<rows_shape, s_Activation, s_Precision>
+                    rows_activation_function{ m_activation_function.params };
+
+            rows_shape out;
+            rows_shape delta;
+            std::copy_n(output.data(), Rows * s_Outputs, out.begin());
+            std::copy_n(gradient.data(), Rows * s_Outputs, delta.begin());
+            rows_activation_function.backward(out, delta);
+            gradient.assign(delta);
+        }
+
+        value_type* const bias_gradients = gradients + s_Inputs * s_Outputs;
+        for (std::size_t j = 0; j != Rows; ++j)
+        {
+            for (std::size_t i = 0; i != s_Outputs; ++i)
+            {
+                bias_gradients[i] += gradient[j, i];
+            }
+        }
+        const ga_sm::static_matrix_view<const value_type, Rows, s_Outputs>
+            delta{ gradient };
+        if constexpr (Layout == weight_layout::input_major)
+        {
+            ga_sm::transposed_multiply_add(
+                input,
+                delta,
+                ga_sm::static_matrix_view<value_type, s_Inputs, s_Outputs>{
+                    gradients }
+            );
+        }
+        else
+        {
+            ga_sm::transposed_multiply_add(
+                delta,
+                input,
+                ga_sm::static_matrix_view<value_type, s_Outputs, s_Inputs>{
+                    gradients }
+            );
+        }
+
+        if (input_gradient)
+        {
+            // gradient * transpose(weights), by the forward kernels of the
+            // other layout and no bias
+            const ga_sm::static_matrix<T, 1, s_Inputs, Storage> no_bias{};
+            const ga_sm::static_matrix_view<value_type, Rows, s_Inputs>
+                     out{ input_gradient };
+            const auto identity = [](value_type x) { return x; };
+            if constexpr (Layout == weight_layout::input_major)
+            {
+                ga_sm::multiply_transposed_add_activate(
+                    delta, m_weights_mat, no_bias, identity, out
+                );
+            }
+            else
+            {
+                ga_sm::multiply_add_activate(
+                    delta, m_weights_mat, no_bias, identity, out
+                );
+            }
+        }
+    }
+
+    /**
+     * \brief Subtracts steps, s_Gradient_Size values laid out as the
+     *        gradients of backward_pass, from the weights and bias
+     */
+    void descend(const value_type* steps)
+        requires(weights_shape::Is_Packed && bias_vector_shape::Is_Packed)
+    {
+        for (auto& w : m_weights_mat.m_Elems)
+        {
+            w = static_cast<T>(static_cast<value_type>(w) - *steps++);
+        }
+        for (auto& b : m_bias_vector.m_Elems)
+        {
+            b = static_cast<T>(static_cast<value_type>(b) - *steps++);
+        }
+    }
+
+private:
+    template <
+        std::size_t Rows,
+        std::size_t In_Stride,
+        std::size_t Out_Stride,
+        typename Fn>
+    constexpr void dense(
+        ga_sm::static_matrix_view<const value_type, Rows, s_Inputs, In_Stride>
+            input,
+        ga_sm::static_matrix_view<value_type, Rows, s_Outputs, Out_Stride>
+                  output,
+        Fn const& activation_func
+    ) const
+    {
+        if constexpr (Layout == weight_layout::input_major)
+        {
+            ga_sm::multiply_add_activate(
+                input, m_weights_mat, m_bias_vector, activation_func, output
+            );
+        }
+        else
+        {
+            ga_sm::multiply_transposed_add_activate(
+                input, m_weights_mat, m_bias_vector, activation_func, output
+            );
+        }
+    }
+
+public:
     template <typename Fn, typename... Args>
         requires std::is_invocable_r_v<T, Fn, Args...>
     constexpr void init(Fn&& fn, Args&&... args)
@@ -96,20 +416,96 @@ public:
         m_activation_function.mutate_params(std::forward<Fn>(fn));
     }
 
+    // The weights are written Inputs x Outputs in either layout, so stored
+    // nets load into any layout
     void store(std::ofstream& out) const
     {
-        m_weights_mat.store(out);
+        if constexpr (Layout == weight_layout::input_major)
+        {
+            m_weights_mat.store(out);
+        }
+        else
+        {
+            ga_sm::transpose(m_weights_mat).store(out);
+        }
         m_bias_vector.store(out);
         m_activation_function.store(out);
     }
 
     void load(std::ifstream& in)
     {
-        m_weights_mat.load(in);
+        if constexpr (Layout == weight_layout::input_major)
+        {
+            m_weights_mat.load(in);
+        }
+        else
+        {
+            ga_sm::static_matrix<T, s_Inputs, s_Outputs, Storage> weights;
+            weights.load(in);
+            m_weights_mat = ga_sm::transpose(weights);
+        }
         m_bias_vector.load(in);
         m_activation_function.load(in);
     }
 
+    /**
+     * \brief Copies a layer of another weight layout, batch size or
+     *        activation precision
+     */
+    template <
+        std::size_t     Other_Batch_Size,
+        Layer_Structure Other_Structure,
+        weight_layout   Other_Layout>
+        requires(Other_Structure.same_weights(Structure))
+    constexpr void init_from(layer<
+                             T,
+                             Other_Batch_Size,
+                             Other_Structure,
+                             Storage,
+                             Other_Layout> const& other)
+    {
+        if constexpr (Other_Layout == Layout)
+        {
+            m_weights_mat = other.get_weights_mat();
+        }
+        else
+        {
+            m_weights_mat = ga_sm::transpose(other.get_weights_mat());
+        }
+        m_bias_vector                = other.get_bias_vector();
+        m_activation_function.params = other.get_activation_function().params;
+    }
+
+    /**
+     * \brief Weight from input to output, in either layout
+     */
+    [[nodiscard]]
+    inline constexpr const T& weight(std::size_t input, std::size_t output)
+        const
+    {
+        if constexpr (Layout == weight_layout::input_major)
+        {
+            return m_weights_mat[input, output];
+        }
+        else
+        {
+            return m_weights_mat[output, input];
+        }
+    }
+
+    [[nodiscard]]
+    inline constexpr T& weight(std::size_t input, std::size_t output)
+    {
+        if constexpr (Layout == weight_layout::input_major)
+        {
+            return m_weights_mat[input, output];
+        }
+        else
+        {
+            return m_weights_mat[output, input];
+        }
+    }
+
     [[nodiscard]]
     inline constexpr const weights_shape& get_weights_mat() const
     {
@@ -176,8 +572,13 @@ public:
 // Static layer concept
 // -----------------------------------------------
 
-template <typename T, std::size_t Batch_Size, Layer_Structure Structure>
-void layer_dummy(layer<T, Batch_Size, Structure>)
+template <
+    typename T,
+    std::size_t     Batch_Size,
+    Layer_Structure Structure,
+    typename Storage,
+    weight_layout Layout>
+void layer_dummy(layer<T, Batch_Size, Structure, Storage, Layout>)
 {
 }
 
@@ -188,10 +589,44 @@ concept static_layer_type =
 // -----------------------------------------------
 // -----------------------------------------------
 
+/**
+ * \brief Weights of layer stored in Layout: the matrix itself, or a
+ *        transposed copy when the layer uses the other layout
+ */
+template <weight_layout Layout, static_layer_type Layer>
+[[nodiscard]]
+constexpr auto weights_in_layout(Layer const& layer) -> decltype(auto)
+{
+    if constexpr (Layer::s_Layout == Layout)
+    {
+        return layer.get_weights_mat();
+    }
+    else
+    {
+        return ga_sm::transpose(layer.get_weights_mat());
+    }
+}
+
+/**
+ * \brief Layer of a net evaluated Rows inputs at a time, with the weights of
+ *        Layer
+ */
+template <static_layer_type Layer, std::size_t Rows>
+using rebatched_layer = layer<
+    typename Layer::weights_shape::value_type,
+    Rows,
+    Layer_Structure{ Layer::s_Inputs,
+                     Layer::s_Outputs,
+                     Layer::s_Activation,
+                     Layer::s_Precision },
+    ga_sm::packed_storage,
+    Layer::s_Layout>;
+
 template <static_layer_type Layer>
 std::ostream& operator<<(std::ostream& os, const Layer& layer)
 {
-    os << layer.get_weights_mat() << layer.get_bias_vector() << '\n'
+    os << weights_in_layout<weight_layout::input_major>(layer)
+       << layer.get_bias_vector() << '\n'
        << layer.get_activation_function() << '\n';
     return os;
 }
@@ -200,23 +635,55 @@ std::ostream& operator<<(std::ostream& os, const Layer& layer)
 //
 //-------------------------------------------------------------------------------
 
+/**
+ * \brief Room for the hidden activations of Rows samples through a net whose
+ *        widest hidden layer has Width neurons: two ping-pong buffers, every
+ *        layer writing into the one the previous layer did not. Its size is
+ *        known at compile time and it is reused across forward passes, keep
+ *        big ones off the stack (see static_net_executor::thread_workspace).
+ */
+template <typename T, std::size_t Rows, std::size_t Width>
+    requires(Rows > 0 && Width > 0)
+struct forward_workspace
+{
+    alignas(64) std::array<T, Rows * Width> m_Ping;
+    alignas(64) std::array<T, Rows * Width> m_Pong;
+};
+
 // base template
 template <
     typename T,
-    std::size_t Inputs,
-    std::size_t Batch_Size,
+    std::size_t   Inputs,
+    std::size_t   Batch_Size,
+    weight_layout Layout,
     Layer_Signature...>
     requires(Batch_Size > 0)
-struct layer_unroll;
+struct basic_layer_unroll;
+
+/**
+ * \brief basic_layer_unroll with input-major weights
+ */
+template <
+    typename T,
+    std::size_t Inputs,
+    std::size_t Batch_Size,
+    Layer_Signature... Signatures>
+using layer_unroll = basic_layer_unroll<
+    T,
+    Inputs,
+    Batch_Size,
+    weight_layout::input_major,
+    Signatures...>;
 
 // specialization for last layer
 template <
     typename T,
     std::size_t     Inputs,
     std::size_t     Batch_Size,
+    weight_layout   Layout,
     Layer_Signature Current_Signature>
     requires(Batch_Size > 0)
-struct layer_unroll<T, Inputs, Batch_Size, Current_Signature>
+struct basic_layer_unroll<T, Inputs, Batch_Size, Layout, Current_Signature>
 {
     static constexpr std::size_t s_Inputs{ Inputs };
     static constexpr std::size_t s_Outputs{ Current_Signature.Size };
@@ -224,7 +691,26 @@ struct layer_unroll<T, Inputs, Batch_Size, Current_Signature>
     using current_layer_type = layer<
         T,
         Batch_Size,
-        Layer_Structure{ s_Inputs, s_Outputs, Current_Signature.Activation }>;
+        Layer_Structure{ s_Inputs,
+                         s_Outputs,
+                         Current_Signature.Activation,
+                         Current_Signature.Precision },
+        ga_sm::packed_storage,
+        Layout>;
+    using input_view_type  = typename current_layer_type::input_view_type;
+    using output_type      = typename current_layer_type::output_vector_shape;
+    using output_view_type = typename current_layer_type::output_view_type;
+
+    // Widest hidden layer from here on, the output layer is not one
+    static constexpr std::size_t s_Max_Hidden{ 0 };
+    // Values per sample backward_pass keeps, and of the gradient it adds to,
+    // for the layers from here on
+    static constexpr std::size_t s_Backward_Values{ 3 * s_Outputs };
+    static constexpr std::size_t s_Gradient_Size{
+        current_layer_type::s_Gradient_Size
+    };
+    // Values per sample forward_pass_from keeps for the layers from here on
+    static constexpr std::size_t s_Cached_Values{ s_Outputs };
 
     current_layer_type m_Data; // one data member for this layer
 
@@ -296,11 +782,126 @@ struct layer_unroll<T, Inputs, Batch_Size, Current_Signature>
     }
 
     [[nodiscard]]
-    auto forward_pass(
-        ga_sm::static_matrix<T, Batch_Size, s_Inputs> const& input_data
+    auto forward_pass(input_view_type input_data) const -> output_type
+    {
+        output_type out;
+        forward_pass(input_data, out);
+        return out;
+    }
+
+    void forward_pass(input_view_type input_data, output_view_type output) const
+    {
+        m_Data.forward_pass(input_data, output);
+    }
+
+    // Rows inputs at a time, see layer::forward_pass
+    template <std::size_t Rows, std::size_t In_Stride, std::size_t Out_Stride>
+    void forward_pass(
+        ga_sm::static_matrix_view<
+            const typename output_type::value_type,
+            Rows,
+            s_Inputs,
+            In_Stride> input_data,
+        ga_sm::static_matrix_view<
+            typename output_type::value_type,
+            Rows,
+            output_type::Size_x,
+            Out_Stride> output
+    ) const
+    {
+        m_Data.forward_pass(input_data, output);
+    }
+
+    // The output layer writes into output, the workspace is not needed
+    template <std::size_t Rows, std::size_t In_Stride, std::size_t Out_Stride>
+    void forward_pass(
+        ga_sm::static_matrix_view<
+            const typename output_type::value_type,
+            Rows,
+            s_Inputs,
+            In_Stride> input_data,
+        ga_sm::static_matrix_view<
+            typename output_type::value_type,
+            Rows,
+            output_type::Size_x,
+            Out_Stride> output,
+        typename output_type::value_type*,
+        typename output_type::value_type*
+    ) const
+    {
+        m_Data.forward_pass(input_data, output);
+    }
+
+    // The output layer of layer_unroll::forward_pass_from
+    template <std::size_t Rows, std::size_t In_Stride>
+    void forward_pass_from(
+        std::size_t first_layer,
+        ga_sm::static_matrix_view<
+            const typename output_type::value_type,
+            Rows,
+            s_Inputs,
+            In_Stride>                    input_data,
+        typename output_type::value_type* values
+    ) const
+    {
+        if (first_layer == 0)
+        {
+            m_Data.forward_pass(
+                input_data,
+                ga_sm::static_matrix_view<
+                    typename output_type::value_type,
+                    Rows,
+                    s_Outputs>{ values }
+            );
+        }
+    }
+
+    /**
+     * \brief The output layer of layer_unroll::backward_pass:
+     *        loss_gradient(outputs, output_gradient) gets the outputs of the
+     *        net and writes the gradient of the loss with respect to them
+     */
+    template <std::size_t Rows, std::size_t In_Stride, typename Loss_Gradient>
+    void backward_pass(
+        ga_sm::static_matrix_view<
+            const typename output_type::value_type,
+            Rows,
+            s_Inputs,
+            In_Stride>                     input_data,
+        Loss_Gradient&&                    loss_gradient,
+        typename output_type::value_type*  values,
+        typename output_type::value_type*  gradients,
+        typename output_type::value_type*  input_gradient
     ) const
     {
-        return m_Data.forward_pass(input_data);
+        using value_type = typename output_type::value_type;
+        using view_type  =
+            ga_sm::static_matrix_view<value_type, Rows, s_Outputs>;
+        using const_view_type =
+            ga_sm::static_matrix_view<const value_type, Rows, s_Outputs>;
+
+        const view_type pre_activations{ values };
+        const view_type outputs{ values + Rows * s_Outputs };
+        const view_type gradient{ values + 2 * Rows * s_Outputs };
+        m_Data.forward_pass(input_data, pre_activations, outputs);
+        std::invoke(
+            std::forward<Loss_Gradient>(loss_gradient),
+            const_view_type{ outputs },
+            gradient
+        );
+        m_Data.backward_pass(
+            input_data,
+            const_view_type{ pre_activations },
+            const_view_type{ outputs },
+            gradient,
+            gradients,
+            input_gradient
+        );
+    }
+
+    void descend(const typename output_type::value_type* steps)
+    {
+        m_Data.descend(steps);
     }
 
     [[nodiscard]]
@@ -333,10 +934,17 @@ template <
     typename T,
     std::size_t     Inputs,
     std::size_t     Batch_Size,
+    weight_layout   Layout,
     Layer_Signature Current_Signature,
     Layer_Signature... Signatures>
     requires(Batch_Size > 0)
-struct layer_unroll<T, Inputs, Batch_Size, Current_Signature, Signatures...>
+struct basic_layer_unroll<
+    T,
+    Inputs,
+    Batch_Size,
+    Layout,
+    Current_Signature,
+    Signatures...>
 {
     static constexpr std::size_t s_Inputs{ Inputs };
     static constexpr std::size_t s_Outputs{ Current_Signature.Size };
@@ -344,9 +952,35 @@ struct layer_unroll<T, Inputs, Batch_Size, Current_Signature, Signatures...>
     using current_layer_type = layer<
         T,
         Batch_Size,
-        Layer_Structure{ s_Inputs, s_Outputs, Current_Signature.Activation }>;
-    using next_data_type =
-        layer_unroll<T, Current_Signature.Size, Batch_Size, Signatures...>;
+        Layer_Structure{ s_Inputs,
+                         s_Outputs,
+                         Current_Signature.Activation,
+                         Current_Signature.Precision },
+        ga_sm::packed_storage,
+        Layout>;
+    using next_data_type = basic_layer_unroll<
+        T,
+        Current_Signature.Size,
+        Batch_Size,
+        Layout,
+        Signatures...>;
+    using input_view_type  = typename current_layer_type::input_view_type;
+    using output_type      = typename next_data_type::output_type;
+    using output_view_type = typename next_data_type::output_view_type;
+
+    // Widest hidden layer from here on
+    static constexpr std::size_t s_Max_Hidden{
+        std::max(s_Outputs, next_data_type::s_Max_Hidden)
+    };
+    static constexpr std::size_t s_Backward_Values{
+        3 * s_Outputs + next_data_type::s_Backward_Values
+    };
+    static constexpr std::size_t s_Gradient_Size{
+        current_layer_type::s_Gradient_Size + next_data_type::s_Gradient_Size
+    };
+    static constexpr std::size_t s_Cached_Values{
+        s_Outputs + next_data_type::s_Cached_Values
+    };
 
     current_layer_type m_Data; // one data member for this layer
     next_data_type     m_Next; // another layer_unroll member for the rest
@@ -425,11 +1059,170 @@ struct layer_unroll<T, Inputs, Batch_Size, Current_Signature, Signatures...>
     }
 
     [[nodiscard]]
-    auto forward_pass(
-        ga_sm::static_matrix<T, Batch_Size, s_Inputs> const& input_data
+    auto forward_pass(input_view_type input_data) const -> output_type
+    {
+        output_type out;
+        forward_pass(input_data, out);
+        return out;
+    }
+
+    void forward_pass(input_view_type input_data, output_view_type output) const
+    {
+        // Only the hidden activations are materialized, the input and output
+        // are read and written in place
+        typename current_layer_type::output_vector_shape hidden;
+        m_Data.forward_pass(input_data, ga_sm::make_view(hidden));
+        m_Next.forward_pass(hidden, output);
+    }
+
+    // Rows inputs at a time, see layer::forward_pass
+    template <std::size_t Rows, std::size_t In_Stride, std::size_t Out_Stride>
+    void forward_pass(
+        ga_sm::static_matrix_view<
+            const typename output_type::value_type,
+            Rows,
+            s_Inputs,
+            In_Stride> input_data,
+        ga_sm::static_matrix_view<
+            typename output_type::value_type,
+            Rows,
+            output_type::Size_x,
+            Out_Stride> output
+    ) const
+    {
+        ga_sm::static_matrix<typename output_type::value_type, Rows, s_Outputs>
+            hidden;
+        m_Data.forward_pass(input_data, ga_sm::make_view(hidden));
+        m_Next.forward_pass(ga_sm::make_view(std::as_const(hidden)), output);
+    }
+
+    /**
+     * \brief Rows inputs at a time, with the hidden activations in ping and
+     *        pong, Rows * s_Max_Hidden values each (see forward_workspace)
+     *        instead of on the stack. This layer writes into ping, which the
+     *        next one reads while writing into pong, and so on.
+     */
+    template <std::size_t Rows, std::size_t In_Stride, std::size_t Out_Stride>
+    void forward_pass(
+        ga_sm::static_matrix_view<
+            const typename output_type::value_type,
+            Rows,
+            s_Inputs,
+            In_Stride> input_data,
+        ga_sm::static_matrix_view<
+            typename output_type::value_type,
+            Rows,
+            output_type::Size_x,
+            Out_Stride>                   output,
+        typename output_type::value_type* ping,
+        typename output_type::value_type* pong
     ) const
     {
-        return m_Next.forward_pass(m_Data.forward_pass(input_data));
+        using value_type = typename output_type::value_type;
+        using hidden_view_type =
+            ga_sm::static_matrix_view<value_type, Rows, s_Outputs>;
+        const hidden_view_type hidden{ ping };
+        m_Data.forward_pass(input_data, hidden);
+        m_Next.forward_pass(
+            ga_sm::static_matrix_view<const value_type, Rows, s_Outputs>{
+                hidden },
+            output,
+            pong,
+            ping
+        );
+    }
+
+    /**
+     * \brief Rows inputs at a time, with the outputs of every layer kept in
+     *        values, Rows * s_Cached_Values of them, one layer after the
+     *        other. The layers before first_layer are not run: their outputs
+     *        must already be in values, from an earlier pass over the same
+     *        inputs with the same weights. After a mutation of the last
+     *        layers only those are evaluated again (see cached_neural_net).
+     */
+    template <std::size_t Rows, std::size_t In_Stride>
+    void forward_pass_from(
+        std::size_t first_layer,
+        ga_sm::static_matrix_view<
+            const typename output_type::value_type,
+            Rows,
+            s_Inputs,
+            In_Stride>                    input_data,
+        typename output_type::value_type* values
+    ) const
+    {
+        using value_type = typename output_type::value_type;
+
+        const ga_sm::static_matrix_view<value_type, Rows, s_Outputs> outputs{
+            values
+        };
+        if (first_layer == 0)
+        {
+            m_Data.forward_pass(input_data, outputs);
+        }
+        m_Next.forward_pass_from(
+            first_layer == 0 ? 0 : first_layer - 1,
+            ga_sm::static_matrix_view<const value_type, Rows, s_Outputs>{
+                outputs },
+            values + Rows * s_Outputs
+        );
+    }
+
+    /**
+     * \brief Reverse-mode pass over Rows samples: every layer runs forward
+     *        keeping its pre-activations and outputs in values, Rows *
+     *        s_Backward_Values of them, then loss_gradient(outputs,
+     *        output_gradient) writes the gradient of the loss with respect to
+     *        the outputs of the net and it is backpropagated, layer by layer.
+     *        The gradient with respect to the parameters of every layer (see
+     *        layer::backward_pass), s_Gradient_Size values, is added to
+     *        gradients, and the one with respect to input_data written to
+     *        input_gradient unless it is null.
+     */
+    template <std::size_t Rows, std::size_t In_Stride, typename Loss_Gradient>
+    void backward_pass(
+        ga_sm::static_matrix_view<
+            const typename output_type::value_type,
+            Rows,
+            s_Inputs,
+            In_Stride>                     input_data,
+        Loss_Gradient&&                    loss_gradient,
+        typename output_type::value_type*  values,
+        typename output_type::value_type*  gradients,
+        typename output_type::value_type*  input_gradient
+    ) const
+    {
+        using value_type = typename output_type::value_type;
+        using view_type  =
+            ga_sm::static_matrix_view<value_type, Rows, s_Outputs>;
+        using const_view_type =
+            ga_sm::static_matrix_view<const value_type, Rows, s_Outputs>;
+
+        const view_type pre_activations{ values };
+        const view_type outputs{ values + Rows * s_Outputs };
+        const view_type gradient{ values + 2 * Rows * s_Outputs };
+        m_Data.forward_pass(input_data, pre_activations, outputs);
+        m_Next.backward_pass(
+            const_view_type{ outputs },
+            std::forward<Loss_Gradient>(loss_gradient),
+            values + 3 * Rows * s_Outputs,
+            gradients + current_layer_type::s_Gradient_Size,
+            gradient.data()
+        );
+        m_Data.backward_pass(
+            input_data,
+            const_view_type{ pre_activations },
+            const_view_type{ outputs },
+            gradient,
+            gradients,
+            input_gradient
+        );
+    }
+
+    void descend(const typename output_type::value_type* steps)
+    {
+        m_Data.descend(steps);
+        m_Next.descend(steps + current_layer_type::s_Gradient_Size);
     }
 
     [[nodiscard]]
@@ -455,12 +1248,149 @@ struct layer_unroll<T, Inputs, Batch_Size, Current_Signature, Signatures...>
 
 //--------------------------------------------------------------------------------------//
 
+/**
+ * \brief Evaluates the layers of a net (its genome, see
+ *        basic_static_neural_net::genome_type) Batch_Size samples per
+ *        forward pass. It only references the genome, which must outlive it:
+ *        executors of any batch size, e.g. one evaluating a training dataset
+ *        and one playing moves, run the same genome without copying it.
+ */
+template <typename Genome, std::size_t Batch_Size>
+    requires(Batch_Size > 0)
+class static_net_executor
+{
+public:
+    using genome_type = Genome;
+    using value_type  = typename Genome::output_type::value_type;
+
+    static constexpr std::size_t s_Input_Size  = Genome::s_Inputs;
+    static constexpr std::size_t s_Output_Size = Genome::output_type::Size_x;
+    static constexpr std::size_t s_Batch_Size  = Batch_Size;
+
+    using input_type =
+        ga_sm::static_matrix<value_type, Batch_Size, s_Input_Size>;
+    using output_type =
+        ga_sm::static_matrix<value_type, Batch_Size, s_Output_Size>;
+    using input_view_type = ga_sm::static_matrix_view<
+        const value_type,
+        Batch_Size,
+        s_Input_Size,
+        input_type::Row_Stride>;
+    using output_view_type = ga_sm::static_matrix_view<
+        value_type,
+        Batch_Size,
+        s_Output_Size,
+        output_type::Row_Stride>;
+    using workspace_type =
+        forward_workspace<value_type, Batch_Size, Genome::s_Max_Hidden>;
+
+    // Above this many bytes of hidden activations, forward passes use the
+    // thread_workspace instead of the stack
+    static constexpr std::size_t s_Max_Stack_Activations =
+        ga_sm::gemm::cache_sizes::L1;
+
+private:
+    Genome const* m_Genome;
+
+public:
+    explicit constexpr static_net_executor(Genome const& genome) noexcept :
+        m_Genome{ &genome }
+    {
+    }
+
+    [[nodiscard]]
+    constexpr auto get_genome() const noexcept -> Genome const&
+    {
+        return *m_Genome;
+    }
+
+    [[nodiscard]]
+    auto forward_pass(input_type const& input_data) const -> output_type
+    {
+        output_type out;
+        forward_pass(ga_sm::make_view(input_data), ga_sm::make_view(out));
+        return out;
+    }
+
+    [[nodiscard]]
+    auto batch_forward_pass(input_type const& input_data) const -> output_type
+    {
+        return forward_pass(input_data);
+    }
+
+    /**
+     * \brief forward_pass without copies of the input or output, see
+     *        basic_static_neural_net::forward_pass
+     */
+    auto forward_pass(input_view_type input_data, output_view_type output_data)
+        const -> void
+    {
+        if constexpr (sizeof(workspace_type) > s_Max_Stack_Activations)
+        {
+            forward_pass(input_data, output_data, thread_workspace());
+        }
+        else
+        {
+            m_Genome->forward_pass(input_data, output_data);
+        }
+    }
+
+    /**
+     * \brief forward_pass with the hidden activations in workspace, which
+     *        this pass overwrites
+     */
+    auto forward_pass(
+        input_view_type  input_data,
+        output_view_type output_data,
+        workspace_type&  workspace
+    ) const -> void
+    {
+        m_Genome->forward_pass(
+            input_data,
+            output_data,
+            workspace.m_Ping.data(),
+            workspace.m_Pong.data()
+        );
+    }
+
+    /**
+     * \brief The calling thread's workspace, allocated on its first use and
+     *        reused by every later forward pass of the thread at this batch
+     *        size
+     */
+    [[nodiscard]]
+    static auto thread_workspace() -> workspace_type&
+    {
+        thread_local const auto workspace = std::make_unique<workspace_type>();
+        return *workspace;
+    }
+};
+
+//--------------------------------------------------------------------------------------//
+
+/**
+ * \brief Fully connected net.
+ * \tparam T Type the weights and biases are stored in, see layer. With
+ *         ga_sm::bf16 or ga_sm::fp16 the net takes half the memory and is
+ *         still fed and evaluated in float (value_type). Mutation, crossover
+ *         and serialization work on the stored form.
+ * \tparam Layout Weight layout of every layer, see weight_layout. Nets of
+ *         both layouts evaluate alike, init_from converts between them and
+ *         store / load files are shared. serialize_store writes the memory
+ *         image, which only deserialize_load into the same layout reads back
+ *         (see net_image.hpp for checked images, used in place).
+ * \tparam Batch_Size Samples per forward pass of the net itself. The layers
+ *         (genome_type) do not depend on it: nets of every batch size share
+ *         them, and executor evaluates this net's genome at any other batch
+ *         size without copying it.
+ */
 template <
-    std::floating_point T,
-    std::size_t         Batch_Size,
+    ga_sm::floating_point_storage T,
+    std::size_t                   Batch_Size,
+    weight_layout                 Layout,
     Layer_Signature... Signatures>
     requires((sizeof...(Signatures) >= 3) && Batch_Size > 0)
-class static_neural_net
+class basic_static_neural_net
 {
 public:
     static constexpr std::size_t s_Layers{ sizeof...(Signatures) };
@@ -470,17 +1400,64 @@ public:
     static constexpr std::size_t s_Output_Size =
         s_Signatures[s_Layers - 1].Size;
     static constexpr std::size_t s_Input_Size = s_Signatures[0].Size;
+    static constexpr weight_layout s_Layout   = Layout;
+    // Rows the forward_pass over a run time number of rows evaluates at
+    // once: a power of two up to 32, small enough that the widest activations
+    // of a micro-batch take at most a quarter of L1
+    static constexpr std::size_t s_Micro_Batch = std::clamp<std::size_t>(
+        std::bit_floor(
+            ga_sm::gemm::cache_sizes::L1 / 4 /
+            (std::ranges::max(s_Signatures, {}, &Layer_Signature::Size).Size *
+             sizeof(ga_sm::compute_t<T>))
+        ),
+        1,
+        32
+    );
 
-private:
-    using layers_type =
-        layer_unroll<T, s_Input_Size, Batch_Size, Signatures...>;
+    // The parameters of the net: its layers, independent of Batch_Size
+    using genome_type =
+        basic_layer_unroll<T, s_Input_Size, 1, Layout, Signatures...>;
+    // Values of the gradient backward_pass computes: the weights and bias of
+    // every layer, the activation parameters are left to mutation
+    static constexpr std::size_t s_Gradient_Size = genome_type::s_Gradient_Size;
+    // Values per sample backward_pass keeps while running
+    static constexpr std::size_t s_Backward_Values =
+        genome_type::s_Backward_Values;
+    // Values per sample forward_pass_from keeps: the outputs of every layer
+    static constexpr std::size_t s_Cached_Values = genome_type::s_Cached_Values;
+    // Evaluates the genome Other_Batch_Size samples per forward pass
+    template <std::size_t Other_Batch_Size = Batch_Size>
+    using executor_type = static_net_executor<genome_type, Other_Batch_Size>;
 
-    layers_type m_Layers;
+private:
+    genome_type m_Genome;
 
 public:
-    using value_type  = T;
-    using input_type  = ga_sm::static_matrix<T, Batch_Size, s_Input_Size>;
-    using output_type = ga_sm::static_matrix<T, Batch_Size, s_Output_Size>;
+    using value_type       = ga_sm::compute_t<T>;
+    using weight_type      = T;
+    using input_type       = typename executor_type<>::input_type;
+    using output_type      = typename executor_type<>::output_type;
+    using input_view_type  = typename executor_type<>::input_view_type;
+    using output_view_type = typename executor_type<>::output_view_type;
+    using workspace_type   = typename executor_type<>::workspace_type;
+    // The same net with its weights stored in Other_Layout
+    template <weight_layout Other_Layout>
+    using with_layout =
+        basic_static_neural_net<T, Batch_Size, Other_Layout, Signatures...>;
+    // The same net evaluating Other_Batch_Size samples per forward pass
+    template <std::size_t Other_Batch_Size>
+    using with_batch_size =
+        basic_static_neural_net<T, Other_Batch_Size, Layout, Signatures...>;
+    // The same net with every activation computed at Precision, see
+    // matrix_activation_functions::activation_precision
+    template <matrix_activation_functions::activation_precision Precision>
+    using with_activation_precision = basic_static_neural_net<
+        T,
+        Batch_Size,
+        Layout,
+        Layer_Signature{
+            Signatures.Size, Signatures.Activation, Precision
+        }...>;
 
 public:
     [[nodiscard]]
@@ -507,7 +1484,7 @@ public:
     {
         assert(layer_idx < s_Layers);
 
-        return layers_type::parameter_count(layer_idx);
+        return genome_type::parameter_count(layer_idx);
     }
 
     [[nodiscard]]
@@ -527,41 +1504,59 @@ public:
     [[nodiscard]]
     static constexpr std::size_t layer_size(const unsigned int layer_idx)
     {
-        return layers_type::layer_size(layer_idx);
+        return genome_type::layer_size(layer_idx);
     }
 
     template <std::size_t Idx>
     [[nodiscard]]
-    auto layer() -> decltype(m_Layers.template get<Idx>()
+    auto layer() -> decltype(m_Genome.template get<Idx>()
     )& // TODO: maybe try decltype(auto)
     {
-        return m_Layers.template get<Idx>();
+        return m_Genome.template get<Idx>();
     }
 
     template <std::size_t Idx>
     [[nodiscard]]
-    auto layer() const -> decltype(m_Layers.template get<Idx>()) const&
+    auto layer() const -> decltype(m_Genome.template get<Idx>()) const&
+    {
+        return m_Genome.template get<Idx>();
+    }
+
+    [[nodiscard]]
+    auto get_genome() const noexcept -> genome_type const&
+    {
+        return m_Genome;
+    }
+
+    /**
+     * \brief This net evaluating Other_Batch_Size samples per forward pass.
+     *        The executor references the net's genome, so it sees later
+     *        mutations and must not outlive the net.
+     */
+    template <std::size_t Other_Batch_Size = Batch_Size>
+    [[nodiscard]]
+    auto executor() const noexcept -> executor_type<Other_Batch_Size>
     {
-        return m_Layers.template get<Idx>();
+        return executor_type<Other_Batch_Size>{ m_Genome };
     }
 
     template <typename Fn, typename... Args>
         requires std::is_invocable_r_v<T, Fn, Args...>
     auto init(Fn&& fn, Args&&... args) -> void
     {
-        m_Layers.init(std::forward<Fn>(fn), std::forward<Args>(args)...);
+        m_Genome.init(std::forward<Fn>(fn), std::forward<Args>(args)...);
     }
 
     template <typename Fn>
     auto mutate(Fn&& fn) -> void
     {
-        m_Layers.mutate(std::forward<Fn>(fn));
+        m_Genome.mutate(std::forward<Fn>(fn));
     }
 
     template <typename Fn>
     auto mutate_layer(size_t layer_idx, Fn&& fn) -> void
     {
-        m_Layers.mutate_layer(layer_idx, std::forward<Fn>(fn));
+        m_Genome.mutate_layer(layer_idx, std::forward<Fn>(fn));
     }
 
     template <typename Fn>
@@ -588,7 +1583,7 @@ public:
     auto print_layers() const -> void
     {
         std::ios_base::sync_with_stdio(false);
-        m_Layers.print();
+        m_Genome.print();
         std::ios_base::sync_with_stdio(true);
     }
 
@@ -622,17 +1617,19 @@ public:
             log::add(message);
             std::exit(EXIT_FAILURE);
         }
+        // Enough digits for load to restore every parameter exactly
+        out << std::setprecision(std::numeric_limits<value_type>::max_digits10);
         // store net shapes
         for (const auto& layer_signature : s_Signatures)
         {
             out << layer_signature.Size << ' ';
         }
         out << "\n\n";
-        m_Layers.store(out);
+        m_Genome.store(out);
     }
 
     auto serialize_store(const std::filesystem::path& filename) const -> void
-        requires(std::is_trivial_v<static_neural_net> && std::is_standard_layout_v<static_neural_net>)
+        requires(std::is_trivial_v<basic_static_neural_net> && std::is_standard_layout_v<basic_static_neural_net>)
     {
         std::ofstream out(filename, std::ios::binary);
         if (!out.is_open())
@@ -679,13 +1676,13 @@ public:
                 std::exit(EXIT_FAILURE);
             }
         }
-        m_Layers.load(in);
+        m_Genome.load(in);
     }
 
     // Overrides current net with one read from "filename"
     // Shapes of both nets must be the same
     auto deserialize_load(const std::filesystem::path& filename) -> void
-        requires(std::is_trivial_v<static_neural_net> && std::is_standard_layout_v<static_neural_net>)
+        requires(std::is_trivial_v<basic_static_neural_net> && std::is_standard_layout_v<basic_static_neural_net>)
     {
         std::ifstream in(filename, std::ios::binary);
         if (!in.is_open())
@@ -710,28 +1707,119 @@ public:
                 std::exit(EXIT_FAILURE);
             }
         }
-        for (auto* p = reinterpret_cast<char*>(this);
-             p != reinterpret_cast<const char*>(this) + sizeof(*this);
-             p += sizeof(value_type))
-        {
-            in.read(p, sizeof(value_type));
-        }
+        in.read(reinterpret_cast<char*>(this), sizeof(*this));
     }
 
     [[nodiscard]]
     auto batch_forward_pass(input_type const& input_data) const -> output_type
     {
-        return m_Layers.forward_pass(input_data);
+        return executor().forward_pass(input_data);
     }
 
     [[nodiscard]]
     auto forward_pass(input_type const& input_data) const -> output_type
     {
-        return m_Layers.forward_pass(
-            cast_to_shape<Batch_Size, s_Input_Size>(input_data)
+        return executor().forward_pass(input_data);
+    }
+
+    /**
+     * \brief forward_pass without copies of the input or output, e.g. for
+     *        rows of a bigger matrix (ga_sm::row_view) or reshaped matrices
+     *        (ga_sm::reshape_view)
+     */
+    auto forward_pass(input_view_type input_data, output_view_type output_data)
+        const -> void
+    {
+        executor().forward_pass(input_data, output_data);
+    }
+
+    /**
+     * \brief forward_pass with the hidden activations in a caller supplied
+     *        workspace, e.g. one held in a std::unique_ptr for big batches
+     */
+    auto forward_pass(
+        input_view_type  input_data,
+        output_view_type output_data,
+        workspace_type&  workspace
+    ) const -> void
+    {
+        executor().forward_pass(input_data, output_data, workspace);
+    }
+
+    /**
+     * \brief forward_pass over any number of rows, known at run time: inputs
+     *        holds rows of s_Input_Size values back to back and outputs
+     *        receives as many rows of s_Output_Size. The rows go through the
+     *        layers Micro_Batch at a time, with the hidden activations of a
+     *        micro-batch on the stack. The tail is split into power of two
+     *        chunks, so no padding rows are evaluated.
+     */
+    template <std::size_t Micro_Batch = s_Micro_Batch>
+        requires(std::has_single_bit(Micro_Batch))
+    auto forward_pass(
+        std::span<const value_type> inputs,
+        std::span<value_type>       outputs
+    ) const -> void
+    {
+        assert(inputs.size() % s_Input_Size == 0);
+        const auto rows = inputs.size() / s_Input_Size;
+        assert(outputs.size() >= rows * s_Output_Size);
+
+        const value_type* in  = inputs.data();
+        value_type*       out = outputs.data();
+        for (auto left = rows; left >= Micro_Batch; left -= Micro_Batch)
+        {
+            forward_pass_rows<Micro_Batch>(in, out);
+            in += Micro_Batch * s_Input_Size;
+            out += Micro_Batch * s_Output_Size;
+        }
+        if constexpr (Micro_Batch > 1)
+        {
+            forward_pass_tail<Micro_Batch / 2>(rows % Micro_Batch, in, out);
+        }
+    }
+
+private:
+    template <std::size_t Rows>
+    auto forward_pass_rows(const value_type* in, value_type* out) const
+        -> void
+    {
+        m_Genome.forward_pass(
+            ga_sm::static_matrix_view<
+                const value_type,
+                Rows,
+                s_Input_Size,
+                s_Input_Size>{ in },
+            ga_sm::static_matrix_view<
+                value_type,
+                Rows,
+                s_Output_Size,
+                s_Output_Size>{ out }
         );
     }
 
+    // Rows left over, fewer than 2 * Rows, taken by the set bits of their
+    // count
+    template <std::size_t Rows>
+    auto forward_pass_tail(
+        std::size_t       rows,
+        const value_type* in,
+        value_type*       out
+    ) const -> void
+    {
+        if (rows & Rows)
+        {
+            forward_pass_rows<Rows>(in, out);
+            in += Rows * s_Input_Size;
+            out += Rows * s_Output_Size;
+        }
+        if constexpr (Rows > 1)
+        {
+            forward_pass_tail<Rows / 2>(rows, in, out);
+        }
+    }
+
+public:
     template <
         size_t      M_Out,
         std::size_t N_Out,
@@ -742,38 +1830,152 @@ public:
             Batch_Size == 1
         )
     [[nodiscard]]
-    auto forward_pass(ga_sm::static_matrix<T, M_In, N_In> const& input_data
-    ) const -> ga_sm::static_matrix<T, M_Out, N_Out>
+    auto forward_pass(
+        ga_sm::static_matrix<value_type, M_In, N_In> const& input_data
+    ) const -> ga_sm::static_matrix<value_type, M_Out, N_Out>
     {
-        const auto temp = cast_to_shape<1, s_Input_Size>(input_data);
-        return cast_to_shape<M_Out, N_Out>(m_Layers.forward_pass(temp));
+        ga_sm::static_matrix<value_type, M_Out, N_Out> ret;
+        m_Genome.forward_pass(
+            ga_sm::reshape_view<1, s_Input_Size>(input_data),
+            ga_sm::reshape_view<1, s_Output_Size>(ret)
+        );
+        return ret;
     }
 
     [[nodiscard]]
     auto forward_pass(value_type input_value) const -> value_type
         requires((1 == s_Output_Size) && (1 == s_Input_Size) && Batch_Size == 1)
     {
-        return m_Layers.forward_pass(ga_sm::static_matrix<value_type, 1, 1>{
-            input_value })(0, 0);
+        return m_Genome.forward_pass(ga_sm::static_matrix<value_type, 1, 1>{
+            input_value })[0, 0];
+    }
+
+    /**
+     * \brief Reverse-mode pass over Rows samples, see
+     *        layer_unroll::backward_pass: values holds Rows *
+     *        s_Backward_Values values and the gradient of the loss
+     *        loss_gradient defines is added to gradients, s_Gradient_Size
+     *        values. backprop.hpp trains nets with it.
+     */
+    template <std::size_t Rows, std::size_t In_Stride, typename Loss_Gradient>
+    auto backward_pass(
+        ga_sm::static_matrix_view<
+            const value_type,
+            Rows,
+            s_Input_Size,
+            In_Stride>  input_data,
+        Loss_Gradient&& loss_gradient,
+        value_type*     values,
+        value_type*     gradients
+    ) const -> void
+    {
+        m_Genome.backward_pass(
+            input_data,
+            std::forward<Loss_Gradient>(loss_gradient),
+            values,
+            gradients,
+            nullptr
+        );
     }
 
+    /**
+     * \brief Forward pass over Rows samples from layer first_layer on, see
+     *        layer_unroll::forward_pass_from: values holds Rows *
+     *        s_Cached_Values values, the outputs of every layer, those of the
+     *        layers before first_layer being reused as they are. The outputs
+     *        of the net are the last Rows * s_Output_Size.
+     */
+    template <std::size_t Rows, std::size_t In_Stride>
+    auto forward_pass_from(
+        std::size_t first_layer,
+        ga_sm::static_matrix_view<
+            const value_type,
+            Rows,
+            s_Input_Size,
+            In_Stride> input_data,
+        value_type*    values
+    ) const -> void
+    {
+        assert(first_layer < s_Layers);
+        m_Genome.forward_pass_from(first_layer, input_data, values);
+    }
+
+    /**
+     * \brief Subtracts steps, laid out as the gradients of backward_pass,
+     *        from the weights and biases of the net
+     */
+    auto descend(std::span<const value_type> steps) -> void
+    {
+        assert(steps.size() == s_Gradient_Size);
+        m_Genome.descend(steps.data());
+    }
+
+    // Nets of every batch size share genome_type, so this is a plain copy
+    // of the layers
     template <size_t Other_Batch_Size>
-    // TODO: add requires std is strivial and is standar layout
     auto init_from_ptr(
-        const static_neural_net<T, Other_Batch_Size, Signatures...>* const
-            src_ptr
+        const basic_static_neural_net<
+            T,
+            Other_Batch_Size,
+            Layout,
+            Signatures...>* const src_ptr
     ) -> void
     {
-        std::memcpy(this, src_ptr, sizeof(static_neural_net));
+        m_Genome = src_ptr->get_genome();
+    }
+
+    /**
+     * \brief Overrides this net with other, stored in the other weight
+     *        layout, evaluating another batch size or computing its
+     *        activations at another precision. To evaluate a net at another
+     *        batch size, see executor, which does not copy it.
+     */
+    template <
+        std::size_t   Other_Batch_Size,
+        weight_layout Other_Layout,
+        Layer_Signature... Other_Signatures>
+        requires(
+            sizeof...(Other_Signatures) == s_Layers &&
+            (Signatures.same_weights(Other_Signatures) && ...)
+        )
+    auto init_from(basic_static_neural_net<
+                   T,
+                   Other_Batch_Size,
+                   Other_Layout,
+                   Other_Signatures...> const& other) -> void
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (this->template layer<I>().init_from(other.template layer<I>()),
+             ...);
+        }(std::make_index_sequence<s_Layers>{});
     }
 };
 
+/**
+ * \brief static_neural_net with input-major weights, see
+ *        basic_static_neural_net
+ */
+template <
+    ga_sm::floating_point_storage T,
+    std::size_t                   Batch_Size,
+    Layer_Signature... Signatures>
+using static_neural_net = basic_static_neural_net<
+    T,
+    Batch_Size,
+    weight_layout::input_major,
+    Signatures...>;
+
 //--------------------------------------------------------------------------------------//
 //  Neural net concept
 //--------------------------------------------------------------------------------------//
 
-template <typename T, std::size_t Batch_Size, Layer_Signature... Signatures>
-auto nnet_dummy(static_neural_net<T, Batch_Size, Signatures...>) -> void
+template <
+    typename T,
+    std::size_t   Batch_Size,
+    weight_layout Layout,
+    Layer_Signature... Signatures>
+auto nnet_dummy(basic_static_neural_net<T, Batch_Size, Layout, Signatures...>)
+    -> void
 {
 }
 
@@ -802,6 +2004,20 @@ auto static_neural_net_factory(Fn&& fn, Args&&... args) -> std::unique_ptr<NNet>
     return ptr;
 }
 
+/**
+ * \brief Copy of net with its weights stored in Layout, e.g. output_major for
+ *        batch 1 inference of a net evolved in input_major
+ */
+template <weight_layout Layout, static_neural_net_type NNet>
+[[nodiscard]]
+auto with_weight_layout(NNet const& net)
+    -> std::unique_ptr<typename NNet::template with_layout<Layout>>
+{
+    auto ptr = std::make_unique<typename NNet::template with_layout<Layout>>();
+    ptr->init_from(net);
+    return ptr;
+}
+
 template <static_neural_net_type NNet>
     requires(std::is_standard_layout_v<NNet> && std::is_trivial_v<NNet>)
 [[nodiscard]] auto operator==(const NNet& net1, const NNet& net2) -> bool
@@ -872,35 +2088,29 @@ inline auto to_target_layer_swap(
     NNet&       out_net2
 ) -> void
 {
-    using value_type = typename NNet::value_type;
-
-    const auto layers         = NNet::s_Layers;
-    const auto net_parameters = NNet::parameter_count();
+    const auto layers = NNet::s_Layers;
 
     const auto a = random::randint(0, layers - 1);
 
-    const auto first_half_count  = NNet::parameter_count(0, a);
-    const auto second_half_count = NNet::parameter_count(a + 1, layers - 1);
-    const auto first_half_size   = first_half_count * sizeof(value_type);
-    const auto second_half_size  = second_half_count * sizeof(value_type);
+    // Sizes in bytes rather than parameter counts, so that padded layers (see
+    // ga_sm::aligned_storage) are split on their real boundaries
+    const auto first_half_size  = NNet::subnet_size(0, a);
+    const auto second_half_size = NNet::subnet_size(a + 1, layers - 1);
 
-    assert(
-        net_parameters * sizeof(value_type) ==
-        first_half_size + second_half_size
-    );
-    assert(net_parameters * sizeof(value_type) == sizeof(NNet));
+    assert(NNet::subnet_size() == first_half_size + second_half_size);
+    assert(NNet::subnet_size() == sizeof(NNet));
 
     std::memcpy(&out_net1, &in_net1, first_half_size);
     std::memcpy(
-        (value_type*)&out_net1 + first_half_count,
-        (value_type*)&in_net2 + first_half_count,
+        (char*)&out_net1 + first_half_size,
+        (const char*)&in_net2 + first_half_size,
         second_half_size
     );
 
     std::memcpy(&out_net2, &in_net2, first_half_size);
     std::memcpy(
-        (value_type*)&out_net2 + first_half_count,
-        (value_type*)&in_net1 + first_half_count,
+        (char*)&out_net2 + first_half_size,
+        (const char*)&in_net1 + first_half_size,
         second_half_size
     );
 }
@@ -975,7 +2185,7 @@ auto population_variability(
     Distance&&                                               dist_op
 ) -> ga_sm::static_matrix<R, N, N>
 {
-    ga_sm::static_matrix<double, N, N> distance_matrix{};
+    ga_sm::static_matrix<R, N, N> distance_matrix{};
     for (size_t j = 0; j != N - 1; ++j)
     {
         for (size_t i = j + 1; i != N; ++i)
@@ -995,8 +2205,8 @@ auto population_variability(
 // TODO add perfect forwarding
 /**
  * \brief Returns the sum of the normalized distance between homologous pairs of
- * matrices between two layers \tparam R \tparam Layer \param layer1 \param
- * layer2 \return
+ * matrices between two layers, of the same or different weight layouts
+ * \tparam R \tparam Layer \param layer1 \param layer2 \return
  */
 template <
     std::floating_point R,
@@ -1006,7 +2216,8 @@ template <
     requires(
         (Layer1::s_Inputs == Layer2::s_Inputs) &&
         (Layer1::s_Outputs == Layer2::s_Outputs) &&
-        (Layer1::s_Activation == Layer2::s_Activation)
+        (Layer1::s_Activation == Layer2::s_Activation) &&
+        !ga_sm::distance_tag<std::remove_cvref_t<Distance>>
     )
 [[nodiscard]]
 auto layer_distance(
@@ -1017,7 +2228,7 @@ auto layer_distance(
 {
     return matrix_distance<R>(
                layer1.get_weights_mat(),
-               layer2.get_weights_mat(),
+               weights_in_layout<Layer1::s_Layout>(layer2),
                std::forward<Distance>(dist_op)
            ) +
         matrix_distance<R>(
@@ -1032,6 +2243,55 @@ auto layer_distance(
         );
 }
 
+/**
+ * \brief Built-in distance (see ga_sm::distance) between two layers, with
+ * weights, bias and activation parameters seen as a single vector. For L1 and
+ * L2 this is the sum of the distances of the homologous matrices, as with the
+ * callable overload, but the matrices are reduced by the vectorised kernels.
+ */
+template <
+    std::floating_point  R,
+    static_layer_type    Layer1,
+    static_layer_type    Layer2,
+    ga_sm::distance_tag Distance>
+    requires(
+        (Layer1::s_Inputs == Layer2::s_Inputs) &&
+        (Layer1::s_Outputs == Layer2::s_Outputs) &&
+        (Layer1::s_Activation == Layer2::s_Activation)
+    )
+[[nodiscard]]
+auto layer_distance(
+    Layer1 const& layer1,
+    Layer2 const& layer2,
+    Distance      dist_tag
+) -> R
+{
+    auto sums = ga_sm::matrix_distance_sums<R>(
+        layer1.get_weights_mat(),
+        weights_in_layout<Layer1::s_Layout>(layer2),
+        dist_tag
+    );
+    const auto bias_sums = ga_sm::matrix_distance_sums<R>(
+        layer1.get_bias_vector(), layer2.get_bias_vector(), dist_tag
+    );
+    for (std::size_t s = 0; s != sums.size(); ++s)
+    {
+        sums[s] += bias_sums[s];
+    }
+
+    // The parameters are added to the sums as they are visited
+    using T = typename Layer1::value_type;
+    (void)activation_function_distance<R>(
+        layer1.get_activation_function(),
+        layer2.get_activation_function(),
+        [&sums](T a, T b) -> R {
+            Distance::accumulate(sums, static_cast<R>(a), static_cast<R>(b));
+            return R{};
+        }
+    );
+    return Distance::finish(sums);
+}
+
 /**
  * \brief Calculates the sum of the normalized distance between homologous pairs
  * of matrices between both nets. Distance between each matrix is normalized by
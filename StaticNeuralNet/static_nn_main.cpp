@@ -1,5 +1,6 @@
 #include "Random.hpp"
 #include "Stopwatch.hpp"
+#include "net_image.hpp"
 #include "static_matrix.hpp"
 #include "static_neural_net.hpp"
 #include <iostream>
@@ -97,6 +98,18 @@ int flat_test()
                  )
               << std::endl;
 
+    // The same net as an image, used where it is mapped
+    const std::string image_filename = "Image_test0.img";
+    ga_snn::store_net_image(image_filename, *ptr_net);
+    const ga_snn::mapped_net_image<NET> image(image_filename);
+    std::cout << "L1:"
+              << neural_net_distance<float>(
+                     *ptr_net.get(),
+                     image[0],
+                     [](float a, float b) { return std::abs(a - b); }
+                 )
+              << std::endl;
+
     for (size_t i = 0; const auto& e : in)
     {
         const auto res =
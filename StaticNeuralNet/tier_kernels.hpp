@@ -0,0 +1,2684 @@
+// No include guard: kernels.hpp includes this file once per instruction set
+// tier, inside namespace ga_sm::simd::<tier> and under the matching
+// #pragma GCC target. The enclosing namespace provides register_bytes and
+// int8_dot.
+//
+// Everything in here must be compiled for the tier, so the helpers are
+// defined here rather than shared: a vector helper compiled for the baseline
+// and inlined into a tier kernel is lowered to the baseline width first.
+
+template <typename T>
+using vec = simd::vec<T, register_bytes>;
+
+template <typename T>
+inline constexpr std::size_t lanes = simd::lanes<T, register_bytes>;
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto load(const scalar_type<V>* src) noexcept -> V
+{
+    V ret;
+    std::memcpy(&ret, src, sizeof(V));
+    return ret;
+}
+
+/**
+ * \brief Lane mask selecting the last Count lanes of a V
+ */
+template <typename V, std::size_t Count, std::size_t... I>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto tail_mask(std::index_sequence<I...>) noexcept
+{
+    using lane = std::conditional_t<
+        sizeof(scalar_type<V>) == 4,
+        std::int32_t,
+        std::int64_t>;
+    using mask = simd::vec<lane, sizeof(V)>;
+
+    return mask{ (I >= sizeof...(I) - Count ? lane{ -1 } : lane{ 0 })... };
+}
+
+/**
+ * \brief Loads the Count < lanes elements ending at src_end. When End
+ *        elements precede src_end (End >= lanes), this is one full vector
+ *        load ending at src_end with the lanes in front of the Count elements
+ *        zeroed. Otherwise the elements are copied into a zeroed vector.
+ */
+template <typename V, std::size_t Count, std::size_t End>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto load_tail(const scalar_type<V>* src_end) noexcept -> V
+{
+    using T                 = scalar_type<V>;
+    constexpr std::size_t L = sizeof(V) / sizeof(T);
+    static_assert(Count < L && Count <= End);
+
+    if constexpr (End >= L)
+    {
+        return tail_mask<V, Count>(std::make_index_sequence<L>{})
+            ? load<V>(src_end - L)
+            : V{};
+    }
+    else
+    {
+        V ret{};
+        std::memcpy(&ret, src_end - Count, Count * sizeof(T));
+        return ret;
+    }
+}
+
+/**
+ * \brief Loads Count < lanes elements into the low lanes of a zeroed vector
+ */
+template <typename V, std::size_t Count>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto load_partial(const scalar_type<V>* src) noexcept -> V
+{
+    V ret{};
+    std::memcpy(&ret, src, Count * sizeof(scalar_type<V>));
+    return ret;
+}
+
+/**
+ * \brief Widens the bits of lanes bf16 or fp16 values (W) to floats
+ */
+template <typename V, typename W>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto widen(simd::vec<std::uint16_t, sizeof(V) / 2> bits) noexcept -> V
+{
+    using wide = simd::vec<std::uint32_t, sizeof(V)>;
+    const wide u = __builtin_convertvector(bits, wide);
+
+    if constexpr (std::same_as<W, bf16>)
+    {
+        return __builtin_bit_cast(V, u << 16);
+    }
+    else if constexpr (sizeof(V) == 64)
+    {
+        // the unmasked form reads an undefined source vector
+        return __builtin_bit_cast(
+            V, _mm512_maskz_cvtph_ps(0xffff, __builtin_bit_cast(__m256i, bits))
+        );
+    }
+    else if constexpr (sizeof(V) == 32)
+    {
+        return __builtin_bit_cast(
+            V, _mm256_cvtph_ps(__builtin_bit_cast(__m128i, bits))
+        );
+    }
+    else
+    {
+        // No F16C below AVX: fp16_format::to_float on every lane
+        const wide sign     = (u & 0x8000u) << 16;
+        const wide exp_mant = (u & 0x7fffu) << 13;
+        const V    ret      = (u & 0x7c00u) == 0x7c00u
+                    ? __builtin_bit_cast(V, exp_mant | 0x7f800000u)
+                    : __builtin_bit_cast(V, exp_mant) * 0x1p112f;
+        return __builtin_bit_cast(V, __builtin_bit_cast(wide, ret) | sign);
+    }
+}
+
+/**
+ * \brief Loads a V from lanes elements of type W: a plain load when W is the
+ *        lane type, widened from bf16 or fp16 otherwise
+ */
+template <typename V, typename W>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto load_as(const W* src) noexcept -> V
+{
+    if constexpr (std::same_as<W, scalar_type<V>>)
+    {
+        return load<V>(src);
+    }
+    else
+    {
+        simd::vec<std::uint16_t, sizeof(V) / 2> bits;
+        std::memcpy(&bits, src, sizeof(bits));
+        return widen<V, W>(bits);
+    }
+}
+
+/**
+ * \brief load_partial for elements of type W, see load_as
+ */
+template <typename V, std::size_t Count, typename W>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto load_partial_as(const W* src) noexcept -> V
+{
+    if constexpr (std::same_as<W, scalar_type<V>>)
+    {
+        return load_partial<V, Count>(src);
+    }
+    else
+    {
+        simd::vec<std::uint16_t, sizeof(V) / 2> bits{};
+        std::memcpy(&bits, src, Count * sizeof(W));
+        return widen<V, W>(bits);
+    }
+}
+
+/**
+ * \brief Lane mask selecting the first count lanes of a V, count known at run
+ *        time
+ */
+template <typename V, std::size_t... I>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto head_mask(std::size_t count, std::index_sequence<I...>) noexcept
+{
+    using lane = std::conditional_t<
+        sizeof(scalar_type<V>) == 4,
+        std::int32_t,
+        std::int64_t>;
+    using mask = simd::vec<lane, sizeof(V)>;
+
+    return mask{ lane{ I }... } < static_cast<lane>(count);
+}
+
+template <typename V>
+[[gnu::always_inline]]
+inline auto store(scalar_type<V>* dst, V const& v) noexcept -> void
+{
+    std::memcpy(dst, &v, sizeof(V));
+}
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto broadcast(scalar_type<V> value) noexcept -> V
+{
+    // value - 0 is exact for every value (including -0), so it folds into a
+    // plain broadcast, unlike V{} + value
+    return value - V{};
+}
+
+/**
+ * \brief Lower or upper half of v, as a vector of half the width
+ */
+template <bool Upper, typename V, std::size_t... I>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto half(V const& v, std::index_sequence<I...>) noexcept
+    -> simd::vec<scalar_type<V>, sizeof(V) / 2>
+{
+    return __builtin_shufflevector(v, v, (Upper ? sizeof...(I) + I : I)...);
+}
+
+/**
+ * \brief Vector of the lanes of lo then those of hi, the inverse of half
+ */
+template <typename H, std::size_t... I>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto join(H const& lo, H const& hi, std::index_sequence<I...>) noexcept
+    -> simd::vec<scalar_type<H>, 2 * sizeof(H)>
+{
+    return __builtin_shufflevector(lo, hi, I...);
+}
+
+/**
+ * \brief Loads count <= lanes elements, count known at run time, into the low
+ *        lanes of a zeroed vector: whole halves of V while they fit, then 8
+ *        and 4 byte loads. None reads past src + count. Unlike a masked load
+ *        they can forward from the stores that wrote the row, where a masked
+ *        load waits for them to reach the cache.
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto load_first(const scalar_type<V>* src, std::size_t count) noexcept
+    -> V
+{
+    using T                 = scalar_type<V>;
+    constexpr std::size_t L = sizeof(V) / sizeof(T);
+
+    if (count == L)
+    {
+        return load<V>(src);
+    }
+    else if constexpr (sizeof(V) > 16)
+    {
+        using H = simd::vec<T, sizeof(V) / 2>;
+        if (count < L / 2)
+        {
+            return join(
+                load_first<H>(src, count), H{}, std::make_index_sequence<L>{}
+            );
+        }
+        return join(
+            load<H>(src),
+            load_first<H>(src + L / 2, count - L / 2),
+            std::make_index_sequence<L>{}
+        );
+    }
+    else if constexpr (std::same_as<T, float>)
+    {
+        // movq / movss zero the lanes above the ones they load
+        if (count < 2)
+        {
+            return count == 0 ? V{} : __builtin_bit_cast(V, _mm_load_ss(src));
+        }
+        const auto low = _mm_castsi128_ps(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src))
+        );
+        return __builtin_bit_cast(
+            V, count == 2 ? low : _mm_movelh_ps(low, _mm_load_ss(src + 2))
+        );
+    }
+    else
+    {
+        return count == 0 ? V{} : __builtin_bit_cast(V, _mm_load_sd(src));
+    }
+}
+
+/**
+ * \brief load_first one element at a time, combined by shuffles: each load
+ *        forwards from whichever store wrote its element, where a vector load
+ *        that spans several stores (a row just written by narrower ones)
+ *        waits for them to reach the cache. For latency bound single rows.
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto load_each(const scalar_type<V>* src, std::size_t count) noexcept
+    -> V
+{
+    using T                 = scalar_type<V>;
+    constexpr std::size_t L = sizeof(V) / sizeof(T);
+
+    if constexpr (sizeof(V) > 16)
+    {
+        using H = simd::vec<T, sizeof(V) / 2>;
+        return join(
+            load_each<H>(src, std::min(count, L / 2)),
+            count > L / 2 ? load_each<H>(src + L / 2, count - L / 2) : H{},
+            std::make_index_sequence<L>{}
+        );
+    }
+    else if constexpr (std::same_as<T, float>)
+    {
+        const auto lane = [src, count](std::size_t l) {
+            return l < count ? _mm_load_ss(src + l) : _mm_setzero_ps();
+        };
+        return __builtin_bit_cast(
+            V,
+            _mm_movelh_ps(
+                _mm_unpacklo_ps(lane(0), lane(1)),
+                _mm_unpacklo_ps(lane(2), lane(3))
+            )
+        );
+    }
+    else
+    {
+        const auto lane = [src, count](std::size_t l) {
+            return l < count ? _mm_load_sd(src + l) : _mm_setzero_pd();
+        };
+        return __builtin_bit_cast(V, _mm_unpacklo_pd(lane(0), lane(1)));
+    }
+}
+
+/**
+ * \brief Stores the first count <= lanes lanes of v, count known at run time:
+ *        whole halves of v while they fit, then 8 and 4 byte stores. Not a
+ *        masked store, which does not forward to the loads that overlap it
+ *        (the next row's, the reads of the outputs): they wait for it to
+ *        reach the cache instead.
+ */
+template <typename V>
+[[gnu::always_inline]]
+inline auto store_first(scalar_type<V>* dst, V const& v, std::size_t count)
+    noexcept -> void
+{
+    using T                 = scalar_type<V>;
+    constexpr std::size_t L = sizeof(V) / sizeof(T);
+
+    if (count == L)
+    {
+        store(dst, v);
+    }
+    else if constexpr (sizeof(V) > 16)
+    {
+        constexpr auto H  = std::make_index_sequence<L / 2>{};
+        const auto     lo = half<false>(v, H);
+        if (count < L / 2)
+        {
+            store_first(dst, lo, count);
+        }
+        else
+        {
+            store(dst, lo);
+            store_first(dst + L / 2, half<true>(v, H), count - L / 2);
+        }
+    }
+    else
+    {
+        if (count * sizeof(T) >= 8)
+        {
+            std::memcpy(dst, &v, 8);
+        }
+        if constexpr (sizeof(T) == 4)
+        {
+            if (count == 1)
+            {
+                dst[0] = v[0];
+            }
+            else if (count == 3)
+            {
+                dst[2] = v[2];
+            }
+        }
+    }
+}
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto horizontal_sum(V const& v) noexcept -> scalar_type<V>
+{
+    using T = scalar_type<V>;
+    if constexpr (sizeof(V) > 16)
+    {
+        // Fold the upper half onto the lower one (vextract + add)
+        return horizontal_sum(
+            half<false>(v, std::make_index_sequence<sizeof(V) / sizeof(T) / 2>{}
+            ) +
+            half<true>(v, std::make_index_sequence<sizeof(V) / sizeof(T) / 2>{})
+        );
+    }
+    else
+    {
+        constexpr auto L   = sizeof(V) / sizeof(T);
+        T              ret = v[0];
+#pragma GCC unroll 16
+        for (std::size_t i = 1; i != L; ++i)
+        {
+            ret += v[i];
+        }
+        return ret;
+    }
+}
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto horizontal_max(V const& v) noexcept -> scalar_type<V>
+{
+    using T = scalar_type<V>;
+    if constexpr (sizeof(V) > 16)
+    {
+        constexpr auto H  = sizeof(V) / sizeof(T) / 2;
+        const auto     lo = half<false>(v, std::make_index_sequence<H>{});
+        const auto     hi = half<true>(v, std::make_index_sequence<H>{});
+        return horizontal_max(lo > hi ? lo : hi);
+    }
+    else
+    {
+        constexpr auto L   = sizeof(V) / sizeof(T);
+        T              ret = v[0];
+#pragma GCC unroll 16
+        for (std::size_t i = 1; i != L; ++i)
+        {
+            ret = std::max(ret, v[i]);
+        }
+        return ret;
+    }
+}
+
+#include "vector_math.hpp"
+
+/**
+ * \brief fn applied to every lane of v. fn is called on the whole vector
+ *        instead when it accepts one, or has a vectorized form (the fast
+ *        activation functions, see vector_math.hpp). Otherwise the lanes go
+ *        through an array, whose loop the vectorizer turns back into vector
+ *        code for simple functions (ReLU, identity, ...) instead of an
+ *        extract and an insert per lane.
+ */
+template <typename V, typename Fn>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto apply_lanes(V v, Fn const& fn) noexcept -> V
+{
+    if constexpr (requires { vectorized(fn, v); })
+    {
+        return vectorized(fn, v);
+    }
+    else if constexpr (std::is_invocable_r_v<V, Fn const&, V>)
+    {
+        return fn(v);
+    }
+    else
+    {
+        constexpr auto L = sizeof(V) / sizeof(scalar_type<V>);
+        scalar_type<V> x[L];
+        std::memcpy(x, &v, sizeof(V));
+        for (std::size_t l = 0; l != L; ++l)
+        {
+            x[l] = fn(x[l]);
+        }
+        std::memcpy(&v, x, sizeof(V));
+        return v;
+    }
+}
+
+//-----------------------------------------------------------------------------
+//------------ GEMM (see gemm_kernels.hpp)  -----------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Packs the mc x kc block of A starting at a into MR tall slivers.
+ *        Within a sliver, the MR elements of each column are contiguous.
+ */
+template <std::size_t MR, typename T>
+inline auto pack_a(
+    const T*    a,
+    std::size_t lda,
+    std::size_t mc,
+    std::size_t kc,
+    T*          packed
+) noexcept -> void
+{
+    for (std::size_t i = 0; i < mc; i += MR)
+    {
+        const auto mr = std::min(MR, mc - i);
+        for (std::size_t p = 0; p != kc; ++p)
+        {
+            for (std::size_t r = 0; r != mr; ++r)
+            {
+                *packed++ = a[(i + r) * lda + p];
+            }
+            for (std::size_t r = mr; r != MR; ++r)
+            {
+                *packed++ = T{};
+            }
+        }
+    }
+}
+
+/**
+ * \brief Packs the kc x nc block of B starting at b into NR wide slivers.
+ *        Within a sliver, the NR elements of each row are contiguous.
+ *        Reduced precision elements (W) are widened to T on the way.
+ */
+template <std::size_t NR, typename T, typename W>
+inline auto pack_b(
+    const W*    b,
+    std::size_t ldb,
+    std::size_t kc,
+    std::size_t nc,
+    T*          packed
+) noexcept -> void
+{
+    using V                 = vec<T>;
+    constexpr std::size_t L = lanes<T>;
+
+    for (std::size_t j = 0; j < nc; j += NR)
+    {
+        const auto nr = std::min(NR, nc - j);
+        for (std::size_t p = 0; p != kc; ++p)
+        {
+            const W* src = b + p * ldb + j;
+            if constexpr (!std::same_as<W, T>)
+            {
+                if (nr == NR)
+                {
+#pragma GCC unroll 8
+                    for (std::size_t c = 0; c != NR; c += L)
+                    {
+                        store(packed + c, load_as<V>(src + c));
+                    }
+                    packed += NR;
+                    continue;
+                }
+            }
+            for (std::size_t c = 0; c != nr; ++c)
+            {
+                *packed++ = static_cast<T>(src[c]);
+            }
+            for (std::size_t c = nr; c != NR; ++c)
+            {
+                *packed++ = T{};
+            }
+        }
+    }
+}
+
+/**
+ * \brief Computes the MR x NR tile C = A_sliver * B_sliver (+ C if
+ *        accumulate) keeping the whole tile in vector registers. On the last
+ *        K panel (last), the bias is added and the epilogue applied before
+ *        the tile leaves the registers.
+ * \param mr, nr Valid extent of the tile in C (edges are written through a
+ *        local buffer)
+ * \param bias Bias of the first column of the tile
+ */
+template <
+    typename T,
+    std::size_t MR,
+    std::size_t NR,
+    typename Epilogue,
+    typename W>
+[[gnu::always_inline]]
+inline auto microkernel(
+    std::size_t     kc,
+    const T*        a,
+    const T*        b,
+    T*              c,
+    std::size_t     ldc,
+    std::size_t     mr,
+    std::size_t     nr,
+    bool            accumulate,
+    const W*        bias,
+    Epilogue const& epilogue,
+    bool            last
+) noexcept -> void
+{
+    using V                  = vec<T>;
+    constexpr std::size_t L  = lanes<T>;
+    constexpr std::size_t NV = NR / L;
+    static_assert(NR % L == 0);
+    constexpr bool Has_Epilogue = !std::same_as<Epilogue, gemm::no_epilogue>;
+
+    V acc[MR][NV]{};
+    for (std::size_t p = 0; p != kc; ++p)
+    {
+        V b_row[NV];
+#pragma GCC unroll 8
+        for (std::size_t v = 0; v != NV; ++v)
+        {
+            b_row[v] = load<V>(b + v * L);
+        }
+#pragma GCC unroll 16
+        for (std::size_t r = 0; r != MR; ++r)
+        {
+            const auto a_elem = broadcast<V>(a[r]);
+#pragma GCC unroll 8
+            for (std::size_t v = 0; v != NV; ++v)
+            {
+                acc[r][v] += a_elem * b_row[v];
+            }
+        }
+        a += MR;
+        b += NR;
+    }
+
+    const bool full_tile = (mr == MR) && (nr == NR);
+    alignas(64) T edge_buffer[MR * NR];
+    T*          dst     = full_tile ? c : edge_buffer;
+    std::size_t dst_ldc = full_tile ? ldc : NR;
+
+#pragma GCC unroll 16
+    for (std::size_t r = 0; r != MR; ++r)
+    {
+#pragma GCC unroll 8
+        for (std::size_t v = 0; v != NV; ++v)
+        {
+            T* p   = dst + r * dst_ldc + v * L;
+            V  out = full_tile && accumulate ? load<V>(p) + acc[r][v]
+                                             : acc[r][v];
+            if constexpr (Has_Epilogue)
+            {
+                if (full_tile && last)
+                {
+                    out = apply_lanes(
+                        out + load_as<V>(bias + v * L), epilogue
+                    );
+                }
+            }
+            store(p, out);
+        }
+    }
+
+    if (!full_tile)
+    {
+        for (std::size_t r = 0; r != mr; ++r)
+        {
+            for (std::size_t i = 0; i != nr; ++i)
+            {
+                T out = accumulate ? c[r * ldc + i] + edge_buffer[r * NR + i]
+                                   : edge_buffer[r * NR + i];
+                if constexpr (Has_Epilogue)
+                {
+                    if (last)
+                    {
+                        out = epilogue(out + static_cast<T>(bias[i]));
+                    }
+                }
+                c[r * ldc + i] = out;
+            }
+        }
+    }
+}
+
+/**
+ * \brief Blocked C = A * B for compile time shapes. C is overwritten.
+ *        Unless Epilogue is gemm::no_epilogue, every element of C becomes
+ *        epilogue(C[j, i] + bias[i]), applied in the microkernel of the last
+ *        K panel. B and the bias may be stored in bf16 or fp16 (W), they are
+ *        widened to T when B is packed.
+ * \tparam M Rows of A and C
+ * \tparam K Columns of A, rows of B
+ * \tparam N Columns of B and C
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           K,
+    std::size_t           N,
+    typename Epilogue,
+    typename W>
+auto gemm(
+    const T*        a,
+    std::size_t     lda,
+    const W*        b,
+    std::size_t     ldb,
+    T*              c,
+    std::size_t     ldc,
+    const W*        bias,
+    Epilogue const& epilogue
+) noexcept -> void
+{
+    using block = gemm::blocking<T, M, K, N, register_bytes>;
+    constexpr bool Has_Epilogue = !std::same_as<Epilogue, gemm::no_epilogue>;
+
+    constexpr auto MR = block::MR;
+    constexpr auto NR = block::NR;
+    constexpr auto MC = block::MC;
+    constexpr auto KC = block::KC;
+    constexpr auto NC = block::NC;
+
+    alignas(64) thread_local static T packed_a[MC * KC];
+    alignas(64) thread_local static T packed_b[KC * NC];
+
+    for (std::size_t jc = 0; jc < N; jc += NC)
+    {
+        const auto nc = std::min(NC, N - jc);
+        for (std::size_t pc = 0; pc < K; pc += KC)
+        {
+            const auto kc   = std::min(KC, K - pc);
+            const bool last = pc + kc == K;
+            pack_b<NR>(b + pc * ldb + jc, ldb, kc, nc, packed_b);
+
+            for (std::size_t ic = 0; ic < M; ic += MC)
+            {
+                const auto mc = std::min(MC, M - ic);
+                pack_a<MR>(a + ic * lda + pc, lda, mc, kc, packed_a);
+
+                for (std::size_t jr = 0; jr < nc; jr += NR)
+                {
+                    const auto nr = std::min(NR, nc - jr);
+                    for (std::size_t ir = 0; ir < mc; ir += MR)
+                    {
+                        const auto mr = std::min(MR, mc - ir);
+                        microkernel<T, MR, NR>(
+                            kc,
+                            packed_a + ir * kc,
+                            packed_b + jr * kc,
+                            c + (ic + ir) * ldc + jc + jr,
+                            ldc,
+                            mr,
+                            nr,
+                            pc != 0,
+                            Has_Epilogue ? bias + jc + jr : nullptr,
+                            epilogue,
+                            last
+                        );
+                    }
+                }
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//------------ Fused dense layer  ---------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Vectors of the fused dense layer for rows of N elements: the widest
+ *        that fit in a row, so a row of 9 floats is two overlapping 8 lane
+ *        vectors even on AVX-512. Rows of less than 16 bytes get SSE ones.
+ */
+template <typename T, std::size_t N>
+using row_vec = simd::vec<
+    T,
+    std::min(
+        register_bytes,
+        std::max<std::size_t>(16, std::bit_floor(N * sizeof(T)))
+    )>;
+
+/**
+ * \brief Computes NT column vectors of R consecutive rows of C, starting at
+ *        column vector v0, with the whole tile in registers:
+ *        C = epilogue(A * W + bias), for K columns of A and N >= L columns
+ *        of C. Both are compile time constants once inlined in dense, the
+ *        dense_dynamic kernels pass them at run time.
+ *        The last column vector of a row that is not a multiple of the vector
+ *        width is the one that ends on column N: it overlaps the previous
+ *        one, whose columns it recomputes bit for bit.
+ */
+template <
+    typename V,
+    std::size_t R,
+    std::size_t NT,
+    typename Epilogue,
+    typename Weight_Type>
+[[gnu::always_inline]]
+inline auto dense_tile(
+    const scalar_type<V>* a,
+    std::size_t           lda,
+    const Weight_Type*    w,
+    std::size_t           ldw,
+    const Weight_Type*    bias,
+    scalar_type<V>*       c,
+    std::size_t           ldc,
+    std::size_t           K,
+    std::size_t           N,
+    std::size_t           v0,
+    Epilogue const&       epilogue
+) noexcept -> void
+{
+    constexpr std::size_t L = sizeof(V) / sizeof(scalar_type<V>);
+
+    std::size_t col[NT];
+#pragma GCC unroll 8
+    for (std::size_t v = 0; v != NT; ++v)
+    {
+        col[v] = std::min((v0 + v) * L, N - L);
+    }
+
+    V acc[R][NT]{};
+    for (std::size_t k = 0; k != K; ++k)
+    {
+        V w_row[NT];
+#pragma GCC unroll 8
+        for (std::size_t v = 0; v != NT; ++v)
+        {
+            w_row[v] = load_as<V>(w + k * ldw + col[v]);
+        }
+#pragma GCC unroll 4
+        for (std::size_t r = 0; r != R; ++r)
+        {
+            const auto a_elem = broadcast<V>(a[r * lda + k]);
+#pragma GCC unroll 8
+            for (std::size_t v = 0; v != NT; ++v)
+            {
+                acc[r][v] += a_elem * w_row[v];
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (std::size_t v = 0; v != NT; ++v)
+    {
+        const V b = load_as<V>(bias + col[v]);
+#pragma GCC unroll 4
+        for (std::size_t r = 0; r != R; ++r)
+        {
+            store(c + r * ldc + col[v], apply_lanes(acc[r][v] + b, epilogue));
+        }
+    }
+}
+
+/**
+ * \brief R rows of the fused dense layer, in tiles of at most NV column
+ *        vectors.
+ */
+template <
+    typename T,
+    std::size_t R,
+    std::size_t NV,
+    std::size_t K,
+    std::size_t N,
+    typename Epilogue,
+    typename Weight_Type>
+[[gnu::always_inline]]
+inline auto dense_rows(
+    const T*           a,
+    std::size_t        lda,
+    const Weight_Type* w,
+    std::size_t        ldw,
+    const Weight_Type* bias,
+    T*                 c,
+    std::size_t        ldc,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    using V                     = row_vec<T, N>;
+    constexpr std::size_t L     = sizeof(V) / sizeof(T);
+    constexpr std::size_t N_Vec = (N + L - 1) / L;
+
+    if constexpr (N < L)
+    {
+        // Less than 16 bytes of outputs, plain scalar accumulators
+        for (std::size_t r = 0; r != R; ++r)
+        {
+            T acc[N]{};
+            for (std::size_t k = 0; k != K; ++k)
+            {
+                for (std::size_t i = 0; i != N; ++i)
+                {
+                    acc[i] += a[r * lda + k] * static_cast<T>(w[k * ldw + i]);
+                }
+            }
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                c[r * ldc + i] = epilogue(acc[i] + static_cast<T>(bias[i]));
+            }
+        }
+    }
+    else
+    {
+        std::size_t v0 = 0;
+        for (; v0 + NV <= N_Vec; v0 += NV)
+        {
+            dense_tile<V, R, NV>(
+                a, lda, w, ldw, bias, c, ldc, K, N, v0, epilogue
+            );
+        }
+        if constexpr (N_Vec % NV != 0)
+        {
+            dense_tile<V, R, N_Vec % NV>(
+                a, lda, w, ldw, bias, c, ldc, K, N, v0, epilogue
+            );
+        }
+    }
+}
+
+/**
+ * \brief Fused dense layer for compile time shapes,
+ *        C[M x N] = epilogue(A[M x K] * W[K x N] + bias[N]) with the bias and
+ *        the (element-wise) epilogue applied to the accumulators before they
+ *        are stored. Meant for the shapes of layer::forward_pass, too small
+ *        for the blocked engine: W is streamed from its rows, unpacked, once
+ *        per block of up to 4 rows of A. W and the bias may be stored in bf16
+ *        or fp16 (Weight_Type), they are widened to T as they are loaded.
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           K,
+    std::size_t           N,
+    typename Epilogue,
+    typename Weight_Type>
+auto dense(
+    const T*           a,
+    std::size_t        lda,
+    const Weight_Type* w,
+    std::size_t        ldw,
+    const Weight_Type* bias,
+    T*                 c,
+    std::size_t        ldc,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    constexpr std::size_t L     = sizeof(row_vec<T, N>) / sizeof(T);
+    constexpr std::size_t N_Vec = (N + L - 1) / L;
+    // Accumulators that fit in the register file next to a broadcast and
+    // the rows of W (16 vector registers, 32 with AVX-512)
+    constexpr std::size_t Max_Acc = register_bytes == 64 ? 24 : 12;
+
+    // Column tiles of balanced widths, rather than full ones and a narrow
+    // remainder
+    constexpr auto balanced = [](std::size_t max_width) {
+        const std::size_t tiles = (N_Vec + max_width - 1) / max_width;
+        return (N_Vec + tiles - 1) / tiles;
+    };
+    constexpr std::size_t MR  = std::min<std::size_t>(M, 4);
+    constexpr std::size_t NV  = balanced(std::min<std::size_t>(Max_Acc / MR, 8));
+    constexpr std::size_t NV1 = balanced(8);
+
+    std::size_t j = 0;
+    for (; j + MR <= M; j += MR)
+    {
+        dense_rows<T, MR, NV, K, N>(
+            a + j * lda, lda, w, ldw, bias, c + j * ldc, ldc, epilogue
+        );
+    }
+    for (; j != M; ++j)
+    {
+        dense_rows<T, 1, NV1, K, N>(
+            a + j * lda, lda, w, ldw, bias, c + j * ldc, ldc, epilogue
+        );
+    }
+}
+
+//-----------------------------------------------------------------------------
+//------------ Dense layer of run time shape  ---------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief dense for shapes only known at run time (M, K and N), with
+ *        Bytes wide vectors, N >= their lanes, and column tiles of NT
+ *        vectors. Tiles past the last column vector start over on it, so NT
+ *        should divide the column vectors of N or nearly: the tile widths
+ *        are picked per shape, see dense_dynamic_candidates. The epilogue is
+ *        stateless, it is default constructed.
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           Bytes,
+    std::size_t           NT,
+    typename Epilogue>
+auto dense_dynamic(
+    std::size_t M,
+    std::size_t K,
+    std::size_t N,
+    const T*    a,
+    std::size_t lda,
+    const T*    w,
+    std::size_t ldw,
+    const T*    bias,
+    T*          c,
+    std::size_t ldc
+) noexcept -> void
+{
+    using V                     = simd::vec<T, Bytes>;
+    constexpr std::size_t L     = Bytes / sizeof(T);
+    constexpr std::size_t MR    = 4;
+    const Epilogue        epilogue{};
+    const std::size_t     N_Vec = (N + L - 1) / L;
+
+    std::size_t j = 0;
+    for (; j + MR <= M; j += MR)
+    {
+        for (std::size_t v0 = 0; v0 < N_Vec; v0 += NT)
+        {
+            dense_tile<V, MR, NT>(
+                a + j * lda, lda, w, ldw, bias, c + j * ldc, ldc, K, N, v0,
+                epilogue
+            );
+        }
+    }
+    for (; j != M; ++j)
+    {
+        for (std::size_t v0 = 0; v0 < N_Vec; v0 += NT)
+        {
+            dense_tile<V, 1, NT>(
+                a + j * lda, lda, w, ldw, bias, c + j * ldc, ldc, K, N, v0,
+                epilogue
+            );
+        }
+    }
+}
+
+/**
+ * \brief dense_dynamic for rows of less than 16 bytes, with plain scalar
+ *        accumulators. MR rows go at once, so that their sums are
+ *        independent chains even for N = 1.
+ */
+template <gemm::gemm_value_type T, typename Epilogue>
+auto dense_dynamic_narrow(
+    std::size_t M,
+    std::size_t K,
+    std::size_t N,
+    const T*    a,
+    std::size_t lda,
+    const T*    w,
+    std::size_t ldw,
+    const T*    bias,
+    T*          c,
+    std::size_t ldc
+) noexcept -> void
+{
+    constexpr std::size_t Max_N = 16 / sizeof(T);
+    constexpr std::size_t MR    = 8;
+    const Epilogue        epilogue{};
+
+    const auto rows = [&]<std::size_t R>(std::size_t j) {
+        T acc[R][Max_N]{};
+        for (std::size_t k = 0; k != K; ++k)
+        {
+            for (std::size_t i = 0; i != N; ++i)
+            {
+#pragma GCC unroll 8
+                for (std::size_t r = 0; r != R; ++r)
+                {
+                    acc[r][i] += a[(j + r) * lda + k] * w[k * ldw + i];
+                }
+            }
+        }
+        for (std::size_t r = 0; r != R; ++r)
+        {
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                c[(j + r) * ldc + i] = epilogue(acc[r][i] + bias[i]);
+            }
+        }
+    };
+
+    std::size_t j = 0;
+    for (; j + MR <= M; j += MR)
+    {
+        rows.template operator()<MR>(j);
+    }
+    for (; j != M; ++j)
+    {
+        rows.template operator()<1>(j);
+    }
+}
+
+/**
+ * \brief dense_dynamic for a single column, N = 1: the column of W is
+ *        contiguous, so every output is a dot product of two contiguous
+ *        vectors. Rows go MR at a time, their sums being independent chains
+ *        that share the loads of W.
+ */
+template <gemm::gemm_value_type T, typename Epilogue>
+auto dense_dynamic_dot(
+    std::size_t                  M,
+    std::size_t                  K,
+    [[maybe_unused]] std::size_t N,
+    const T*                     a,
+    std::size_t                  lda,
+    const T*                     w,
+    [[maybe_unused]] std::size_t ldw,
+    const T*                     bias,
+    T*                           c,
+    std::size_t                  ldc
+) noexcept -> void
+{
+    using V                  = vec<T>;
+    constexpr std::size_t L  = lanes<T>;
+    constexpr std::size_t MR = 4;
+    const Epilogue        epilogue{};
+
+    const auto rows = [&]<std::size_t R>(std::size_t j) {
+        T           sum[R]{};
+        std::size_t k = 0;
+        if (K >= L)
+        {
+            V acc[R]{};
+            for (; k + L <= K; k += L)
+            {
+                const V w_vec = load<V>(w + k);
+#pragma GCC unroll 4
+                for (std::size_t r = 0; r != R; ++r)
+                {
+                    acc[r] += load<V>(a + (j + r) * lda + k) * w_vec;
+                }
+            }
+#pragma GCC unroll 4
+            for (std::size_t r = 0; r != R; ++r)
+            {
+                sum[r] = horizontal_sum(acc[r]);
+            }
+        }
+        for (; k != K; ++k)
+        {
+#pragma GCC unroll 4
+            for (std::size_t r = 0; r != R; ++r)
+            {
+                sum[r] += a[(j + r) * lda + k] * w[k];
+            }
+        }
+#pragma GCC unroll 4
+        for (std::size_t r = 0; r != R; ++r)
+        {
+            c[(j + r) * ldc] = epilogue(sum[r] + bias[0]);
+        }
+    };
+
+    std::size_t j = 0;
+    for (; j + MR <= M; j += MR)
+    {
+        rows.template operator()<MR>(j);
+    }
+    for (; j != M; ++j)
+    {
+        rows.template operator()<1>(j);
+    }
+}
+
+/**
+ * \brief The dense_dynamic kernels of this tier fit for rows of N
+ *        elements, by column tile width: the vectors are the widest that fit
+ *        in a row (as row_vec), the tiles go from 1 vector to as many as the
+ *        accumulators of 4 rows fit in the register file. Rows of less than
+ *        16 bytes only have one kernel, dot products for a single column and
+ *        scalar accumulators otherwise. Unused entries are null.
+ */
+template <gemm::gemm_value_type T, typename Epilogue>
+[[nodiscard]]
+auto dense_dynamic_tiles(std::size_t N) noexcept
+    -> std::array<dense_dynamic_kernel<T>, dense_dynamic_max_tile>
+{
+    // Accumulators of 4 rows that fit in the register file, as in dense
+    constexpr std::size_t Max_NT = std::min<std::size_t>(
+        (register_bytes == 64 ? 24 : 12) / 4, dense_dynamic_max_tile
+    );
+
+    std::array<dense_dynamic_kernel<T>, dense_dynamic_max_tile> kernels{};
+    const auto bytes = std::min(
+        register_bytes, std::max<std::size_t>(16, std::bit_floor(N * sizeof(T)))
+    );
+    if (N * sizeof(T) < 16)
+    {
+        kernels[0] = N == 1 ? &dense_dynamic_dot<T, Epilogue>
+                            : &dense_dynamic_narrow<T, Epilogue>;
+        return kernels;
+    }
+
+    const auto fill = [&]<std::size_t Bytes>() {
+        const auto n_vec = (N * sizeof(T) + Bytes - 1) / Bytes;
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((kernels[I] = I < n_vec
+                   ? &dense_dynamic<T, Bytes, I + 1, Epilogue>
+                   : nullptr),
+             ...);
+        }(std::make_index_sequence<Max_NT>{});
+    };
+    if constexpr (register_bytes >= 64)
+    {
+        if (bytes == 64)
+        {
+            fill.template operator()<64>();
+            return kernels;
+        }
+    }
+    if constexpr (register_bytes >= 32)
+    {
+        if (bytes == 32)
+        {
+            fill.template operator()<32>();
+            return kernels;
+        }
+    }
+    fill.template operator()<16>();
+    return kernels;
+}
+
+//-----------------------------------------------------------------------------
+//------------ Unrolled dense layer  ------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Sum of the P accumulator chains of column vector v, as a tree
+ */
+template <typename V, std::size_t P, std::size_t NT>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto sum_chains(V (&acc)[P][NT], std::size_t v) noexcept -> V
+{
+    static_assert(P >= 1 && P <= 4);
+    if constexpr (P == 4)
+    {
+        return (acc[0][v] + acc[1][v]) + (acc[2][v] + acc[3][v]);
+    }
+    else if constexpr (P == 3)
+    {
+        return (acc[0][v] + acc[1][v]) + acc[2][v];
+    }
+    else if constexpr (P == 2)
+    {
+        return acc[0][v] + acc[1][v];
+    }
+    else
+    {
+        return acc[0][v];
+    }
+}
+
+/**
+ * \brief Column vectors [V0, V0 + NT) of one row of the unrolled dense layer,
+ *        with the columns placed as in dense_tile. The K steps are unrolled
+ *        and spread over P accumulator chains, so a row of a tiny layer is
+ *        not one long chain of dependent FMAs.
+ */
+template <
+    typename V,
+    std::size_t P,
+    std::size_t NT,
+    std::size_t V0,
+    std::size_t K,
+    std::size_t N,
+    std::size_t Ldw,
+    typename Epilogue,
+    typename Weight_Type>
+[[gnu::always_inline]]
+inline auto unrolled_tile(
+    const scalar_type<V>* a,
+    const Weight_Type*    w,
+    const Weight_Type*    bias,
+    scalar_type<V>*       c,
+    Epilogue const&       epilogue
+) noexcept -> void
+{
+    constexpr std::size_t L = sizeof(V) / sizeof(scalar_type<V>);
+
+    std::size_t col[NT];
+#pragma GCC unroll 16
+    for (std::size_t v = 0; v != NT; ++v)
+    {
+        col[v] = std::min((V0 + v) * L, N - L);
+    }
+
+    V acc[P][NT]{};
+#pragma GCC unroll 256
+    for (std::size_t k = 0; k != K; ++k)
+    {
+        const auto a_elem = broadcast<V>(a[k]);
+#pragma GCC unroll 16
+        for (std::size_t v = 0; v != NT; ++v)
+        {
+            acc[k % P][v] += a_elem * load_as<V>(w + k * Ldw + col[v]);
+        }
+    }
+
+#pragma GCC unroll 16
+    for (std::size_t v = 0; v != NT; ++v)
+    {
+        const V sum = sum_chains(acc, v) + load_as<V>(bias + col[v]);
+        store(c + col[v], apply_lanes(sum, epilogue));
+    }
+}
+
+/**
+ * \brief One row of the unrolled dense layer, in Tiles tiles of at most NT
+ *        of its N_Vec column vectors
+ */
+template <
+    typename V,
+    std::size_t P,
+    std::size_t NT,
+    std::size_t N_Vec,
+    std::size_t K,
+    std::size_t N,
+    std::size_t Ldw,
+    typename Epilogue,
+    typename Weight_Type,
+    std::size_t... Tile>
+[[gnu::always_inline]]
+inline auto unrolled_row(
+    const scalar_type<V>* a,
+    const Weight_Type*    w,
+    const Weight_Type*    bias,
+    scalar_type<V>*       c,
+    Epilogue const&       epilogue,
+    std::index_sequence<Tile...>
+) noexcept -> void
+{
+    static_assert(NT * (sizeof...(Tile) - 1) < N_Vec);
+    (unrolled_tile<V, P, std::min(NT, N_Vec - Tile * NT), Tile * NT, K, N, Ldw>(
+         a, w, bias, c, epilogue
+     ),
+     ...);
+}
+
+/**
+ * \brief One row of the unrolled dense layer with less than 16 bytes of
+ *        outputs. A single output with contiguous weights is a dot product,
+ *        vectorized along K. Otherwise the few columns are scalar chains.
+ */
+template <
+    typename T,
+    std::size_t K,
+    std::size_t N,
+    std::size_t Ldw,
+    typename Epilogue,
+    typename Weight_Type>
+[[gnu::always_inline]]
+inline auto unrolled_narrow_row(
+    const T*           a,
+    const Weight_Type* w,
+    const Weight_Type* bias,
+    T*                 c,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    if constexpr (N == 1 && Ldw == 1 && K * sizeof(T) >= 16)
+    {
+        using V = simd::vec<
+            T,
+            std::min(register_bytes, std::bit_floor(K * sizeof(T)))>;
+        constexpr std::size_t L  = sizeof(V) / sizeof(T);
+        constexpr std::size_t P  = std::min<std::size_t>(K / L, 4);
+        constexpr std::size_t NL = K / L * L;
+
+        V acc[P][1]{};
+#pragma GCC unroll 32
+        for (std::size_t k = 0; k != NL; k += L)
+        {
+            acc[k / L % P][0] += load<V>(a + k) * load_as<V>(w + k);
+        }
+        if constexpr (NL != K)
+        {
+            acc[P - 1][0] += load_partial<V, K - NL>(a + NL) *
+                             load_partial_as<V, K - NL>(w + NL);
+        }
+        c[0] = epilogue(
+            horizontal_sum(sum_chains(acc, 0)) + static_cast<T>(bias[0])
+        );
+    }
+    else
+    {
+        constexpr std::size_t P = std::min<std::size_t>(K, 4);
+
+        T acc[P][N]{};
+#pragma GCC unroll 256
+        for (std::size_t k = 0; k != K; ++k)
+        {
+#pragma GCC unroll 4
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                acc[k % P][i] += a[k] * static_cast<T>(w[k * Ldw + i]);
+            }
+        }
+#pragma GCC unroll 4
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            c[i] = epilogue(sum_chains(acc, i) + static_cast<T>(bias[i]));
+        }
+    }
+}
+
+/**
+ * \brief Fused dense layer for the tiny shapes of gemm::use_unrolled_dense,
+ *        C[M x N] = epilogue(A[M x K] * W[K x N] + bias[N]), with the whole
+ *        shape and the leading dimensions known at compile time. Every loop
+ *        is unrolled: rows, K steps and column vectors. Vectors are the
+ *        widest that fit in a row of C, so a row of 9 floats is two
+ *        overlapping 8 lane vectors even on AVX-512. The K steps are split
+ *        over up to 4 accumulator chains, as many as the register file holds
+ *        next to the columns. W and the bias may be stored in bf16 or fp16.
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           K,
+    std::size_t           N,
+    std::size_t           Lda,
+    std::size_t           Ldw,
+    std::size_t           Ldc,
+    typename Epilogue,
+    typename Weight_Type>
+auto dense_unrolled(
+    const T*           a,
+    const Weight_Type* w,
+    const Weight_Type* bias,
+    T*                 c,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    if constexpr (N * sizeof(T) < 16)
+    {
+#pragma GCC unroll 16
+        for (std::size_t j = 0; j != M; ++j)
+        {
+            unrolled_narrow_row<T, K, N, Ldw>(
+                a + j * Lda, w, bias, c + j * Ldc, epilogue
+            );
+        }
+    }
+    else
+    {
+        using V = simd::vec<
+            T,
+            std::min(register_bytes, std::bit_floor(N * sizeof(T)))>;
+        constexpr std::size_t L     = sizeof(V) / sizeof(T);
+        constexpr std::size_t N_Vec = (N + L - 1) / L;
+        // Accumulators that fit in the register file next to a broadcast and
+        // a row of W (16 vector registers, 32 with AVX-512)
+        constexpr std::size_t Max_Acc = register_bytes == 64 ? 24 : 12;
+        constexpr std::size_t P = std::clamp<std::size_t>(
+            Max_Acc / N_Vec, 1, std::min<std::size_t>(K, 4)
+        );
+        constexpr std::size_t Tiles = (N_Vec * P + Max_Acc - 1) / Max_Acc;
+        constexpr std::size_t NT    = (N_Vec + Tiles - 1) / Tiles;
+
+#pragma GCC unroll 16
+        for (std::size_t j = 0; j != M; ++j)
+        {
+            unrolled_row<V, P, NT, N_Vec, K, N, Ldw>(
+                a + j * Lda,
+                w,
+                bias,
+                c + j * Ldc,
+                epilogue,
+                std::make_index_sequence<Tiles>{}
+            );
+        }
+    }
+}
+
+/**
+ * \brief dense_dynamic for K x N layers of packed rows (lda = K, ldw = ldc
+ *        = N), K and N known at compile time: dense_unrolled over blocks of
+ *        MR rows, as many as its budget of vector FMAs allows, then single
+ *        rows. Only M is left to run time.
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           K,
+    std::size_t           N,
+    typename Epilogue>
+auto dense_dynamic_unrolled(
+    std::size_t                  M,
+    [[maybe_unused]] std::size_t k,
+    [[maybe_unused]] std::size_t n,
+    const T*                     a,
+    [[maybe_unused]] std::size_t lda,
+    const T*                     w,
+    [[maybe_unused]] std::size_t ldw,
+    const T*                     bias,
+    T*                           c,
+    [[maybe_unused]] std::size_t ldc
+) noexcept -> void
+{
+    assert(k == K && n == N && lda == K && ldw == N && ldc == N);
+    constexpr std::size_t N_Vec = (N + lanes<T> - 1) / lanes<T>;
+    constexpr std::size_t MR =
+        std::clamp<std::size_t>(std::bit_floor(256 / (K * N_Vec)), 1, 8);
+    const Epilogue epilogue{};
+
+    // Parenthesised, so that the epilogue does not bring in the dispatching
+    // ga_sm::simd::dense_unrolled by argument dependent lookup
+    std::size_t j = 0;
+    for (; j + MR <= M; j += MR)
+    {
+        (dense_unrolled<T, MR, K, N, K, N, N>)(
+            a + j * K, w, bias, c + j * N, epilogue
+        );
+    }
+    for (; j != M; ++j)
+    {
+        (dense_unrolled<T, 1, K, N, K, N, N>)(
+            a + j * K, w, bias, c + j * N, epilogue
+        );
+    }
+}
+
+/**
+ * \brief The dense_dynamic kernels of this tier fit for K x N layers: those
+ *        of dense_dynamic_tiles and, if K x N is one of
+ *        dense_dynamic_unrolled_shapes and a row of it fits the registers
+ *        of this tier, dense_dynamic_unrolled. Unused entries are null.
+ */
+template <gemm::gemm_value_type T, typename Epilogue>
+[[nodiscard]]
+auto dense_dynamic_candidates(std::size_t K, std::size_t N) noexcept
+    -> std::array<dense_dynamic_kernel<T>, dense_dynamic_max_tile>
+{
+    auto kernels = dense_dynamic_tiles<T, Epilogue>(N);
+    const auto unused = std::ranges::find(kernels, nullptr);
+    if (unused == kernels.end())
+    {
+        return kernels;
+    }
+
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        const auto unrolled = [&]<std::size_t Shape>() {
+            constexpr auto Shape_K = dense_dynamic_unrolled_shapes[Shape].first;
+            constexpr auto Shape_N =
+                dense_dynamic_unrolled_shapes[Shape].second;
+            constexpr auto N_Vec = (Shape_N + lanes<T> - 1) / lanes<T>;
+            if constexpr (N_Vec <= 4 && Shape_K * N_Vec <= 256)
+            {
+                if (K == Shape_K && N == Shape_N)
+                {
+                    *unused =
+                        &dense_dynamic_unrolled<T, Shape_K, Shape_N, Epilogue>;
+                }
+            }
+        };
+        (unrolled.template operator()<I>(), ...);
+    }(std::make_index_sequence<dense_dynamic_unrolled_shapes.size()>{});
+    return kernels;
+}
+
+//-----------------------------------------------------------------------------
+//------------ Transposed dense layer  ----------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief One step of transpose_sum: folds every W lane segment of a and b in
+ *        half and interleaves the halves, a's first, into W / 2 lane segments
+ */
+template <std::size_t W, typename V, std::size_t... P>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto fold_pair(V const& a, V const& b, std::index_sequence<P...>)
+    noexcept -> V
+{
+    constexpr std::size_t L = sizeof...(P);
+    return __builtin_shufflevector(
+               a,
+               b,
+               (P % W < W / 2 ? P / W * W + P % W
+                              : L + P / W * W + P % W - W / 2)...
+           ) +
+        __builtin_shufflevector(
+               a,
+               b,
+               (P % W < W / 2 ? P / W * W + P % W + W / 2
+                              : L + P / W * W + P % W)...
+        );
+}
+
+/**
+ * \brief Horizontal sums of N = lanes vectors at once: lane i of the result
+ *        is the sum of the lanes of v[i]. log2(N) levels of shuffles and adds
+ *        instead of N separate reductions.
+ */
+template <std::size_t N, typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto transpose_sum(V const (&v)[N]) noexcept -> V
+{
+    if constexpr (N == 1)
+    {
+        return v[0];
+    }
+    else
+    {
+        constexpr std::size_t L = sizeof(V) / sizeof(scalar_type<V>);
+        static_assert(N <= L);
+
+        V folded[N / 2];
+#pragma GCC unroll 16
+        for (std::size_t m = 0; m != N / 2; ++m)
+        {
+            folded[m] = fold_pair<N>(
+                v[m], v[m + N / 2], std::make_index_sequence<L>{}
+            );
+        }
+        return transpose_sum(folded);
+    }
+}
+
+/**
+ * \brief The last Count < lanes elements of a row of K >= lanes elements of
+ *        type W, in the last lanes of the vector ending on the row end, with
+ *        the lanes in front zeroed (see load_tail)
+ */
+template <typename V, std::size_t Count, std::size_t K, typename W>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto load_row_tail(const W* row) noexcept -> V
+{
+    constexpr std::size_t L = sizeof(V) / sizeof(scalar_type<V>);
+    static_assert(Count < L && K >= L);
+
+    return tail_mask<V, Count>(std::make_index_sequence<L>{})
+        ? load_as<V>(row + K - L)
+        : V{};
+}
+
+/**
+ * \brief Outputs i0 .. i0 + R (R <= lanes) of one row of the transposed
+ *        dense layer: R dot products of the row of A with rows of W in
+ *        independent FMA chains, reduced together by transpose_sum, so the
+ *        bias and the epilogue are applied and stored a vector at a time.
+ */
+template <
+    typename V,
+    std::size_t R,
+    std::size_t K,
+    std::size_t Ldw,
+    typename Epilogue,
+    typename Weight_Type>
+[[gnu::always_inline]]
+inline auto transposed_outputs(
+    const scalar_type<V>* a,
+    const Weight_Type*    w,
+    const Weight_Type*    bias,
+    scalar_type<V>*       c,
+    Epilogue const&       epilogue
+) noexcept -> void
+{
+    constexpr std::size_t L      = sizeof(V) / sizeof(scalar_type<V>);
+    constexpr std::size_t K_Body = K / L * L;
+    static_assert(R <= L && K >= L);
+
+    // Zeroed past R, so the reduction works on L vectors either way
+    V acc[L]{};
+#pragma GCC unroll 16
+    for (std::size_t k = 0; k != K_Body; k += L)
+    {
+        const V x = load<V>(a + k);
+#pragma GCC unroll 16
+        for (std::size_t r = 0; r != R; ++r)
+        {
+            acc[r] += load_as<V>(w + r * Ldw + k) * x;
+        }
+    }
+    if constexpr (K_Body != K)
+    {
+        constexpr std::size_t Tail = K - K_Body;
+        const V x = load_row_tail<V, Tail, K>(a);
+#pragma GCC unroll 16
+        for (std::size_t r = 0; r != R; ++r)
+        {
+            acc[r] += load_row_tail<V, Tail, K>(w + r * Ldw) * x;
+        }
+    }
+
+    if constexpr (R == L)
+    {
+        const V b = load_as<V>(bias);
+        store(c, apply_lanes(transpose_sum(acc) + b, epilogue));
+    }
+    else if constexpr (R == 1)
+    {
+        c[0] = epilogue(
+            horizontal_sum(acc[0]) + static_cast<scalar_type<V>>(bias[0])
+        );
+    }
+    else
+    {
+        const V b   = load_partial_as<V, R>(bias);
+        const V out = apply_lanes(transpose_sum(acc) + b, epilogue);
+        std::memcpy(c, &out, R * sizeof(scalar_type<V>));
+    }
+}
+
+/**
+ * \brief Fused dense layer on output-major weights,
+ *        C[M x N] = epilogue(A[M x K] * transpose(W[N x K]) + bias[N]), with
+ *        the shape and the leading dimensions known at compile time. Every
+ *        output is the dot product of a row of A with a contiguous row of W,
+ *        a vector of outputs at a time (see transposed_outputs). Vectors are
+ *        the widest that fit in a row of A, K >= 4 floats. W and the bias may
+ *        be stored in bf16 or fp16.
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           K,
+    std::size_t           N,
+    std::size_t           Lda,
+    std::size_t           Ldw,
+    std::size_t           Ldc,
+    typename Epilogue,
+    typename Weight_Type>
+auto dense_transposed(
+    const T*           a,
+    const Weight_Type* w,
+    const Weight_Type* bias,
+    T*                 c,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    static_assert(K * sizeof(T) >= 16);
+    using V = simd::vec<
+        T,
+        std::min(register_bytes, std::bit_floor(K * sizeof(T)))>;
+    constexpr std::size_t L      = sizeof(V) / sizeof(T);
+    constexpr std::size_t N_Body = N / L * L;
+
+    for (std::size_t j = 0; j != M; ++j)
+    {
+        for (std::size_t i = 0; i != N_Body; i += L)
+        {
+            transposed_outputs<V, L, K, Ldw>(
+                a + j * Lda, w + i * Ldw, bias + i, c + j * Ldc + i, epilogue
+            );
+        }
+        if constexpr (N_Body != N)
+        {
+            transposed_outputs<V, N - N_Body, K, Ldw>(
+                a + j * Lda,
+                w + N_Body * Ldw,
+                bias + N_Body,
+                c + j * Ldc + N_Body,
+                epilogue
+            );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//------------ Matrix vector product  -----------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Dot products of R consecutive rows of mat with B vectors, keeping
+ *        R x B independent FMA chains in registers. Each accumulator is only
+ *        reduced horizontally once, after the whole row has been swept.
+ * \param sums sums[r][b] = mat row r . vector b
+ */
+template <
+    typename T,
+    std::size_t R,
+    std::size_t B,
+    std::size_t N,
+    std::size_t Row_Stride>
+[[gnu::always_inline]]
+inline auto dot_block(const T* mat, const T* v, T (&sums)[R][B]) noexcept
+    -> void
+{
+    using V                      = vec<T>;
+    constexpr std::size_t L      = lanes<T>;
+    constexpr std::size_t N_Body = Row_Stride / L * L;
+
+    V acc[R][B]{};
+    for (std::size_t i = 0; i != N_Body; i += L)
+    {
+        V rows[R];
+#pragma GCC unroll 8
+        for (std::size_t r = 0; r != R; ++r)
+        {
+            rows[r] = load<V>(mat + r * Row_Stride + i);
+        }
+#pragma GCC unroll 8
+        for (std::size_t b = 0; b != B; ++b)
+        {
+            const V x = load<V>(v + b * Row_Stride + i);
+#pragma GCC unroll 8
+            for (std::size_t r = 0; r != R; ++r)
+            {
+                acc[r][b] += rows[r] * x;
+            }
+        }
+    }
+    if constexpr (N_Body < N)
+    {
+        constexpr std::size_t Tail = N - N_Body;
+#pragma GCC unroll 8
+        for (std::size_t b = 0; b != B; ++b)
+        {
+            const V x = load_tail<V, Tail, N>(v + b * Row_Stride + N);
+#pragma GCC unroll 8
+            for (std::size_t r = 0; r != R; ++r)
+            {
+                acc[r][b] +=
+                    load_tail<V, Tail, N>(mat + r * Row_Stride + N) * x;
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (std::size_t r = 0; r != R; ++r)
+    {
+#pragma GCC unroll 8
+        for (std::size_t b = 0; b != B; ++b)
+        {
+            sums[r][b] = horizontal_sum(acc[r][b]);
+        }
+    }
+}
+
+/**
+ * \brief Multiplies mat[M x N] by B <= 8 vectors of N elements each:
+ *        out[j * ldo_row + b * ldo_batch] = mat row j . vector b.
+ *        Rows are processed in blocks of 8 / B so every row load feeds
+ *        several vectors (or, for B = 1, several rows are in flight), which
+ *        keeps enough FMA chains independent to hide their latency.
+ * \tparam Row_Stride Elements between rows of mat and between the vectors.
+ *         Padding past N must be 0: when Row_Stride is a multiple of the
+ *         vector width the rows are swept whole. Otherwise the last partial
+ *         vector of each row is loaded into a zeroed register.
+ * \tparam Alignment Alignment of mat and v in bytes
+ */
+template <
+    gemm::gemm_value_type T,
+    std::size_t           M,
+    std::size_t           N,
+    std::size_t           B,
+    std::size_t           Row_Stride,
+    std::size_t           Alignment>
+auto matvec_batch(
+    const T*    mat,
+    const T*    v,
+    T*          out,
+    std::size_t ldo_row,
+    std::size_t ldo_batch
+) noexcept -> void
+{
+    static_assert(B >= 1 && B <= 8);
+    constexpr std::size_t R      = 8 / B;
+    constexpr std::size_t M_Body = M / R * R;
+
+    mat = static_cast<const T*>(__builtin_assume_aligned(mat, Alignment));
+    v   = static_cast<const T*>(__builtin_assume_aligned(v, Alignment));
+
+    for (std::size_t j = 0; j != M_Body; j += R)
+    {
+        T sums[R][B];
+        dot_block<T, R, B, N, Row_Stride>(mat + j * Row_Stride, v, sums);
+#pragma GCC unroll 8
+        for (std::size_t r = 0; r != R; ++r)
+        {
+#pragma GCC unroll 8
+            for (std::size_t b = 0; b != B; ++b)
+            {
+                out[(j + r) * ldo_row + b * ldo_batch] = sums[r][b];
+            }
+        }
+    }
+    for (std::size_t j = M_Body; j != M; ++j)
+    {
+        T sums[1][B];
+        dot_block<T, 1, B, N, Row_Stride>(mat + j * Row_Stride, v, sums);
+#pragma GCC unroll 8
+        for (std::size_t b = 0; b != B; ++b)
+        {
+            out[j * ldo_row + b * ldo_batch] = sums[0][b];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//------------ Sparse net plan  -----------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief The V of values[idx[0]], ..., values[idx[lanes - 1]]: one gather
+ *        instruction from AVX2 on, lane by lane below
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto gather(const scalar_type<V>* values, const std::uint32_t* idx)
+    noexcept -> V
+{
+    using T = scalar_type<V>;
+    // The indices are read as int32, every plan fits. The unmasked forms
+    // read an undefined source vector.
+    if constexpr (sizeof(V) == 64 && std::same_as<T, float>)
+    {
+        __m512i index;
+        std::memcpy(&index, idx, sizeof(index));
+        return __builtin_bit_cast(
+            V,
+            _mm512_mask_i32gather_ps(
+                _mm512_setzero_ps(), 0xffff, index, values, 4
+            )
+        );
+    }
+    else if constexpr (sizeof(V) == 64)
+    {
+        __m256i index;
+        std::memcpy(&index, idx, sizeof(index));
+        return __builtin_bit_cast(
+            V,
+            _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xff, index, values, 8)
+        );
+    }
+    else if constexpr (sizeof(V) == 32 && std::same_as<T, float>)
+    {
+        __m256i index;
+        std::memcpy(&index, idx, sizeof(index));
+        const auto all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        return __builtin_bit_cast(
+            V,
+            _mm256_mask_i32gather_ps(_mm256_setzero_ps(), values, index, all, 4)
+        );
+    }
+    else if constexpr (sizeof(V) == 32)
+    {
+        __m128i index;
+        std::memcpy(&index, idx, sizeof(index));
+        const auto all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        return __builtin_bit_cast(
+            V,
+            _mm256_mask_i32gather_pd(_mm256_setzero_pd(), values, index, all, 8)
+        );
+    }
+    else
+    {
+        V ret;
+#pragma GCC unroll 4
+        for (std::size_t l = 0; l != sizeof(V) / sizeof(T); ++l)
+        {
+            ret[l] = values[idx[l]];
+        }
+        return ret;
+    }
+}
+
+/**
+ * \brief Runs nodes nodes of the flat plan of a sparse net (see
+ *        ga_snn::neat_neural_net), in order:
+ *        out[n] = epilogue(sum over e in [offsets[n], offsets[n + 1]) of
+ *        values[sources[e]] * weights[e], + bias[n]). Full vectors of inputs
+ *        are gathered into 2 independent chains, the rest is summed by
+ *        scalars. out may point into values: a node can read the outputs of
+ *        the nodes run before it.
+ */
+template <typename T, typename Epilogue>
+auto gather_plan(
+    std::size_t          nodes,
+    const std::uint32_t* offsets,
+    const std::uint32_t* sources,
+    const T*             weights,
+    const T*             bias,
+    const T*             values,
+    T*                   out
+) noexcept -> void
+{
+    using V                 = vec<T>;
+    constexpr std::size_t L = lanes<T>;
+    const Epilogue        epilogue{};
+
+    for (std::size_t n = 0; n != nodes; ++n)
+    {
+        auto       e    = std::size_t{ offsets[n] };
+        const auto last = std::size_t{ offsets[n + 1] };
+
+        T sum{};
+        if (last - e >= L)
+        {
+            V acc[2]{};
+            for (; e + 2 * L <= last; e += 2 * L)
+            {
+                acc[0] += gather<V>(values, sources + e) * load<V>(weights + e);
+                acc[1] += gather<V>(values, sources + e + L) *
+                          load<V>(weights + e + L);
+            }
+            if (e + L <= last)
+            {
+                acc[0] += gather<V>(values, sources + e) * load<V>(weights + e);
+                e += L;
+            }
+            sum = horizontal_sum(acc[0] + acc[1]);
+        }
+        for (; e != last; ++e)
+        {
+            sum += values[sources[e]] * weights[e];
+        }
+        out[n] = epilogue(sum + bias[n]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+//------------ Softmax  -------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief e^d for d <= 0, d being clamped to -87 whose e^d is still a normal
+ *        float: an instruction that produces subnormals takes a microcode
+ *        assist on x86, which costs more than a whole row
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto softmax_exp(V d) noexcept -> V
+{
+    return exp(d < -87.f ? V{} - 87.f : d);
+}
+
+/**
+ * \brief Online softmax step: folds the lanes of x selected by valid into
+ *        the running max m and sum s of e^(x - m) of every lane. Whichever of
+ *        m and x is the larger becomes the max, the other comes in scaled by
+ *        e^-|x - m|, so a step takes a single exp. The other lanes of x are
+ *        replaced by m first, their e^0 being discarded. x == m counts as
+ *        e^0 without the subtraction, which is nan for -inf logits (the
+ *        masked moves of a policy head).
+ */
+template <typename V, typename Mask>
+[[gnu::always_inline]]
+inline auto softmax_step(V x, Mask valid, V& m, V& s) noexcept -> void
+{
+    x                = valid ? x : m;
+    const auto above = x > m;
+    const V    d     = above ? m - x : x - m;
+    const V    e     = softmax_exp(x == m ? V{} : d);
+    s                = valid ? (above ? s * e + 1.f : s + e) : s;
+    m                = above ? x : m;
+}
+
+/**
+ * \brief e^(x - max) / sum, 0 below e^-87 (see softmax_exp)
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto softmax_output(V x, V max, V sum) noexcept -> V
+{
+    const V d = x - max;
+    return d < -87.f ? V{} : softmax_exp(d) / sum;
+}
+
+/**
+ * \brief softmax of a row of (K - 1) * lanes < N <= K * lanes of V floats, in
+ *        K registers of type V, loaded element by element if Each (see
+ *        load_each): one exp per element and a single sum
+ */
+template <typename V, std::size_t K, bool Each>
+[[gnu::always_inline]]
+inline auto softmax_short(float* row, std::size_t N) noexcept -> void
+{
+    constexpr std::size_t L = sizeof(V) / sizeof(float);
+    constexpr std::size_t B = (K - 1) * L;
+
+    const auto       head = head_mask<V>(N - B, std::make_index_sequence<L>{});
+    std::array<V, K> x;
+#pragma GCC unroll 2
+    for (std::size_t k = 0; k + 1 != K; ++k)
+    {
+        x[k] = Each ? load_each<V>(row + k * L, L) : load<V>(row + k * L);
+    }
+    x[K - 1] = Each ? load_each<V>(row + B, N - B)
+                    : load_first<V>(row + B, N - B);
+
+    V max = head ? x[K - 1] : row[0];
+#pragma GCC unroll 2
+    for (std::size_t k = 0; k + 1 != K; ++k)
+    {
+        max = x[k] > max ? x[k] : max;
+    }
+    max = broadcast<V>(horizontal_max(max));
+
+    std::array<V, K> d;
+    std::array<V, K> e;
+    V                sum{};
+#pragma GCC unroll 2
+    for (std::size_t k = 0; k != K; ++k)
+    {
+        d[k] = x[k] - max;
+        e[k] = softmax_exp(d[k]);
+        sum += k + 1 == K ? (head ? e[k] : V{}) : e[k];
+    }
+    sum = broadcast<V>(horizontal_sum(sum));
+#pragma GCC unroll 2
+    for (std::size_t k = 0; k + 1 != K; ++k)
+    {
+        store(row + k * L, d[k] < -87.f ? V{} : e[k] / sum);
+    }
+    store_first(row + B, d[K - 1] < -87.f ? V{} : e[K - 1] / sum, N - B);
+}
+
+/**
+ * \brief softmax_short of a row of up to two vectors, in the fewest
+ *        registers. Whether the row was one.
+ */
+template <bool Each>
+[[gnu::always_inline]]
+inline auto softmax_in_registers(float* row, std::size_t N) noexcept -> bool
+{
+    using V                 = vec<float>;
+    constexpr std::size_t L = lanes<float>;
+
+    // Half a 512 bit register is enough for the policy heads of the game
+    // agents (7 moves), with shorter reductions
+    if constexpr (sizeof(V) == 64)
+    {
+        if (N <= L / 2)
+        {
+            softmax_short<simd::vec<float, 32>, 1, Each>(row, N);
+            return true;
+        }
+    }
+    if (N <= L)
+    {
+        softmax_short<V, 1, Each>(row, N);
+        return true;
+    }
+    // Two registers still take one exp per element, where the online passes
+    // take two
+    if (N <= 2 * L)
+    {
+        softmax_short<V, 2, Each>(row, N);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * \brief softmax of each of the M rows of N floats of c, in place, for any
+ *        N. A first pass folds the row into a running max and sum per lane
+ *        (see softmax_step), the lanes are merged, then a second pass writes
+ *        e^(x - max) / sum. A row of up to two vectors stays in registers,
+ *        with a single exp per element. The exps are those of
+ *        vector_math.hpp, outputs below e^-87 (1.6e-38) may be flushed to 0.
+ */
+inline auto softmax(std::size_t M, std::size_t N, float* c, std::size_t ldc)
+    noexcept -> void
+{
+    using V                 = vec<float>;
+    constexpr std::size_t L = lanes<float>;
+    constexpr auto        I = std::make_index_sequence<L>{};
+
+    // A single row is latency bound: loads of its elements forward from the
+    // stores that just wrote it
+    if (M == 1 && softmax_in_registers<true>(c, N))
+    {
+        return;
+    }
+
+    const auto NL   = N / L * L;
+    const auto all  = head_mask<V>(L, I);
+    const auto tail = head_mask<V>(N - NL, I);
+
+    for (std::size_t j = 0; j != M; ++j)
+    {
+        float* const row = c + j * ldc;
+
+        if (softmax_in_registers<false>(row, N))
+        {
+            continue;
+        }
+
+        // Every lane starts from an empty sum under a max of row[0]
+        V m = broadcast<V>(row[0]);
+        V s{};
+        for (std::size_t i = 0; i != NL; i += L)
+        {
+            softmax_step(load<V>(row + i), all, m, s);
+        }
+        if (NL != N)
+        {
+            softmax_step(load_first<V>(row + NL, N - NL), tail, m, s);
+        }
+
+        const V max = broadcast<V>(horizontal_max(m));
+        const V sum = broadcast<V>(horizontal_sum(s * softmax_exp(m - max)));
+        for (std::size_t i = 0; i != NL; i += L)
+        {
+            store(row + i, softmax_output(load<V>(row + i), max, sum));
+        }
+        if (NL != N)
+        {
+            const V x = load_first<V>(row + NL, N - NL);
+            store_first(row + NL, softmax_output(x, max, sum), N - NL);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//------------ Weight gradients  ----------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief NT column vectors of row k of c += transpose(a) * b, starting at
+ *        column vector v0, summed over the M rows in registers and added to
+ *        c once. As in dense_tile, the last column vector of a row that is not
+ *        a multiple of the vector width ends on column N; the lanes it shares
+ *        with the previous one are zeroed before it is added.
+ */
+template <
+    typename V,
+    std::size_t NT,
+    std::size_t M,
+    std::size_t N,
+    std::size_t Lda,
+    std::size_t Ldb>
+[[gnu::always_inline]]
+inline auto transposed_multiply_tile(
+    const scalar_type<V>* a,
+    const scalar_type<V>* b,
+    scalar_type<V>*       c,
+    std::size_t           v0
+) noexcept -> void
+{
+    constexpr std::size_t L     = sizeof(V) / sizeof(scalar_type<V>);
+    constexpr std::size_t N_Vec = (N + L - 1) / L;
+
+    std::size_t col[NT];
+#pragma GCC unroll 8
+    for (std::size_t v = 0; v != NT; ++v)
+    {
+        col[v] = std::min((v0 + v) * L, N - L);
+    }
+
+    V acc[NT]{};
+    for (std::size_t r = 0; r != M; ++r)
+    {
+        const V x = broadcast<V>(a[r * Lda]);
+#pragma GCC unroll 8
+        for (std::size_t v = 0; v != NT; ++v)
+        {
+            acc[v] += x * load<V>(b + r * Ldb + col[v]);
+        }
+    }
+
+#pragma GCC unroll 8
+    for (std::size_t v = 0; v != NT; ++v)
+    {
+        if constexpr (N % L != 0)
+        {
+            if (v0 + v + 1 == N_Vec)
+            {
+                acc[v] = tail_mask<V, N % L>(std::make_index_sequence<L>{})
+                    ? acc[v]
+                    : V{};
+            }
+        }
+        store(c + col[v], load<V>(c + col[v]) + acc[v]);
+    }
+}
+
+/**
+ * \brief c += transpose(a) * b, a being M x K, b M x N and c K x N: the
+ *        gradient of a dense layer with respect to its weights, from its
+ *        inputs and the gradients of its outputs (or transposed, from them
+ *        and the inputs). Every row of c is taken 4 column vectors at a time
+ *        (of row_vec width), the M samples being summed in registers.
+ */
+template <
+    typename T,
+    std::size_t M,
+    std::size_t K,
+    std::size_t N,
+    std::size_t Lda,
+    std::size_t Ldb,
+    std::size_t Ldc>
+auto transposed_multiply_add(const T* a, const T* b, T* c) noexcept -> void
+{
+    using V                     = row_vec<T, N>;
+    constexpr std::size_t L     = sizeof(V) / sizeof(T);
+    constexpr std::size_t N_Vec = (N + L - 1) / L;
+    constexpr std::size_t NT    = 4;
+
+    for (std::size_t k = 0; k != K; ++k)
+    {
+        T* const row = c + k * Ldc;
+        if constexpr (N < L)
+        {
+            // Less than 16 bytes of columns, plain scalar accumulators
+            T acc[N]{};
+            for (std::size_t r = 0; r != M; ++r)
+            {
+                for (std::size_t i = 0; i != N; ++i)
+                {
+                    acc[i] += a[r * Lda + k] * b[r * Ldb + i];
+                }
+            }
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                row[i] += acc[i];
+            }
+        }
+        else
+        {
+            std::size_t v0 = 0;
+            for (; v0 + NT <= N_Vec; v0 += NT)
+            {
+                transposed_multiply_tile<V, NT, M, N, Lda, Ldb>(
+                    a + k, b, row, v0
+                );
+            }
+            if constexpr (N_Vec % NT != 0)
+            {
+                transposed_multiply_tile<V, N_Vec % NT, M, N, Lda, Ldb>(
+                    a + k, b, row, v0
+                );
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+//------------ Distance reductions  -------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Accumulates |x - y|
+ */
+struct abs_diff
+{
+    static constexpr std::size_t s_Sums = 1;
+
+    template <typename V>
+    [[gnu::always_inline]]
+    inline static auto step(V const& x, V const& y, V* acc) noexcept -> void
+    {
+        const V d = x - y;
+        acc[0] += d < V{} ? -d : d;
+    }
+};
+
+/**
+ * \brief Accumulates (x - y)^2
+ */
+struct squared_diff
+{
+    static constexpr std::size_t s_Sums = 1;
+
+    template <typename V>
+    [[gnu::always_inline]]
+    inline static auto step(V const& x, V const& y, V* acc) noexcept -> void
+    {
+        const V d = x - y;
+        acc[0] += d * d;
+    }
+};
+
+/**
+ * \brief Accumulates x . y, x . x and y . y
+ */
+struct dot_norms
+{
+    static constexpr std::size_t s_Sums = 3;
+
+    template <typename V>
+    [[gnu::always_inline]]
+    inline static auto step(V const& x, V const& y, V* acc) noexcept -> void
+    {
+        acc[0] += x * y;
+        acc[1] += x * x;
+        acc[2] += y * y;
+    }
+};
+
+/**
+ * \brief sums[0, Op::s_Sums) = the sums Op accumulates over the Size element
+ *        pairs of a and b. Runs 4 independent accumulators per sum, the tail
+ *        is loaded zero extended, which adds 0 to every sum. a and b may be
+ *        stored in bf16 or fp16 (W), they are widened to T as they are
+ *        loaded.
+ */
+template <typename T, std::size_t Size, typename Op, typename W>
+auto reduce(const W* a, const W* b, T* sums) noexcept -> void
+{
+    using V                  = vec<T>;
+    constexpr std::size_t L  = lanes<T>;
+    constexpr std::size_t U  = 4;
+    constexpr std::size_t S  = Op::s_Sums;
+    constexpr std::size_t NB = Size / (U * L) * (U * L);
+    constexpr std::size_t NL = Size / L * L;
+
+    V acc[U][S]{};
+    for (std::size_t i = 0; i != NB; i += U * L)
+    {
+#pragma GCC unroll 4
+        for (std::size_t u = 0; u != U; ++u)
+        {
+            Op::step(
+                load_as<V>(a + i + u * L), load_as<V>(b + i + u * L), acc[u]
+            );
+        }
+    }
+#pragma GCC unroll 4
+    for (std::size_t i = NB; i != NL; i += L)
+    {
+        Op::step(load_as<V>(a + i), load_as<V>(b + i), acc[(i - NB) / L]);
+    }
+    if constexpr (Size % L != 0 && std::same_as<W, T>)
+    {
+        Op::step(
+            load_tail<V, Size % L, Size>(a + Size),
+            load_tail<V, Size % L, Size>(b + Size),
+            acc[U - 1]
+        );
+    }
+    else if constexpr (Size % L != 0)
+    {
+        Op::step(
+            load_partial_as<V, Size % L>(a + NL),
+            load_partial_as<V, Size % L>(b + NL),
+            acc[U - 1]
+        );
+    }
+
+#pragma GCC unroll 4
+    for (std::size_t s = 0; s != S; ++s)
+    {
+        sums[s] = horizontal_sum(
+            (acc[0][s] + acc[1][s]) + (acc[2][s] + acc[3][s])
+        );
+    }
+}
+
+//-----------------------------------------------------------------------------
+//------------ int8 dense kernel  ---------------------------------------------
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief acc += x . w over the lanes of one register of int8, 4 products per
+ *        int32 lane. pmaddubsw and vpdpbusd multiply unsigned by signed
+ *        bytes, so the sign of x is moved onto w: |x| * sign(x) w. With x
+ *        and w in [-127, 127] the int16 pair sums of pmaddubsw stay below
+ *        2 * 127 * 127 and never saturate, every tier computes the exact
+ *        integer dot product. The SSE2 tier widens to int16 instead.
+ */
+template <typename V8, typename V32>
+[[gnu::always_inline]]
+inline auto dot_i8(V32& acc, V8 const& x, V8 const& w) noexcept -> void
+{
+    if constexpr (int8_dot == int8_dot_kind::madd16)
+    {
+        // SSE2: sign extend the even and the odd bytes to int16 and use
+        // pmaddwd, lane i sums bytes 4i, 4i + 2 and 4i + 1, 4i + 3
+        const auto xi   = __builtin_bit_cast(__m128i, x);
+        const auto wi   = __builtin_bit_cast(__m128i, w);
+        const auto even = _mm_madd_epi16(
+            _mm_srai_epi16(_mm_slli_epi16(xi, 8), 8),
+            _mm_srai_epi16(_mm_slli_epi16(wi, 8), 8)
+        );
+        const auto odd =
+            _mm_madd_epi16(_mm_srai_epi16(xi, 8), _mm_srai_epi16(wi, 8));
+        acc += __builtin_bit_cast(V32, _mm_add_epi32(even, odd));
+    }
+    else if constexpr (sizeof(V8) == 16)
+    {
+        const auto xi = __builtin_bit_cast(__m128i, x);
+        const auto p  = _mm_maddubs_epi16(
+            _mm_abs_epi8(xi), _mm_sign_epi8(__builtin_bit_cast(__m128i, w), xi)
+        );
+        acc += __builtin_bit_cast(V32, _mm_madd_epi16(p, _mm_set1_epi16(1)));
+    }
+    else if constexpr (sizeof(V8) == 32)
+    {
+        const auto xi = __builtin_bit_cast(__m256i, x);
+        const auto p  = _mm256_maddubs_epi16(
+            _mm256_abs_epi8(xi),
+            _mm256_sign_epi8(__builtin_bit_cast(__m256i, w), xi)
+        );
+        acc += __builtin_bit_cast(
+            V32, _mm256_madd_epi16(p, _mm256_set1_epi16(1))
+        );
+    }
+    else
+    {
+        // No vpsignb on 512 bit registers: negate w under the sign mask of x
+        const auto xi = __builtin_bit_cast(__m512i, x);
+        const auto wi = __builtin_bit_cast(__m512i, w);
+        const auto ax = _mm512_abs_epi8(xi);
+        const auto sw = _mm512_mask_sub_epi8(
+            wi, _mm512_movepi8_mask(xi), _mm512_setzero_si512(), wi
+        );
+        if constexpr (int8_dot == int8_dot_kind::vnni)
+        {
+            const auto ai = __builtin_bit_cast(__m512i, acc);
+            acc = __builtin_bit_cast(V32, _mm512_dpbusd_epi32(ai, ax, sw));
+        }
+        else
+        {
+            acc += __builtin_bit_cast(
+                V32,
+                _mm512_madd_epi16(
+                    _mm512_maddubs_epi16(ax, sw), _mm512_set1_epi16(1)
+                )
+            );
+        }
+    }
+}
+
+/**
+ * \brief out[M x N] = x[M x K] * w[K x N] for int8 x and w in [-127, 127],
+ *        accumulated exactly in int32. K is a multiple of 4 and N of 16,
+ *        zero padded. w is packed in groups of 4 inputs: element (k, j) is at
+ *        (k / 4 * N + j) * 4 + k % 4, so broadcasting 4 inputs and
+ *        multiplying them with one register of w adds their products to
+ *        the int32 lane of each output, without horizontal sums.
+ */
+template <std::size_t M, std::size_t K, std::size_t N>
+auto dense_i8(
+    const std::int8_t* x,
+    const std::int8_t* w,
+    std::int32_t*      out
+) noexcept -> void
+{
+    using V8                 = vec<std::int8_t>;
+    using V32                = vec<std::int32_t>;
+    constexpr std::size_t L  = lanes<std::int32_t>;
+    constexpr std::size_t U  = std::min<std::size_t>(4, N / L);
+    constexpr std::size_t NB = N / (U * L) * (U * L);
+    static_assert(K % 4 == 0 && N % L == 0);
+
+    for (std::size_t m = 0; m != M; ++m)
+    {
+        const std::int8_t* x_row   = x + m * K;
+        std::int32_t*      out_row = out + m * N;
+
+        for (std::size_t j = 0; j != NB; j += U * L)
+        {
+            V32 acc[U]{};
+            for (std::size_t k = 0; k != K; k += 4)
+            {
+                std::int32_t x4;
+                std::memcpy(&x4, x_row + k, sizeof(x4));
+                const auto xv = __builtin_bit_cast(V8, V32{} + x4);
+#pragma GCC unroll 4
+                for (std::size_t u = 0; u != U; ++u)
+                {
+                    dot_i8(acc[u], xv, load<V8>(w + (k * N + (j + u * L) * 4)));
+                }
+            }
+#pragma GCC unroll 4
+            for (std::size_t u = 0; u != U; ++u)
+            {
+                store(out_row + j + u * L, acc[u]);
+            }
+        }
+        for (std::size_t j = NB; j != N; j += L)
+        {
+            V32 acc{};
+            for (std::size_t k = 0; k != K; k += 4)
+            {
+                std::int32_t x4;
+                std::memcpy(&x4, x_row + k, sizeof(x4));
+                const auto xv = __builtin_bit_cast(V8, V32{} + x4);
+                dot_i8(acc, xv, load<V8>(w + (k * N + j * 4)));
+            }
+            store(out_row + j, acc);
+        }
+    }
+}
+
+/**
+ * \brief Rounds the lanes of v * inv_scale half away from zero to int8
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto round_to_i8(V const& v, float inv_scale) noexcept
+    -> simd::vec<std::int8_t, lanes<float>>
+{
+    using Q        = simd::vec<std::int8_t, lanes<float>>;
+    const V  y     = v * inv_scale;
+    const auto r   = __builtin_convertvector(
+        y + (y < 0 ? V{} - 0.5f : V{} + 0.5f),
+        simd::vec<std::int32_t, sizeof(V)>
+    );
+
+    // Without AVX-512 (vpmovdb) a plain conversion is lowered lane by lane,
+    // the lanes are in range so saturating packs narrow them as well
+    if constexpr (sizeof(V) == 16)
+    {
+        const auto ri = __builtin_bit_cast(__m128i, r);
+        const auto p  = _mm_packs_epi16(_mm_packs_epi32(ri, ri), ri);
+        return __builtin_bit_cast(Q, _mm_cvtsi128_si32(p));
+    }
+    else if constexpr (sizeof(V) == 32)
+    {
+        const auto ri = __builtin_bit_cast(__m256i, r);
+        const auto p  = _mm_packs_epi32(
+            _mm256_castsi256_si128(ri), _mm256_extracti128_si256(ri, 1)
+        );
+        return __builtin_bit_cast(Q, _mm_cvtsi128_si64(_mm_packs_epi16(p, p)));
+    }
+    else
+    {
+        return __builtin_convertvector(r, Q);
+    }
+}
+
+/**
+ * \brief Quantizes Size floats to int8: q = round(x * 127 / max |x|),
+ *        rounding half away from zero. Returns the scale max |x| / 127
+ *        (0 for a row of zeros, which quantizes to zeros).
+ */
+template <std::size_t Size>
+[[nodiscard]]
+auto quantize_i8(const float* x, std::int8_t* q) noexcept -> float
+{
+    using V                  = vec<float>;
+    using Q                  = simd::vec<std::int8_t, lanes<float>>;
+    constexpr std::size_t L  = lanes<float>;
+    constexpr std::size_t NL = Size / L * L;
+
+    V max_abs{};
+    for (std::size_t i = 0; i != NL; i += L)
+    {
+        const V v = load<V>(x + i);
+        max_abs   = max_abs > v ? max_abs : v;
+        max_abs   = max_abs > -v ? max_abs : -v;
+    }
+    if constexpr (Size % L != 0)
+    {
+        const V v = load_partial<V, Size % L>(x + NL);
+        max_abs   = max_abs > v ? max_abs : v;
+        max_abs   = max_abs > -v ? max_abs : -v;
+    }
+    float m = max_abs[0];
+#pragma GCC unroll 16
+    for (std::size_t l = 1; l != L; ++l)
+    {
+        m = std::max(m, max_abs[l]);
+    }
+
+    // |x * inv_scale| <= 127 up to rounding, + 0.5 truncates to [-127, 127]
+    const float inv_scale = m > 0 ? 127 / m : 0;
+    for (std::size_t i = 0; i != NL; i += L)
+    {
+        const Q r = round_to_i8(load<V>(x + i), inv_scale);
+        std::memcpy(q + i, &r, sizeof(Q));
+    }
+    if constexpr (Size % L != 0)
+    {
+        const Q r = round_to_i8(load_partial<V, Size % L>(x + NL), inv_scale);
+        std::memcpy(q + NL, &r, Size % L);
+    }
+    return m / 127;
+}
+
+/**
+ * \brief int8 dense layer C[M x N] = epilogue(A * W + bias) for float A and
+ *        C. Every row of A is quantized with its own scale (quantize_i8),
+ *        multiplied with W by dense_i8 and rescaled by its scale times
+ *        w_scale, before the bias is added and the element-wise epilogue
+ *        applied. W (w_scale * int8) is packed as dense_i8 expects for
+ *        K rounded up to a multiple of 4 and N to 16, the bias holds N
+ *        rounded up to 16 floats.
+ */
+template <std::size_t M, std::size_t K, std::size_t N, typename Epilogue>
+auto quantized_dense(
+    const float*       a,
+    std::size_t        lda,
+    const std::int8_t* w,
+    float              w_scale,
+    const float*       bias,
+    float*             c,
+    std::size_t        ldc,
+    Epilogue const&    epilogue
+) noexcept -> void
+{
+    using V                  = vec<float>;
+    using Vi                 = vec<std::int32_t>;
+    constexpr std::size_t L  = lanes<float>;
+    constexpr std::size_t K4 = (K + 3) / 4 * 4;
+    constexpr std::size_t NP = (N + 15) / 16 * 16;
+
+    alignas(64) std::int8_t  q[M * K4]{};
+    alignas(64) std::int32_t acc[M * NP];
+    float                    scale[M];
+
+    for (std::size_t r = 0; r != M; ++r)
+    {
+        scale[r] = quantize_i8<K>(a + r * lda, q + r * K4) * w_scale;
+    }
+    dense_i8<M, K4, NP>(q, w, acc);
+
+    constexpr std::size_t NL = N / L * L;
+    for (std::size_t r = 0; r != M; ++r)
+    {
+        const V s = V{} + scale[r];
+        for (std::size_t j = 0; j != NL; j += L)
+        {
+            store(
+                c + r * ldc + j,
+                apply_lanes(
+                    __builtin_convertvector(load<Vi>(acc + r * NP + j), V) * s +
+                        load<V>(bias + j),
+                    epilogue
+                )
+            );
+        }
+        if constexpr (N % L != 0)
+        {
+            // Only the N logical columns are written
+            const V out = apply_lanes(
+                __builtin_convertvector(load<Vi>(acc + r * NP + NL), V) * s +
+                    load<V>(bias + NL),
+                epilogue
+            );
+            std::memcpy(c + r * ldc + NL, &out, N % L * sizeof(float));
+        }
+    }
+}
@@ -0,0 +1,262 @@
+// No include guard: tier_kernels.hpp includes this file, so it is compiled
+// once per instruction set tier like the kernels (see the top of
+// tier_kernels.hpp), inside namespace ga_sm::simd::<tier>.
+//
+// Polynomial approximations of the transcendental functions behind the
+// activation functions, for float vectors of any width. They have no libm
+// call and no branch: inlined into a kernel (as the epilogue of a dense
+// layer, see apply_lanes) they compile to the instructions of its tier, 4, 8
+// or 16 lanes at a time. The activation functions reach them through the
+// function objects of kernels.hpp (ga_sm::simd::sigmoid_function, ...),
+// whose float overloads run the sse2 copy on a 4 lane vector.
+//
+// Largest error against the correctly rounded result, over every float whose
+// result is a normal float (smaller results are within FLT_MIN of it), as
+// measured by the activation_accuracy benchmark against libm in double:
+//
+//     exp       1 ulp   Cody-Waite reduction, degree 6 polynomial (Cephes)
+//     sigmoid   3 ulp   1 / (1 + e^-x), from e^-|x|
+//     swish     4 ulp   x / (1 + e^-(beta * x)), of the rounded beta * x
+//     tanh      2 ulp   odd polynomial below 0.625, 1 - 2 / (e^2|x| + 1) above
+//     gelu      9 ulp   x * Phi(x), Phi from the Chebyshev erfc of Numerical
+//                       Recipes, with e^-x^2/2 split so that x^2 is exact
+//
+// The tiers with FMA contract a * b + c into fmas (see simd.hpp), so their
+// results may differ from the sse2 ones by an ulp. The bounds hold for every
+// tier. Out of finite inputs they never produce inf or nan: exp is clamped
+// to [-104, 88.72], FLT_MAX above it.
+
+namespace vector_math_detail
+{
+
+template <typename V>
+using int_vec = simd::vec<std::int32_t, sizeof(V)>;
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto abs(V x) noexcept -> V
+{
+    using I = int_vec<V>;
+    return __builtin_bit_cast(V, __builtin_bit_cast(I, x) & 0x7fffffff);
+}
+
+// x with the sign of s
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto copy_sign(V x, V s) noexcept -> V
+{
+    using I = int_vec<V>;
+    return __builtin_bit_cast(
+        V,
+        (__builtin_bit_cast(I, x) & 0x7fffffff) |
+            (__builtin_bit_cast(I, s) & std::int32_t(0x80000000u))
+    );
+}
+
+// x with the 12 low bits of its mantissa cleared, so its square is exact
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto truncate_12(V x) noexcept -> V
+{
+    using I = int_vec<V>;
+    return __builtin_bit_cast(
+        V, __builtin_bit_cast(I, x) & std::int32_t(0xfffff000u)
+    );
+}
+
+// e^x as the product high * low of two normal floats, high holding the
+// mantissa: e^x is subnormal below -87.3 while x * e^x is not, multiplying
+// by low last keeps the ulps that a subnormal e^x would lose.
+// x is clamped to [-104, 88.72], e^x being 0 and FLT_MAX past it.
+template <typename V>
+struct split_exp
+{
+    V high;
+    V low;
+};
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto exp_split(V x) noexcept -> split_exp<V>
+{
+    using I = int_vec<V>;
+
+    const V lo = V{} - 104.f;
+    const V hi = V{} + 88.7228317f;
+    x          = x < lo ? lo : x;
+    x          = x > hi ? hi : x;
+
+    // n = round(x / ln 2): adding 1.5 * 2^23 rounds to an integer and leaves
+    // it in the low bits of the mantissa
+    const V shifter = V{} + 0x1.8p23f;
+    const V j       = x * 1.44269504088896341f + shifter;
+    const V n       = j - shifter;
+
+    // r = x - n * ln 2, ln 2 split in two so that n * 0.693359375 is exact
+    V r = x - n * 0.693359375f;
+    r   = r - n * -2.12194440e-4f;
+
+    // e^r on [-ln 2 / 2, ln 2 / 2], degree 6 (Cephes)
+    const V r2 = r * r;
+    V       p  = V{} + 1.9875691500e-4f;
+    p          = p * r + 1.3981999507e-3f;
+    p          = p * r + 8.3334519073e-3f;
+    p          = p * r + 4.1665795894e-2f;
+    p          = p * r + 1.6666665459e-1f;
+    p          = p * r + 5.0000001201e-1f;
+    p          = p * r2 + r + 1.f;
+
+    // 2^n in two normal halves, n in [-150, 128] being out of range of one.
+    // Shifting the low bits of j into the exponent field drops the shifter.
+    const I n_all  = (__builtin_bit_cast(I, j) << 23) >> 23;
+    const I n_half = n_all >> 1;
+    return {
+        p * __builtin_bit_cast(V, (n_half << 23) + 0x3f800000),
+        __builtin_bit_cast(V, ((n_all - n_half) << 23) + 0x3f800000)
+    };
+}
+
+// y / (1 + e^-x), from e^-|x| which does not overflow
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto times_sigmoid(V y, V x) noexcept -> V
+{
+    const auto e = exp_split(-abs(x));
+    const V    s = 1.f / (1.f + e.high * e.low);
+    return x < 0.f ? y * e.high * s * e.low : y * s;
+}
+
+} // namespace vector_math_detail
+
+/**
+ * \brief e^x, 0 below -104 and FLT_MAX above 88.72
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto exp(V x) noexcept -> V
+{
+    const auto e = vector_math_detail::exp_split(x);
+    return e.high * e.low;
+}
+
+/**
+ * \brief 1 / (1 + e^-x)
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto sigmoid(V x) noexcept -> V
+{
+    using namespace vector_math_detail;
+    return times_sigmoid(V{} + 1.f, x);
+}
+
+/**
+ * \brief x / (1 + e^-(beta * x)), SiLU for beta = 1
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto swish(V x, float beta = 1.f) noexcept -> V
+{
+    return vector_math_detail::times_sigmoid(x, beta * x);
+}
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto tanh(V x) noexcept -> V
+{
+    using namespace vector_math_detail;
+
+    const V a = abs(x);
+
+    // Small arguments, odd polynomial (Cephes)
+    const V z = x * x;
+    V       p = V{} - 5.70498872745e-3f;
+    p         = p * z + 2.06390887954e-2f;
+    p         = p * z - 5.37397155531e-2f;
+    p         = p * z + 1.33314422036e-1f;
+    p         = p * z - 3.33332819422e-1f;
+    const V small = p * z * x + x;
+
+    // The others from e^2|x|, which saturates to 1 past 9
+    const V large = copy_sign(1.f - 2.f / (exp(a + a) + 1.f), x);
+
+    return a < 0.625f ? small : large;
+}
+
+/**
+ * \brief x * Phi(x), Phi being the standard normal cdf
+ */
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto gelu(V x) noexcept -> V
+{
+    using namespace vector_math_detail;
+
+    // q = erfc(z) / 2 = Phi(-|x|), z = |x| / sqrt(2)
+    const V a = abs(x);
+    const V z = a * 0.707106781186547524f;
+    const V t = 1.f / (1.f + 0.5f * z);
+    V       p = V{} + 0.17087277f;
+    p         = p * t - 0.82215223f;
+    p         = p * t + 1.48851587f;
+    p         = p * t - 1.13520398f;
+    p         = p * t + 0.27886807f;
+    p         = p * t - 0.18628806f;
+    p         = p * t + 0.09678418f;
+    p         = p * t + 0.37409196f;
+    p         = p * t + 1.00002368f;
+    p         = p * t - 1.26551223f;
+
+    // e^-z^2 = e^-x^2/2 as e^-ah^2/2 * e^-(a - ah)(a + ah)/2, a = |x|: ah^2
+    // is exact, so neither the rounding of z nor that of its square costs
+    // ulps where it is big. The small factor comes last (see exp_split), so
+    // that x * Phi(x) only goes through subnormals when it is one.
+    const V    ah = truncate_12(a);
+    const auto e  = exp_split(-0.5f * ah * ah);
+    const V    q  = 0.5f * t * exp(-0.5f * (a - ah) * (a + ah) + p);
+    const V    xq = x * q * e.high * e.low;
+
+    return x < 0.f ? xq : x - xq;
+}
+
+//-----------------------------------------------------------------------------
+//------------ Function objects  ----------------------------------------------
+//-----------------------------------------------------------------------------
+
+// The vector form of the function objects of kernels.hpp, which apply_lanes
+// calls on whole vectors
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto vectorized(sigmoid_function const&, V x) noexcept -> V
+{
+    return sigmoid(x);
+}
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto vectorized(silu_function const&, V x) noexcept -> V
+{
+    return swish(x);
+}
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto vectorized(swish_function const& fn, V x) noexcept -> V
+{
+    return swish(x, fn.beta);
+}
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto vectorized(tanh_function const&, V x) noexcept -> V
+{
+    return tanh(x);
+}
+
+template <typename V>
+[[nodiscard]] [[gnu::always_inline]]
+inline auto vectorized(gelu_function const&, V x) noexcept -> V
+{
+    return gelu(x);
+}
@@ -4,6 +4,10 @@
 #include "activation_functions.hpp"
 #include "static_matrix.hpp"
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <type_traits>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -21,6 +25,68 @@ TEST_CLASS(unittesting_activation_functions)
 
     using AF_ReLU = matrix_activation_functions::activation_function<Mf5, matrix_activation_functions::Identifiers::ReLU>;
 
+    // Largest error in ulps of fn against ref, in double, over every 4099th
+    // float whose result is a normal float
+    template <typename Fn, typename Ref>
+    static double max_ulp(Fn fn, Ref ref)
+    {
+        double worst = 0;
+        for (std::uint32_t bits = 0; bits < 0x7f800000u; bits += 4099)
+        {
+            for (const std::uint32_t sign : { 0u, 0x80000000u })
+            {
+                float               x;
+                const std::uint32_t x_bits = bits | sign;
+                std::memcpy(&x, &x_bits, sizeof(x));
+                const double r = ref(static_cast<double>(x));
+                if (!(std::abs(r) >= std::numeric_limits<float>::min()))
+                {
+                    continue;
+                }
+                int exponent;
+                std::frexp(static_cast<float>(r), &exponent);
+                worst = std::max(
+                    worst,
+                    std::abs(static_cast<double>(fn(x)) - r) /
+                        std::ldexp(1.0, exponent - 24)
+                );
+            }
+        }
+        return worst;
+    }
+
+    // Whether Softmax of mat is within rel of the softmax of every row in
+    // double, outputs below 1e-37 being allowed to be flushed to 0 (a nan
+    // output never is)
+    template <typename Mat>
+    static bool softmax_matches(Mat mat, double rel)
+    {
+        const Mat in = mat;
+        matrix_activation_functions::Softmax<Mat>{}(mat, {});
+        for (std::size_t j = 0; j != Mat::Size_y; ++j)
+        {
+            double max = in[j, 0];
+            for (std::size_t i = 0; i != Mat::Size_x; ++i)
+            {
+                max = std::max(max, static_cast<double>(in[j, i]));
+            }
+            double sum = 0;
+            for (std::size_t i = 0; i != Mat::Size_x; ++i)
+            {
+                sum += std::exp(in[j, i] - max);
+            }
+            for (std::size_t i = 0; i != Mat::Size_x; ++i)
+            {
+                const double ref = std::exp(in[j, i] - max) / sum;
+                if (!(std::abs(mat[j, i] - ref) <= std::max(rel * ref, 1e-37)))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
 public:
     TEST_METHOD(assert_is_trivially_copiable)
     {
@@ -43,5 +109,89 @@ public:
     {
         Assert::IsTrue(std::is_trivially_constructible_v<AF_ReLU>);
     }
+
+    // The bounds documented in vector_math.hpp
+    TEST_METHOD(assert_fast_element_functions_within_their_ulps)
+    {
+        using namespace matrix_activation_functions;
+        using precision = activation_precision;
+
+        using Sigmoid_Fast = activation_function<Mf5, Identifiers::Sigmoid, precision::fast>;
+        using Tanh_Fast    = activation_function<Mf5, Identifiers::Tanh, precision::fast>;
+        using GELU_Fast    = activation_function<Mf5, Identifiers::GELU, precision::fast>;
+        using SiLU_Fast    = activation_function<Mf5, Identifiers::SiLU, precision::fast>;
+        using Swish_Fast   = activation_function<Mf5, Identifiers::Swish, precision::fast>;
+        Assert::IsTrue(Sigmoid_Fast::is_fast && !activation_function<Md5, Identifiers::Sigmoid, precision::fast>::is_fast);
+
+        Assert::IsTrue(max_ulp(Sigmoid_Fast{}.element_function(), [](double x) { return 1 / (1 + std::exp(-x)); }) <= 3);
+        Assert::IsTrue(max_ulp(Tanh_Fast{}.element_function(), [](double x) { return std::tanh(x); }) <= 2);
+        Assert::IsTrue(max_ulp(GELU_Fast{}.element_function(), [](double x) { return x / 2 * std::erfc(-x / std::sqrt(2.)); }) <= 9);
+        Assert::IsTrue(max_ulp(SiLU_Fast{}.element_function(), [](double x) { return x / (1 + std::exp(-x)); }) <= 4);
+
+        Swish_Fast swish{};
+        swish.params.beta = 0.5f;
+        Assert::IsTrue(max_ulp(swish.element_function(), [](double x) { return x / (1 + std::exp(-x / 2)); }) <= 4);
+    }
+
+    // Rows in one register, over several and with a partial last one, and
+    // with a spread past e^80 (see ga_sm::simd::softmax)
+    TEST_METHOD(assert_softmax_matches_double_softmax)
+    {
+        std::size_t idx  = 0;
+        const auto  wave = [&idx](float amplitude) {
+            return [&idx, amplitude] { return amplitude * static_cast<float>(std::sin(1.7 * static_cast<double>(idx++))); };
+        };
+
+        Mf5 m5;
+        m5.fill(wave(10.f));
+        Mf20 m20;
+        m20.fill(wave(10.f));
+        ga_sm::static_matrix<float, 3, 7> m7;
+        m7.fill(wave(60.f));
+        ga_sm::static_matrix<float, 2, 37> m37;
+        m37.fill(wave(60.f));
+        Md5 md5;
+        md5.fill(wave(10.f));
+
+        Assert::IsTrue(softmax_matches(m5, 1e-5));
+        Assert::IsTrue(softmax_matches(m20, 1e-5));
+        Assert::IsTrue(softmax_matches(m7, 1e-5));
+        Assert::IsTrue(softmax_matches(m37, 1e-5));
+        Assert::IsTrue(softmax_matches(md5, 1e-12));
+    }
+
+    TEST_METHOD(assert_softmax_ignores_masked_logits)
+    {
+        // Illegal moves of a policy head are masked with -inf logits, among
+        // them the first of every other row
+        const auto mask = []<typename Mat>(Mat& mat) {
+            std::size_t idx = 0;
+            mat.fill([&idx] { return 3.f * static_cast<float>(std::sin(1.7 * static_cast<double>(idx++))); });
+            for (std::size_t j = 0; j != Mat::Size_y; ++j)
+            {
+                for (std::size_t i = 0; i != Mat::Size_x; ++i)
+                {
+                    if ((i + j) % 3 == 0)
+                    {
+                        mat[j, i] = -std::numeric_limits<float>::infinity();
+                    }
+                }
+            }
+        };
+
+        ga_sm::static_matrix<float, 3, 7> m7;
+        mask(m7);
+        ga_sm::static_matrix<float, 3, 37> m37;
+        mask(m37);
+        ga_sm::static_matrix<float, 2, 100> m100;
+        mask(m100);
+        Md5 md5;
+        mask(md5);
+
+        Assert::IsTrue(softmax_matches(m7, 1e-5));
+        Assert::IsTrue(softmax_matches(m37, 1e-5));
+        Assert::IsTrue(softmax_matches(m100, 1e-5));
+        Assert::IsTrue(softmax_matches(md5, 1e-12));
+    }
 };
 } // namespace NativeUnitTesting
@@ -0,0 +1,123 @@
+#include "pch.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "CppUnitTest.h"
+#include "Random.hpp"
+#include "data_processor.hpp"
+#include "evolution_agent.hpp"
+#include "neural_model.hpp"
+#include "population_neural_net.hpp"
+#include "static_neural_net.hpp"
+#include "system.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace NativeUnitTesting
+{
+// One task, scored from each agent's responses to the whole dataset or, when
+// Stacked, from the stacked generation one stimulus at a time
+template <bool Stacked>
+struct squared_error
+{
+    using fitness_score_type  = float;
+    using stimulus_type       = float;
+    using agent_response_type = float;
+
+    inline static constexpr std::size_t N                     = 50;
+    inline static constexpr std::size_t s_Batch_Size          = 8;
+    inline static constexpr bool        s_Evaluate_Population = Stacked;
+
+    using input_data_container  = std::array<stimulus_type, N>;
+    using output_data_container = std::array<agent_response_type, N>;
+
+    inline static constexpr auto f = [](stimulus_type x) -> agent_response_type {
+        return std::sin(3 * x);
+    };
+
+    inline static const auto input_data = []() -> input_data_container {
+        input_data_container ret{};
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            ret[i] = static_cast<stimulus_type>(i) / N;
+        }
+        return ret;
+    }();
+
+    [[nodiscard]]
+    auto operator()(output_data_container const& responses) const -> fitness_score_type
+    {
+        fitness_score_type ret{};
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            const auto error = responses[i] - f(input_data[i]);
+            ret += error * error;
+        }
+        return ret;
+    }
+
+    template <typename Population_Type>
+        requires std::is_invocable_r_v<
+            std::array<agent_response_type, Population_Type::s_Population>,
+            Population_Type,
+            stimulus_type>
+    [[nodiscard]]
+    auto operator()(Population_Type const& population) const
+        -> std::array<fitness_score_type, Population_Type::s_Population>
+    {
+        std::array<fitness_score_type, Population_Type::s_Population> ret{};
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            const auto responses = population(input_data[i]);
+            for (std::size_t p = 0; p != Population_Type::s_Population; ++p)
+            {
+                const auto error = responses[p] - f(input_data[i]);
+                ret[p] += error * error;
+            }
+        }
+        return ret;
+    }
+};
+
+TEST_CLASS(unittesting_evaluation_system)
+{
+public:
+    inline static constexpr double epsilon = 1e-4;
+
+    inline static constexpr auto Tanh = matrix_activation_functions::Identifiers::Tanh;
+
+    inline static constexpr ga_snn::Layer_Signature a1{ 1, Tanh };
+    inline static constexpr ga_snn::Layer_Signature a16{ 16, Tanh };
+
+    using N       = ga_snn::static_neural_net<float, 1, a1, a16, a16, a1>;
+    using brain_t = ga_neural_model::brain<N, data_processor::scalar_converter, data_processor::scalar_converter, float>;
+    using agent_t = evolution_agent::agent<brain_t>;
+
+    TEST_METHOD(assert_stacked_generation_scores_as_dataset_responses)
+    {
+        constexpr std::size_t P = 7;
+
+        static_assert(evaluation_system::dataset_evaluation_function<squared_error<false>, agent_t>);
+        static_assert(evaluation_system::population_evaluation_function<squared_error<true>, agent_t, P>);
+
+        const auto generation = []<std::size_t... I>(std::index_sequence<I...>) {
+            return std::array<agent_t, P>{ (static_cast<void>(I), agent_t(brain_t(random::randnormal, 0, 1)))... };
+        }(std::make_index_sequence<P>{});
+
+        squared_error<false> batched_fn;
+        squared_error<true>  stacked_fn;
+        const evaluation_system::system<squared_error<false>> batched_system(batched_fn);
+        const evaluation_system::system<squared_error<true>>  stacked_system(stacked_fn);
+
+        const auto batched = batched_system.evaluate(generation);
+        const auto stacked = stacked_system.evaluate(generation);
+        for (std::size_t p = 0; p != P; ++p)
+        {
+            Assert::IsTrue(std::abs(batched[p] - stacked[p]) < epsilon * std::max(1.f, std::abs(batched[p])));
+        }
+    }
+};
+} // namespace NativeUnitTesting
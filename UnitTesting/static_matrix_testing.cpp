@@ -2,13 +2,29 @@
 
 #include "CppUnitTest.h"
 #include "Random.hpp"
+#include "matrix_expression.hpp"
 #include "static_matrix.hpp"
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <span>
 #include <type_traits>
+#include <utility>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 namespace NativeUnitTesting
 {
+// Mean absolute difference between the elements of mat1 and mat2
+template <std::floating_point R, typename Matrix>
+auto normalized_L1_distance(Matrix const& mat1, Matrix const& mat2) -> R
+{
+    return ga_sm::matrix_distance<R>(
+               mat1, mat2, [](auto a, auto b) { return std::abs(a - b); }
+           ) /
+        static_cast<R>(Matrix::Size_y * Matrix::Size_x);
+}
+
 TEST_CLASS(unittesting_static_matrix)
 {
     static constexpr double epsilon = 1e-5;
@@ -19,6 +35,7 @@ TEST_CLASS(unittesting_static_matrix)
     using Mf20 = ga_sm::static_matrix<float, 20, 20>;
     using Md20 = ga_sm::static_matrix<double, 20, 20>;
     using Mi20 = ga_sm::static_matrix<int, 20, 20>;
+    using Mf5a = ga_sm::static_matrix<float, 5, 5, ga_sm::aligned_storage<32>>;
 
 public:
     TEST_METHOD(assert_static_mat_mat_mul)
@@ -54,6 +71,84 @@ public:
         Assert::IsTrue(normalized_L1_distance<double>(m, res) < epsilon);
     }
 
+    TEST_METHOD(assert_static_mat_mat_mul_blocked)
+    {
+        // Shapes that go through the blocked engine, with partial tiles on
+        // every edge
+        ga_sm::static_matrix<float, 37, 70>  a{};
+        ga_sm::static_matrix<float, 70, 45>  b{};
+        ga_sm::static_matrix<double, 13, 33> c{};
+        ga_sm::static_matrix<double, 33, 90> d{};
+
+        static_assert(ga_sm::gemm::use_blocked_gemm<float, 37, 70, 45>);
+        static_assert(ga_sm::gemm::use_blocked_gemm<double, 13, 33, 90>);
+
+        for (int i = 0; i != 10; ++i)
+        {
+            a.fill(random::randfloat);
+            b.fill(random::randfloat);
+            c.fill(random::randfloat);
+            d.fill(random::randfloat);
+
+            Assert::IsTrue(
+                normalized_L1_distance<double>(
+                    matrix_mul(a, b), matrix_mul_reference(a, b)
+                ) < epsilon
+            );
+            Assert::IsTrue(
+                normalized_L1_distance<double>(
+                    matrix_mul(c, d), matrix_mul_reference(c, d)
+                ) < epsilon
+            );
+        }
+    }
+
+    TEST_METHOD(assert_static_mat_mat_mul_aligned)
+    {
+        using A = ga_sm::aligned_storage<64>;
+
+        ga_sm::static_matrix<float, 37, 70>    a{};
+        ga_sm::static_matrix<float, 70, 45>    b{};
+        ga_sm::static_matrix<float, 37, 70, A> a_aligned{};
+        ga_sm::static_matrix<float, 70, 45, A> b_aligned{};
+
+        static_assert(decltype(a_aligned)::Row_Stride == 80);
+
+        for (int i = 0; i != 10; ++i)
+        {
+            a.fill(random::randfloat);
+            b.fill(random::randfloat);
+            std::copy(a.begin(), a.end(), a_aligned.begin());
+            std::copy(b.begin(), b.end(), b_aligned.begin());
+
+            const auto c         = matrix_mul(a, b);
+            const auto c_aligned = matrix_mul(a_aligned, b_aligned);
+            const auto c_small   = matrix_mul_reference(a_aligned, b_aligned);
+
+            Assert::IsTrue(
+                normalized_L1_distance<double>(
+                    c, ga_sm::cast_to_shape<37, 45, decltype(c_aligned),
+                                            ga_sm::packed_storage>(c_aligned)
+                ) < epsilon
+            );
+            Assert::IsTrue(
+                normalized_L1_distance<double>(
+                    c, ga_sm::cast_to_shape<37, 45, decltype(c_small),
+                                            ga_sm::packed_storage>(c_small)
+                ) < epsilon
+            );
+
+            // Padding stays 0
+            for (std::size_t j = 0; j != 37; ++j)
+            {
+                for (std::size_t k = 45; k != 48; ++k)
+                {
+                    Assert::AreEqual(c_aligned.m_Elems[j * 48 + k], 0.f);
+                }
+            }
+        }
+    }
+
     TEST_METHOD(assert_static_mat_vec_mul_float)
     {
         constexpr std::size_t N = 4;
@@ -145,13 +240,382 @@ public:
         }
     }
 
+    TEST_METHOD(assert_static_mat_small_batch_mul)
+    {
+        // Goes through the batched matrix vector kernel, with a partial row
+        // block and a partial vector at the end of every row
+        ga_sm::static_matrix<float, 37, 45> m{};
+        ga_sm::static_matrix<float, 45, 3>  x{};
+        ga_sm::static_matrix<float, 3, 45>  x_rows{};
+
+        static_assert(ga_sm::gemm::use_batched_matvec<float, 37, 45, 3>);
+
+        for (int i = 0; i != 10; ++i)
+        {
+            m.fill(random::randfloat);
+            x.fill(random::randfloat);
+            for (std::size_t k = 0; k != 45; ++k)
+            {
+                for (std::size_t b = 0; b != 3; ++b)
+                {
+                    x_rows[b, k] = x[k, b];
+                }
+            }
+
+            const auto res_ref = matrix_mul_reference(m, x);
+
+            Assert::IsTrue(
+                normalized_L1_distance<double>(matrix_mul(m, x), res_ref) <
+                epsilon
+            );
+            Assert::IsTrue(
+                normalized_L1_distance<double>(
+                    matrix_vector_mul_batch(m, x_rows), transpose(res_ref)
+                ) < epsilon
+            );
+        }
+    }
+
+    TEST_METHOD(assert_multiply_add_activate)
+    {
+        using namespace ga_sm;
+
+        // Rows of 37 outputs: the last column vector overlaps the previous
+        // one, and 7 rows leave a partial row block
+        static_matrix<float, 7, 45>  a{};
+        static_matrix<float, 45, 37> w{};
+        static_matrix<float, 1, 37>  bias{};
+        const auto relu = [](float x) { return x > 0.f ? x : 0.f; };
+
+        for (int i = 0; i != 10; ++i)
+        {
+            a.fill(random::randfloat);
+            w.fill(random::randfloat);
+            bias.fill(random::randfloat);
+
+            auto res_ref = matrix_vec_add(matrix_mul_reference(a, w), bias);
+            res_ref.transform(relu);
+
+            Assert::IsTrue(
+                normalized_L1_distance<double>(
+                    multiply_add_activate(a, w, bias, relu), res_ref
+                ) < epsilon
+            );
+        }
+
+        // Rows of 9 outputs, narrower than an AVX-512 register
+        static_assert(!gemm::use_unrolled_dense<float, 8, 42, 9>);
+        static_matrix<float, 8, 42> a_narrow{};
+        static_matrix<float, 42, 9> w_narrow{};
+        static_matrix<float, 1, 9>  bias_narrow{};
+        a_narrow.fill(random::randfloat);
+        w_narrow.fill(random::randfloat);
+        bias_narrow.fill(random::randfloat);
+
+        auto res_ref = matrix_vec_add(
+            matrix_mul_reference(a_narrow, w_narrow), bias_narrow
+        );
+        res_ref.transform(relu);
+        Assert::IsTrue(
+            normalized_L1_distance<double>(
+                multiply_add_activate(a_narrow, w_narrow, bias_narrow, relu),
+                res_ref
+            ) < epsilon
+        );
+
+        // A single output per row, one dot product each
+        static_assert(!gemm::use_unrolled_dense<float, 32, 64, 1>);
+        static_matrix<float, 32, 64> a_column{};
+        static_matrix<float, 64, 1>  w_column{};
+        static_matrix<float, 1, 1>   bias_column{};
+        a_column.fill(random::randfloat);
+        w_column.fill(random::randfloat);
+        bias_column.fill(random::randfloat);
+
+        auto res_ref_column = matrix_vec_add(
+            matrix_mul_reference(a_column, w_column), bias_column
+        );
+        res_ref_column.transform(relu);
+        Assert::IsTrue(
+            normalized_L1_distance<double>(
+                multiply_add_activate(a_column, w_column, bias_column, relu),
+                res_ref_column
+            ) < epsilon
+        );
+    }
+
+    TEST_METHOD(assert_unrolled_multiply_add_activate)
+    {
+        using namespace ga_sm;
+
+        // Connect Four and proof of concept layer shapes: two overlapping
+        // column vectors, and a single output computed as a dot product
+        static_assert(gemm::use_unrolled_dense<float, 1, 42, 9>);
+        static_assert(gemm::use_unrolled_dense<float, 1, 64, 1>);
+        static_assert(!gemm::use_unrolled_dense<float, 1, 42, 42>);
+
+        static_matrix<float, 1, 42> a{};
+        static_matrix<float, 42, 9> w{};
+        static_matrix<float, 1, 9>  bias{};
+        static_matrix<float, 1, 64> x{};
+        static_matrix<float, 64, 1> v{};
+        static_matrix<float, 1, 1>  v_bias{};
+        const auto relu = [](float e) { return e > 0.f ? e : 0.f; };
+
+        for (int i = 0; i != 10; ++i)
+        {
+            a.fill(random::randfloat);
+            w.fill(random::randfloat);
+            bias.fill(random::randfloat);
+            x.fill(random::randfloat);
+            v.fill(random::randfloat);
+            v_bias.fill(random::randfloat);
+
+            auto res_ref = matrix_vec_add(matrix_mul_reference(a, w), bias);
+            res_ref.transform(relu);
+            Assert::IsTrue(
+                normalized_L1_distance<double>(
+                    multiply_add_activate(a, w, bias, relu), res_ref
+                ) < epsilon
+            );
+
+            auto dot_ref = matrix_vec_add(matrix_mul_reference(x, v), v_bias);
+            dot_ref.transform(relu);
+            Assert::IsTrue(
+                normalized_L1_distance<double>(
+                    multiply_add_activate(x, v, v_bias, relu), dot_ref
+                ) < epsilon
+            );
+        }
+    }
+
+    TEST_METHOD(assert_views)
+    {
+        using namespace ga_sm;
+
+        static_matrix<float, 4, 6> mat{};
+        mat.fill(random::randfloat);
+
+        // Reshapes and slices alias the matrix, they do not copy it
+        const auto flat = reshape_view<1, 24>(mat);
+        const auto row  = row_view<2>(mat);
+        const auto col  = column_view<3>(mat);
+        Assert::IsTrue(flat.data() == mat.m_Elems);
+        Assert::IsTrue(row.data() == mat.m_Elems + 12);
+        for (size_t i = 0; i != 6; ++i)
+        {
+            Assert::IsTrue(flat[0, 6 + i] == mat[1, i]);
+            Assert::IsTrue(row[0, i] == mat[2, i]);
+        }
+        for (size_t j = 0; j != 4; ++j)
+        {
+            Assert::IsTrue(col[j, 0] == mat[j, 3]);
+        }
+
+        make_view(mat).column<0>()[1, 0] = 42.f;
+        Assert::IsTrue(mat[1, 0] == 42.f);
+
+        // A layer run on one row of a batch, written into a row of another
+        static_matrix<float, 6, 9> w{};
+        static_matrix<float, 1, 9> bias{};
+        static_matrix<float, 3, 9> out{};
+        w.fill(random::randfloat);
+        bias.fill(random::randfloat);
+        const auto relu = [](float e) { return e > 0.f ? e : 0.f; };
+
+        multiply_add_activate(
+            row_view<2>(std::as_const(mat)), w, bias, relu, row_view<1>(out)
+        );
+        static_matrix<float, 1, 6> in{};
+        for (size_t i = 0; i != 6; ++i)
+        {
+            in[0, i] = row[0, i];
+        }
+        auto res_ref = matrix_vec_add(matrix_mul_reference(in, w), bias);
+        res_ref.transform(relu);
+        for (size_t i = 0; i != 9; ++i)
+        {
+            Assert::IsTrue(std::abs(out[1, i] - res_ref[0, i]) < epsilon);
+        }
+        Assert::IsTrue(out[0, 0] == 0.f && out[2, 8] == 0.f);
+    }
+
+    TEST_METHOD(assert_multiply_transposed_add_activate)
+    {
+        using namespace ga_sm;
+
+        // Output-major weights: every output is a dot product with a row of
+        // w_t. 42 x 9 reduces a whole and a partial vector of outputs, 64 x 1
+        // a single one
+        static_matrix<float, 1, 42> a{};
+        static_matrix<float, 9, 42> w_t{};
+        static_matrix<float, 1, 9>  bias{};
+        static_matrix<float, 2, 64> x{};
+        static_matrix<float, 1, 64> v_t{};
+        static_matrix<float, 1, 1>  v_bias{};
+        static_matrix<float, 1, 9>  res{};
+        static_matrix<float, 2, 1>  dot{};
+        const auto relu = [](float e) { return e > 0.f ? e : 0.f; };
+
+        for (int i = 0; i != 10; ++i)
+        {
+            a.fill(random::randfloat);
+            w_t.fill(random::randfloat);
+            bias.fill(random::randfloat);
+            x.fill(random::randfloat);
+            v_t.fill(random::randfloat);
+            v_bias.fill(random::randfloat);
+
+            multiply_transposed_add_activate(
+                make_view(std::as_const(a)), w_t, bias, relu, make_view(res)
+            );
+            auto res_ref =
+                matrix_vec_add(matrix_mul_reference(a, transpose(w_t)), bias);
+            res_ref.transform(relu);
+            Assert::IsTrue(
+                normalized_L1_distance<double>(res, res_ref) < epsilon
+            );
+
+            multiply_transposed_add_activate(
+                make_view(std::as_const(x)), v_t, v_bias, relu, make_view(dot)
+            );
+            auto dot_ref =
+                matrix_vec_add(matrix_mul_reference(x, transpose(v_t)), v_bias);
+            dot_ref.transform(relu);
+            Assert::IsTrue(
+                normalized_L1_distance<double>(dot, dot_ref) < epsilon
+            );
+        }
+    }
+
+    TEST_METHOD(assert_builtin_distances)
+    {
+        using namespace ga_sm;
+
+        static_matrix<float, 45, 37> a{};
+        static_matrix<float, 45, 37> b{};
+        a.fill(random::randfloat);
+        b.fill(random::randfloat);
+
+        const auto l1 = [](float x, float y) { return std::abs(x - y); };
+        const auto l2 = [](float x, float y) { return (x - y) * (x - y); };
+
+        const auto ref_l1 = matrix_distance<double>(a, b, l1);
+        const auto ref_l2 = matrix_distance<double>(a, b, l2);
+        Assert::IsTrue(
+            std::abs(matrix_distance<double>(a, b, distance::L1{}) - ref_l1) <
+            epsilon * ref_l1
+        );
+        Assert::IsTrue(
+            std::abs(matrix_distance<double>(a, b, distance::L2{}) - ref_l2) <
+            epsilon * ref_l2
+        );
+        Assert::IsTrue(
+            std::abs(matrix_distance<double>(a, a, distance::cosine{})) <
+            epsilon
+        );
+
+        constexpr static_matrix<float, 1, 2> x{ 1.f, 0.f };
+        constexpr static_matrix<float, 1, 2> y{ 0.f, 2.f };
+        static_assert(matrix_distance<float>(x, y, distance::L1{}) == 3.f);
+        static_assert(matrix_distance<float>(x, y, distance::L2{}) == 5.f);
+
+        // Arrays are reduced as the same elements in a matrix
+        std::array<float, 45 * 37> a_array{};
+        std::array<float, 45 * 37> b_array{};
+        std::copy(a.begin(), a.end(), a_array.begin());
+        std::copy(b.begin(), b.end(), b_array.begin());
+        Assert::IsTrue(
+            std::abs(
+                span_distance<double>(
+                    std::span{ std::as_const(a_array) },
+                    std::span{ std::as_const(b_array) },
+                    distance::L2{}
+                ) -
+                ref_l2
+            ) < epsilon * ref_l2
+        );
+    }
+
+    TEST_METHOD(assert_reduced_precision_weights)
+    {
+        using namespace ga_sm;
+
+        static_assert(sizeof(static_matrix<bf16, 45, 37>) == 45 * 37 * 2);
+        static_assert(std::is_trivial_v<static_matrix<fp16, 45, 37>>);
+        static_assert(static_cast<float>(bf16{ 1.5f }) == 1.5f);
+        static_assert(static_cast<float>(fp16{ -0.25f }) == -0.25f);
+
+        static_matrix<float, 7, 45> a{};
+        static_matrix<bf16, 45, 37> w{};
+        static_matrix<bf16, 1, 37>  bias{};
+        const auto relu = [](float x) { return x > 0.f ? x : 0.f; };
+
+        a.fill(random::randfloat);
+        w.fill(random::randfloat);
+        bias.fill(random::randfloat);
+
+        // The kernel has to match float math on the widened weights
+        auto res_ref = matrix_vec_add(
+            matrix_mul_reference(a, cast_to<float>(w)), cast_to<float>(bias)
+        );
+        res_ref.transform(relu);
+        Assert::IsTrue(
+            normalized_L1_distance<double>(
+                multiply_add_activate(a, w, bias, relu), res_ref
+            ) < epsilon
+        );
+
+        static_matrix<fp16, 45, 37> x{};
+        static_matrix<fp16, 45, 37> y{};
+        x.fill(random::randfloat);
+        y.fill(random::randfloat);
+        const auto l1 = [](float p, float q) { return std::abs(p - q); };
+        const auto ref_l1 = matrix_distance<double>(x, y, l1);
+        Assert::IsTrue(
+            std::abs(matrix_distance<double>(x, y, distance::L1{}) - ref_l1) <
+            epsilon * ref_l1
+        );
+    }
+
+    TEST_METHOD(assert_lazy_expressions)
+    {
+        using namespace ga_sm;
+
+        constexpr auto res = [] {
+            static_matrix<int, 2, 3> m{ 1, 2, 3, 4, 5, 6 };
+            static_matrix<int, 1, 3> v{ 10, 20, 30 };
+
+            m = expr::matrix_vec_add(m, v) * 2 - m;
+            return m;
+        }();
+        constexpr static_matrix<int, 2, 3> ground_truth{ 21, 42, 63,
+                                                         24, 45, 66 };
+        static_assert(exactly_equals(res, ground_truth));
+
+        Mf20                        a{};
+        Mf20                        b{};
+        static_matrix<float, 1, 20> v{};
+        a.fill(random::randfloat);
+        b.fill(random::randfloat);
+        v.fill(random::randfloat);
+
+        const auto lazy  = expr::evaluate(
+            expr::vector_expand(v, a) + expr::element_wise_mul(a, b) / 2.f
+        );
+        const auto eager =
+            vector_expand(v, a) + element_wise_mul(a, b) / 2.f;
+
+        Assert::IsTrue(normalized_L1_distance<double>(lazy, eager) < epsilon);
+    }
+
     TEST_METHOD(assert_to_target_x_crossover)
     {
         constexpr int N = 10;
         constexpr int n = N - 1;
 
-        constexpr int K = 20;
-        constexpr int k = 10;
+        constexpr int K = 200;
+        constexpr int k = 100;
 
         using Mat = ga_sm::static_matrix<int, N, N>;
 
@@ -173,14 +637,14 @@ public:
 
             Assert::IsTrue(mat1 + mat2 == mat12 + mat21);
 
-            if ((mat1(0, 0) == mat12(0, 0) && mat1(n, n) == mat12(n, n) &&
-                 mat1(0, n) == mat21(0, n) && mat1(n, 0) == mat21(n, 0) &&
-                 mat2(0, 0) == mat21(0, 0) && mat2(n, n) == mat21(n, n) &&
-                 mat2(0, n) == mat12(0, n) && mat2(n, 0) == mat12(n, 0)) ||
-                (mat2(0, 0) == mat12(0, 0) && mat2(n, n) == mat12(n, n) &&
-                 mat2(0, n) == mat21(0, n) && mat2(n, 0) == mat21(n, 0) &&
-                 mat1(0, 0) == mat21(0, 0) && mat1(n, n) == mat21(n, n) &&
-                 mat1(0, n) == mat12(0, n) && mat1(n, 0) == mat12(n, 0)))
+            if ((mat1[0, 0] == mat12[0, 0] && mat1[n, n] == mat12[n, n] &&
+                 mat1[0, n] == mat21[0, n] && mat1[n, 0] == mat21[n, 0] &&
+                 mat2[0, 0] == mat21[0, 0] && mat2[n, n] == mat21[n, n] &&
+                 mat2[0, n] == mat12[0, n] && mat2[n, 0] == mat12[n, 0]) ||
+                (mat2[0, 0] == mat12[0, 0] && mat2[n, n] == mat12[n, n] &&
+                 mat2[0, n] == mat21[0, n] && mat2[n, 0] == mat21[n, 0] &&
+                 mat1[0, 0] == mat21[0, 0] && mat1[n, n] == mat21[n, n] &&
+                 mat1[0, n] == mat12[0, n] && mat1[n, 0] == mat12[n, 0]))
             {
                 ++count;
             }
@@ -196,8 +660,8 @@ public:
         constexpr int M = 15;
         constexpr int m = M - 1;
 
-        constexpr int K = 20;
-        constexpr int k = 12;
+        constexpr int K = 200;
+        constexpr int k = 120;
 
         using Mat = ga_sm::static_matrix<int, M, N>;
 
@@ -219,14 +683,14 @@ public:
 
             Assert::IsTrue(mat1 + mat2 == mat12 + mat21);
 
-            if ((mat1(0, 0) == mat12(0, 0) && mat1(m, n) == mat12(m, n) &&
-                 mat1(0, n) == mat21(0, n) && mat1(m, 0) == mat21(m, 0) &&
-                 mat2(0, 0) == mat21(0, 0) && mat2(m, n) == mat21(m, n) &&
-                 mat2(0, n) == mat12(0, n) && mat2(m, 0) == mat12(m, 0)) ||
-                (mat2(0, 0) == mat12(0, 0) && mat2(m, n) == mat12(m, n) &&
-                 mat2(0, n) == mat21(0, n) && mat2(m, 0) == mat21(m, 0) &&
-                 mat1(0, 0) == mat21(0, 0) && mat1(m, n) == mat21(m, n) &&
-                 mat1(0, n) == mat12(0, n) && mat1(m, 0) == mat12(m, 0)))
+            if ((mat1[0, 0] == mat12[0, 0] && mat1[m, n] == mat12[m, n] &&
+                 mat1[0, n] == mat21[0, n] && mat1[m, 0] == mat21[m, 0] &&
+                 mat2[0, 0] == mat21[0, 0] && mat2[m, n] == mat21[m, n] &&
+                 mat2[0, n] == mat12[0, n] && mat2[m, 0] == mat12[m, 0]) ||
+                (mat2[0, 0] == mat12[0, 0] && mat2[m, n] == mat12[m, n] &&
+                 mat2[0, n] == mat21[0, n] && mat2[m, 0] == mat21[m, 0] &&
+                 mat1[0, 0] == mat21[0, 0] && mat1[m, n] == mat21[m, n] &&
+                 mat1[0, n] == mat12[0, n] && mat1[m, 0] == mat12[m, 0]))
             {
                 ++count;
             }
@@ -247,6 +711,13 @@ public:
         Assert::IsTrue(std::is_standard_layout_v<Mf5>);
     }
 
+    TEST_METHOD(assert_is_trivial_aligned_float)
+    {
+        Assert::IsTrue(std::is_trivial_v<Mf5a>);
+        Assert::IsTrue(std::is_standard_layout_v<Mf5a>);
+        Assert::IsTrue(alignof(Mf5a) == 32);
+    }
+
     TEST_METHOD(assert_is_trivially_copiable_int)
     {
         Assert::IsTrue(std::is_trivially_copyable_v<Mi5>);
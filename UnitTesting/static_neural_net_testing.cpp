@@ -1,13 +1,32 @@
 #include "pch.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <span>
 #include <string>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "CppUnitTest.h"
 #include "Random.hpp"
 #include "activation_functions.hpp"
+#include "backprop.hpp"
+#include "cached_neural_net.hpp"
+#include "dynamic_neural_net.hpp"
+#include "neat_neural_net.hpp"
+#include "net_arena.hpp"
+#include "net_image.hpp"
+#include "population_neural_net.hpp"
+#include "quantized_neural_net.hpp"
 #include "static_matrix.hpp"
 #include "static_neural_net.hpp"
 
@@ -27,6 +46,7 @@ public:
     inline static const matrix_activation_functions::Identifiers::Identifiers_ Sigmoid =
         matrix_activation_functions::Identifiers::Sigmoid;
 
+    inline static constexpr ga_snn::Layer_Signature a1{ 1, Sigmoid };
     inline static constexpr ga_snn::Layer_Signature a3{ 9, PReLU };
     inline static constexpr ga_snn::Layer_Signature a4{ 16, Sigmoid };
 
@@ -35,6 +55,8 @@ public:
     using L  = ga_snn::layer<T, 1, ga_snn::Layer_Structure{ 3, 3, PReLU }>;
     using LU = ga_snn::layer_unroll<T, 3, 1, a3>;
 
+    inline static constexpr auto L1_distance = [](T a, T b) { return std::abs(a - b); };
+
     TEST_METHOD(assert_init_from_ptr)
     {
         random::init();
@@ -44,7 +66,7 @@ public:
 
         uptr2->init_from_ptr(uptr1.get());
 
-        Assert::IsTrue(ga_snn::L1_net_distance<double>(*uptr1.get(), *uptr2.get()) == 0.0);
+        Assert::IsTrue(ga_snn::neural_net_distance<double>(*uptr1, *uptr2, L1_distance) == 0.0);
     }
 
     TEST_METHOD(assert_store_and_load)
@@ -55,7 +77,10 @@ public:
         auto uptr2 = std::make_unique<N>();
         uptr2->load(output_file);
 
-        Assert::IsTrue(ga_snn::L1_net_distance<double>(*uptr1.get(), *uptr2.get()) < epsilon);
+        Assert::IsTrue(
+            ga_snn::neural_net_distance<double>(*uptr1, *uptr2, L1_distance) <
+            epsilon
+        );
     }
 
     TEST_METHOD(assert_population_variability_same_net)
@@ -66,14 +91,15 @@ public:
         const auto uptr4 = std::make_unique<N>(*uptr1);
 
         const auto ret = ga_snn::population_variability<double, 4, N>(
-            { std::cref(*uptr1), std::cref(*uptr2), std::cref(*uptr3), std::cref(*uptr4) }
+            { std::cref(*uptr1), std::cref(*uptr2), std::cref(*uptr3), std::cref(*uptr4) },
+            L1_distance
         );
 
         for (int j = 0; j != 4; ++j)
         {
             for (int i = 0; i != 4; ++i)
             {
-                Assert::IsTrue(ret(j, i) < epsilon);
+                Assert::IsTrue(ret[j, i] < epsilon);
             }
         }
     }
@@ -86,16 +112,678 @@ public:
         auto uptr4 = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
 
         const auto ret = ga_snn::population_variability<double, 4, N>(
-            { std::cref(*uptr1), std::cref(*uptr2), std::cref(*uptr3), std::cref(*uptr4) }
+            { std::cref(*uptr1), std::cref(*uptr2), std::cref(*uptr3), std::cref(*uptr4) },
+            L1_distance
         );
 
         for (int j = 0; j != 4; ++j)
         {
             for (int i = 0; i != 4; ++i)
             {
-                Assert::IsTrue(ret(j, i) >= (j == i ? 0. : epsilon));
+                Assert::IsTrue(ret[j, i] >= (j == i ? 0. : epsilon));
+            }
+        }
+    }
+
+    TEST_METHOD(assert_quantized_net_close_to_float_net)
+    {
+        auto       uptr  = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+        const auto q_net = ga_snn::quantize(*uptr);
+
+        float       diff  = 0;
+        std::size_t count = 0;
+        for (int i = 0; i != 10; ++i)
+        {
+            N::input_type in{};
+            in.fill(random::randfloat);
+
+            const auto out   = uptr->forward_pass(in);
+            const auto q_out = q_net->forward_pass(in);
+            for (std::size_t j = 0; j != out.size(); ++j)
+            {
+                diff += std::abs(out.m_Elems[j] - q_out.m_Elems[j]);
+                ++count;
             }
         }
+        // 8 bit weights and inputs: about 1% of the output range on average,
+        // single outputs near a steep part of the activation can be further off
+        Assert::IsTrue(diff / static_cast<float>(count) < 0.05f);
+    }
+
+    TEST_METHOD(assert_view_forward_pass_equals_forward_pass)
+    {
+        auto uptr = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+
+        // Inputs and outputs of several games as rows of one matrix each
+        ga_sm::static_matrix<T, 4, 9>  inputs{};
+        ga_sm::static_matrix<T, 4, 16> outputs{};
+        inputs.fill(random::randfloat);
+
+        uptr->forward_pass(ga_sm::row_view<1>(std::as_const(inputs)), ga_sm::row_view<3>(outputs));
+
+        N::input_type in{};
+        for (std::size_t i = 0; i != in.size(); ++i)
+        {
+            in[0, i] = inputs[1, i];
+        }
+        const auto out = uptr->forward_pass(in);
+        for (std::size_t i = 0; i != out.size(); ++i)
+        {
+            Assert::IsTrue(outputs[3, i] == out[0, i]);
+            Assert::IsTrue(outputs[0, i] == 0.f);
+        }
+
+        const auto reshaped = uptr->forward_pass<4, 4>(ga_sm::cast_to_shape<3, 3>(in));
+        Assert::IsTrue(reshaped[1, 2] == out[0, 6]);
+    }
+
+    TEST_METHOD(assert_output_major_net_equals_input_major_net)
+    {
+        using ga_snn::weight_layout;
+
+        auto uptr   = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+        auto o_uptr = ga_snn::with_weight_layout<weight_layout::output_major>(*uptr);
+        auto back   = ga_snn::with_weight_layout<weight_layout::input_major>(*o_uptr);
+        static_assert(std::same_as<decltype(back)::element_type, N>);
+
+        // Same weights: converting back is exact, distances see no difference
+        Assert::IsTrue(*uptr == *back);
+        Assert::IsTrue(ga_snn::neural_net_distance<double>(*uptr, *o_uptr, ga_sm::distance::L1{}) == 0.0);
+        Assert::IsTrue(uptr->layer<1>().weight(2, 7) == o_uptr->layer<1>().weight(2, 7));
+
+        for (int i = 0; i != 10; ++i)
+        {
+            N::input_type in{};
+            in.fill(random::randfloat);
+
+            const auto out   = uptr->forward_pass(in);
+            const auto o_out = o_uptr->forward_pass(in);
+            for (std::size_t j = 0; j != out.size(); ++j)
+            {
+                Assert::IsTrue(std::abs(out.m_Elems[j] - o_out.m_Elems[j]) < epsilon);
+            }
+        }
+
+        // Text files hold the weights input-major in either layout
+        o_uptr->store(output_file);
+        auto loaded = std::make_unique<N>();
+        loaded->load(output_file);
+        uptr->store(output_file);
+        auto expected = std::make_unique<N>();
+        expected->load(output_file);
+        Assert::IsTrue(*loaded == *expected);
+    }
+
+    TEST_METHOD(assert_population_net_equals_each_net)
+    {
+        constexpr std::size_t P = 5;
+
+        std::array<std::unique_ptr<N>, P> nets;
+        std::array<N const*, P>           ptrs;
+        for (std::size_t p = 0; p != P; ++p)
+        {
+            nets[p] = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+            ptrs[p] = nets[p].get();
+        }
+
+        // One input at a time, as the nets
+        const auto population = ga_snn::stack_nets(ptrs);
+        N::input_type in{};
+        in.fill(random::randfloat);
+        const auto outs = population->forward_pass(in);
+        for (std::size_t p = 0; p != P; ++p)
+        {
+            const auto out = nets[p]->forward_pass(in);
+            for (std::size_t j = 0; j != out.size(); ++j)
+            {
+                Assert::IsTrue(std::abs(out.m_Elems[j] - outs[p].m_Elems[j]) < epsilon);
+            }
+        }
+
+        // Several inputs per forward_pass
+        constexpr std::size_t Rows    = 3;
+        const auto            batched = ga_snn::stack_nets<Rows>(ptrs);
+        ga_sm::static_matrix<T, Rows, N::s_Input_Size> ins{};
+        ins.fill(random::randfloat);
+        const auto batched_outs = batched->forward_pass(ins);
+        for (std::size_t r = 0; r != Rows; ++r)
+        {
+            for (std::size_t i = 0; i != N::s_Input_Size; ++i)
+            {
+                in[0, i] = ins[r, i];
+            }
+            for (std::size_t p = 0; p != P; ++p)
+            {
+                const auto out = nets[p]->forward_pass(in);
+                for (std::size_t j = 0; j != N::s_Output_Size; ++j)
+                {
+                    Assert::IsTrue(std::abs(out[0, j] - batched_outs[p][r, j]) < epsilon);
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(assert_rebatched_net_equals_net)
+    {
+        constexpr std::size_t Rows = 7;
+        using NR                   = N::with_batch_size<Rows>;
+
+        const auto net     = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+        const auto batched = std::make_unique<NR>();
+        batched->init_from(*net);
+
+        NR::input_type ins{};
+        ins.fill(random::randfloat);
+        const auto outs = batched->batch_forward_pass(ins);
+
+        N::input_type in{};
+        for (std::size_t r = 0; r != Rows; ++r)
+        {
+            for (std::size_t i = 0; i != N::s_Input_Size; ++i)
+            {
+                in[0, i] = ins[r, i];
+            }
+            const auto out = net->forward_pass(in);
+            for (std::size_t j = 0; j != N::s_Output_Size; ++j)
+            {
+                Assert::IsTrue(std::abs(out[0, j] - outs[r, j]) < epsilon);
+            }
+        }
+    }
+
+    TEST_METHOD(assert_executors_share_genome)
+    {
+        constexpr std::size_t Rows = 7;
+
+        const auto net     = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+        const auto batched = net->executor<Rows>();
+        const auto single  = net->executor<1>();
+        Assert::IsTrue(&batched.get_genome() == &net->get_genome());
+        Assert::IsTrue(&single.get_genome() == &net->get_genome());
+
+        // Mutations of the net are seen by its executors
+        net->mutate([](T x) { return x + 1; });
+
+        N::executor_type<Rows>::input_type ins{};
+        ins.fill(random::randfloat);
+        const auto outs = batched.batch_forward_pass(ins);
+
+        N::input_type in{};
+        for (std::size_t r = 0; r != Rows; ++r)
+        {
+            for (std::size_t i = 0; i != N::s_Input_Size; ++i)
+            {
+                in[0, i] = ins[r, i];
+            }
+            const auto out = net->forward_pass(in);
+            const auto one = single.forward_pass(in);
+            for (std::size_t j = 0; j != N::s_Output_Size; ++j)
+            {
+                Assert::IsTrue(std::abs(out[0, j] - outs[r, j]) < epsilon);
+                Assert::IsTrue(out[0, j] == one[0, j]);
+            }
+        }
+    }
+
+    TEST_METHOD(assert_workspace_forward_pass_equals_forward_pass)
+    {
+        // Too many hidden activations for the stack, the forward pass falls
+        // back to the thread's workspace
+        constexpr std::size_t Rows = 2048;
+        using NR                   = N::with_batch_size<Rows>;
+        static_assert(sizeof(NR::workspace_type) > NR::executor_type<>::s_Max_Stack_Activations);
+
+        const auto net = ga_snn::static_neural_net_factory<NR>(random::randnormal, 0, 1);
+        const auto ins = std::make_unique<NR::input_type>();
+        ins->fill(random::randfloat);
+        const auto outs      = std::make_unique<NR::output_type>();
+        const auto workspace = std::make_unique<NR::workspace_type>();
+        net->forward_pass(*ins, *outs, *workspace);
+        const auto thread_outs = std::make_unique<NR::output_type>();
+        net->forward_pass(*ins, *thread_outs);
+
+        const auto sample = net->executor<1>();
+        N::input_type in{};
+        for (std::size_t r = 0; r < Rows; r += 97)
+        {
+            for (std::size_t i = 0; i != N::s_Input_Size; ++i)
+            {
+                in[0, i] = (*ins)[r, i];
+            }
+            const auto out = sample.forward_pass(in);
+            for (std::size_t j = 0; j != N::s_Output_Size; ++j)
+            {
+                Assert::IsTrue(std::abs(out[0, j] - (*outs)[r, j]) < epsilon);
+                Assert::IsTrue((*outs)[r, j] == (*thread_outs)[r, j]);
+            }
+        }
+    }
+
+    TEST_METHOD(assert_arena_nets_are_contiguous_and_recycled)
+    {
+        constexpr std::size_t Population = 10;
+
+        ga_snn::net_arena<N> arena(Population);
+        Assert::IsTrue(arena.block_count() == 1);
+
+        std::vector<ga_snn::arena_ptr<N>> nets;
+        for (std::size_t i = 0; i != Population; ++i)
+        {
+            nets.push_back(arena.make(*ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1)));
+        }
+        Assert::IsTrue(arena.block_count() == 1);
+        Assert::IsTrue(arena.size() == Population);
+        for (std::size_t i = 1; i != Population; ++i)
+        {
+            const auto* prev = reinterpret_cast<const std::byte*>(nets[i - 1].get());
+            const auto* next = reinterpret_cast<const std::byte*>(nets[i].get());
+            Assert::IsTrue(static_cast<std::size_t>(next - prev) == ga_snn::net_arena<N>::s_Slot_Size);
+            Assert::IsTrue(&arena[nets[i].handle()] == nets[i].get());
+        }
+
+        // A released net's slot goes to the next one made
+        const auto handle = nets[3].handle();
+        nets[3].reset();
+        Assert::IsTrue(arena.size() == Population - 1);
+        nets[3] = arena.make(*nets[7]);
+        Assert::IsTrue(nets[3].handle() == handle);
+        Assert::IsTrue(*nets[3] == *nets[7]);
+        Assert::IsTrue(arena.block_count() == 1);
+
+        nets.clear();
+        Assert::IsTrue(arena.size() == 0);
+    }
+
+    TEST_METHOD(assert_dynamic_net_equals_static_net)
+    {
+        const auto net = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+        const ga_snn::dynamic_neural_net<T> dynamic_net(*net);
+        Assert::IsTrue(dynamic_net.layer_count() == N::s_Layers);
+        Assert::IsTrue(dynamic_net.parameter_count() == N::parameter_count());
+
+        // Rows in 4 row tiles and in single row tails
+        constexpr std::size_t Rows = 39;
+        std::vector<T>        ins(Rows * N::s_Input_Size);
+        std::vector<T>        static_outs(Rows * N::s_Output_Size);
+        std::vector<T>        dynamic_outs(Rows * N::s_Output_Size);
+        std::ranges::generate(ins, random::randfloat);
+        net->forward_pass(std::span<const T>(ins), std::span<T>(static_outs));
+        dynamic_net.forward_pass(std::span<const T>(ins), std::span<T>(dynamic_outs));
+        for (std::size_t i = 0; i != static_outs.size(); ++i)
+        {
+            Assert::IsTrue(std::abs(static_outs[i] - dynamic_outs[i]) < epsilon);
+        }
+    }
+
+    TEST_METHOD(assert_dynamic_net_store_loads_into_static_net)
+    {
+        const auto net = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+        ga_snn::dynamic_neural_net<T> dynamic_net(std::vector<ga_snn::Layer_Signature>(N::s_Signatures.begin(), N::s_Signatures.end()));
+        // Both from the file, which rounds the parameters
+        net->store(output_file);
+        net->load(output_file);
+        dynamic_net.load(output_file);
+
+        // Mutations of both, one layer at a time too, keep them the same net
+        const auto mutation = [](T x) { return x / 2 + T(0.25); };
+        const std::vector<std::size_t> layers{ 1, 3 };
+        net->mutate(mutation);
+        net->mutate_set_layers(layers, mutation);
+        dynamic_net.mutate(mutation);
+        dynamic_net.mutate_set_layers(layers, mutation);
+
+        dynamic_net.store(output_file);
+        auto loaded = std::make_unique<N>();
+        loaded->load(output_file);
+        net->store(output_file);
+        auto expected = std::make_unique<N>();
+        expected->load(output_file);
+        Assert::IsTrue(*loaded == *expected);
+    }
+
+    TEST_METHOD(assert_net_image_maps_population)
+    {
+        std::vector<std::unique_ptr<N>> population;
+        for (std::size_t i = 0; i != 21; ++i)
+        {
+            population.push_back(ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1));
+        }
+        ga_snn::store_net_image(output_file, population);
+
+        ga_snn::mapped_net_image<N> image(output_file);
+        Assert::IsTrue(image.size() == population.size());
+        for (std::size_t i = 0; i != image.size(); ++i)
+        {
+            Assert::IsTrue(image[i] == *population[i]);
+        }
+
+        // Mutations in place never reach the file
+        image[0].mutate([](T x) { return x + 1; });
+        const ga_snn::mapped_net_image<N> reopened(output_file);
+        Assert::IsTrue(reopened[0] == *population[0]);
+    }
+
+    TEST_METHOD(assert_net_image_maps_single_net)
+    {
+        const auto net = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+        ga_snn::store_net_image(output_file, *net);
+
+        const ga_snn::mapped_net_image<N> image(output_file);
+        Assert::IsTrue(image.size() == 1 && image[0] == *net);
+    }
+
+    TEST_METHOD(assert_net_image_rejects_truncated_images)
+    {
+        std::vector<std::unique_ptr<N>> population;
+        for (std::size_t i = 0; i != 3; ++i)
+        {
+            population.push_back(ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1));
+        }
+        ga_snn::store_net_image(output_file, population);
+
+        std::ifstream in(output_file, std::ios::binary);
+        const std::vector<char> file{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+        const auto image = std::as_bytes(std::span{ file });
+        Assert::IsTrue(ga_snn::net_image_error<N>(image) == nullptr);
+
+        // Cut inside the header, the signatures and the last net
+        const auto nets_offset = image.size() - population.size() * sizeof(N);
+        for (const std::size_t size : { sizeof(ga_snn::net_image_header) / 2, sizeof(ga_snn::net_image_header) + 1, nets_offset - 1, image.size() - 1 })
+        {
+            Assert::IsTrue(ga_snn::net_image_error<N>(image.first(size)) != nullptr);
+        }
+
+        // A count whose size in bytes wraps around
+        ga_snn::net_image_header header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        header.Count = std::numeric_limits<decltype(header.Count)>::max() / sizeof(N) + 1 + population.size();
+        std::vector<char> corrupt = file;
+        std::memcpy(corrupt.data(), &header, sizeof(header));
+        Assert::IsTrue(ga_snn::net_image_error<N>(std::as_bytes(std::span{ corrupt }), false) != nullptr);
+    }
+
+    // NEAT net of identity nodes, whose outputs are plain sums
+    using NEAT = ga_snn::neat_neural_net<T, 9, 2, matrix_activation_functions::Identifiers::Identity, matrix_activation_functions::Identifiers::Identity>;
+
+    TEST_METHOD(assert_neat_net_recompiles_on_structural_mutations_only)
+    {
+        NEAT net;
+        net.init([] { return T(1); });
+        net.set_mutation_rates({ 0, 0, 0 });
+        const auto compilations = net.compilations();
+
+        NEAT::input_type in{};
+        std::iota(in.begin(), in.end(), T(0));
+        net.mutate([](T x) { return 2 * x; });
+        Assert::IsTrue(net.compilations() == compilations);
+        // Every output: 2 * (0 + 1 + ... + 8) + 2
+        const auto out = net.forward_pass(in);
+        Assert::IsTrue(out[0, 0] == T(74) && out[0, 1] == T(74));
+
+        Assert::IsTrue(net.mutate_add_node());
+        Assert::IsTrue(net.compilations() == compilations + 1);
+    }
+
+    TEST_METHOD(assert_neat_net_split_keeps_outputs)
+    {
+        NEAT net;
+        net.init(random::randnormal, 0, 1);
+        NEAT::input_type in{};
+        std::generate(in.begin(), in.end(), random::randfloat);
+        const auto out = net.forward_pass(in);
+
+        // The split connection is replaced by a path of weights 1 and w
+        Assert::IsTrue(net.mutate_add_node());
+        Assert::IsTrue(net.hidden_count() == 1 && net.plan_hidden_count() == 1);
+        const auto split_out = net.forward_pass(in);
+        for (std::size_t j = 0; j != 2; ++j)
+        {
+            Assert::IsTrue(std::abs(out[0, j] - split_out[0, j]) < epsilon);
+        }
+    }
+
+    TEST_METHOD(assert_neat_net_rejects_cycles)
+    {
+        NEAT net;
+        // 0 -> n1 -> n2 -> output 9
+        Assert::IsTrue(net.mutate_add_node(0));
+        const auto n1 = net.nodes().back().Id;
+        const auto to_output = std::ranges::find_if(net.connections(), [&](const auto& c) { return c.In == n1; });
+        Assert::IsTrue(net.mutate_add_node(to_output->Innovation));
+        const auto n2 = net.nodes().back().Id;
+
+        Assert::IsTrue(!net.mutate_add_connection(n2, n1, T(1)));
+        Assert::IsTrue(!net.mutate_add_connection(9, n1, T(1)));
+        Assert::IsTrue(!net.mutate_add_connection(n1, n2, T(1)));
+        Assert::IsTrue(net.mutate_add_connection(1, n2, T(1)));
+        Assert::IsTrue(net.plan_hidden_count() == 2);
+    }
+
+    TEST_METHOD(assert_forward_pass_any_rows)
+    {
+        const auto net = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+
+        // Whole micro-batches, a tail of every size below one, and none at all
+        for (const std::size_t rows : { 0uz, 1uz, 5uz, N::s_Micro_Batch, 2 * N::s_Micro_Batch + 7 })
+        {
+            std::vector<T> ins(rows * N::s_Input_Size);
+            std::vector<T> outs(rows * N::s_Output_Size);
+            std::ranges::generate(ins, random::randfloat);
+            net->forward_pass(std::span<const T>(ins), std::span<T>(outs));
+
+            N::input_type in{};
+            for (std::size_t r = 0; r != rows; ++r)
+            {
+                std::copy_n(ins.begin() + r * N::s_Input_Size, N::s_Input_Size, in.begin());
+                const auto out = net->forward_pass(in);
+                for (std::size_t j = 0; j != N::s_Output_Size; ++j)
+                {
+                    Assert::IsTrue(std::abs(out[0, j] - outs[r * N::s_Output_Size + j]) < epsilon);
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(assert_scalar_forward_pass_equals_forward_pass)
+    {
+        using N1 = ga_snn::static_neural_net<T, 1, a1, a1, a1>;
+
+        const auto net = ga_snn::static_neural_net_factory<N1>(random::randnormal, 0, 1);
+        for (int i = 0; i != 10; ++i)
+        {
+            const T in = random::randfloat();
+            const auto out = net->forward_pass<1, 1>(ga_sm::static_matrix<T, 1, 1>{ in });
+            Assert::IsTrue(net->forward_pass(in) == out[0, 0]);
+        }
+    }
+
+    TEST_METHOD(assert_cached_net_equals_net_after_layer_mutations)
+    {
+        const auto net = ga_snn::static_neural_net_factory<N>(random::randnormal, 0, 1);
+        ga_snn::cached_neural_net<N> cached(*net);
+        const auto halve = [](T w) { return w / 2; };
+
+        const std::size_t rows = 2 * N::s_Micro_Batch + 5;
+        std::vector<T> ins(rows * N::s_Input_Size);
+        std::vector<T> outs(rows * N::s_Output_Size);
+        std::vector<T> cached_outs(rows * N::s_Output_Size);
+        std::ranges::generate(ins, random::randfloat);
+
+        const auto assert_equal_outputs = [&](ga_snn::cached_neural_net<N>& c) {
+            net->forward_pass(std::span<const T>(ins), std::span<T>(outs));
+            c.dataset_forward_pass(ins, cached_outs);
+            Assert::IsTrue(c.dirty_layers().none());
+            for (std::size_t i = 0; i != outs.size(); ++i)
+            {
+                Assert::IsTrue(std::abs(outs[i] - cached_outs[i]) < epsilon);
+            }
+        };
+
+        assert_equal_outputs(cached);
+
+        // Only the mutated layer is flagged, the outputs of the ones before
+        // it are reused
+        net->mutate_layer(2, halve);
+        cached.mutate_layer(2, halve);
+        Assert::IsTrue(cached.dirty_layers() == decltype(cached)::dirty_flags_type{ 0b0100 });
+        assert_equal_outputs(cached);
+
+        // Copies start from the cache of the net they copy, which keeps its
+        // own once a copy evaluates a mutation
+        const auto parent_outs = cached_outs;
+        auto child = cached;
+        net->mutate_set_layers({ 3 }, halve);
+        child.mutate_set_layers({ 3 }, halve);
+        Assert::IsTrue(child.dirty_layers() == decltype(child)::dirty_flags_type{ 0b1000 });
+        assert_equal_outputs(child);
+        cached.dataset_forward_pass(ins, cached_outs);
+        Assert::IsTrue(cached.dirty_layers().none());
+        Assert::IsTrue(cached_outs == parent_outs);
+
+        // A copy mutated as a whole leaves the shared cache alone
+        auto sibling = cached;
+        sibling.mutate(halve);
+        sibling.dataset_forward_pass(ins, cached_outs);
+        cached.dataset_forward_pass(ins, cached_outs);
+        Assert::IsTrue(cached_outs == parent_outs);
+
+        // The cache is keyed on the contents: the key of of is the one the
+        // span overload cached, and a hit does not read the dataset
+        int fills = 0;
+        const auto fill = [&](std::span<T> dst) {
+            ++fills;
+            std::ranges::copy(ins, dst.begin());
+        };
+        const auto key = ga_snn::dataset_key::of(std::span<const T>(ins), rows);
+        child.dataset_forward_pass(key, fill, cached_outs);
+        Assert::IsTrue(fills == 0);
+        for (std::size_t i = 0; i != outs.size(); ++i)
+        {
+            Assert::IsTrue(std::abs(outs[i] - cached_outs[i]) < epsilon);
+        }
+
+        // Another dataset evaluates every layer, as does one written over the
+        // cached one at the same address
+        std::vector<T> other_ins(ins.size());
+        std::ranges::generate(other_ins, random::randfloat);
+        ins.swap(other_ins);
+        assert_equal_outputs(child);
+        std::ranges::generate(ins, random::randfloat);
+        assert_equal_outputs(child);
+
+        // invalidate drops the cached dataset whatever its key
+        child.invalidate();
+        child.dataset_forward_pass(
+            ga_snn::dataset_key::of(std::span<const T>(ins), rows), fill, cached_outs
+        );
+        Assert::IsTrue(fills == 1);
+        for (std::size_t i = 0; i != outs.size(); ++i)
+        {
+            Assert::IsTrue(std::abs(outs[i] - cached_outs[i]) < epsilon);
+        }
+    }
+
+    TEST_METHOD(assert_backprop_gradient_equals_finite_differences)
+    {
+        using namespace matrix_activation_functions;
+        constexpr ga_snn::Layer_Signature in{ 4, Identifiers::ReLU };
+        constexpr ga_snn::Layer_Signature tanh{ 6, Identifiers::Tanh };
+        constexpr ga_snn::Layer_Signature gelu{ 5, Identifiers::GELU };
+        constexpr ga_snn::Layer_Signature swish{ 7, Identifiers::Swish };
+        constexpr ga_snn::Layer_Signature out{ 3, Identifiers::Softmax };
+        using D = ga_snn::basic_static_neural_net<double, 1, ga_snn::weight_layout::output_major, in, tanh, gelu, swish, out>;
+        using trainer = ga_snn::gradient_trainer<D, ga_snn::sgd<double>, ga_snn::cross_entropy>;
+
+        const auto net = ga_snn::static_neural_net_factory<D>(random::randnormal, 0, 1);
+        // A partial chunk of samples, which must not count its padding
+        const auto rows = trainer::s_Rows + 3;
+        std::vector<double> inputs(rows * D::s_Input_Size);
+        std::vector<double> targets(rows * D::s_Output_Size, 0.0);
+        std::ranges::generate(inputs, [] { return random::randnormal(0, 1); });
+        for (std::size_t r = 0; r != rows; ++r)
+        {
+            targets[r * D::s_Output_Size + r % D::s_Output_Size] = 1;
+        }
+
+        trainer t;
+        t.gradient(*net, inputs, targets);
+        const std::vector<double> gradient(t.gradients().begin(), t.gradients().end());
+
+        const double h = 1e-6;
+        std::vector<double> steps(D::s_Gradient_Size);
+        auto moved = std::make_unique<D>();
+        for (std::size_t p = 0; p != D::s_Gradient_Size; ++p)
+        {
+            *moved   = *net;
+            steps[p] = -h;
+            moved->descend(steps);
+            const auto forward = t.gradient(*moved, inputs, targets);
+            *moved   = *net;
+            steps[p] = h;
+            moved->descend(steps);
+            const auto backward = t.gradient(*moved, inputs, targets);
+            steps[p]            = 0;
+
+            Assert::IsTrue(std::abs((forward - backward) / (2 * h) - gradient[p]) < epsilon);
+        }
+    }
+
+    TEST_METHOD(assert_gradient_refinement_lowers_loss)
+    {
+        constexpr ga_snn::Layer_Signature in{ 1, Sigmoid };
+        constexpr ga_snn::Layer_Signature hidden{ 16, matrix_activation_functions::Identifiers::Tanh };
+        constexpr ga_snn::Layer_Signature out{ 1, matrix_activation_functions::Identifiers::Identity };
+        using R = ga_snn::static_neural_net<T, 1, in, hidden, hidden, out>;
+
+        std::vector<T> inputs(100);
+        std::vector<T> targets(100);
+        for (std::size_t i = 0; i != inputs.size(); ++i)
+        {
+            inputs[i]  = static_cast<T>(i) / 50 - 1;
+            targets[i] = std::sin(3 * inputs[i]);
+        }
+
+        auto net = ga_snn::static_neural_net_factory<R>(random::randnormal, 0, 0.5);
+        ga_snn::gradient_trainer<R> trainer(ga_snn::adam<T>(0.01f));
+        const auto loss = trainer.gradient(*net, inputs, targets);
+        trainer.refine(*net, inputs, targets, 500);
+        Assert::IsTrue(trainer.gradient(*net, inputs, targets) < loss / 4);
+    }
+
+    TEST_METHOD(assert_fast_activations_net_close_to_exact_net)
+    {
+        using namespace matrix_activation_functions;
+        constexpr ga_snn::Layer_Signature in{ 6, Identifiers::Identity };
+        constexpr ga_snn::Layer_Signature gelu{ 19, Identifiers::GELU };
+        constexpr ga_snn::Layer_Signature swish{ 11, Identifiers::Swish };
+        constexpr ga_snn::Layer_Signature tanh{ 9, Identifiers::Tanh };
+        constexpr ga_snn::Layer_Signature out{ 3, Identifiers::Sigmoid };
+        using E = ga_snn::static_neural_net<T, 1, in, gelu, swish, tanh, out>;
+        using F = E::with_activation_precision<activation_precision::fast>;
+
+        const auto exact = ga_snn::static_neural_net_factory<E>(random::randnormal, 0, 1);
+        auto       fast  = std::make_unique<F>();
+        fast->init_from(*exact);
+        const ga_snn::dynamic_neural_net<T> dynamic_fast(*fast);
+
+        const std::size_t rows = 2 * F::s_Micro_Batch + 3;
+        std::vector<T> ins(rows * E::s_Input_Size);
+        std::vector<T> exact_outs(rows * E::s_Output_Size);
+        std::vector<T> fast_outs(rows * E::s_Output_Size);
+        std::vector<T> dynamic_outs(rows * E::s_Output_Size);
+        std::ranges::generate(ins, [] { return random::randnormal(0, 2); });
+
+        exact->forward_pass(std::span<const T>(ins), std::span<T>(exact_outs));
+        fast->forward_pass(std::span<const T>(ins), std::span<T>(fast_outs));
+        dynamic_fast.forward_pass(std::span<const T>(ins), std::span<T>(dynamic_outs));
+        // The static and dynamic kernels sum in different orders, over four
+        // layers of N(0, 1) weights: up to 2e-5 apart over 3000 random nets
+        constexpr double tolerance = 5e-5;
+        for (std::size_t i = 0; i != exact_outs.size(); ++i)
+        {
+            Assert::IsTrue(std::abs(exact_outs[i] - fast_outs[i]) < tolerance);
+            Assert::IsTrue(std::abs(dynamic_outs[i] - fast_outs[i]) < tolerance);
+        }
     }
 
     TEST_METHOD(assert_staticneural_net_size)
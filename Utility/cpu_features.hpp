@@ -0,0 +1,171 @@
+#pragma once
+
+#ifndef CPU_FEATURES_UTILITY
+#define CPU_FEATURES_UTILITY
+
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+/*
+Runtime detection of the vector instruction sets the kernels are
+multi-versioned for. The tier is detected once (cpuid + xgetbv, so features
+the OS does not save on context switches are not reported) and cached.
+
+The environment variable GA_MAX_ISA (sse2, sse4.2, avx2, avx512) caps the
+detected tier, which allows exercising the lower kernels on newer hardware.
+*/
+
+namespace cpu_features
+{
+
+enum class isa : std::uint8_t
+{
+    sse2     = 0, // x86-64 baseline, also used on non x86 targets
+    sse4_2   = 1,
+    avx2_fma = 2, // AVX2 + FMA + F16C
+    avx512   = 3, // F + VL + BW + DQ
+};
+
+[[nodiscard]]
+constexpr auto isa_name(isa value) noexcept -> std::string_view
+{
+    switch (value)
+    {
+    case isa::sse2:
+        return "sse2";
+    case isa::sse4_2:
+        return "sse4.2";
+    case isa::avx2_fma:
+        return "avx2";
+    case isa::avx512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+namespace detail
+{
+
+#if defined(__x86_64__) || defined(__i386__)
+[[nodiscard]]
+inline auto xgetbv0() noexcept -> std::uint64_t
+{
+    std::uint32_t eax{}, edx{};
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (std::uint64_t{ edx } << 32) | eax;
+}
+#endif
+
+[[nodiscard]]
+inline auto detect_isa() noexcept -> isa
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax{}, ebx{}, ecx{}, edx{};
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        return isa::sse2;
+    }
+    const bool sse4_2  = ecx & bit_SSE4_2;
+    const bool fma     = ecx & bit_FMA;
+    const bool f16c    = ecx & bit_F16C;
+    const bool avx     = ecx & bit_AVX;
+    const bool osxsave = ecx & bit_OSXSAVE;
+    if (!sse4_2)
+    {
+        return isa::sse2;
+    }
+    if (!(avx && fma && f16c && osxsave))
+    {
+        return isa::sse4_2;
+    }
+
+    // XMM and YMM state (bits 1, 2) and opmask / ZMM state (bits 5, 6, 7)
+    const auto xcr0      = xgetbv0();
+    const bool os_avx    = (xcr0 & 0x06) == 0x06;
+    const bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+    if (!os_avx || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) ||
+        !(ebx & bit_AVX2))
+    {
+        return isa::sse4_2;
+    }
+
+    constexpr unsigned avx512_bits =
+        bit_AVX512F | bit_AVX512VL | bit_AVX512BW | bit_AVX512DQ;
+    if (os_avx512 && (ebx & avx512_bits) == avx512_bits)
+    {
+        return isa::avx512;
+    }
+    return isa::avx2_fma;
+#else
+    return isa::sse2;
+#endif
+}
+
+[[nodiscard]]
+inline auto isa_cap_from_env() noexcept -> isa
+{
+    const char* env = std::getenv("GA_MAX_ISA");
+    if (env == nullptr)
+    {
+        return isa::avx512;
+    }
+    const std::string_view name{ env };
+    for (auto value : { isa::sse2, isa::sse4_2, isa::avx2_fma, isa::avx512 })
+    {
+        if (name == isa_name(value))
+        {
+            return value;
+        }
+    }
+    return isa::avx512;
+}
+
+[[nodiscard]]
+inline auto detect_avx512_vnni() noexcept -> bool
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax{}, ebx{}, ecx{}, edx{};
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+        (ecx & bit_AVX512VNNI);
+#else
+    return false;
+#endif
+}
+
+} // namespace detail
+
+/**
+ * \brief Best instruction set tier available on this machine, capped by
+ *        GA_MAX_ISA. Detected on the first call.
+ */
+[[nodiscard]]
+inline auto active_isa() noexcept -> isa
+{
+    static const isa s_Isa = [] {
+        const auto detected = detail::detect_isa();
+        const auto cap      = detail::isa_cap_from_env();
+        return detected < cap ? detected : cap;
+    }();
+    return s_Isa;
+}
+
+/**
+ * \brief AVX512-VNNI (int8 dot products) on top of the avx512 tier. Off
+ *        when GA_MAX_ISA caps the tier below avx512.
+ */
+[[nodiscard]]
+inline auto has_avx512_vnni() noexcept -> bool
+{
+    static const bool s_Vnni =
+        active_isa() == isa::avx512 && detail::detect_avx512_vnni();
+    return s_Vnni;
+}
+
+} // namespace cpu_features
+
+#endif // !CPU_FEATURES_UTILITY